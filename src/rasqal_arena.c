@@ -0,0 +1,300 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_arena.c - Rasqal bump allocation arena
+ *
+ * Copyright (C) 2026, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+
+#ifndef STANDALONE
+
+/*
+ * An arena hands out memory from large blocks by moving a pointer
+ * forward.  Nothing is freed individually; all the memory goes back
+ * to the heap at once when the arena is freed.  Allocations larger
+ * than a quarter of a block get a block of their own so that they do
+ * not waste the rest of the current block.
+ */
+
+/* alignment of every allocation */
+#define RASQAL_ARENA_ALIGN (sizeof(double) > sizeof(void*) ? sizeof(double) : sizeof(void*))
+
+#define RASQAL_ARENA_ROUND(size) \
+  (((size) + RASQAL_ARENA_ALIGN - 1) & ~(RASQAL_ARENA_ALIGN - 1))
+
+/* default block size if none is given */
+#define RASQAL_ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+typedef struct rasqal_arena_block_s {
+  struct rasqal_arena_block_s* next;
+
+  /* bytes of data in this block */
+  size_t size;
+
+  /* bytes of data handed out */
+  size_t used;
+} rasqal_arena_block;
+
+struct rasqal_arena_s {
+  /* blocks with the current one first */
+  rasqal_arena_block* blocks;
+
+  /* size of normal blocks */
+  size_t block_size;
+
+  /* total bytes of blocks allocated from the heap */
+  size_t allocated;
+};
+
+
+#define RASQAL_ARENA_BLOCK_DATA(block) \
+  (RASQAL_GOOD_CAST(char*, block) + RASQAL_ARENA_ROUND(sizeof(rasqal_arena_block)))
+
+
+static rasqal_arena_block*
+rasqal_new_arena_block(rasqal_arena* arena, size_t size)
+{
+  rasqal_arena_block* block;
+
+  /* calloc so that all memory handed out starts zeroed */
+  block = RASQAL_CALLOC(rasqal_arena_block*, 1,
+                        RASQAL_ARENA_ROUND(sizeof(*block)) + size);
+  if(!block)
+    return NULL;
+
+  block->size = size;
+  arena->allocated += size;
+
+  return block;
+}
+
+
+/*
+ * rasqal_new_arena:
+ * @block_size: size of each block in bytes or 0 for the default
+ *
+ * INTERNAL - Constructor - create a new bump allocation arena
+ *
+ * Return value: new arena or NULL on failure
+ */
+rasqal_arena*
+rasqal_new_arena(size_t block_size)
+{
+  rasqal_arena* arena;
+
+  arena = RASQAL_CALLOC(rasqal_arena*, 1, sizeof(*arena));
+  if(!arena)
+    return NULL;
+
+  arena->block_size = block_size ? RASQAL_ARENA_ROUND(block_size) :
+                                   RASQAL_ARENA_DEFAULT_BLOCK_SIZE;
+
+  return arena;
+}
+
+
+/*
+ * rasqal_free_arena:
+ * @arena: arena
+ *
+ * INTERNAL - Destructor - free the arena and all memory allocated from it
+ */
+void
+rasqal_free_arena(rasqal_arena* arena)
+{
+  rasqal_arena_block* block;
+
+  if(!arena)
+    return;
+
+  block = arena->blocks;
+  while(block) {
+    rasqal_arena_block* next = block->next;
+    RASQAL_FREE(rasqal_arena_block, block);
+    block = next;
+  }
+
+  RASQAL_FREE(rasqal_arena, arena);
+}
+
+
+/*
+ * rasqal_arena_alloc:
+ * @arena: arena
+ * @size: number of bytes
+ *
+ * INTERNAL - Allocate zeroed, aligned memory from the arena
+ *
+ * The memory must not be freed; it is released by rasqal_free_arena().
+ *
+ * Return value: pointer to memory or NULL on failure
+ */
+void*
+rasqal_arena_alloc(rasqal_arena* arena, size_t size)
+{
+  rasqal_arena_block* block;
+  void* ptr;
+
+  size = RASQAL_ARENA_ROUND(size ? size : 1);
+
+  if(size > (arena->block_size >> 2)) {
+    /* dedicated block placed after the current one */
+    block = rasqal_new_arena_block(arena, size);
+    if(!block)
+      return NULL;
+
+    if(arena->blocks) {
+      block->next = arena->blocks->next;
+      arena->blocks->next = block;
+    } else
+      arena->blocks = block;
+
+    block->used = size;
+    return RASQAL_ARENA_BLOCK_DATA(block);
+  }
+
+  block = arena->blocks;
+  if(!block || block->size - block->used < size) {
+    block = rasqal_new_arena_block(arena, arena->block_size);
+    if(!block)
+      return NULL;
+
+    block->next = arena->blocks;
+    arena->blocks = block;
+  }
+
+  ptr = RASQAL_ARENA_BLOCK_DATA(block) + block->used;
+  block->used += size;
+
+  return ptr;
+}
+
+
+/*
+ * rasqal_arena_get_allocated:
+ * @arena: arena
+ *
+ * INTERNAL - Get the number of bytes the arena has taken from the heap
+ *
+ * Return value: size in bytes
+ */
+size_t
+rasqal_arena_get_allocated(rasqal_arena* arena)
+{
+  return arena->allocated;
+}
+
+#endif /* not STANDALONE */
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = rasqal_basename(argv[0]);
+  rasqal_arena* arena;
+  size_t sizes[] = { 1, 3, 8, 24, 100, 1000, 5000, 17 };
+  char* ptrs[8];
+  size_t align = sizeof(double) > sizeof(void*) ? sizeof(double) : sizeof(void*);
+  int failures = 0;
+  unsigned int i;
+
+  /* small blocks so that both the shared and dedicated block paths run */
+  arena = rasqal_new_arena(4096);
+  if(!arena) {
+    fprintf(stderr, "%s: failed to create arena\n", program);
+    return 1;
+  }
+
+  for(i = 0; i < 8; i++) {
+    size_t j;
+
+    ptrs[i] = RASQAL_GOOD_CAST(char*, rasqal_arena_alloc(arena, sizes[i]));
+    if(!ptrs[i]) {
+      fprintf(stderr, "%s: allocation #%u of %d bytes failed\n", program,
+              i, RASQAL_GOOD_CAST(int, sizes[i]));
+      failures++;
+      goto tidy;
+    }
+
+    if(RASQAL_GOOD_CAST(size_t, ptrs[i]) % align) {
+      fprintf(stderr, "%s: allocation #%u is not aligned\n", program, i);
+      failures++;
+    }
+
+    for(j = 0; j < sizes[i]; j++) {
+      if(ptrs[i][j]) {
+        fprintf(stderr, "%s: allocation #%u is not zeroed\n", program, i);
+        failures++;
+        break;
+      }
+    }
+
+    /* fill so that any overlap shows up below */
+    memset(ptrs[i], RASQAL_GOOD_CAST(int, i + 1), sizes[i]);
+  }
+
+  for(i = 0; i < 8; i++) {
+    size_t j;
+
+    for(j = 0; j < sizes[i]; j++) {
+      if(ptrs[i][j] != RASQAL_GOOD_CAST(char, i + 1)) {
+        fprintf(stderr, "%s: allocation #%u was overwritten\n", program, i);
+        failures++;
+        break;
+      }
+    }
+  }
+
+  if(rasqal_arena_get_allocated(arena) < 5000) {
+    fprintf(stderr, "%s: arena allocated %d bytes, expected at least 5000\n",
+            program, RASQAL_GOOD_CAST(int, rasqal_arena_get_allocated(arena)));
+    failures++;
+  }
+
+  tidy:
+  rasqal_free_arena(arena);
+
+  return failures;
+}
+
+#endif /* STANDALONE */
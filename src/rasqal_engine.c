@@ -31,6 +31,16 @@
 
 #include <stdio.h>
 #include <string.h>
+#ifdef TIME_WITH_SYS_TIME
+# include <sys/time.h>
+# include <time.h>
+#else
+# ifdef HAVE_SYS_TIME_H
+#  include <sys/time.h>
+# else
+#  include <time.h>
+# endif
+#endif
 
 #include <raptor.h>
 
@@ -62,6 +72,9 @@ static const char* const rasqal_engine_error_labels[RASQAL_ENGINE_ERROR_LAST+2]=
   "ok",
   "FAILED",
   "finished",
+  "FAILED (memory limit)",
+  "FAILED (timeout)",
+  "FAILED (cancelled)",
   "unknown"
 };
 
@@ -74,3 +87,196 @@ rasqal_engine_error_as_string(rasqal_engine_error error)
   return rasqal_engine_error_labels[RASQAL_GOOD_CAST(int, error)];
 }
 #endif
+
+
+#ifndef HAVE_GETTIMEOFDAY
+#define gettimeofday(x,y) rasqal_gettimeofday(x,y)
+#endif
+
+/*
+ * rasqal_execution_state_init:
+ * @state: execution state
+ * @timeout_ms: milliseconds the execution may run for or <= 0 for no limit
+ *
+ * INTERNAL - Start a query execution, setting any deadline from now
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_execution_state_init(rasqal_execution_state* state, int timeout_ms)
+{
+  state->cancelled = 0;
+  state->stopped = 0;
+  state->has_deadline = 0;
+  state->check_counter = 0;
+  state->error = RASQAL_ENGINE_OK;
+  state->parent = NULL;
+
+  if(timeout_ms > 0) {
+    double now;
+
+    rasqal_engine_get_times(&now, NULL);
+    if(now <= 0.0)
+      return 1;
+
+    state->deadline = now + RASQAL_GOOD_CAST(double, timeout_ms) / 1000.0;
+    state->has_deadline = 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_execution_state_init_child:
+ * @state: execution state
+ * @parent: state of the execution this is part of
+ *
+ * INTERNAL - Start part of an execution that runs on a worker thread
+ *
+ * The part has the deadline of @parent and stops when @parent is
+ * cancelled or stops with an error such as passing its deadline.
+ */
+void
+rasqal_execution_state_init_child(rasqal_execution_state* state,
+                                  rasqal_execution_state* parent)
+{
+  state->cancelled = 0;
+  state->stopped = 0;
+  state->has_deadline = parent->has_deadline;
+  state->deadline = parent->deadline;
+  state->check_counter = 0;
+  state->error = RASQAL_ENGINE_OK;
+  state->parent = parent;
+}
+
+
+/*
+ * rasqal_execution_state_check:
+ * @state: execution state
+ *
+ * INTERNAL - Check if a query execution has been cancelled or has run out of time
+ *
+ * Called from rowsource loops via RASQAL_EXECUTION_CHECK() so a
+ * cancel is seen on the next check but the clock is only read every
+ * #RASQAL_EXECUTION_CHECK_INTERVAL checks.  Once this returns non-0
+ * it always will for the rest of the execution.
+ *
+ * Return value: non-0 if the execution must stop
+ */
+int
+rasqal_execution_state_check(rasqal_execution_state* state)
+{
+  rasqal_execution_state* parent;
+  rasqal_engine_error error = RASQAL_ENGINE_OK;
+
+  if(state->error != RASQAL_ENGINE_OK)
+    return 1;
+
+  if(RASQAL_FLAG_GET(&state->cancelled))
+    error = RASQAL_ENGINE_FAILED_CANCELLED;
+
+  /* the states of the executions this is part of are run by other
+   * threads; their error is only written before they are stopped */
+  for(parent = state->parent; parent && error == RASQAL_ENGINE_OK;
+      parent = parent->parent) {
+    if(RASQAL_FLAG_GET(&parent->cancelled))
+      error = RASQAL_ENGINE_FAILED_CANCELLED;
+    else if(RASQAL_FLAG_GET(&parent->stopped))
+      error = parent->error;
+  }
+
+  if(error == RASQAL_ENGINE_OK && state->has_deadline &&
+     ++state->check_counter >= RASQAL_EXECUTION_CHECK_INTERVAL) {
+    double now;
+
+    state->check_counter = 0;
+    rasqal_engine_get_times(&now, NULL);
+    if(now > 0.0 && now >= state->deadline) {
+      RASQAL_DEBUG1("execution deadline passed\n");
+      error = RASQAL_ENGINE_FAILED_TIMEOUT;
+    }
+  }
+
+  if(error == RASQAL_ENGINE_OK)
+    return 0;
+
+  RASQAL_DEBUG2("execution stopped with error %u\n", error);
+  rasqal_execution_state_fail(state, error);
+  return 1;
+}
+
+
+/*
+ * rasqal_execution_state_fail:
+ * @state: execution state (or NULL)
+ * @error: execution error
+ *
+ * INTERNAL - Stop a query execution because a rowsource failed
+ *
+ * A rowsource can only return no row so this records why, for the
+ * engine to return as the execution error instead of the end of the
+ * results.  The first error recorded is kept and parts of the
+ * execution running on other threads stop with it.
+ */
+void
+rasqal_execution_state_fail(rasqal_execution_state* state,
+                            rasqal_engine_error error)
+{
+  if(state && state->error == RASQAL_ENGINE_OK) {
+    state->error = error;
+    RASQAL_FLAG_SET(&state->stopped);
+  }
+}
+
+
+/*
+ * rasqal_engine_get_times:
+ * @wall_p: pointer to store seconds of wall clock time
+ * @cpu_p: pointer to store seconds of CPU time of the calling thread or NULL
+ *
+ * INTERNAL - Read the clocks used to time parts of a query execution
+ *
+ * The times are from arbitrary starting points so only differences
+ * between two readings are meaningful.  Uses a monotonic clock when
+ * there is one; without per-thread CPU clocks the CPU time is of the
+ * whole process.
+ */
+void
+rasqal_engine_get_times(double* wall_p, double* cpu_p)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec wall;
+
+  if(clock_gettime(CLOCK_MONOTONIC, &wall))
+    *wall_p = 0.0;
+  else
+    *wall_p = RASQAL_GOOD_CAST(double, wall.tv_sec) +
+              RASQAL_GOOD_CAST(double, wall.tv_nsec) / 1000000000.0;
+#else
+  struct timeval wall;
+
+  if(gettimeofday(&wall, NULL))
+    *wall_p = 0.0;
+  else
+    *wall_p = RASQAL_GOOD_CAST(double, wall.tv_sec) +
+              RASQAL_GOOD_CAST(double, wall.tv_usec) / 1000000.0;
+#endif
+
+  if(!cpu_p)
+    return;
+
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_THREAD_CPUTIME_ID)
+  {
+    struct timespec cpu;
+
+    if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu))
+      *cpu_p = 0.0;
+    else
+      *cpu_p = RASQAL_GOOD_CAST(double, cpu.tv_sec) +
+               RASQAL_GOOD_CAST(double, cpu.tv_nsec) / 1000000000.0;
+  }
+#else
+  *cpu_p = RASQAL_GOOD_CAST(double, clock()) / CLOCKS_PER_SEC;
+#endif
+}
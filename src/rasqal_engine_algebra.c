@@ -35,6 +35,10 @@
 #include <stdlib.h>
 #endif
 #include <stdarg.h>
+/* for INT_MAX */
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
 
 #include "rasqal.h"
 #include "rasqal_internal.h"
@@ -42,6 +46,83 @@
 
 #define DEBUG_FH stderr
 
+/* morsels of the first triple pattern matches per worker for a BGP
+ * so that the workers finishing early take the remaining ones */
+#define RASQAL_ENGINE_MORSELS_PER_WORKER 4
+
+/* fewest matches of the first triple pattern in a morsel */
+#define RASQAL_ENGINE_MORSEL_MIN_SIZE 256
+
+
+/*
+ * Worker threads evaluating parts of one execution in parallel.
+ *
+ * Variable values live in the query so each worker binds them in a
+ * private prepared copy of the executing query.  The pattern algebra
+ * of a copy is built once when it is made and copies are reused by
+ * later tasks.  A task finds the node with the same ordinal as the
+ * part being evaluated and matches against the triples source of the
+ * execution which is shared read-only.
+ */
+typedef struct {
+  /* executing query */
+  rasqal_query* query;
+
+  rasqal_worker_pool* pool;
+
+  /* most tasks of this execution that may run at once */
+  int parallelism;
+
+  rasqal_triples_source* triples_source;
+  int graph_origins;
+
+  /* non-0 when evaluations must stop since the execution is finishing */
+  int stop;
+
+  /* lock for the fields below */
+  rasqal_mutex lock;
+
+  /* signalled when @running becomes 0 */
+  rasqal_cond idle;
+
+  /* tasks submitted and not finished */
+  int running;
+
+  /* #rasqal_engine_workers_copy of @query not in use by a worker */
+  raptor_sequence* copies;
+} rasqal_engine_workers;
+
+
+/* a query copy with its pattern algebra built once for all tasks */
+typedef struct {
+  rasqal_query* query;
+  rasqal_algebra_node* root;
+} rasqal_engine_workers_copy;
+
+
+typedef struct {
+  rasqal_engine_workers* workers;
+
+  rasqal_worker_task_handler handler;
+  void* task_data;
+} rasqal_engine_workers_task;
+
+
+struct rasqal_subplan_s {
+  rasqal_engine_workers* workers;
+
+  /* algebra node ordinal and operator */
+  int ordinal;
+  rasqal_algebra_node_operator op;
+
+  /* name of the variable bound to the origin or NULL */
+  const unsigned char* var_name;
+
+  /* variable names of the rows, shared with the executing query */
+  int size;
+  const unsigned char** names;
+};
+
 
 typedef struct {
   rasqal_query* query;
@@ -57,10 +138,50 @@ typedef struct {
   rasqal_rowsource* rowsource;
 
   rasqal_triples_source* triples_source;
+
+  /* non-0 if @triples_source is a shared one not owned here */
+  int triples_source_shared;
+
+  /* non-0 if the origins of the triples in @triples_source are the
+   * names of the query named data graphs */
+  int graph_origins;
+
+  /* number of GRAPH nodes around the node being turned into a rowsource */
+  int graph_depth;
+
+  /* rows read from @rowsource by rasqal_rowsource_read_batch() and
+   * not yet returned; array of size RASQAL_ROWSOURCE_BATCH_SIZE */
+  rasqal_row** batch;
+
+  /* number of rows in @batch */
+  int batch_count;
+
+  /* index of next row to return from @batch */
+  int batch_index;
+
+  /* cancellation and deadline state shared with the rowsources or NULL */
+  rasqal_execution_state* execution;
+
+  /* workers for parallel evaluation or NULL */
+  rasqal_engine_workers* workers;
+
+  /* number of rows to make ahead on a producer thread or 0 */
+  int prefetch_size;
+
+  /* rows made ahead on a producer thread or NULL before the first row
+   * is read */
+  rasqal_row_prefetch* prefetch;
+
+  /* BGP node whose morsels were last decided or NULL, with the
+   * decision, so the first triple pattern matches are counted once */
+  rasqal_algebra_node* morsels_node;
+  int morsels;
+  int morsel_size;
 } rasqal_engine_algebra_data;
 
 
 static rasqal_rowsource* rasqal_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data, rasqal_algebra_node* node, rasqal_engine_error *error_p);
+static rasqal_subplan* rasqal_engine_algebra_new_subplan(rasqal_engine_algebra_data* execution_data, rasqal_algebra_node* node, rasqal_rowsource* rowsource, rasqal_variable* var);
 
 
 static int
@@ -75,17 +196,155 @@ rasqal_engine_algebra_count_nodes(rasqal_query* query,
 }
 
 
+static int
+rasqal_engine_algebra_number_node(rasqal_query* query,
+                                  rasqal_algebra_node* node,
+                                  void* data)
+{
+  int *count_p = (int*)data;
+  node->ordinal = ++(*count_p);
+
+  return 0;
+}
+
+
+typedef struct {
+  int ordinal;
+  int count;
+  rasqal_algebra_node* node;
+} rasqal_engine_algebra_find_state;
+
+static int
+rasqal_engine_algebra_find_node(rasqal_query* query,
+                                rasqal_algebra_node* node,
+                                void* data)
+{
+  rasqal_engine_algebra_find_state *state;
+
+  state = (rasqal_engine_algebra_find_state*)data;
+  if(++state->count != state->ordinal)
+    return 0;
+
+  state->node = node;
+  /* found so stop */
+  return 1;
+}
+
+
+/*
+ * rasqal_algebra_bgp_node_get_morsels:
+ * @execution_data: execution data
+ * @node: BGP algebra node
+ * @morsel_size_p: pointer to store the morsel size
+ *
+ * INTERNAL - Get the number of morsels to split the first triple pattern matches of a BGP into
+ *
+ * A BGP of several triple patterns is evaluated on the worker threads
+ * in morsels when the triples source can count the matches of the
+ * first triple pattern cheaply and there are enough of them.
+ *
+ * The decision for the last node asked about is remembered since a
+ * BGP is asked about when trying to fuse it into a pipeline and again
+ * when it is made into a rowsource.
+ *
+ * Return value: number of morsels or 0 to evaluate in the calling thread
+ */
+static int
+rasqal_algebra_bgp_node_get_morsels(rasqal_engine_algebra_data* execution_data,
+                                    rasqal_algebra_node* node,
+                                    int* morsel_size_p)
+{
+  rasqal_engine_workers* workers = execution_data->workers;
+  rasqal_triple* t;
+  rasqal_variable* s;
+  rasqal_variable* p;
+  rasqal_variable* o;
+  long count = 0;
+  long morsels;
+
+  if(node == execution_data->morsels_node) {
+    *morsel_size_p = execution_data->morsel_size;
+    return execution_data->morsels;
+  }
+
+  execution_data->morsels_node = node;
+  execution_data->morsels = 0;
+  execution_data->morsel_size = 0;
+
+  if(!workers || execution_data->graph_depth || !node->triples ||
+     node->end_column <= node->start_column)
+    return 0;
+
+  t = (rasqal_triple*)raptor_sequence_get_at(node->triples, node->start_column);
+  if(t->origin)
+    return 0;
+
+  /* a count is only defined with each variable used once */
+  s = rasqal_literal_as_variable(t->subject);
+  p = rasqal_literal_as_variable(t->predicate);
+  o = rasqal_literal_as_variable(t->object);
+  if((s && (s == p || s == o)) || (p && p == o))
+    return 0;
+
+  if(rasqal_triples_source_triple_count(execution_data->triples_source, t,
+                                        &count))
+    return 0;
+
+  morsels = workers->parallelism * RASQAL_ENGINE_MORSELS_PER_WORKER;
+  if(count / RASQAL_ENGINE_MORSEL_MIN_SIZE < morsels)
+    morsels = count / RASQAL_ENGINE_MORSEL_MIN_SIZE;
+  if(morsels < 2)
+    return 0;
+
+  execution_data->morsels = RASQAL_GOOD_CAST(int, morsels);
+  execution_data->morsel_size = RASQAL_GOOD_CAST(int,
+                                                 (count + morsels - 1) / morsels);
+  *morsel_size_p = execution_data->morsel_size;
+
+  return execution_data->morsels;
+}
+
+
 static rasqal_rowsource*
 rasqal_algebra_basic_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
                                                rasqal_algebra_node* node,
                                                rasqal_engine_error *error_p)
 {
   rasqal_query *query = execution_data->query;
+  rasqal_rowsource* rs;
+  rasqal_subplan* subplan;
+  int morsel_size = 0;
+  int morsels;
+
+  rs = rasqal_new_triples_rowsource(query->world, query,
+                                    execution_data->triples_source,
+                                    node->triples,
+                                    node->start_column, node->end_column);
+  if(!rs)
+    return NULL;
+
+  morsels = rasqal_algebra_bgp_node_get_morsels(execution_data, node,
+                                                &morsel_size);
+  if(morsels) {
+    /* Evaluate morsels of the first triple pattern matches on worker
+     * threads.  Rows are returned in match order unless they are
+     * sorted later.
+     */
+    subplan = rasqal_engine_algebra_new_subplan(execution_data, node, rs,
+                                                NULL);
+    if(subplan) {
+      RASQAL_DEBUG3("Evaluating BGP in %d morsels of %d matches\n", morsels,
+                    morsel_size);
+      if(rasqal_triples_rowsource_set_subplan(rs, subplan, morsels,
+                                              morsel_size,
+                                              rasqal_query_get_order_condition(query, 0) != NULL)) {
+        rasqal_free_rowsource(rs);
+        return NULL;
+      }
+    }
+  }
 
-  return rasqal_new_triples_rowsource(query->world, query,
-                                      execution_data->triples_source,
-                                      node->triples,
-                                      node->start_column, node->end_column);
+  return rs;
 }
 
 
@@ -131,6 +390,109 @@ rasqal_algebra_orderby_algebra_node_to_rowsource(rasqal_engine_algebra_data* exe
 }
 
 
+static int
+rasqal_algebra_union_node_add_branches(rasqal_algebra_node* node,
+                                       raptor_sequence* branches)
+{
+  if(node->op != RASQAL_ALGEBRA_OPERATOR_UNION)
+    return raptor_sequence_push(branches, node);
+
+  if(rasqal_algebra_union_node_add_branches(node->node1, branches))
+    return 1;
+
+  return rasqal_algebra_union_node_add_branches(node->node2, branches);
+}
+
+
+/*
+ * rasqal_algebra_union_algebra_node_to_parallel_rowsource:
+ * @execution_data: execution data
+ * @node: UNION algebra node
+ * @error_p: execution error (out)
+ *
+ * INTERNAL - Create a rowsource evaluating the branches of a UNION and any nested UNIONs in parallel
+ *
+ * The branches are evaluated in the executing thread too if any
+ * cannot be a subplan.  Rows are returned in branch order unless
+ * they are sorted later.
+ *
+ * Return value: rowsource or NULL on failure
+ */
+static rasqal_rowsource*
+rasqal_algebra_union_algebra_node_to_parallel_rowsource(rasqal_engine_algebra_data* execution_data,
+                                                        rasqal_algebra_node* node,
+                                                        rasqal_engine_error *error_p)
+{
+  rasqal_query *query = execution_data->query;
+  raptor_sequence* branches;
+  raptor_sequence* subplans = NULL;
+  rasqal_rowsource *rs = NULL;
+  int count;
+  int i;
+
+  /* branch nodes are owned by @node */
+  branches = raptor_new_sequence(NULL, NULL);
+  if(!branches ||
+     rasqal_algebra_union_node_add_branches(node, branches))
+    goto failed;
+
+  subplans = raptor_new_sequence((raptor_data_free_handler)rasqal_free_subplan,
+                                 NULL);
+  if(!subplans)
+    goto failed;
+
+  count = raptor_sequence_size(branches);
+  for(i = 0; i < count; i++) {
+    rasqal_algebra_node* branch;
+    rasqal_rowsource *branch_rs;
+
+    branch = (rasqal_algebra_node*)raptor_sequence_get_at(branches, i);
+    branch_rs = rasqal_algebra_node_to_rowsource(execution_data, branch,
+                                                 error_p);
+    if((error_p && *error_p) || !branch_rs)
+      goto failed;
+
+    if(subplans) {
+      rasqal_subplan* subplan;
+
+      subplan = rasqal_engine_algebra_new_subplan(execution_data, branch,
+                                                  branch_rs, NULL);
+      if(!subplan || raptor_sequence_push(subplans, subplan)) {
+        raptor_free_sequence(subplans);
+        subplans = NULL;
+      }
+    }
+
+    if(!rs)
+      rs = branch_rs;
+    else {
+      /* the last UNION rowsource gets the subplans of all branches */
+      rs = rasqal_new_union_rowsource(query->world, query, rs, branch_rs,
+                                      (i == count - 1) ? subplans : NULL,
+                                      rasqal_query_get_order_condition(query, 0) != NULL);
+      if(i == count - 1)
+        subplans = NULL;
+      if(!rs)
+        goto failed;
+    }
+  }
+
+  raptor_free_sequence(branches);
+
+  return rs;
+
+  failed:
+  if(rs)
+    rasqal_free_rowsource(rs);
+  if(subplans)
+    raptor_free_sequence(subplans);
+  if(branches)
+    raptor_free_sequence(branches);
+
+  return NULL;
+}
+
+
 static rasqal_rowsource*
 rasqal_algebra_union_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
                                                rasqal_algebra_node* node,
@@ -140,6 +502,11 @@ rasqal_algebra_union_algebra_node_to_rowsource(rasqal_engine_algebra_data* execu
   rasqal_rowsource *left_rs;
   rasqal_rowsource *right_rs;
 
+  if(execution_data->workers)
+    return rasqal_algebra_union_algebra_node_to_parallel_rowsource(execution_data,
+                                                                   node,
+                                                                   error_p);
+
   left_rs = rasqal_algebra_node_to_rowsource(execution_data, node->node1,
                                              error_p);
   if((error_p && *error_p) || !left_rs)
@@ -152,7 +519,8 @@ rasqal_algebra_union_algebra_node_to_rowsource(rasqal_engine_algebra_data* execu
     return NULL;
   }
 
-  return rasqal_new_union_rowsource(query->world, query, left_rs, right_rs);
+  return rasqal_new_union_rowsource(query->world, query, left_rs, right_rs,
+                                    NULL, 0);
 }
 
 
@@ -223,51 +591,708 @@ rasqal_algebra_join_algebra_node_to_rowsource(rasqal_engine_algebra_data* execut
 }
 
 
-static rasqal_rowsource*
-rasqal_algebra_assignment_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
-                                                    rasqal_algebra_node* node,
-                                                    rasqal_engine_error *error_p)
-{
-  rasqal_query *query = execution_data->query;
+static rasqal_rowsource*
+rasqal_algebra_assignment_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
+                                                    rasqal_algebra_node* node,
+                                                    rasqal_engine_error *error_p)
+{
+  rasqal_query *query = execution_data->query;
+
+  return rasqal_new_assignment_rowsource(query->world, query, node->var,
+                                         node->expr);
+}
+
+
+static int
+rasqal_algebra_visitor_set_origin(rasqal_query* query,
+                                  rasqal_algebra_node* node,
+                                  void *user_data)
+{
+  rasqal_literal *origin = (rasqal_literal*)user_data;
+  int i;
+
+  if(node->op != RASQAL_ALGEBRA_OPERATOR_BGP)
+    return 0;
+
+  for(i = node->start_column; i <= node->end_column; i++) {
+    rasqal_triple *t;
+    rasqal_literal *o = NULL;
+
+    t = (rasqal_triple*)raptor_sequence_get_at(node->triples, i);
+    if(origin)
+      o = rasqal_new_literal_from_literal(origin);
+
+    rasqal_triple_set_origin(t, o);
+  }
+  return 0;
+}
+
+
+static void
+rasqal_algebra_node_set_origin(rasqal_query *query,
+                               rasqal_algebra_node* node,
+                               rasqal_literal *origin)
+{
+  rasqal_algebra_node_visit(query, node,
+                            rasqal_algebra_visitor_set_origin,
+                            origin);
+}
+
+
+static void
+rasqal_free_engine_workers_copy(rasqal_engine_workers_copy* copy)
+{
+  if(copy->root)
+    rasqal_free_algebra_node(copy->root);
+  if(copy->query)
+    rasqal_free_query(copy->query);
+
+  RASQAL_FREE(rasqal_engine_workers_copy, copy);
+}
+
+
+/*
+ * rasqal_new_engine_workers:
+ * @execution_data: execution data
+ *
+ * INTERNAL - Create the workers for parallel evaluation of an execution
+ *
+ * Return value: workers or NULL if the execution is evaluated in the calling thread
+ */
+static rasqal_engine_workers*
+rasqal_new_engine_workers(rasqal_engine_algebra_data* execution_data)
+{
+  rasqal_query* query = execution_data->query;
+  rasqal_engine_workers* workers;
+  rasqal_worker_pool* pool;
+  int parallelism;
+
+  parallelism = query->features[RASQAL_FEATURE_PARALLELISM];
+  if(parallelism <= 0)
+    return NULL;
+
+  if(!rasqal_triples_source_support_feature(execution_data->triples_source,
+                                            RASQAL_TRIPLES_SOURCE_FEATURE_SHARED))
+    return NULL;
+
+  /* worker threads make URIs at the same time as this one */
+  if(rasqal_world_get_uri_interning(query->world)) {
+    rasqal_log_warning_simple(query->world, RASQAL_WARNING_LEVEL_MISSING_SUPPORT,
+                              &query->locator,
+                              "Parallelism feature ignored since the raptor world interns URIs");
+    return NULL;
+  }
+
+  pool = rasqal_world_get_worker_pool(query->world, parallelism);
+  if(!pool)
+    return NULL;
+
+  workers = RASQAL_CALLOC(rasqal_engine_workers*, 1, sizeof(*workers));
+  if(!workers)
+    return NULL;
+
+  workers->copies = raptor_new_sequence((raptor_data_free_handler)rasqal_free_engine_workers_copy,
+                                        NULL);
+  if(!workers->copies) {
+    RASQAL_FREE(rasqal_engine_workers, workers);
+    return NULL;
+  }
+
+  RASQAL_MUTEX_INIT(&workers->lock);
+  RASQAL_COND_INIT(&workers->idle);
+  workers->query = query;
+  workers->pool = pool;
+  if(parallelism > rasqal_worker_pool_get_size(pool))
+    parallelism = rasqal_worker_pool_get_size(pool);
+  workers->parallelism = parallelism;
+  workers->triples_source = execution_data->triples_source;
+  workers->graph_origins = execution_data->graph_origins;
+
+  return workers;
+}
+
+
+/*
+ * rasqal_free_engine_workers:
+ * @workers: workers
+ *
+ * INTERNAL - Destructor - stop evaluations and free the workers after all their tasks finish
+ *
+ * Rowsources are reference counted by rows so they may outlive the
+ * execution; their tasks are finished here instead before the
+ * triples source they match against is freed.
+ */
+static void
+rasqal_free_engine_workers(rasqal_engine_workers* workers)
+{
+  if(!workers)
+    return;
+
+  RASQAL_FLAG_SET(&workers->stop);
+
+  RASQAL_MUTEX_LOCK(&workers->lock);
+  while(workers->running)
+    RASQAL_COND_WAIT(&workers->idle, &workers->lock);
+  RASQAL_MUTEX_UNLOCK(&workers->lock);
+
+  raptor_free_sequence(workers->copies);
+  RASQAL_COND_DESTROY(&workers->idle);
+  RASQAL_MUTEX_DESTROY(&workers->lock);
+
+  RASQAL_FREE(rasqal_engine_workers, workers);
+}
+
+
+static rasqal_engine_workers_copy*
+rasqal_engine_workers_get_copy(rasqal_engine_workers* workers)
+{
+  rasqal_engine_workers_copy* copy;
+
+  RASQAL_MUTEX_LOCK(&workers->lock);
+  copy = (rasqal_engine_workers_copy*)raptor_sequence_pop(workers->copies);
+  RASQAL_MUTEX_UNLOCK(&workers->lock);
+
+  if(copy)
+    return copy;
+
+  copy = RASQAL_CALLOC(rasqal_engine_workers_copy*, 1, sizeof(*copy));
+  if(!copy)
+    return NULL;
+
+  /* workers match against the triples source of the execution */
+  copy->query = rasqal_query_copy_for_execution(workers->query, 0);
+  if(copy->query)
+    copy->root = rasqal_algebra_query_to_algebra(copy->query);
+
+  if(!copy->root) {
+    rasqal_free_engine_workers_copy(copy);
+    return NULL;
+  }
+
+  return copy;
+}
+
+
+static void
+rasqal_engine_workers_put_copy(rasqal_engine_workers* workers,
+                               rasqal_engine_workers_copy* copy)
+{
+  RASQAL_MUTEX_LOCK(&workers->lock);
+  /* frees the copy on failure */
+  raptor_sequence_push(workers->copies, copy);
+  RASQAL_MUTEX_UNLOCK(&workers->lock);
+}
+
+
+static int
+rasqal_engine_algebra_add_bgp_node(rasqal_query* query,
+                                   rasqal_algebra_node* node,
+                                   void* data)
+{
+  raptor_sequence* seq = (raptor_sequence*)data;
+
+  if(node->op == RASQAL_ALGEBRA_OPERATOR_BGP && node->triples)
+    return raptor_sequence_push(seq, node);
+
+  return 0;
+}
+
+
+/*
+ * rasqal_engine_algebra_node_binds_variables:
+ * @query: query
+ * @node: algebra node
+ * @var: variable bound outside @node that may be used or NULL
+ *
+ * INTERNAL - Test if every variable of the triple patterns inside a node is bound inside it
+ *
+ * A triple pattern using a variable bound by a triple pattern
+ * elsewhere in the query matches the current value of the variable
+ * which a query copy does not have.
+ *
+ * Return value: non-0 if @node can be evaluated on its own
+ */
+static int
+rasqal_engine_algebra_node_binds_variables(rasqal_query* query,
+                                           rasqal_algebra_node* node,
+                                           rasqal_variable* var)
+{
+  raptor_sequence* bgps;
+  int bgps_count;
+  int result = 1;
+  int i;
+
+  bgps = raptor_new_sequence(NULL, NULL);
+  if(!bgps)
+    return 0;
+
+  if(rasqal_algebra_node_visit(query, node,
+                               rasqal_engine_algebra_add_bgp_node, bgps)) {
+    raptor_free_sequence(bgps);
+    return 0;
+  }
+
+  bgps_count = raptor_sequence_size(bgps);
+  for(i = 0; result && i < bgps_count; i++) {
+    rasqal_algebra_node* bgp = (rasqal_algebra_node*)raptor_sequence_get_at(bgps, i);
+    int column;
+
+    for(column = bgp->start_column;
+        result && column <= bgp->end_column; column++) {
+      rasqal_triple* t;
+      rasqal_literal* parts[3];
+      int p;
+
+      t = (rasqal_triple*)raptor_sequence_get_at(bgp->triples, column);
+      parts[0] = t->subject;
+      parts[1] = t->predicate;
+      parts[2] = t->object;
+
+      for(p = 0; result && p < 3; p++) {
+        rasqal_variable* v = rasqal_literal_as_variable(parts[p]);
+        int bound = 0;
+        int j;
+
+        if(!v || v == var)
+          continue;
+
+        for(j = 0; !bound && j < bgps_count; j++) {
+          rasqal_algebra_node* b;
+          int c;
+
+          b = (rasqal_algebra_node*)raptor_sequence_get_at(bgps, j);
+          for(c = b->start_column; !bound && c <= b->end_column; c++)
+            bound = (rasqal_query_variable_bound_in_triple(query, v, c) != 0);
+        }
+
+        result = bound;
+      }
+    }
+  }
+
+  raptor_free_sequence(bgps);
+
+  return result;
+}
+
+
+/*
+ * rasqal_engine_algebra_new_subplan:
+ * @execution_data: execution data
+ * @node: algebra node
+ * @rowsource: rowsource evaluating @node in the executing query
+ * @var: variable to bind to the origin of each evaluation or NULL
+ *
+ * INTERNAL - Create a subplan to evaluate an algebra node on worker threads
+ *
+ * Return value: new subplan or NULL if @node must be evaluated in the calling thread
+ */
+static rasqal_subplan*
+rasqal_engine_algebra_new_subplan(rasqal_engine_algebra_data* execution_data,
+                                  rasqal_algebra_node* node,
+                                  rasqal_rowsource* rowsource,
+                                  rasqal_variable* var)
+{
+  rasqal_engine_workers* workers = execution_data->workers;
+  rasqal_subplan* subplan;
+  rasqal_engine_workers_copy* copy;
+  int i;
+
+  /* the origin set by an enclosing GRAPH is not known here */
+  if(!workers || !node->ordinal || execution_data->graph_depth)
+    return NULL;
+
+  if(!rasqal_engine_algebra_node_binds_variables(execution_data->query, node,
+                                                 var))
+    return NULL;
+
+  /* a query that cannot be copied is evaluated in the calling thread */
+  copy = rasqal_engine_workers_get_copy(workers);
+  if(!copy)
+    return NULL;
+  rasqal_engine_workers_put_copy(workers, copy);
+
+  if(rasqal_rowsource_ensure_variables(rowsource))
+    return NULL;
+
+  subplan = RASQAL_CALLOC(rasqal_subplan*, 1, sizeof(*subplan));
+  if(!subplan)
+    return NULL;
+
+  subplan->workers = workers;
+  subplan->ordinal = node->ordinal;
+  subplan->op = node->op;
+  subplan->var_name = var ? var->name : NULL;
+  subplan->size = rasqal_rowsource_get_size(rowsource);
+  subplan->names = RASQAL_CALLOC(const unsigned char**,
+                                 RASQAL_GOOD_CAST(size_t, subplan->size + 1),
+                                 sizeof(unsigned char*));
+  if(!subplan->names) {
+    RASQAL_FREE(rasqal_subplan, subplan);
+    return NULL;
+  }
+
+  for(i = 0; i < subplan->size; i++) {
+    rasqal_variable* v = rasqal_rowsource_get_variable_by_offset(rowsource, i);
+    subplan->names[i] = v->name;
+  }
+
+  return subplan;
+}
+
+
+/*
+ * rasqal_free_subplan:
+ * @subplan: subplan
+ *
+ * INTERNAL - Destructor - free a subplan once no task is executing it
+ */
+void
+rasqal_free_subplan(rasqal_subplan* subplan)
+{
+  if(!subplan)
+    return;
+
+  if(subplan->names)
+    RASQAL_FREE(unsigned char**, subplan->names);
+
+  RASQAL_FREE(rasqal_subplan, subplan);
+}
+
+
+/*
+ * rasqal_subplan_get_size:
+ * @subplan: subplan
+ *
+ * INTERNAL - Get the number of values in each row of a subplan
+ *
+ * Return value: number of values
+ */
+int
+rasqal_subplan_get_size(rasqal_subplan* subplan)
+{
+  return subplan->size;
+}
+
+
+/*
+ * rasqal_subplan_get_variable_name:
+ * @subplan: subplan
+ * @offset: value offset
+ *
+ * INTERNAL - Get the name of the variable of a value in the rows of a subplan
+ *
+ * Return value: shared variable name
+ */
+const unsigned char*
+rasqal_subplan_get_variable_name(rasqal_subplan* subplan, int offset)
+{
+  return subplan->names[offset];
+}
+
+
+/*
+ * rasqal_subplan_free_values:
+ * @subplan: subplan
+ * @values: row values from rasqal_subplan_execute()
+ *
+ * INTERNAL - Free the values of a row of a subplan
+ */
+void
+rasqal_subplan_free_values(rasqal_subplan* subplan, rasqal_literal** values)
+{
+  int i;
+
+  for(i = 0; i < subplan->size; i++) {
+    if(values[i])
+      rasqal_free_literal(values[i]);
+  }
+  RASQAL_FREE(rasqal_literal**, values);
+}
+
+
+/*
+ * rasqal_subplan_get_parallelism:
+ * @subplan: subplan
+ *
+ * INTERNAL - Get the most tasks executing a subplan that should run at once
+ *
+ * Return value: number of tasks
+ */
+int
+rasqal_subplan_get_parallelism(rasqal_subplan* subplan)
+{
+  return subplan->workers->parallelism;
+}
+
+
+/*
+ * rasqal_subplan_submit:
+ * @subplan: subplan
+ * @handler: task function that calls rasqal_subplan_execute()
+ * @task_data: data for @handler
+ *
+ * INTERNAL - Queue a task on the worker pool of a subplan
+ *
+ * Return value: non-0 on failure
+ */
+static void
+rasqal_engine_workers_run_task(void* data)
+{
+  rasqal_engine_workers_task* task = (rasqal_engine_workers_task*)data;
+  rasqal_engine_workers* workers = task->workers;
+
+  task->handler(task->task_data);
+  RASQAL_FREE(rasqal_engine_workers_task, task);
+
+  RASQAL_MUTEX_LOCK(&workers->lock);
+  if(!--workers->running)
+    RASQAL_COND_BROADCAST(&workers->idle);
+  RASQAL_MUTEX_UNLOCK(&workers->lock);
+}
+
+
+int
+rasqal_subplan_submit(rasqal_subplan* subplan,
+                      rasqal_worker_task_handler handler, void* task_data)
+{
+  rasqal_engine_workers* workers = subplan->workers;
+  rasqal_engine_workers_task* task;
+
+  task = RASQAL_CALLOC(rasqal_engine_workers_task*, 1, sizeof(*task));
+  if(!task)
+    return 1;
+
+  task->workers = workers;
+  task->handler = handler;
+  task->task_data = task_data;
+
+  RASQAL_MUTEX_LOCK(&workers->lock);
+  workers->running++;
+  RASQAL_MUTEX_UNLOCK(&workers->lock);
+
+  if(rasqal_worker_pool_submit(workers->pool, rasqal_engine_workers_run_task,
+                               task)) {
+    RASQAL_FREE(rasqal_engine_workers_task, task);
+
+    RASQAL_MUTEX_LOCK(&workers->lock);
+    if(!--workers->running)
+      RASQAL_COND_BROADCAST(&workers->idle);
+    RASQAL_MUTEX_UNLOCK(&workers->lock);
+
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_subplan_execute:
+ * @subplan: subplan
+ * @parent: execution state of the executing query or NULL
+ * @origin: origin of the triples to match or NULL
+ * @range_start: first match of the first triple pattern to use
+ * @range_end: match of the first triple pattern to stop at or <0 for all
+ * @handler: function called with each row
+ * @user_data: data for @handler
+ * @error_p: execution error (out)
+ *
+ * INTERNAL - Evaluate a subplan on the calling worker thread
+ *
+ * @handler is given each row as a new array of subplan size values
+ * in the variable order of the executing query rowsource and takes
+ * ownership of it.  It returns non-0 to stop the evaluation.
+ *
+ * A range other than 0 to <0 evaluates one morsel of a BGP subplan
+ * with only those matches of its first triple pattern.
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_subplan_execute(rasqal_subplan* subplan,
+                       rasqal_execution_state* parent,
+                       rasqal_literal* origin,
+                       int range_start, int range_end,
+                       rasqal_subplan_row_handler handler,
+                       void* user_data,
+                       rasqal_engine_error* error_p)
+{
+  rasqal_engine_workers* workers = subplan->workers;
+  rasqal_engine_algebra_data worker_data;
+  rasqal_execution_state execution;
+  rasqal_engine_algebra_find_state find_state;
+  rasqal_engine_error error = RASQAL_ENGINE_OK;
+  rasqal_engine_workers_copy* copy;
+  rasqal_rowsource* rs = NULL;
+  rasqal_variable* var = NULL;
+  int* offsets = NULL;
+  int i;
+
+  copy = rasqal_engine_workers_get_copy(workers);
+  if(!copy) {
+    *error_p = RASQAL_ENGINE_FAILED;
+    return 1;
+  }
+
+  if(parent)
+    rasqal_execution_state_init_child(&execution, parent);
+  else
+    rasqal_execution_state_init(&execution, 0);
+
+  memset(&worker_data, '\0', sizeof(worker_data));
+  worker_data.query = copy->query;
+  worker_data.triples_source = workers->triples_source;
+  worker_data.triples_source_shared = 1;
+  worker_data.graph_origins = workers->graph_origins;
+  worker_data.execution = &execution;
+
+  find_state.ordinal = subplan->ordinal;
+  find_state.count = 0;
+  find_state.node = NULL;
+  rasqal_algebra_node_visit(copy->query, copy->root,
+                            rasqal_engine_algebra_find_node,
+                            &find_state);
+  if(!find_state.node || find_state.node->op != subplan->op) {
+    RASQAL_DEBUG2("No algebra node %d in query copy\n", subplan->ordinal);
+    error = RASQAL_ENGINE_FAILED;
+    goto tidy;
+  }
+
+  /* the origin is set on the rowsource as the graph rowsource does */
+  if(origin)
+    rasqal_algebra_node_set_origin(copy->query, find_state.node, NULL);
+
+  rs = rasqal_algebra_node_to_rowsource(&worker_data, find_state.node, &error);
+  if(!rs || error != RASQAL_ENGINE_OK) {
+    error = RASQAL_ENGINE_FAILED;
+    goto tidy;
+  }
+
+  if((range_start > 0 || range_end >= 0) &&
+     rasqal_triples_rowsource_set_range(rs, range_start, range_end)) {
+    error = RASQAL_ENGINE_FAILED;
+    goto tidy;
+  }
+
+  rasqal_rowsource_set_execution_state(rs, &execution);
+  if(origin)
+    rasqal_rowsource_set_origin(rs, origin);
+
+  if(origin && subplan->var_name) {
+    var = rasqal_variables_table_get_by_name(copy->query->vars_table,
+                                             RASQAL_VARIABLE_TYPE_NORMAL,
+                                             subplan->var_name);
+    if(var)
+      rasqal_variable_set_value(var, rasqal_new_literal_from_literal(origin));
+  }
+
+  offsets = RASQAL_CALLOC(int*, RASQAL_GOOD_CAST(size_t, subplan->size + 1),
+                          sizeof(int));
+  if(!offsets || rasqal_rowsource_ensure_variables(rs)) {
+    error = RASQAL_ENGINE_FAILED;
+    goto tidy;
+  }
+
+  for(i = 0; i < subplan->size; i++)
+    offsets[i] = rasqal_rowsource_get_variable_offset_by_name(rs,
+                                                              subplan->names[i]);
+
+  while(1) {
+    rasqal_row* row;
+    rasqal_literal** values;
+
+    if(RASQAL_FLAG_GET(&workers->stop))
+      break;
+
+    row = rasqal_rowsource_read_row(rs);
+    if(!row)
+      break;
+
+    values = RASQAL_CALLOC(rasqal_literal**,
+                           RASQAL_GOOD_CAST(size_t, subplan->size + 1),
+                           sizeof(rasqal_literal*));
+    if(!values) {
+      rasqal_free_row(row);
+      error = RASQAL_ENGINE_FAILED;
+      break;
+    }
+
+    /* rows belong to the copy so hand back their values */
+    for(i = 0; i < subplan->size; i++) {
+      if(offsets[i] >= 0 && row->values[offsets[i]])
+        values[i] = rasqal_new_literal_from_literal(row->values[offsets[i]]);
+    }
+    rasqal_free_row(row);
+
+    if(handler(user_data, values))
+      break;
+  }
+
+  if(error == RASQAL_ENGINE_OK && rasqal_execution_state_check(&execution))
+    error = execution.error;
+
+  tidy:
+  if(var)
+    rasqal_variable_set_value(var, NULL);
+  if(offsets)
+    RASQAL_FREE(int*, offsets);
+  if(rs)
+    rasqal_free_rowsource(rs);
+
+  rasqal_engine_workers_put_copy(workers, copy);
+
+  if(error != RASQAL_ENGINE_OK) {
+    *error_p = error;
+    return 1;
+  }
 
-  return rasqal_new_assignment_rowsource(query->world, query, node->var,
-                                         node->expr);
+  return 0;
 }
 
 
+/*
+ * rasqal_algebra_graph_node_is_single_pass:
+ * @execution_data: execution data
+ * @node: GRAPH algebra node
+ * @v: GRAPH variable
+ *
+ * INTERNAL - Test if GRAPH ?var can bind ?var from triple origins in one pass
+ *
+ * That needs an inner BGP of at least one triple pattern that does
+ * not otherwise mention ?var and a triples source holding the named
+ * graphs of the query dataset as triple origins.  Anything else is
+ * evaluated one named graph at a time.
+ *
+ * Return value: non-0 if one pass over the triples can be used
+ */
 static int
-rasqal_algebra_visitor_set_origin(rasqal_query* query,
-                                  rasqal_algebra_node* node,
-                                  void *user_data)
+rasqal_algebra_graph_node_is_single_pass(rasqal_engine_algebra_data* execution_data,
+                                         rasqal_algebra_node* node,
+                                         rasqal_variable* v)
 {
-  rasqal_literal *origin = (rasqal_literal*)user_data;
-  int i;
+  rasqal_algebra_node* bgp_node = node->node1;
+  int column;
 
-  if(node->op != RASQAL_ALGEBRA_OPERATOR_BGP)
+  if(!execution_data->graph_origins)
     return 0;
 
-  for(i = node->start_column; i <= node->end_column; i++) {
-    rasqal_triple *t;
-    rasqal_literal *o = NULL;
+  if(!bgp_node || bgp_node->op != RASQAL_ALGEBRA_OPERATOR_BGP ||
+     !bgp_node->triples || bgp_node->start_column > bgp_node->end_column)
+    return 0;
 
-    t = (rasqal_triple*)raptor_sequence_get_at(node->triples, i);
-    if(origin)
-      o = rasqal_new_literal_from_literal(origin);
+  for(column = bgp_node->start_column; column <= bgp_node->end_column;
+      column++) {
+    rasqal_triple *t;
 
-    rasqal_triple_set_origin(t, o);
+    t = (rasqal_triple*)raptor_sequence_get_at(bgp_node->triples, column);
+    if(rasqal_literal_as_variable(t->subject) == v ||
+       rasqal_literal_as_variable(t->predicate) == v ||
+       rasqal_literal_as_variable(t->object) == v)
+      return 0;
   }
-  return 0;
-}
-
 
-static void
-rasqal_algebra_node_set_origin(rasqal_query *query,
-                               rasqal_algebra_node* node,
-                               rasqal_literal *origin)
-{
-  rasqal_algebra_node_visit(query, node,
-                            rasqal_algebra_visitor_set_origin,
-                            origin);
+  return 1;
 }
 
 
@@ -280,6 +1305,7 @@ rasqal_algebra_graph_algebra_node_to_rowsource(rasqal_engine_algebra_data* execu
   rasqal_rowsource *rs;
   rasqal_literal *graph = node->graph;
   rasqal_variable* v;
+  rasqal_subplan* subplan;
 
   if(!graph) {
     RASQAL_DEBUG1("graph algebra node has NULL graph\n");
@@ -329,13 +1355,13 @@ eval(D(G), Graph(IRI,P)) = the empty multiset
        */
       rasqal_algebra_node_set_origin(query, node->node1, graph);
 
+      execution_data->graph_depth++;
       rs = rasqal_algebra_node_to_rowsource(execution_data, node->node1,
                                             error_p);
+      execution_data->graph_depth--;
     } else {
-      /* case #2 - IRI is not a graph name in D - return empty rowsource */
-      rasqal_free_algebra_node(node->node1);
-      node->node1 = NULL;
-
+      /* case #2 - IRI is not a graph name in D - return empty rowsource
+       * leaving the algebra as it is for workers that reuse it */
       rs = rasqal_new_empty_rowsource(query->world, query);
     }
 
@@ -349,11 +1375,42 @@ eval(D(G), Graph(IRI,P)) = the empty multiset
 
 
   /* case #3 - a variable */
+  if(rasqal_algebra_graph_node_is_single_pass(execution_data, node, v)) {
+    /* Match the triple patterns against all named graphs at once
+     * binding the variable from the origin of each matched triple
+     * instead of evaluating them once per named graph.
+     */
+    rasqal_algebra_node_set_origin(query, node->node1, graph);
+
+    execution_data->graph_depth++;
+    rs = rasqal_algebra_node_to_rowsource(execution_data, node->node1,
+                                          error_p);
+    execution_data->graph_depth--;
+    if((error_p && *error_p) && rs) {
+      rasqal_free_rowsource(rs);
+      rs = NULL;
+    }
+
+    return rs;
+  }
+
+  /* the graph rowsource sets the origin for each named graph */
+  rasqal_algebra_node_set_origin(query, node->node1, NULL);
+
+  execution_data->graph_depth++;
   rs = rasqal_algebra_node_to_rowsource(execution_data, node->node1, error_p);
+  execution_data->graph_depth--;
   if((error_p && *error_p) || !rs)
     return NULL;
 
-  return rasqal_new_graph_rowsource(query->world, query, rs, v);
+  /* Evaluate the named graphs on worker threads if possible.  Rows
+   * are returned in named graph order unless they are sorted later.
+   */
+  subplan = rasqal_engine_algebra_new_subplan(execution_data, node->node1,
+                                              rs, v);
+
+  return rasqal_new_graph_rowsource(query->world, query, rs, v, subplan,
+                                    rasqal_query_get_order_condition(query, 0) != NULL);
 }
 
 
@@ -389,6 +1446,79 @@ rasqal_algebra_group_algebra_node_to_rowsource(rasqal_engine_algebra_data* execu
 }
 
 
+/*
+ * rasqal_algebra_aggregation_count_rowsource:
+ * @execution_data: execution data
+ * @node: AGGREGATION algebra node
+ *
+ * INTERNAL - Make a count rowsource for COUNT over a single triple pattern if possible
+ *
+ * Handles (COUNT(*) AS ?c), (COUNT(?v) AS ?c) and
+ * (COUNT(DISTINCT ?v) AS ?c) with no GROUP BY over a BGP of one
+ * triple pattern that binds ?v.
+ *
+ * Return value: new rowsource or NULL if not possible
+ */
+static rasqal_rowsource*
+rasqal_algebra_aggregation_count_rowsource(rasqal_engine_algebra_data* execution_data,
+                                           rasqal_algebra_node* node)
+{
+  rasqal_query *query = execution_data->query;
+  rasqal_algebra_node* bgp_node = node->node1;
+  rasqal_expression* expr;
+  rasqal_variable* v = NULL;
+  rasqal_triple* t;
+  rasqal_triple_parts parts;
+
+  if(bgp_node->op != RASQAL_ALGEBRA_OPERATOR_BGP || !bgp_node->triples ||
+     bgp_node->start_column != bgp_node->end_column ||
+     !execution_data->triples_source ||
+     raptor_sequence_size(node->seq) != 1)
+    return NULL;
+
+  expr = (rasqal_expression*)raptor_sequence_get_at(node->seq, 0);
+  if(expr->op != RASQAL_EXPR_COUNT || expr->args || !expr->arg1)
+    return NULL;
+
+  if(expr->arg1->op == RASQAL_EXPR_VARSTAR) {
+    if(expr->flags & RASQAL_EXPR_FLAG_DISTINCT)
+      return NULL;
+  } else if(expr->arg1->op == RASQAL_EXPR_LITERAL) {
+    v = rasqal_literal_as_variable(expr->arg1->literal);
+    if(!v)
+      return NULL;
+  } else
+    return NULL;
+
+  parts = rasqal_count_rowsource_pattern_parts(query, bgp_node->triples,
+                                               bgp_node->start_column);
+  if(!parts)
+    return NULL;
+
+  if(v) {
+    /* the counted variable must be bound by the pattern */
+    t = (rasqal_triple*)raptor_sequence_get_at(bgp_node->triples,
+                                               bgp_node->start_column);
+    if(v != rasqal_literal_as_variable(t->subject) &&
+       v != rasqal_literal_as_variable(t->predicate) &&
+       v != rasqal_literal_as_variable(t->object))
+      return NULL;
+
+    /* always bound so COUNT(?v) counts every match */
+    if(!(expr->flags & RASQAL_EXPR_FLAG_DISTINCT))
+      v = NULL;
+  }
+
+  RASQAL_DEBUG1("Counting single triple pattern without making rows\n");
+
+  return rasqal_new_count_rowsource(query->world, query,
+                                    execution_data->triples_source,
+                                    bgp_node->triples, bgp_node->start_column,
+                                    v,
+                                    (rasqal_variable*)raptor_sequence_get_at(node->vars_seq, 0));
+}
+
+
 static rasqal_rowsource*
 rasqal_algebra_aggregation_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
                                                      rasqal_algebra_node* node,
@@ -396,6 +1526,29 @@ rasqal_algebra_aggregation_algebra_node_to_rowsource(rasqal_engine_algebra_data*
 {
   rasqal_query *query = execution_data->query;
   rasqal_rowsource *rs;
+  rasqal_algebra_node* group_node = node->node1;
+
+  rs = rasqal_algebra_aggregation_count_rowsource(execution_data, node);
+  if(rs)
+    return rs;
+
+  if(group_node->op == RASQAL_ALGEBRA_OPERATOR_GROUP &&
+     rasqal_aggregation_expressions_can_hash(node->seq)) {
+    /* Group and aggregate in one step without buffering group rows.
+     * A BGP below may be matched in morsels on worker threads but the
+     * groups are aggregated here in the calling thread: aggregate
+     * states are not combined from per-morsel partial aggregates.
+     */
+    rs = rasqal_algebra_node_to_rowsource(execution_data, group_node->node1,
+                                          error_p);
+    if((error_p && *error_p) || !rs)
+      return NULL;
+
+    return rasqal_new_hash_aggregation_rowsource(query->world, query, rs,
+                                                 group_node->seq,
+                                                 node->seq,
+                                                 node->vars_seq);
+  }
 
   rs = rasqal_algebra_node_to_rowsource(execution_data, node->node1, error_p);
   if((error_p && *error_p) || !rs)
@@ -466,6 +1619,105 @@ rasqal_algebra_service_algebra_node_to_rowsource(rasqal_engine_algebra_data* exe
 }
 
 
+/*
+ * rasqal_algebra_pipeline_algebra_node_to_rowsource:
+ * @execution_data: execution data
+ * @node: algebra node
+ * @error_p: error pointer
+ *
+ * INTERNAL - Fuse a linear SLICE, PROJECT and FILTER chain over a BGP
+ *
+ * Matches an optional SLICE over an optional PROJECT over zero or
+ * more FILTERs over a BGP, with at least one operator above the
+ * BGP, and makes one pipeline rowsource for the whole chain.
+ *
+ * Return value: rowsource or NULL if @node does not start such a chain or on failure
+ */
+static rasqal_rowsource*
+rasqal_algebra_pipeline_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
+                                                  rasqal_algebra_node* node,
+                                                  rasqal_engine_error *error_p)
+{
+  rasqal_query *query = execution_data->query;
+  rasqal_algebra_node* slice_node = NULL;
+  rasqal_algebra_node* project_node = NULL;
+  rasqal_algebra_node* filter_node;
+  rasqal_algebra_node* n = node;
+  raptor_sequence* filters_seq = NULL;
+  int filters_count = 0;
+  rasqal_rowsource* rs;
+  int i;
+
+  if(n->op == RASQAL_ALGEBRA_OPERATOR_SLICE) {
+    slice_node = n;
+    n = n->node1;
+  }
+
+  if(n && n->op == RASQAL_ALGEBRA_OPERATOR_PROJECT) {
+    project_node = n;
+    n = n->node1;
+  }
+
+  filter_node = n;
+  while(n && n->op == RASQAL_ALGEBRA_OPERATOR_FILTER && n->expr) {
+    filters_count++;
+    n = n->node1;
+  }
+
+  if(!n || n->op != RASQAL_ALGEBRA_OPERATOR_BGP || !n->triples)
+    return NULL;
+
+  /* nothing to fuse */
+  if(!slice_node && !project_node && !filters_count)
+    return NULL;
+
+  /* a BGP evaluated in morsels on worker threads is not fused */
+  if(rasqal_algebra_bgp_node_get_morsels(execution_data, n, &i))
+    return NULL;
+
+  if(filters_count) {
+    filters_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                                      (raptor_data_print_handler)rasqal_expression_print);
+    if(!filters_seq)
+      goto failed;
+
+    /* innermost FILTER first as they are applied in that order */
+    for(i = 0; i < filters_count; i++) {
+      rasqal_expression* e;
+
+      e = rasqal_new_expression_from_expression(filter_node->expr);
+      if(!e || raptor_sequence_shift(filters_seq, e))
+        goto failed;
+      filter_node = filter_node->node1;
+    }
+  }
+
+  rs = rasqal_new_triples_rowsource(query->world, query,
+                                    execution_data->triples_source,
+                                    n->triples,
+                                    n->start_column, n->end_column);
+  if(!rs)
+    goto failed;
+
+  RASQAL_DEBUG4("Fusing %s%s%d FILTER over BGP into a pipeline rowsource\n",
+                slice_node ? "SLICE, " : "", project_node ? "PROJECT, " : "",
+                filters_count);
+
+  /* rs and filters_seq become owned by the pipeline rowsource */
+  return rasqal_new_pipeline_rowsource(query->world, query, rs, filters_seq,
+                                       project_node ? project_node->vars_seq : NULL,
+                                       slice_node ? slice_node->limit : -1,
+                                       slice_node ? slice_node->offset : 0);
+
+  failed:
+  if(filters_seq)
+    raptor_free_sequence(filters_seq);
+  *error_p = RASQAL_ENGINE_FAILED;
+
+  return NULL;
+}
+
+
 static rasqal_rowsource*
 rasqal_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
                                  rasqal_algebra_node* node,
@@ -473,6 +1725,12 @@ rasqal_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
 {
   rasqal_rowsource* rs = NULL;
 
+  /* a linear chain over a BGP is run as a single pipeline */
+  rs = rasqal_algebra_pipeline_algebra_node_to_rowsource(execution_data,
+                                                         node, error_p);
+  if(rs || *error_p != RASQAL_ENGINE_OK)
+    return rs;
+
   switch(node->op) {
     case RASQAL_ALGEBRA_OPERATOR_BGP:
       rs = rasqal_algebra_basic_algebra_node_to_rowsource(execution_data,
@@ -588,12 +1846,25 @@ rasqal_query_engine_algebra_execute_init(void* ex_data,
   rasqal_solution_modifier* modifier;
   rasqal_algebra_node* node;
   rasqal_algebra_aggregate* ae;
+  int query_graphs;
 
   execution_data = (rasqal_engine_algebra_data*)ex_data;
 
   /* initialise the execution_data fields */
   execution_data->query = query;
   execution_data->query_results = query_results;
+  execution_data->execution = rasqal_query_results_get_execution_state(query_results);
+
+  /* the results pass the query data graphs unless the execution was
+   * given a set of its own */
+  query_graphs = (!data_graphs || data_graphs == query->data_graphs);
+
+  /* the query data graphs are already in a shared triples source */
+  if(!execution_data->triples_source && query_graphs &&
+     query->shared_triples_source) {
+    execution_data->triples_source = query->shared_triples_source;
+    execution_data->triples_source_shared = 1;
+  }
 
   if(!execution_data->triples_source) {
     execution_data->triples_source = rasqal_new_triples_source(execution_data->query, data_graphs);
@@ -601,6 +1872,11 @@ rasqal_query_engine_algebra_execute_init(void* ex_data,
       *error_p = RASQAL_ENGINE_FAILED;
       return 1;
     }
+
+    /* GRAPH patterns range over the query data graphs */
+    execution_data->graph_origins = query_graphs &&
+      rasqal_triples_source_support_feature(execution_data->triples_source,
+                                            RASQAL_TRIPLES_SOURCE_FEATURE_GRAPH_ORIGINS);
   }
 
   projection = rasqal_query_get_projection(query);
@@ -610,6 +1886,15 @@ rasqal_query_engine_algebra_execute_init(void* ex_data,
   if(!node)
     return 1;
 
+  /* number the pattern nodes so workers can find them in query copies */
+  execution_data->workers = rasqal_new_engine_workers(execution_data);
+  if(execution_data->workers) {
+    int count = 0;
+
+    rasqal_algebra_node_visit(query, node, rasqal_engine_algebra_number_node,
+                              &count);
+  }
+
   node = rasqal_algebra_query_add_group_by(query, node, modifier);
   if(!node)
     return 1;
@@ -681,10 +1966,73 @@ rasqal_query_engine_algebra_execute_init(void* ex_data,
   if(error != RASQAL_ENGINE_OK)
     rc = 1;
 
+  if(!rc && execution_data->rowsource && execution_data->execution)
+    rasqal_rowsource_set_execution_state(execution_data->rowsource,
+                                         execution_data->execution);
+
+  if(!rc && execution_data->rowsource &&
+     query->features[RASQAL_FEATURE_PROFILE])
+    rasqal_rowsource_set_profile(execution_data->rowsource, 1);
+
+  if(!rc && execution_data->rowsource) {
+    int limit = rasqal_query_get_limit(query);
+    int offset = rasqal_query_get_offset(query);
+
+    /* Ensure ASK queries never do more than one result */
+    if(query->verb == RASQAL_QUERY_VERB_ASK)
+      limit = 1;
+
+    /* the query results module applies the outer LIMIT and OFFSET
+     * so tell the rowsources how many rows that will read */
+    if(limit >= 0) {
+      if(offset < 0)
+        offset = 0;
+      if(limit <= INT_MAX - offset)
+        rasqal_rowsource_set_rows_needed(execution_data->rowsource,
+                                         offset + limit);
+    }
+
+    /* only SELECT rows can be read on another thread: the results of
+     * other query forms bind the query variables from each row read */
+    if(query->verb == RASQAL_QUERY_VERB_SELECT && !(flags & 1))
+      execution_data->prefetch_size = query->features[RASQAL_FEATURE_PREFETCH];
+  }
+
   return rc;
 }
 
 
+/*
+ * rasqal_query_engine_algebra_check_error:
+ * @execution_data: execution data
+ * @error_p: execution error (out)
+ *
+ * INTERNAL - Check if the rowsources stopped because of a memory limit, timeout or cancel
+ *
+ * Rowsources see these as a failure to make a row or the end of
+ * their rows, so they are checked here to turn them into an
+ * execution error.
+ *
+ * Return value: non-0 if the execution must stop and *@error_p was set
+ */
+static int
+rasqal_query_engine_algebra_check_error(rasqal_engine_algebra_data* execution_data,
+                                        rasqal_engine_error *error_p)
+{
+  if(rasqal_query_row_memory_limit_exceeded(execution_data->query)) {
+    *error_p = RASQAL_ENGINE_FAILED_MEMORY_LIMIT;
+    return 1;
+  }
+
+  if(RASQAL_EXECUTION_CHECK(execution_data->execution)) {
+    *error_p = execution_data->execution->error;
+    return 1;
+  }
+
+  return 0;
+}
+
+
 static raptor_sequence*
 rasqal_query_engine_algebra_get_all_rows(void* ex_data,
                                          rasqal_engine_error *error_p)
@@ -696,7 +2044,12 @@ rasqal_query_engine_algebra_get_all_rows(void* ex_data,
 
   if(execution_data->rowsource) {
     seq = rasqal_rowsource_read_all_rows(execution_data->rowsource);
-    if(!seq)
+    if(rasqal_query_engine_algebra_check_error(execution_data, error_p)) {
+      if(seq) {
+        raptor_free_sequence(seq);
+        seq = NULL;
+      }
+    } else if(!seq)
       *error_p = RASQAL_ENGINE_FAILED;
   } else
     *error_p = RASQAL_ENGINE_FAILED;
@@ -705,6 +2058,142 @@ rasqal_query_engine_algebra_get_all_rows(void* ex_data,
 }
 
 
+/*
+ * rasqal_query_engine_algebra_read_rows:
+ * @execution_data: execution data
+ * @rows: array to store the rows in
+ * @size: size of @rows
+ *
+ * INTERNAL - Read up to @size rows from the rowsource
+ *
+ * No more rows are read than the query results will still read, if
+ * known, so that LIMIT does not over-read.
+ *
+ * Return value: number of rows read, 0 if finished or <0 on failure
+ */
+static int
+rasqal_query_engine_algebra_read_rows(rasqal_engine_algebra_data* execution_data,
+                                      rasqal_row** rows, int size)
+{
+  rasqal_rowsource* rowsource = execution_data->rowsource;
+
+  if(rowsource->rows_needed >= 0) {
+    int remaining;
+
+    remaining = rowsource->rows_needed - rasqal_rowsource_get_rows_count(rowsource);
+    if(remaining < 1)
+      remaining = 1;
+    if(remaining < size)
+      size = remaining;
+  }
+
+  return rasqal_rowsource_read_batch(rowsource, rows, size);
+}
+
+
+/*
+ * rasqal_query_engine_algebra_fill_batch:
+ * @execution_data: execution data
+ *
+ * INTERNAL - Read the next batch of rows from the rowsource
+ *
+ * Return value: number of rows read, 0 if finished or <0 on failure
+ */
+static int
+rasqal_query_engine_algebra_fill_batch(rasqal_engine_algebra_data* execution_data)
+{
+  int count;
+
+  if(!execution_data->batch) {
+    execution_data->batch = RASQAL_CALLOC(rasqal_row**,
+                                          RASQAL_ROWSOURCE_BATCH_SIZE,
+                                          sizeof(rasqal_row*));
+    if(!execution_data->batch)
+      return -1;
+  }
+
+  count = rasqal_query_engine_algebra_read_rows(execution_data,
+                                                execution_data->batch,
+                                                RASQAL_ROWSOURCE_BATCH_SIZE);
+
+  execution_data->batch_index = 0;
+  execution_data->batch_count = (count > 0) ? count : 0;
+
+  return count;
+}
+
+
+/* prefetch handler reading rows on the producer thread */
+static int
+rasqal_query_engine_algebra_prefetch_rows(void* user_data, rasqal_row** rows,
+                                          int size,
+                                          rasqal_engine_error* error_p)
+{
+  rasqal_engine_algebra_data* execution_data;
+  rasqal_rowsource* rowsource;
+  int count;
+
+  execution_data = (rasqal_engine_algebra_data*)user_data;
+  rowsource = execution_data->rowsource;
+
+  /* the query results stop reading at the row after the last needed */
+  if(rowsource->rows_needed >= 0 &&
+     rasqal_rowsource_get_rows_count(rowsource) > rowsource->rows_needed)
+    return 0;
+
+  count = rasqal_query_engine_algebra_read_rows(execution_data, rows, size);
+  if(rasqal_query_engine_algebra_check_error(execution_data, error_p)) {
+    while(count > 0)
+      rasqal_free_row(rows[--count]);
+    return -1;
+  }
+
+  if(count < 0)
+    *error_p = RASQAL_ENGINE_FAILED;
+
+  return count;
+}
+
+
+/*
+ * rasqal_query_engine_algebra_start_prefetch:
+ * @execution_data: execution data
+ *
+ * INTERNAL - Start evaluating the rowsource on a producer thread
+ *
+ * From here on only the producer thread uses the rowsources and the
+ * execution state, so rows read in this thread come from the
+ * prefetch.  If threads are not available or the raptor world interns
+ * URIs, rows are read here as normal.
+ */
+static void
+rasqal_query_engine_algebra_start_prefetch(rasqal_engine_algebra_data* execution_data)
+{
+  int size = execution_data->prefetch_size;
+
+  execution_data->prefetch_size = 0;
+
+  /* the producer thread makes URIs at the same time as this one */
+  if(rasqal_world_get_uri_interning(execution_data->query->world)) {
+    rasqal_log_warning_simple(execution_data->query->world,
+                              RASQAL_WARNING_LEVEL_MISSING_SUPPORT,
+                              &execution_data->query->locator,
+                              "Prefetch feature ignored since the raptor world interns URIs");
+    return;
+  }
+
+  /* rows are made on the producer thread and freed on this one */
+  if(rasqal_query_set_row_pool_threaded(execution_data->query, 1))
+    return;
+
+  execution_data->prefetch = rasqal_new_row_prefetch(size,
+                                                     rasqal_query_engine_algebra_prefetch_rows,
+                                                     execution_data);
+  if(!execution_data->prefetch)
+    rasqal_query_set_row_pool_threaded(execution_data->query, 0);
+}
+
+
 static rasqal_row*
 rasqal_query_engine_algebra_get_row(void* ex_data,
                                     rasqal_engine_error *error_p)
@@ -714,9 +2203,52 @@ rasqal_query_engine_algebra_get_row(void* ex_data,
 
   execution_data = (rasqal_engine_algebra_data*)ex_data;
 
+  if(execution_data->prefetch_size > 0 && execution_data->rowsource)
+    rasqal_query_engine_algebra_start_prefetch(execution_data);
+
+  if(execution_data->prefetch) {
+    int rc;
+
+    rc = rasqal_row_prefetch_next(execution_data->prefetch, &row, error_p);
+    if(!rc)
+      *error_p = RASQAL_ENGINE_FINISHED;
+
+    return row;
+  }
+
   if(execution_data->rowsource) {
-    row = rasqal_rowsource_read_row(execution_data->rowsource);
-    if(!row)
+    /* notice a cancel even while returning already read rows */
+    if(rasqal_query_engine_algebra_check_error(execution_data, error_p))
+      return NULL;
+
+    if(execution_data->batch_index >= execution_data->batch_count) {
+      int count;
+
+      count = rasqal_query_engine_algebra_fill_batch(execution_data);
+      if(rasqal_query_engine_algebra_check_error(execution_data, error_p))
+        return NULL;
+
+      if(count < 0) {
+        *error_p = RASQAL_ENGINE_FAILED;
+        return NULL;
+      }
+    }
+
+    if(execution_data->batch_index < execution_data->batch_count) {
+      /* row is now owned by the caller */
+      row = execution_data->batch[execution_data->batch_index];
+      execution_data->batch[execution_data->batch_index++] = NULL;
+
+      /* the variables hold the values of the last row read; the
+       * results of query forms other than SELECT read the variables
+       * so bind them to this row as a single row read would */
+      if(execution_data->query->verb != RASQAL_QUERY_VERB_SELECT &&
+         rasqal_row_bind_variables(row, execution_data->query->vars_table)) {
+        rasqal_free_row(row);
+        *error_p = RASQAL_ENGINE_FAILED;
+        return NULL;
+      }
+    } else
       *error_p = RASQAL_ENGINE_FINISHED;
   } else
     *error_p = RASQAL_ENGINE_FAILED;
@@ -734,14 +2266,41 @@ rasqal_query_engine_algebra_execute_finish(void* ex_data,
   execution_data = (rasqal_engine_algebra_data*)ex_data;
 
   if(execution_data) {
+    /* first stop any producer thread evaluating the rowsource */
+    if(execution_data->prefetch) {
+      if(execution_data->execution)
+        RASQAL_FLAG_SET(&execution_data->execution->cancelled);
+      rasqal_free_row_prefetch(execution_data->prefetch);
+      execution_data->prefetch = NULL;
+      rasqal_query_set_row_pool_threaded(execution_data->query, 0);
+    }
+
+    /* then finish any worker tasks using the triples source */
+    if(execution_data->workers) {
+      rasqal_free_engine_workers(execution_data->workers);
+      execution_data->workers = NULL;
+    }
+
     if(execution_data->algebra_node)
       rasqal_free_algebra_node(execution_data->algebra_node);
 
     if(execution_data->triples_source) {
-      rasqal_free_triples_source(execution_data->triples_source);
+      if(!execution_data->triples_source_shared)
+        rasqal_free_triples_source(execution_data->triples_source);
       execution_data->triples_source = NULL;
     }
 
+    if(execution_data->batch) {
+      int i;
+
+      for(i = execution_data->batch_index; i < execution_data->batch_count; i++) {
+        if(execution_data->batch[i])
+          rasqal_free_row(execution_data->batch[i]);
+      }
+      RASQAL_FREE(rasqal_row**, execution_data->batch);
+      execution_data->batch = NULL;
+    }
+
     if(execution_data->rowsource)
       rasqal_free_rowsource(execution_data->rowsource);
   }
@@ -750,6 +2309,73 @@ rasqal_query_engine_algebra_execute_finish(void* ex_data,
 }
 
 
+static int
+rasqal_query_engine_algebra_skip_rows(void* ex_data, int count,
+                                      rasqal_engine_error *error_p)
+{
+  rasqal_engine_algebra_data* execution_data;
+  int skipped = 0;
+
+  execution_data = (rasqal_engine_algebra_data*)ex_data;
+
+  if(execution_data->prefetch) {
+    while(skipped < count) {
+      rasqal_row* row = NULL;
+      int rc;
+
+      rc = rasqal_row_prefetch_next(execution_data->prefetch, &row, error_p);
+      if(rc <= 0)
+        break;
+
+      rasqal_free_row(row);
+      skipped++;
+    }
+
+    return skipped;
+  }
+
+  if(execution_data->rowsource) {
+    /* first drop any rows already read into the batch */
+    while(skipped < count &&
+          execution_data->batch_index < execution_data->batch_count) {
+      int i = execution_data->batch_index++;
+
+      rasqal_free_row(execution_data->batch[i]);
+      execution_data->batch[i] = NULL;
+      skipped++;
+    }
+
+    if(skipped < count) {
+      int rc;
+
+      rc = rasqal_rowsource_skip_rows(execution_data->rowsource,
+                                      count - skipped);
+      if(rasqal_query_engine_algebra_check_error(execution_data, error_p))
+        return skipped;
+
+      if(rc < 0)
+        *error_p = RASQAL_ENGINE_FAILED;
+      else
+        skipped += rc;
+    }
+  } else
+    *error_p = RASQAL_ENGINE_FAILED;
+
+  return skipped;
+}
+
+
+static rasqal_rowsource*
+rasqal_query_engine_algebra_get_rowsource(void* ex_data)
+{
+  rasqal_engine_algebra_data* execution_data;
+
+  execution_data = (rasqal_engine_algebra_data*)ex_data;
+
+  return execution_data->rowsource;
+}
+
+
 static void
 rasqal_query_engine_algebra_finish_factory(rasqal_query_execution_factory* factory)
 {
@@ -765,5 +2391,7 @@ const rasqal_query_execution_factory rasqal_query_engine_algebra =
   /* .get_all_rows=        */ rasqal_query_engine_algebra_get_all_rows,
   /* .get_row=             */ rasqal_query_engine_algebra_get_row,
   /* .execute_finish=      */ rasqal_query_engine_algebra_execute_finish,
-  /* .finish_factory=      */ rasqal_query_engine_algebra_finish_factory
+  /* .finish_factory=      */ rasqal_query_engine_algebra_finish_factory,
+  /* .skip_rows=           */ rasqal_query_engine_algebra_skip_rows,
+  /* .get_rowsource=       */ rasqal_query_engine_algebra_get_rowsource
 };
@@ -94,12 +94,40 @@ rasqal_engine_rowsort_row_compare(void* user_data, const void *a, const void *b)
   }
   
   /* now order it */
-  if(rcd->order_conditions_sequence)
+  return rasqal_engine_rowsort_compare_rows(rcd->compare_flags,
+                                            rcd->order_conditions_sequence,
+                                            row_a, row_b);
+}
+
+
+/**
+ * rasqal_engine_rowsort_compare_rows:
+ * @compare_flags: comparison flags
+ * @order_seq: order conditions sequence (or NULL)
+ * @row_a: first row
+ * @row_b: second row
+ *
+ * INTERNAL - compare two rows by their order values then by offset
+ *
+ * The order values must have been calculated with
+ * rasqal_engine_rowsort_calculate_order_values().  Rows with equal
+ * order values are ordered by their offset, keeping the sort stable.
+ *
+ * Return value: <0, 0 or >0 comparison
+ */
+int
+rasqal_engine_rowsort_compare_rows(int compare_flags,
+                                   raptor_sequence* order_seq,
+                                   rasqal_row* row_a, rasqal_row* row_b)
+{
+  int result = 0;
+
+  if(order_seq)
     result = rasqal_literal_array_compare(row_a->order_values,
                                           row_b->order_values,
-                                          rcd->order_conditions_sequence,
+                                          order_seq,
                                           row_a->order_size,
-                                          rcd->compare_flags);
+                                          compare_flags);
 
 
   /* still equal?  make sort stable by using the original order */
@@ -57,7 +57,14 @@ static const struct
   const char *label;
 } rasqal_features_list [RASQAL_FEATURE_LAST + 1]= {
   { RASQAL_FEATURE_NO_NET,    1,  "noNet",    "Deny network requests." } ,
-  { RASQAL_FEATURE_RAND_SEED, 1,  "randSeed", "Set rand() seed." }
+  { RASQAL_FEATURE_RAND_SEED, 1,  "randSeed", "Set rand() seed." },
+  { RASQAL_FEATURE_GROUP_SPILL_LIMIT, 1,  "groupSpillLimit", "Kilobytes of GROUP BY state in memory before spilling to disk." },
+  { RASQAL_FEATURE_EXECUTION_ARENA, 1,  "executionArena", "Kilobytes per block of the query execution arena." },
+  { RASQAL_FEATURE_MEMORY_LIMIT, 1,  "memoryLimit", "Kilobytes of result row memory a query execution may use." },
+  { RASQAL_FEATURE_TIMEOUT, 1,  "timeout", "Milliseconds a query execution may run for." },
+  { RASQAL_FEATURE_PARALLELISM, 1,  "parallelism", "Number of worker threads a query execution may use." },
+  { RASQAL_FEATURE_PREFETCH, 1,  "prefetch", "Number of result rows a producer thread may evaluate ahead." },
+  { RASQAL_FEATURE_PROFILE, 1,  "profile", "Record time spent in each part of the query plan." }
 };
 
 
@@ -47,6 +47,7 @@
 /* prototypes for helper functions */
 static void rasqal_delete_query_language_factories(rasqal_world*);
 static void rasqal_free_query_language_factory(rasqal_query_language_factory *factory);
+static int rasqal_world_detect_uri_interning(rasqal_world* world);
 
 
 /* statics */
@@ -127,6 +128,8 @@ rasqal_new_world(void)
 
   world->genid_counter = 1;
 
+  RASQAL_MUTEX_INIT(&world->lock);
+
   return world;
 }
 
@@ -169,6 +172,8 @@ rasqal_world_open(rasqal_world *world)
       return rc;
   }
 
+  world->uri_interning = rasqal_world_detect_uri_interning(world);
+
   rc = rasqal_uri_init(world);
   if(rc)
     return rc;
@@ -230,6 +235,10 @@ rasqal_free_world(rasqal_world* world)
   if(!world)
     return;
   
+  /* finish any tasks while the world they use is still valid */
+  if(world->worker_pool)
+    rasqal_free_worker_pool(world->worker_pool);
+
   rasqal_finish_result_formats(world);
   rasqal_finish_query_results();
 
@@ -246,6 +255,8 @@ rasqal_free_world(rasqal_world* world)
   if(world->raptor_world_ptr && world->raptor_world_allocated_here)
     raptor_free_world(world->raptor_world_ptr);
 
+  RASQAL_MUTEX_DESTROY(&world->lock);
+
   RASQAL_FREE(rasqal_world, world);
 }
 
@@ -1058,16 +1069,111 @@ rasqal_world_reset_now(rasqal_world* world)
 struct timeval*
 rasqal_world_get_now_timeval(rasqal_world* world)
 {
+  struct timeval* tv = &world->now;
+
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
 
+  RASQAL_MUTEX_LOCK(&world->lock);
   if(!world->now_set) {
     if(gettimeofday(&world->now, NULL))
-      return NULL;
-    
-    world->now_set = 1;
+      tv = NULL;
+    else
+      world->now_set = 1;
   }
+  RASQAL_MUTEX_UNLOCK(&world->lock);
 
-  return &world->now;
+  return tv;
+}
+
+
+/*
+ * rasqal_world_begin_execution:
+ * @world: world
+ *
+ * INTERNAL - Note the start of a query execution
+ *
+ * The current datetime is taken again only when no other execution
+ * is in progress so that it never changes under a running execution,
+ * which may be in another thread.
+ */
+void
+rasqal_world_begin_execution(rasqal_world* world)
+{
+  RASQAL_MUTEX_LOCK(&world->lock);
+  if(!world->executions++) {
+    if(!gettimeofday(&world->now, NULL))
+      world->now_set = 1;
+    else
+      world->now_set = 0;
+  }
+  RASQAL_MUTEX_UNLOCK(&world->lock);
+}
+
+
+/*
+ * rasqal_world_end_execution:
+ * @world: world
+ *
+ * INTERNAL - Note the end of a query execution started with rasqal_world_begin_execution()
+ */
+void
+rasqal_world_end_execution(rasqal_world* world)
+{
+  RASQAL_MUTEX_LOCK(&world->lock);
+  if(world->executions > 0)
+    world->executions--;
+  RASQAL_MUTEX_UNLOCK(&world->lock);
+}
+
+
+/*
+ * rasqal_world_detect_uri_interning:
+ * @world: world
+ *
+ * INTERNAL - Find if the raptor world returns one shared object for equal URIs
+ *
+ * Raptor has no way to read #RAPTOR_WORLD_FLAG_URI_INTERNING so this
+ * makes the same URI twice and compares them.
+ *
+ * Return value: non-0 if URIs are interned or on failure
+ */
+static int
+rasqal_world_detect_uri_interning(rasqal_world* world)
+{
+  const unsigned char* uri_string = RASQAL_GOOD_CAST(const unsigned char*,
+                                                     "http://librdf.org/rasqal/");
+  raptor_uri* uri1;
+  raptor_uri* uri2;
+  int interning = 1;
+
+  uri1 = raptor_new_uri(world->raptor_world_ptr, uri_string);
+  uri2 = raptor_new_uri(world->raptor_world_ptr, uri_string);
+  if(uri1 && uri2)
+    interning = (uri1 == uri2);
+
+  if(uri1)
+    raptor_free_uri(uri1);
+  if(uri2)
+    raptor_free_uri(uri2);
+
+  return interning;
+}
+
+
+/*
+ * rasqal_world_get_uri_interning:
+ * @world: world
+ *
+ * INTERNAL - Get if the raptor world returns one shared object for equal URIs
+ *
+ * Interned URIs cannot be made or freed on several threads at once.
+ *
+ * Return value: non-0 if URIs are interned
+ */
+int
+rasqal_world_get_uri_interning(rasqal_world* world)
+{
+  return world->uri_interning;
 }
 
 
@@ -1109,6 +1215,81 @@ rasqal_world_set_warning_level(rasqal_world* world,
 }
 
 
+/**
+ * rasqal_world_set_feature:
+ * @world: rasqal_world object
+ * @feature: feature to set
+ * @value: integer feature value (0 or larger)
+ *
+ * Set a world feature
+ *
+ * #RASQAL_WORLD_FEATURE_WORKER_THREADS cannot be changed once the
+ * worker pool has been created with a different number of threads.
+ *
+ * Return value: non-0 on failure or if the feature is unknown or cannot be changed
+ */
+int
+rasqal_world_set_feature(rasqal_world* world, rasqal_world_feature feature,
+                         int value)
+{
+  int rc = 0;
+
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, 1);
+
+  if(value < 0)
+    return 1;
+
+  switch(feature) {
+    case RASQAL_WORLD_FEATURE_WORKER_THREADS:
+      RASQAL_MUTEX_LOCK(&world->lock);
+      if(world->worker_pool &&
+         rasqal_worker_pool_get_size(world->worker_pool) != value)
+        rc = 1;
+      else
+        world->worker_threads = value;
+      RASQAL_MUTEX_UNLOCK(&world->lock);
+      break;
+
+    default:
+      rc = 1;
+      break;
+  }
+
+  return rc;
+}
+
+
+/**
+ * rasqal_world_get_feature:
+ * @world: rasqal_world object
+ * @feature: feature to get
+ *
+ * Get a world feature
+ *
+ * Return value: feature value or < 0 if the feature is unknown
+ */
+int
+rasqal_world_get_feature(rasqal_world* world, rasqal_world_feature feature)
+{
+  int value = -1;
+
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, -1);
+
+  switch(feature) {
+    case RASQAL_WORLD_FEATURE_WORKER_THREADS:
+      RASQAL_MUTEX_LOCK(&world->lock);
+      value = world->worker_threads;
+      RASQAL_MUTEX_UNLOCK(&world->lock);
+      break;
+
+    default:
+      break;
+  }
+
+  return value;
+}
+
+
 /**
  * rasqal_free_memory:
  * @ptr: memory pointer
@@ -32,6 +32,7 @@ typedef __int16 int16_t;
 #else
 #include <stdint.h>
 #endif
+#include <signal.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -88,6 +89,79 @@ void rasqal_sign_free(void *ptr);
 #define __FUNCTION__ "???"
 #endif
 
+/* Locks for state shared between concurrent query executions.
+ * Without threads these do nothing.
+ */
+#ifdef RASQAL_THREADS
+#include <pthread.h>
+typedef pthread_mutex_t rasqal_mutex;
+#define RASQAL_MUTEX_INIT(m)    pthread_mutex_init(m, NULL)
+#define RASQAL_MUTEX_DESTROY(m) pthread_mutex_destroy(m)
+#define RASQAL_MUTEX_LOCK(m)    pthread_mutex_lock(m)
+#define RASQAL_MUTEX_UNLOCK(m)  pthread_mutex_unlock(m)
+typedef pthread_cond_t rasqal_cond;
+#define RASQAL_COND_INIT(c)      pthread_cond_init(c, NULL)
+#define RASQAL_COND_DESTROY(c)   pthread_cond_destroy(c)
+#define RASQAL_COND_WAIT(c, m)   pthread_cond_wait(c, m)
+#define RASQAL_COND_SIGNAL(c)    pthread_cond_signal(c)
+#define RASQAL_COND_BROADCAST(c) pthread_cond_broadcast(c)
+#else
+typedef int rasqal_mutex;
+#define RASQAL_MUTEX_INIT(m)    (*(m) = 0)
+#define RASQAL_MUTEX_DESTROY(m) do { } while(0)
+#define RASQAL_MUTEX_LOCK(m)    do { } while(0)
+#define RASQAL_MUTEX_UNLOCK(m)  do { } while(0)
+typedef int rasqal_cond;
+#define RASQAL_COND_INIT(c)      (*(c) = 0)
+#define RASQAL_COND_DESTROY(c)   do { } while(0)
+#define RASQAL_COND_WAIT(c, m)   do { } while(0)
+#define RASQAL_COND_SIGNAL(c)    do { } while(0)
+#define RASQAL_COND_BROADCAST(c) do { } while(0)
+#endif
+
+/* Usage counts of objects that concurrent executions may share such
+ * as the literals of a shared triples source, and of rows and the
+ * rowsources they point to that may be freed by another thread.
+ */
+#if defined(RASQAL_THREADS) && defined(__GNUC__)
+#define RASQAL_USAGE_INCREMENT(p) __sync_add_and_fetch(p, 1)
+#define RASQAL_USAGE_DECREMENT(p) __sync_sub_and_fetch(p, 1)
+#else
+#define RASQAL_USAGE_INCREMENT(p) (++(*(p)))
+#define RASQAL_USAGE_DECREMENT(p) (--(*(p)))
+#endif
+
+/* Flags set once by one thread and polled by others such as the
+ * cancel flag of an execution.  Writes made before setting a flag are
+ * seen by a thread that reads it set.
+ */
+#if defined(RASQAL_THREADS) && defined(__ATOMIC_ACQUIRE)
+#define RASQAL_FLAG_GET(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define RASQAL_FLAG_SET(p) __atomic_store_n(p, 1, __ATOMIC_RELEASE)
+#elif defined(RASQAL_THREADS) && defined(__GNUC__)
+#define RASQAL_FLAG_GET(p) __sync_add_and_fetch(p, 0)
+#define RASQAL_FLAG_SET(p) ((void)__sync_fetch_and_or(p, 1))
+#else
+#define RASQAL_FLAG_GET(p) (*(p))
+#define RASQAL_FLAG_SET(p) ((void)(*(p) = 1))
+#endif
+
+/* Values such as literal hashes computed when first needed, maybe by
+ * several threads at once, and cached in a word that is 0 until set.
+ * Every thread computes the same value so the word is only read and
+ * written whole.
+ */
+#if defined(RASQAL_THREADS) && defined(__ATOMIC_RELAXED)
+#define RASQAL_CACHE_GET(p) __atomic_load_n(p, __ATOMIC_RELAXED)
+#define RASQAL_CACHE_SET(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
+#elif defined(RASQAL_THREADS) && defined(__GNUC__)
+#define RASQAL_CACHE_GET(p) __sync_add_and_fetch(p, 0)
+#define RASQAL_CACHE_SET(p, v) ((void)__sync_lock_test_and_set(p, v))
+#else
+#define RASQAL_CACHE_GET(p) (*(p))
+#define RASQAL_CACHE_SET(p, v) ((void)(*(p) = (v)))
+#endif
+
 #ifdef RASQAL_DEBUG
 /* Debugging messages */
 #define RASQAL_DEBUG1(msg) do {fprintf(stderr, "%s:%d:%s: " msg, __FILE__, __LINE__, __FUNCTION__); } while(0)
@@ -405,6 +479,33 @@ typedef enum {
 } rasqal_triples_use_map_flags;
 
 
+/* Per-query pool of recycled rows; see rasqal_row.c */
+typedef struct rasqal_row_pool_s rasqal_row_pool;
+
+/* Bump allocation arena; see rasqal_arena.c */
+typedef struct rasqal_arena_s rasqal_arena;
+
+/* Pool of worker threads; see rasqal_worker_pool.c */
+typedef struct rasqal_worker_pool_s rasqal_worker_pool;
+
+typedef void (*rasqal_worker_task_handler)(void* task_data);
+
+/* Part of a query execution evaluated on worker threads; see
+ * rasqal_subplan_execute() */
+typedef struct rasqal_subplan_s rasqal_subplan;
+
+typedef int (*rasqal_subplan_row_handler)(void* user_data, rasqal_literal** values);
+
+/* Subplans evaluated by a set of tasks; see rasqal_subplan_tasks.c */
+typedef struct rasqal_subplan_tasks_s rasqal_subplan_tasks;
+
+/* Rows made ahead on a producer thread; see rasqal_row_prefetch.c */
+typedef struct rasqal_row_prefetch_s rasqal_row_prefetch;
+
+/* State of one query execution; see RASQAL_EXECUTION_CHECK() */
+typedef struct rasqal_execution_state_s rasqal_execution_state;
+
+
 /*
  * A query in some query language
  */
@@ -566,6 +667,27 @@ struct rasqal_query_s {
 
   /* Variable projection (or NULL when invalid such as for ASK) */
   rasqal_projection* projection;
+
+  /* INTERNAL pool of free rows for this query or NULL if not yet used */
+  rasqal_row_pool* row_pool;
+
+  /* INTERNAL lock for @usage, @results and @executing */
+  rasqal_mutex lock;
+
+  /* INTERNAL non-0 while an execution is using this query's variables
+   * and evaluation context; other executions use a private copy */
+  int executing;
+
+  /* INTERNAL results of that execution (or NULL before they are added) */
+  rasqal_query_results* executing_results;
+
+  /* INTERNAL triples source shared with other queries (not owned) or
+   * NULL to load @data_graphs for each execution */
+  rasqal_triples_source* shared_triples_source;
+
+  /* INTERNAL values given by rasqal_query_set_variable2() (or NULL)
+   * to set in private copies of the query */
+  rasqal_variables_table* set_vars_table;
 };
 
 
@@ -608,6 +730,10 @@ struct rasqal_query_language_factory_s {
 typedef struct rasqal_rowsource_s rasqal_rowsource;
 
 #define RASQAL_ROW_FLAG_WEAK_ROWSOURCE 0x01
+/* values array is allocated in the same block as the row */
+#define RASQAL_ROW_FLAG_INLINE_VALUES 0x02
+/* row block was allocated from an arena and must not be freed */
+#define RASQAL_ROW_FLAG_ARENA 0x04
 
 /*
  * A row of values from a query result, usually generated by a rowsource
@@ -634,8 +760,15 @@ struct rasqal_row_s {
   /* Group ID */
   int group_id;
 
-  /* Bit mask of flags: bit 0 = WEAK ROWSOURCE */
+  /* Bit mask of flags: bit 0 = WEAK ROWSOURCE, bit 1 = INLINE VALUES,
+   * bit 2 = ARENA */
   unsigned int flags;
+
+  /* Pool this row returns to when freed (or NULL if none) */
+  rasqal_row_pool* pool;
+
+  /* next row in the pool free list when this row is not in use */
+  struct rasqal_row_s* next_free;
 };
 
 
@@ -659,6 +792,8 @@ typedef enum {
 
 /* rasqal_rowsource_aggregation.c */
 rasqal_rowsource* rasqal_new_aggregation_rowsource(rasqal_world *world, rasqal_query* query, rasqal_rowsource* rowsource, raptor_sequence* exprs_seq, raptor_sequence* vars_seq);
+rasqal_rowsource* rasqal_new_hash_aggregation_rowsource(rasqal_world *world, rasqal_query* query, rasqal_rowsource* rowsource, raptor_sequence* group_exprs_seq, raptor_sequence* exprs_seq, raptor_sequence* vars_seq);
+int rasqal_aggregation_expressions_can_hash(raptor_sequence* exprs_seq);
 
 /* rasqal_rowsource_empty.c */
 rasqal_rowsource* rasqal_new_empty_rowsource(rasqal_world *world, rasqal_query* query);
@@ -679,7 +814,7 @@ rasqal_rowsource* rasqal_new_distinct_rowsource(rasqal_world *world, rasqal_quer
 rasqal_rowsource* rasqal_new_filter_rowsource(rasqal_world *world, rasqal_query *query, rasqal_rowsource* rs, rasqal_expression* expr);
 
 /* rasqal_rowsource_graph.c */
-rasqal_rowsource* rasqal_new_graph_rowsource(rasqal_world *world, rasqal_query *query, rasqal_rowsource* rowsource, rasqal_variable *var);
+rasqal_rowsource* rasqal_new_graph_rowsource(rasqal_world *world, rasqal_query *query, rasqal_rowsource* rowsource, rasqal_variable *var, rasqal_subplan* subplan, int unordered);
 
 /* rasqal_rowsource_groupby.c */
 rasqal_rowsource* rasqal_new_groupby_rowsource(rasqal_world *world, rasqal_query* query, rasqal_rowsource* rowsource, raptor_sequence* exprs_seq);
@@ -690,6 +825,9 @@ rasqal_rowsource* rasqal_new_having_rowsource(rasqal_world *world, rasqal_query
 /* rasqal_rowsource_join.c */
 rasqal_rowsource* rasqal_new_join_rowsource(rasqal_world *world, rasqal_query* query, rasqal_rowsource* left, rasqal_rowsource* right, rasqal_join_type join_type, rasqal_expression *expr);
 
+/* rasqal_rowsource_pipeline.c */
+rasqal_rowsource* rasqal_new_pipeline_rowsource(rasqal_world *world, rasqal_query *query, rasqal_rowsource* triples_rowsource, raptor_sequence* filters_seq, raptor_sequence* projection_variables, int limit, int offset);
+
 /* rasqal_rowsource_project.c */
 rasqal_rowsource* rasqal_new_project_rowsource(rasqal_world *world, rasqal_query *query, rasqal_rowsource* rowsource, raptor_sequence* projection_variables);
 
@@ -707,9 +845,16 @@ rasqal_rowsource* rasqal_new_sort_rowsource(rasqal_world *world, rasqal_query *q
 
 /* rasqal_rowsource_triples.c */
 rasqal_rowsource* rasqal_new_triples_rowsource(rasqal_world *world, rasqal_query* query, rasqal_triples_source* triples_source, raptor_sequence* triples, int start_column, int end_column);
+int rasqal_triples_rowsource_bind_next(rasqal_rowsource* rowsource);
+int rasqal_triples_rowsource_set_range(rasqal_rowsource* rowsource, int range_start, int range_end);
+int rasqal_triples_rowsource_set_subplan(rasqal_rowsource* rowsource, rasqal_subplan* subplan, int morsels, int morsel_size, int unordered);
+
+/* rasqal_rowsource_count.c */
+rasqal_rowsource* rasqal_new_count_rowsource(rasqal_world *world, rasqal_query *query, rasqal_triples_source* triples_source, raptor_sequence* triples, int column, rasqal_variable* distinct_variable, rasqal_variable* variable);
+rasqal_triple_parts rasqal_count_rowsource_pattern_parts(rasqal_query* query, raptor_sequence* triples, int column);
 
 /* rasqal_rowsource_union.c */
-rasqal_rowsource* rasqal_new_union_rowsource(rasqal_world *world, rasqal_query* query, rasqal_rowsource* left, rasqal_rowsource* right);
+rasqal_rowsource* rasqal_new_union_rowsource(rasqal_world *world, rasqal_query* query, rasqal_rowsource* left, rasqal_rowsource* right, raptor_sequence* subplans, int unordered);
 
 
 /**
@@ -776,8 +921,13 @@ typedef raptor_sequence* (*rasqal_rowsource_read_all_rows_func) (rasqal_rowsourc
 typedef int (*rasqal_rowsource_reset_func) (rasqal_rowsource* rowsource, void *user_data);
 
 
+/* default number of rows to read at once with rasqal_rowsource_read_batch() */
+#define RASQAL_ROWSOURCE_BATCH_SIZE 1024
+
 /* bit flags */
 #define RASQAL_ROWSOURCE_REQUIRE_RESET (1 << 0)
+/* rows_needed field of the rowsource has been set or changed */
+#define RASQAL_ROWSOURCE_REQUIRE_ROWS_LIMIT (1 << 1)
 
 /**
  * rasqal_rowsource_set_requirements_func
@@ -815,9 +965,45 @@ typedef rasqal_rowsource* (*rasqal_rowsource_get_inner_rowsource_func) (rasqal_r
 typedef int (*rasqal_rowsource_set_origin_func) (rasqal_rowsource* rowsource, void *user_data, rasqal_literal *origin);
 
 
+/**
+ * rasqal_rowsource_skip_rows_func
+ * @user_data: user data
+ * @count: number of rows to skip
+ *
+ * Handler function for skipping over rows without returning them
+ *
+ * Return value: number of rows skipped (less than @count if the rows ran out) or <0 on failure
+ */
+typedef int (*rasqal_rowsource_skip_rows_func) (rasqal_rowsource* rowsource, void *user_data, int count);
+
+
+/**
+ * rasqal_rowsource_read_batch_func
+ * @user_data: user data
+ * @rows: array to fill with rows
+ * @size: size of @rows array
+ *
+ * Handler function for returning up to @size result rows at once
+ *
+ * Return value: number of rows stored in @rows, 0 if exhausted or <0 on failure
+ */
+typedef int (*rasqal_rowsource_read_batch_func) (rasqal_rowsource* rowsource, void *user_data, rasqal_row** rows, int size);
+
+
+/**
+ * rasqal_rowsource_estimate_rows_func
+ * @user_data: user data
+ *
+ * Handler function for estimating how many rows a rowsource returns before reading any
+ *
+ * Return value: estimated number of rows or <0 if unknown
+ */
+typedef long (*rasqal_rowsource_estimate_rows_func) (rasqal_rowsource* rowsource, void *user_data);
+
+
 /**
  * rasqal_rowsource_handler:
- * @version: API version - 1
+ * @version: API version - 1 or 2
  * @name: rowsource name for debugging
  * @init:  initialisation handler - optional, called at most once (V1)
  * @finish: finishing handler - optional, called at most once (V1)
@@ -828,6 +1014,9 @@ typedef int (*rasqal_rowsource_set_origin_func) (rasqal_rowsource* rowsource, vo
  * @set_requirements: set requirements flag handler - optional (V1)
  * @get_inner_rowsource: get inner rowsource handler - optional if has no inner rowsources (V1)
  * @set_origin: set origin (GRAPH) handler - optional (V1)
+ * @skip_rows: skip rows handler - optional (V2)
+ * @read_batch: read batch of rows handler - optional (V2)
+ * @estimate_rows: estimate number of rows handler - optional (V3)
  *
  * Row Source implementation factory handler structure.
  *
@@ -845,6 +1034,11 @@ typedef struct {
   rasqal_rowsource_set_requirements_func     set_requirements;
   rasqal_rowsource_get_inner_rowsource_func  get_inner_rowsource;
   rasqal_rowsource_set_origin_func           set_origin;
+  /* API V2 methods */
+  rasqal_rowsource_skip_rows_func            skip_rows;
+  rasqal_rowsource_read_batch_func           read_batch;
+  /* API V3 methods */
+  rasqal_rowsource_estimate_rows_func        estimate_rows;
 } rasqal_rowsource_handler;
 
 
@@ -875,6 +1069,41 @@ typedef struct {
 typedef struct rasqal_results_compare_s rasqal_results_compare;
 
 
+/*
+ * Statistics of a rowsource over a query execution for
+ * rasqal_query_results_write_explain() and
+ * rasqal_query_results_get_operator_counters()
+ *
+ * The counts are always kept.  The times and bytes are only recorded
+ * when the rowsource profile flag is set and include the time spent
+ * and rows made in inner rowsources.
+ */
+typedef struct {
+  /* rows returned over all resets */
+  long rows;
+
+  /* number of times the rowsource was reset */
+  int resets;
+
+  /* seconds of wall clock and thread CPU time spent in the handler */
+  double wall_time;
+  double cpu_time;
+
+  /* bytes of rows made while in the handler */
+  size_t bytes;
+
+  /* triples source matches started and next match calls made */
+  long triples_matches;
+  long triples_next_matches;
+
+  /* number of expressions evaluated */
+  long expressions;
+
+  /* number of sorted runs of state written to temporary files */
+  int spilled_runs;
+} rasqal_rowsource_stats;
+
+
 /*
  * Rowsource Internal flags
  *
@@ -903,6 +1132,12 @@ typedef struct rasqal_results_compare_s rasqal_results_compare;
  * @offset: size of @rows_sequence
  * @generate_group: non-0 to generate a group (ID 0) around all the returned rows, if there is no grouping returned.
  * @usage: reference count
+ * @rows_needed: maximum number of rows the consumer will read or <0 for all rows
+ * @execution: state of the execution this rowsource is part of or NULL
+ * @profile: non-0 to record handler times in @stats
+ * @stats: statistics over the execution
+ * @estimated_rows: estimated number of rows, <0 if unknown
+ * @estimated: non-0 if @estimated_rows has been set
  *
  * Rasqal Row Source class providing a sequence of rows of values similar to a SQL table.
  *
@@ -966,6 +1201,19 @@ struct rasqal_rowsource_s
   unsigned int generate_group : 1;
 
   int usage;
+
+  int rows_needed;
+
+  /* state of the execution this rowsource is part of or NULL */
+  rasqal_execution_state* execution;
+
+  unsigned int profile : 1;
+
+  rasqal_rowsource_stats stats;
+
+  long estimated_rows;
+
+  unsigned int estimated : 1;
 };
 
 
@@ -985,11 +1233,19 @@ int rasqal_rowsource_copy_variables(rasqal_rowsource *dest_rowsource, rasqal_row
 void rasqal_rowsource_print_row_sequence(rasqal_rowsource* rowsource,raptor_sequence* seq, FILE* fh);
 int rasqal_rowsource_reset(rasqal_rowsource* rowsource);
 int rasqal_rowsource_set_requirements(rasqal_rowsource* rowsource, unsigned int requirement);
+int rasqal_rowsource_set_rows_needed(rasqal_rowsource* rowsource, int rows_needed);
+int rasqal_rowsource_skip_rows(rasqal_rowsource *rowsource, int count);
+int rasqal_rowsource_read_batch(rasqal_rowsource *rowsource, rasqal_row** rows, int size);
 rasqal_rowsource* rasqal_rowsource_get_inner_rowsource(rasqal_rowsource* rowsource, int offset);
 int rasqal_rowsource_write(rasqal_rowsource *rowsource,  raptor_iostream *iostr);
 void rasqal_rowsource_print(rasqal_rowsource* rs, FILE* fh);
 int rasqal_rowsource_ensure_variables(rasqal_rowsource *rowsource);
 int rasqal_rowsource_set_origin(rasqal_rowsource* rowsource, rasqal_literal *literal);
+int rasqal_rowsource_set_execution_state(rasqal_rowsource* rowsource, rasqal_execution_state* state);
+int rasqal_rowsource_set_profile(rasqal_rowsource* rowsource, int profile);
+long rasqal_rowsource_estimate_rows(rasqal_rowsource* rowsource);
+int rasqal_rowsource_write_explain(rasqal_rowsource* rowsource, raptor_iostream* iostr, rasqal_query_explain_format format);
+int rasqal_rowsource_get_counters(rasqal_rowsource* rowsource, int offset, rasqal_operator_counters* counters);
 int rasqal_rowsource_request_grouping(rasqal_rowsource* rowsource);
 void rasqal_rowsource_remove_all_variables(rasqal_rowsource *rowsource);
 
@@ -1098,6 +1354,9 @@ char* rasqal_vsnprintf(const char* message, va_list arguments);
 unsigned char* rasqal_world_generate_bnodeid(rasqal_world* world, unsigned char *user_bnodeid);
 int rasqal_world_reset_now(rasqal_world* world);
 struct timeval* rasqal_world_get_now_timeval(rasqal_world* world);
+void rasqal_world_begin_execution(rasqal_world* world);
+void rasqal_world_end_execution(rasqal_world* world);
+int rasqal_world_get_uri_interning(rasqal_world* world);
 
 
 typedef enum {
@@ -1358,6 +1617,7 @@ int rasqal_query_declare_prefixes(rasqal_query* rq);
 void rasqal_query_set_base_uri(rasqal_query* rq, raptor_uri* base_uri);
 rasqal_variable* rasqal_query_get_variable_by_offset(rasqal_query* query, int idx);
 const rasqal_query_execution_factory* rasqal_query_get_engine_by_name(const char* name);
+rasqal_query* rasqal_query_copy_for_execution(rasqal_query* query, int with_data_graphs);
 int rasqal_query_variable_is_bound(rasqal_query* query, rasqal_variable* v);
 rasqal_triple_parts rasqal_query_variable_bound_in_triple(rasqal_query* query, rasqal_variable* v, int column);
 int rasqal_query_store_select_query(rasqal_query* query, rasqal_projection* projection, raptor_sequence* data_graphs, rasqal_graph_pattern* where_gp, rasqal_solution_modifier* modifier);
@@ -1370,6 +1630,7 @@ int rasqal_query_set_modifier(rasqal_query* query, rasqal_solution_modifier* mod
 int rasqal_init_query_results(void);
 void rasqal_finish_query_results(void);
 int rasqal_query_results_execute_with_engine(rasqal_query_results* query_results, const rasqal_query_execution_factory* factory, rasqal_data_graphs_set* data_graphs, int store_results);
+rasqal_execution_state* rasqal_query_results_get_execution_state(rasqal_query_results* query_results);
 int rasqal_query_check_limit_offset_core(int result_offset, int limit, int offset);
 int rasqal_query_check_limit_offset(rasqal_query* query, int result_offset);
 void rasqal_query_results_remove_query_reference(rasqal_query_results* query_results);
@@ -1413,9 +1674,30 @@ int rasqal_init_result_format_turtle(rasqal_world*);
 /* rasqal_format_rdf.c */
 int rasqal_init_result_format_rdf(rasqal_world*);
 
+/* rasqal_worker_pool.c */
+rasqal_worker_pool* rasqal_new_worker_pool(int size);
+void rasqal_free_worker_pool(rasqal_worker_pool* pool);
+int rasqal_worker_pool_submit(rasqal_worker_pool* pool, rasqal_worker_task_handler handler, void* task_data);
+int rasqal_worker_pool_get_size(rasqal_worker_pool* pool);
+rasqal_worker_pool* rasqal_world_get_worker_pool(rasqal_world* world, int size);
+
+/* rasqal_arena.c */
+rasqal_arena* rasqal_new_arena(size_t block_size);
+void rasqal_free_arena(rasqal_arena* arena);
+void* rasqal_arena_alloc(rasqal_arena* arena, size_t size);
+size_t rasqal_arena_get_allocated(rasqal_arena* arena);
+
 /* rasqal_row.c */
 rasqal_row* rasqal_new_row(rasqal_rowsource* rowsource);
+rasqal_row* rasqal_new_row_for_query(rasqal_world* world, rasqal_query* query, int size);
 rasqal_row* rasqal_new_row_from_row(rasqal_row* row);
+void rasqal_free_row_pool(rasqal_row_pool* pool);
+int rasqal_query_set_row_arena(rasqal_query* query, rasqal_arena* arena);
+int rasqal_query_set_row_pool_threaded(rasqal_query* query, int threaded);
+int rasqal_query_reset_row_memory(rasqal_query* query, size_t limit);
+size_t rasqal_query_get_row_memory_peak(rasqal_query* query);
+size_t rasqal_query_get_row_bytes_allocated(rasqal_query* query);
+int rasqal_query_row_memory_limit_exceeded(rasqal_query* query);
 int rasqal_row_print(rasqal_row* row, FILE* fh);
 int rasqal_row_write(rasqal_row* row, raptor_iostream* iostr);
 raptor_sequence* rasqal_new_row_sequence(rasqal_world* world, rasqal_variables_table* vt, const char* const row_data[], int vars_count, raptor_sequence** vars_seq_p);
@@ -1441,6 +1723,7 @@ int rasqal_reset_triple_meta(rasqal_triple_meta* m);
 void rasqal_free_triples_source(rasqal_triples_source *rts);
 int rasqal_triples_source_triple_present(rasqal_triples_source *rts, rasqal_triple *t);
 int rasqal_triples_source_support_feature(rasqal_triples_source *rts, rasqal_triples_source_feature feature);
+int rasqal_triples_source_triple_count(rasqal_triples_source *rts, rasqal_triple *t, long *count_p);
 
 rasqal_triples_match* rasqal_new_triples_match(rasqal_query* query, rasqal_triples_source* triples_source, rasqal_triple_meta *m, rasqal_triple *t);
 rasqal_triple_parts rasqal_triples_match_bind_match(struct rasqal_triples_match_s* rtm, rasqal_variable *bindings[4],rasqal_triple_parts parts);
@@ -1479,6 +1762,9 @@ struct rasqal_world_s {
   /* should rasqal free the raptor_world */
   int raptor_world_allocated_here;
 
+  /* non-0 if the raptor world interns URIs; found when opened */
+  int uri_interning;
+
   /* log handler */
   raptor_log_handler log_handler;
   void *log_handler_user_data;
@@ -1522,6 +1808,18 @@ struct rasqal_world_s {
 
   /* generated counter - increments at every generation */
   int genid_counter;
+
+  /* lock for @now, @executions and data graph loading */
+  rasqal_mutex lock;
+
+  /* number of query executions in progress */
+  int executions;
+
+  /* worker threads for parallel evaluation; created on first use */
+  rasqal_worker_pool* worker_pool;
+
+  /* #RASQAL_WORLD_FEATURE_WORKER_THREADS value */
+  int worker_threads;
 };
 
 
@@ -1628,6 +1926,10 @@ struct rasqal_algebra_node_s {
 
   /* flags */
   unsigned int flags;
+
+  /* position in a preorder walk of the query pattern algebra
+   * starting at 1 or 0 if not numbered */
+  int ordinal;
 };
 typedef struct rasqal_algebra_node_s rasqal_algebra_node;
 
@@ -1740,6 +2042,9 @@ int rasqal_variables_write(raptor_sequence* seq, raptor_iostream* iostr);
  * @RASQAL_ENGINE_OK:
  * @RASQAL_ENGINE_FAILED:
  * @RASQAL_ENGINE_FINISHED:
+ * @RASQAL_ENGINE_FAILED_MEMORY_LIMIT: failed because the query used more row memory than #RASQAL_FEATURE_MEMORY_LIMIT allows
+ * @RASQAL_ENGINE_FAILED_TIMEOUT: failed because the query ran longer than #RASQAL_FEATURE_TIMEOUT allows
+ * @RASQAL_ENGINE_FAILED_CANCELLED: failed because the execution was cancelled with rasqal_query_results_cancel()
  *
  * Execution engine errors.
  *
@@ -1748,9 +2053,67 @@ typedef enum {
   RASQAL_ENGINE_OK,
   RASQAL_ENGINE_FAILED,
   RASQAL_ENGINE_FINISHED,
-  RASQAL_ENGINE_ERROR_LAST = RASQAL_ENGINE_FINISHED
+  RASQAL_ENGINE_FAILED_MEMORY_LIMIT,
+  RASQAL_ENGINE_FAILED_TIMEOUT,
+  RASQAL_ENGINE_FAILED_CANCELLED,
+  RASQAL_ENGINE_ERROR_LAST = RASQAL_ENGINE_FAILED_CANCELLED
 } rasqal_engine_error;
 
+/* non-0 if @error is any kind of execution failure */
+#define RASQAL_ENGINE_ERROR_IS_FAILURE(error) \
+  ((error) != RASQAL_ENGINE_OK && (error) != RASQAL_ENGINE_FINISHED)
+
+
+/*
+ * State of one query execution shared by all of its rowsources
+ *
+ * Rowsource loops poll this with RASQAL_EXECUTION_CHECK() and stop
+ * returning rows once it reports an error.  Only @cancelled may be
+ * written from outside the executing thread and other threads only
+ * read @cancelled, @stopped and once that is set, @error, using
+ * RASQAL_FLAG_GET() for the flags.
+ */
+struct rasqal_execution_state_s {
+  /* non-0 when rasqal_query_results_cancel() was called */
+  volatile sig_atomic_t cancelled;
+
+  /* non-0 once @error is set */
+  int stopped;
+
+  /* non-0 if @deadline is set */
+  int has_deadline;
+
+  /* rasqal_engine_get_times() wall clock seconds after which the
+   * execution fails with a timeout */
+  double deadline;
+
+  /* checks since the clock was last read */
+  int check_counter;
+
+  /* error that stopped the execution or RASQAL_ENGINE_OK */
+  rasqal_engine_error error;
+
+  /* execution this one is part of, run on a worker thread, or NULL */
+  rasqal_execution_state* parent;
+};
+
+/* number of checks between reads of the clock for a deadline */
+#define RASQAL_EXECUTION_CHECK_INTERVAL 1024
+
+/* non-0 if the execution with @state (may be NULL) must stop */
+#define RASQAL_EXECUTION_CHECK(state) \
+  ((state) && ((state)->error != RASQAL_ENGINE_OK || \
+               RASQAL_FLAG_GET(&(state)->cancelled) || \
+               (state)->has_deadline || (state)->parent) && \
+   rasqal_execution_state_check(state))
+
+/* rasqal_engine.c */
+int rasqal_execution_state_init(rasqal_execution_state* state, int timeout_ms);
+void rasqal_execution_state_init_child(rasqal_execution_state* state, rasqal_execution_state* parent);
+int rasqal_execution_state_check(rasqal_execution_state* state);
+void rasqal_execution_state_fail(rasqal_execution_state* state, rasqal_engine_error error);
+void rasqal_engine_get_times(double* wall_p, double* cpu_p);
+
 
 /*
  * A query execution engine factory
@@ -1804,6 +2167,28 @@ struct rasqal_query_execution_factory_s {
   /* finish the query execution factory */
   void (*finish_factory)(rasqal_query_execution_factory* factory);
 
+  /*
+   * @ex_data: execution object
+   * @count: number of rows to skip
+   * @error_p: execution error (OUT variable)
+   *
+   * Skip over result rows without returning them - optional
+   *
+   * Used to apply the query OFFSET.  Will not be called if query
+   * results is NULL, finished or failed.
+   *
+   * Return value: number of rows skipped
+   */
+  int (*skip_rows)(void* ex_data, int count, rasqal_engine_error *error_p);
+
+  /*
+   * @ex_data: execution object
+   *
+   * Get the rowsource tree (query plan) of the execution - optional
+   *
+   * Return value: shared rowsource or NULL if there is none
+   */
+  rasqal_rowsource* (*get_rowsource)(void* ex_data);
 };
 
 
@@ -1819,6 +2204,7 @@ rasqal_map* rasqal_engine_new_rowsort_map(int is_distinct, int compare_flags, ra
 int rasqal_engine_rowsort_map_add_row(rasqal_map* map, rasqal_row* row);
 raptor_sequence* rasqal_engine_rowsort_map_to_sequence(rasqal_map* map, raptor_sequence* seq);
 int rasqal_engine_rowsort_calculate_order_values(rasqal_query* query, raptor_sequence* order_seq, rasqal_row* row);
+int rasqal_engine_rowsort_compare_rows(int compare_flags, raptor_sequence* order_seq, rasqal_row* row_a, rasqal_row* row_b);
 
 
 /* rasqal_engine_algebra.c */
@@ -1826,6 +2212,27 @@ int rasqal_engine_rowsort_calculate_order_values(rasqal_query* query, raptor_seq
 /* New query engine based on executing over query algebra */
 extern const rasqal_query_execution_factory rasqal_query_engine_algebra;
 
+void rasqal_free_subplan(rasqal_subplan* subplan);
+int rasqal_subplan_execute(rasqal_subplan* subplan, rasqal_execution_state* parent, rasqal_literal* origin, int range_start, int range_end, rasqal_subplan_row_handler handler, void* user_data, rasqal_engine_error* error_p);
+int rasqal_subplan_get_size(rasqal_subplan* subplan);
+const unsigned char* rasqal_subplan_get_variable_name(rasqal_subplan* subplan, int offset);
+void rasqal_subplan_free_values(rasqal_subplan* subplan, rasqal_literal** values);
+int rasqal_subplan_get_parallelism(rasqal_subplan* subplan);
+int rasqal_subplan_submit(rasqal_subplan* subplan, rasqal_worker_task_handler handler, void* task_data);
+
+/* rasqal_subplan_tasks.c */
+rasqal_subplan_tasks* rasqal_new_subplan_tasks(int size, int unordered);
+void rasqal_free_subplan_tasks(rasqal_subplan_tasks* tasks);
+int rasqal_subplan_tasks_add(rasqal_subplan_tasks* tasks, rasqal_subplan* subplan, rasqal_literal* origin, int range_start, int range_end);
+rasqal_literal* rasqal_subplan_tasks_get_origin(rasqal_subplan_tasks* tasks, int index);
+int rasqal_subplan_tasks_next(rasqal_subplan_tasks* tasks, rasqal_execution_state* execution, int* index_p, rasqal_literal*** values_p);
+
+/* rasqal_row_prefetch.c */
+typedef int (*rasqal_row_prefetch_handler)(void* user_data, rasqal_row** rows, int size, rasqal_engine_error* error_p);
+rasqal_row_prefetch* rasqal_new_row_prefetch(int size, rasqal_row_prefetch_handler handler, void* user_data);
+void rasqal_free_row_prefetch(rasqal_row_prefetch* prefetch);
+int rasqal_row_prefetch_next(rasqal_row_prefetch* prefetch, rasqal_row** row_p, rasqal_engine_error* error_p);
+
 /* rasqal_iostream.c */
 raptor_iostream* rasqal_new_iostream_from_stringbuffer(raptor_world *raptor_world_ptr, raptor_stringbuffer* sb);
 
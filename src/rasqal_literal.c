@@ -598,6 +598,11 @@ rasqal_literal_set_typed_value(rasqal_literal* l, rasqal_literal_type type,
 
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(l, rasqal_literal, 1);
 
+  /* value and lexical form may change */
+  l->hash_rdf = 0;
+  l->hash_value = 0;
+  l->hash_rdql = 0;
+
 retype:
   l->valid = rasqal_xsd_datatype_check(type, string ? string : l->string,
                                        0 /* no flags set */);
@@ -830,6 +835,12 @@ rasqal_literal_string_to_native(rasqal_literal *l, int flags)
   if(native_type == RASQAL_LITERAL_STRING)
     return 0;
 
+  /* already promoted - nothing to do.  This keeps comparisons from
+   * writing to literals that concurrent executions share */
+  if(!canonicalize &&
+     (l->type == native_type || l->type == RASQAL_LITERAL_UDT))
+    return 0;
+
   /* xsd:string - mark and return */
   if(native_type == RASQAL_LITERAL_XSD_STRING) {
     l->type = native_type;
@@ -1134,7 +1145,7 @@ rasqal_new_literal_from_literal(rasqal_literal* l)
   if(!l)
     return NULL;
   
-  l->usage++;
+  RASQAL_USAGE_INCREMENT(&l->usage);
   return l;
 }
 
@@ -1152,7 +1163,7 @@ rasqal_free_literal(rasqal_literal* l)
   if(!l)
     return;
   
-  if(--l->usage)
+  if(RASQAL_USAGE_DECREMENT(&l->usage))
     return;
   
   switch(l->type) {
@@ -2968,6 +2979,465 @@ rasqal_literal_equals_flags(rasqal_literal* l1, rasqal_literal* l2,
 }
 
 
+/* FNV-1a 32 bit hash parameters */
+#define RASQAL_LITERAL_HASH_INIT  2166136261U
+#define RASQAL_LITERAL_HASH_PRIME 16777619U
+
+/* Type classes mixed into a hash so that e.g. a URI and a blank node
+ * with the same string do not collide
+ */
+typedef enum {
+  RASQAL_LITERAL_HASH_CLASS_UNKNOWN,
+  RASQAL_LITERAL_HASH_CLASS_URI,
+  RASQAL_LITERAL_HASH_CLASS_BLANK,
+  RASQAL_LITERAL_HASH_CLASS_STRING,
+  RASQAL_LITERAL_HASH_CLASS_BOOLEAN,
+  RASQAL_LITERAL_HASH_CLASS_NUMERIC,
+  RASQAL_LITERAL_HASH_CLASS_DATETIME
+} rasqal_literal_hash_class;
+
+
+static unsigned int
+rasqal_literal_hash_bytes(unsigned int hash, const void* data, size_t len)
+{
+  const unsigned char* p = RASQAL_GOOD_CAST(const unsigned char*, data);
+
+  while(len--) {
+    hash ^= *p++;
+    hash *= RASQAL_LITERAL_HASH_PRIME;
+  }
+
+  return hash;
+}
+
+
+static unsigned int
+rasqal_literal_hash_uri(unsigned int hash, raptor_uri* uri)
+{
+  const unsigned char* uri_string;
+  size_t len = 0;
+
+  if(!uri)
+    return hash;
+
+  uri_string = raptor_uri_as_counted_string(uri, &len);
+  return rasqal_literal_hash_bytes(hash, uri_string, len);
+}
+
+
+/*
+ * rasqal_literal_hash_string_node:
+ * @l: string literal
+ * @hash: hash so far
+ * @value_mode: non-0 to treat plain and xsd:string literals as equal
+ *
+ * INTERNAL - Hash the lexical form, language and datatype of an RDF literal
+ *
+ * Languages are compared case-independently by
+ * rasqal_literal_string_languages_compare() and are already lowercased
+ * when the literal is constructed.
+ *
+ * Return value: new hash
+ */
+static unsigned int
+rasqal_literal_hash_string_node(rasqal_literal* l, unsigned int hash,
+                                int value_mode)
+{
+  if(l->string)
+    hash = rasqal_literal_hash_bytes(hash, l->string, l->string_len);
+
+  if(l->language) {
+    hash = rasqal_literal_hash_bytes(hash, "@", 1);
+    hash = rasqal_literal_hash_bytes(hash, l->language, strlen(l->language));
+  }
+
+  if(l->datatype) {
+    if(value_mode) {
+      raptor_uri* xsd_string_uri;
+
+      xsd_string_uri = rasqal_xsd_datatype_type_to_uri(l->world,
+                                                       RASQAL_LITERAL_XSD_STRING);
+      if(raptor_uri_equals(l->datatype, xsd_string_uri))
+        return hash;
+    }
+
+    hash = rasqal_literal_hash_bytes(hash, "^^", 2);
+    hash = rasqal_literal_hash_uri(hash, l->datatype);
+  }
+
+  return hash;
+}
+
+
+static unsigned int
+rasqal_literal_hash_rdf_term(rasqal_literal* l)
+{
+  unsigned int hash = RASQAL_LITERAL_HASH_INIT;
+  unsigned char hash_class;
+
+  switch(rasqal_literal_get_rdf_term_type(l)) {
+    case RASQAL_LITERAL_URI:
+      hash_class = RASQAL_LITERAL_HASH_CLASS_URI;
+      hash = rasqal_literal_hash_bytes(hash, &hash_class, 1);
+      hash = rasqal_literal_hash_uri(hash, l->value.uri);
+      break;
+
+    case RASQAL_LITERAL_BLANK:
+      hash_class = RASQAL_LITERAL_HASH_CLASS_BLANK;
+      hash = rasqal_literal_hash_bytes(hash, &hash_class, 1);
+      hash = rasqal_literal_hash_bytes(hash, l->string, l->string_len);
+      break;
+
+    case RASQAL_LITERAL_STRING:
+      hash_class = RASQAL_LITERAL_HASH_CLASS_STRING;
+      hash = rasqal_literal_hash_bytes(hash, &hash_class, 1);
+      hash = rasqal_literal_hash_string_node(l, hash, 0);
+      break;
+
+    case RASQAL_LITERAL_UNKNOWN:
+    case RASQAL_LITERAL_XSD_STRING:
+    case RASQAL_LITERAL_BOOLEAN:
+    case RASQAL_LITERAL_INTEGER:
+    case RASQAL_LITERAL_FLOAT:
+    case RASQAL_LITERAL_DOUBLE:
+    case RASQAL_LITERAL_DECIMAL:
+    case RASQAL_LITERAL_DATETIME:
+    case RASQAL_LITERAL_UDT:
+    case RASQAL_LITERAL_PATTERN:
+    case RASQAL_LITERAL_QNAME:
+    case RASQAL_LITERAL_VARIABLE:
+    case RASQAL_LITERAL_INTEGER_SUBTYPE:
+    case RASQAL_LITERAL_DATE:
+    default:
+      /* Not an RDF term: never equal to anything */
+      hash_class = RASQAL_LITERAL_HASH_CLASS_UNKNOWN;
+      hash = rasqal_literal_hash_bytes(hash, &hash_class, 1);
+      hash = rasqal_literal_hash_bytes(hash, &l->type, sizeof(l->type));
+      if(l->string)
+        hash = rasqal_literal_hash_bytes(hash, l->string, l->string_len);
+      break;
+  }
+
+  return hash;
+}
+
+
+static unsigned int
+rasqal_literal_hash_double(unsigned int hash, double d)
+{
+  /* -0.0 and +0.0 are equal; all NaNs hash the same */
+  if(isnan(d))
+    return rasqal_literal_hash_bytes(hash, "NaN", 3);
+
+  if(!(d < 0.0 || d > 0.0))
+    d = 0.0;
+
+  return rasqal_literal_hash_bytes(hash, &d, sizeof(d));
+}
+
+
+static unsigned int
+rasqal_literal_hash_timeline(unsigned int hash, time_t time_on_timeline,
+                             int microseconds, signed short timezone_minutes)
+{
+  unsigned char has_tz;
+
+  has_tz = (timezone_minutes != RASQAL_XSD_DATETIME_NO_TZ);
+  hash = rasqal_literal_hash_bytes(hash, &has_tz, 1);
+  hash = rasqal_literal_hash_bytes(hash, &time_on_timeline,
+                                   sizeof(time_on_timeline));
+  return rasqal_literal_hash_bytes(hash, &microseconds, sizeof(microseconds));
+}
+
+
+static unsigned int
+rasqal_literal_hash_value(rasqal_literal* l)
+{
+  unsigned int hash = RASQAL_LITERAL_HASH_INIT;
+  unsigned char hash_class;
+
+  /* Same native conversion as done by rasqal_literal_equals_flags() */
+  rasqal_literal_string_to_native(l, 0);
+
+  switch(l->type) {
+    case RASQAL_LITERAL_URI:
+    case RASQAL_LITERAL_BLANK:
+      hash = rasqal_literal_hash_rdf_term(l);
+      break;
+
+    case RASQAL_LITERAL_STRING:
+    case RASQAL_LITERAL_XSD_STRING:
+    case RASQAL_LITERAL_UDT:
+      hash_class = RASQAL_LITERAL_HASH_CLASS_STRING;
+      hash = rasqal_literal_hash_bytes(hash, &hash_class, 1);
+      hash = rasqal_literal_hash_string_node(l, hash, 1);
+      break;
+
+    case RASQAL_LITERAL_BOOLEAN:
+      hash_class = RASQAL_LITERAL_HASH_CLASS_BOOLEAN;
+      hash = rasqal_literal_hash_bytes(hash, &hash_class, 1);
+      hash = rasqal_literal_hash_bytes(hash, &l->value.integer,
+                                       sizeof(l->value.integer));
+      break;
+
+    case RASQAL_LITERAL_INTEGER:
+    case RASQAL_LITERAL_INTEGER_SUBTYPE:
+    case RASQAL_LITERAL_DECIMAL:
+    case RASQAL_LITERAL_FLOAT:
+    case RASQAL_LITERAL_DOUBLE:
+      /* Numbers are promoted to doubles that are equal when within
+       * rasqal_double_approximately_equal() of each other.  Any two
+       * numbers are joined by a chain of such doubles so only the
+       * class can be hashed. */
+      hash_class = RASQAL_LITERAL_HASH_CLASS_NUMERIC;
+      hash = rasqal_literal_hash_bytes(hash, &hash_class, 1);
+      break;
+
+    case RASQAL_LITERAL_DATE:
+      /* a date is promoted to a dateTime at the start of the day */
+      hash_class = RASQAL_LITERAL_HASH_CLASS_DATETIME;
+      hash = rasqal_literal_hash_bytes(hash, &hash_class, 1);
+      hash = rasqal_literal_hash_timeline(hash,
+                                          l->value.date->time_on_timeline,
+                                          0,
+                                          l->value.date->timezone_minutes);
+      break;
+
+    case RASQAL_LITERAL_DATETIME:
+      hash_class = RASQAL_LITERAL_HASH_CLASS_DATETIME;
+      hash = rasqal_literal_hash_bytes(hash, &hash_class, 1);
+      hash = rasqal_literal_hash_timeline(hash,
+                                          l->value.datetime->time_on_timeline,
+                                          l->value.datetime->microseconds,
+                                          l->value.datetime->timezone_minutes);
+      break;
+
+    case RASQAL_LITERAL_UNKNOWN:
+    case RASQAL_LITERAL_PATTERN:
+    case RASQAL_LITERAL_QNAME:
+    case RASQAL_LITERAL_VARIABLE:
+    default:
+      hash = rasqal_literal_hash_rdf_term(l);
+      break;
+  }
+
+  return hash;
+}
+
+
+static unsigned int
+rasqal_literal_hash_rdql_number(double d)
+{
+  unsigned int hash = RASQAL_LITERAL_HASH_INIT;
+  unsigned char hash_class = RASQAL_LITERAL_HASH_CLASS_NUMERIC;
+
+  /* RDQL promotion compares some numeric pairs as truncated integers */
+  d = (d < 0.0) ? ceil(d) : floor(d);
+
+  hash = rasqal_literal_hash_bytes(hash, &hash_class, 1);
+  return rasqal_literal_hash_double(hash, d);
+}
+
+
+/*
+ * rasqal_literal_hash_rdql_string:
+ * @world: world object
+ * @string: lexical form
+ * @len: length of @string
+ *
+ * INTERNAL - Hash a lexical form consistently with RDQL promotion
+ *
+ * RDQL promotion compares a string with a number, boolean or date
+ * either by value or by lexical form, so a lexical form of one of
+ * those types is hashed as that value.
+ *
+ * Return value: hash
+ */
+static unsigned int
+rasqal_literal_hash_rdql_string(rasqal_world* world,
+                                const unsigned char* string, size_t len)
+{
+  const char* s = RASQAL_GOOD_CAST(const char*, string);
+  unsigned int hash = RASQAL_LITERAL_HASH_INIT;
+  unsigned char hash_class;
+
+  if(len) {
+    /* same test as rasqal_literal_as_double() */
+    char* eptr = NULL;
+    double d = strtod(s, &eptr);
+
+    if(eptr != s && *eptr == '\0')
+      return rasqal_literal_hash_rdql_number(d);
+  }
+
+  if(!strcmp(s, "true") || !strcmp(s, "TRUE"))
+    return rasqal_literal_hash_rdql_number(1.0);
+
+  if(!strcmp(s, "false") || !strcmp(s, "FALSE"))
+    return rasqal_literal_hash_rdql_number(0.0);
+
+  /* shortest date is YYYY-MM-DD */
+  if(len >= 10 && (isdigit(string[0]) || string[0] == '-')) {
+    rasqal_xsd_datetime* dt;
+    rasqal_xsd_date* date;
+
+    hash_class = RASQAL_LITERAL_HASH_CLASS_DATETIME;
+
+    dt = rasqal_new_xsd_datetime(world, s);
+    if(dt) {
+      hash = rasqal_literal_hash_bytes(hash, &hash_class, 1);
+      hash = rasqal_literal_hash_timeline(hash, dt->time_on_timeline,
+                                          dt->microseconds,
+                                          dt->timezone_minutes);
+      rasqal_free_xsd_datetime(dt);
+      return hash;
+    }
+
+    date = rasqal_new_xsd_date(world, s);
+    if(date) {
+      hash = rasqal_literal_hash_bytes(hash, &hash_class, 1);
+      hash = rasqal_literal_hash_timeline(hash, date->time_on_timeline, 0,
+                                          date->timezone_minutes);
+      rasqal_free_xsd_date(date);
+      return hash;
+    }
+  }
+
+  hash_class = RASQAL_LITERAL_HASH_CLASS_STRING;
+  hash = rasqal_literal_hash_bytes(hash, &hash_class, 1);
+  return rasqal_literal_hash_bytes(hash, string, len);
+}
+
+
+/*
+ * rasqal_literal_hash_rdql:
+ * @l: literal
+ *
+ * INTERNAL - Hash a literal consistently with the RDQL promotion rules
+ *
+ * Numbers and booleans hash as their value truncated to an integer
+ * and all other literals by their lexical form as done by
+ * rasqal_literal_hash_rdql_string().
+ *
+ * Return value: hash
+ */
+static unsigned int
+rasqal_literal_hash_rdql(rasqal_literal* l)
+{
+  const unsigned char* string;
+  size_t len = 0;
+
+  switch(l->type) {
+    case RASQAL_LITERAL_BOOLEAN:
+    case RASQAL_LITERAL_INTEGER:
+    case RASQAL_LITERAL_INTEGER_SUBTYPE:
+      return rasqal_literal_hash_rdql_number(RASQAL_GOOD_CAST(double, l->value.integer));
+
+    case RASQAL_LITERAL_DECIMAL:
+      return rasqal_literal_hash_rdql_number(rasqal_xsd_decimal_get_double(l->value.decimal));
+
+    case RASQAL_LITERAL_FLOAT:
+    case RASQAL_LITERAL_DOUBLE:
+      return rasqal_literal_hash_rdql_number(l->value.floating);
+
+    case RASQAL_LITERAL_URI:
+    case RASQAL_LITERAL_BLANK:
+    case RASQAL_LITERAL_STRING:
+    case RASQAL_LITERAL_XSD_STRING:
+    case RASQAL_LITERAL_UDT:
+    case RASQAL_LITERAL_PATTERN:
+    case RASQAL_LITERAL_QNAME:
+    case RASQAL_LITERAL_DATE:
+    case RASQAL_LITERAL_DATETIME:
+      string = rasqal_literal_as_counted_string(l, &len, 0, NULL);
+      if(string)
+        return rasqal_literal_hash_rdql_string(l->world, string, len);
+      break;
+
+    case RASQAL_LITERAL_UNKNOWN:
+    case RASQAL_LITERAL_VARIABLE:
+    default:
+      break;
+  }
+
+  return rasqal_literal_hash_rdf_term(l);
+}
+
+
+/**
+ * rasqal_literal_hash:
+ * @l: #rasqal_literal literal (or NULL)
+ * @flags: comparison flags
+ *
+ * Get a hash of a literal consistent with rasqal_literal_equals_flags()
+ *
+ * If @flags contains #RASQAL_COMPARE_RDF, the hash is of the RDF term
+ * so that literals equal as RDF terms have equal hashes.  If @flags
+ * contains #RASQAL_COMPARE_XQUERY the hash is of the value using the
+ * XQuery rules including numeric type promotion.  Doubles are equal
+ * when approximately equal so all numbers hash the same, including
+ * "1"^^xsd:integer, "1.0"^^xsd:decimal and "1.0e0"^^xsd:double.
+ *
+ * Otherwise the hash is consistent with rasqal_literal_compare() using
+ * the RDQL promotion rules, so for example "1" and "1"^^xsd:integer
+ * hash the same.  Pairs that compare equal only because a string is
+ * promoted to a boolean other than from "true", "false", "1" or "0"
+ * may hash differently, as may pairs where the comparison fails with
+ * an error, which callers hashing keys should treat as not equal.
+ *
+ * Each hash is computed once and cached inside the literal, where it
+ * is read and written atomically so that literals shared between
+ * threads may be hashed concurrently.  A variable literal hashes as
+ * its current value, which is not cached.
+ *
+ * Return value: hash value; 0 for NULL or an unbound variable
+ **/
+unsigned int
+rasqal_literal_hash(rasqal_literal* l, int flags)
+{
+  unsigned int hash;
+
+  if(!l)
+    return 0;
+
+  if(l->type == RASQAL_LITERAL_VARIABLE)
+    return rasqal_literal_hash(l->value.variable->value, flags);
+
+  if(flags & RASQAL_COMPARE_RDF) {
+    hash = RASQAL_CACHE_GET(&l->hash_rdf);
+    if(!hash) {
+      /* 0 means not cached */
+      hash = rasqal_literal_hash_rdf_term(l);
+      if(!hash)
+        hash = 1;
+      RASQAL_CACHE_SET(&l->hash_rdf, hash);
+    }
+    return hash;
+  }
+
+  if(!(flags & RASQAL_COMPARE_XQUERY)) {
+    hash = RASQAL_CACHE_GET(&l->hash_rdql);
+    if(!hash) {
+      hash = rasqal_literal_hash_rdql(l);
+      if(!hash)
+        hash = 1;
+      RASQAL_CACHE_SET(&l->hash_rdql, hash);
+    }
+    return hash;
+  }
+
+  hash = RASQAL_CACHE_GET(&l->hash_value);
+  if(!hash) {
+    hash = rasqal_literal_hash_value(l);
+    if(!hash)
+      hash = 1;
+    /* set after hashing since native conversion may reset the cache */
+    RASQAL_CACHE_SET(&l->hash_value, hash);
+  }
+  return hash;
+}
+
+
 /*
  * rasqal_literal_expand_qname:
  * @user_data: #rasqal_query cast as void for use with raptor_sequence_foreach
@@ -3002,6 +3472,9 @@ rasqal_literal_expand_qname(void *user_data, rasqal_literal *l)
     l->string = NULL;
     l->type = RASQAL_LITERAL_URI;
     l->value.uri = uri;
+    l->hash_rdf = 0;
+    l->hash_value = 0;
+    l->hash_rdql = 0;
   } else if (l->type == RASQAL_LITERAL_STRING) {
     raptor_uri *uri;
     
@@ -3015,6 +3488,9 @@ rasqal_literal_expand_qname(void *user_data, rasqal_literal *l)
       l->datatype = uri;
       RASQAL_FREE(char*, l->flags);
       l->flags = NULL;
+      l->hash_rdf = 0;
+      l->hash_value = 0;
+      l->hash_rdql = 0;
 
       if(l->language && uri) {
         RASQAL_FREE(char*, l->language);
@@ -4985,6 +5461,146 @@ static const struct {
 };
 
 
+static rasqal_literal*
+rasqal_literal_hash_test_string(rasqal_world* world, const char* str,
+                                const char* lang,
+                                rasqal_literal_type datatype_type)
+{
+  size_t len = strlen(str);
+  unsigned char* val;
+  char* language = NULL;
+  raptor_uri* dt_uri = NULL;
+
+  val = RASQAL_MALLOC(unsigned char*, len + 1);
+  if(!val)
+    return NULL;
+  memcpy(val, str, len + 1);
+
+  if(lang) {
+    len = strlen(lang);
+    language = RASQAL_MALLOC(char*, len + 1);
+    if(!language) {
+      RASQAL_FREE(char*, val);
+      return NULL;
+    }
+    memcpy(language, lang, len + 1);
+  }
+
+  if(datatype_type != RASQAL_LITERAL_UNKNOWN)
+    dt_uri = raptor_uri_copy(rasqal_xsd_datatype_type_to_uri(world,
+                                                             datatype_type));
+
+  return rasqal_new_string_literal_node(world, val, language, dt_uri);
+}
+
+
+static int
+rasqal_literal_hash_test(rasqal_world* world, const char* program)
+{
+  rasqal_literal* l[10];
+  int failures = 0;
+  int i;
+  unsigned int h;
+
+  l[0] = rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER, 1);
+  l[1] = rasqal_new_decimal_literal(world, (const unsigned char*)"1.0");
+  l[2] = rasqal_new_double_literal(world, 1.0);
+  l[3] = rasqal_literal_hash_test_string(world, "abc", NULL,
+                                         RASQAL_LITERAL_UNKNOWN);
+  l[4] = rasqal_literal_hash_test_string(world, "abc", NULL,
+                                         RASQAL_LITERAL_XSD_STRING);
+  l[5] = rasqal_literal_hash_test_string(world, "chat", "en",
+                                         RASQAL_LITERAL_UNKNOWN);
+  l[6] = rasqal_literal_hash_test_string(world, "chat", "EN",
+                                         RASQAL_LITERAL_UNKNOWN);
+  l[7] = rasqal_new_double_literal(world, -0.0);
+  l[8] = rasqal_literal_hash_test_string(world, "1", NULL,
+                                         RASQAL_LITERAL_UNKNOWN);
+  l[9] = rasqal_new_double_literal(world, 1.0 + DBL_EPSILON);
+
+  for(i = 0; i < 10; i++) {
+    if(!l[i]) {
+      fprintf(stderr, "%s: failed to create hash test literal %d\n",
+              program, i);
+      failures++;
+      goto tidy;
+    }
+  }
+
+#define HASH_TEST_EQUAL(a, b, flags)                                    \
+  do {                                                                  \
+    if(rasqal_literal_hash(l[a], flags) != rasqal_literal_hash(l[b], flags)) { \
+      fprintf(stderr, "%s: hash of literals %d and %d differ with flags %d\n", \
+              program, a, b, flags);                                    \
+      failures++;                                                       \
+    }                                                                   \
+  } while(0)
+
+  /* 1 = 1.0 = 1.0e0 */
+  HASH_TEST_EQUAL(0, 1, RASQAL_COMPARE_XQUERY);
+  HASH_TEST_EQUAL(0, 2, RASQAL_COMPARE_XQUERY);
+  /* 1.0e0 = 1.0e0 + epsilon since doubles are approximately equal */
+  HASH_TEST_EQUAL(2, 9, RASQAL_COMPARE_XQUERY);
+  /* "abc" = "abc"^^xsd:string as values but not as RDF terms */
+  HASH_TEST_EQUAL(3, 4, RASQAL_COMPARE_XQUERY);
+  if(rasqal_literal_hash(l[3], RASQAL_COMPARE_RDF) ==
+     rasqal_literal_hash(l[4], RASQAL_COMPARE_RDF)) {
+    fprintf(stderr, "%s: RDF term hash of \"abc\" and \"abc\"^^xsd:string are the same\n",
+            program);
+    failures++;
+  }
+  /* "chat"@en = "chat"@EN */
+  HASH_TEST_EQUAL(5, 6, RASQAL_COMPARE_XQUERY);
+  HASH_TEST_EQUAL(5, 6, RASQAL_COMPARE_RDF);
+
+  /* 1 != 1.0 as RDF terms */
+  if(rasqal_literal_hash(l[0], RASQAL_COMPARE_RDF) ==
+     rasqal_literal_hash(l[1], RASQAL_COMPARE_RDF)) {
+    fprintf(stderr, "%s: RDF term hash of 1 and 1.0 are the same\n", program);
+    failures++;
+  }
+
+  /* "1" = 1 = 1.0 and "abc" = "abc"^^xsd:string with RDQL promotion */
+  HASH_TEST_EQUAL(8, 0, RASQAL_COMPARE_URI);
+  HASH_TEST_EQUAL(0, 1, RASQAL_COMPARE_URI);
+  HASH_TEST_EQUAL(0, 2, RASQAL_COMPARE_URI);
+  HASH_TEST_EQUAL(3, 4, RASQAL_COMPARE_URI);
+
+  /* -0.0 = 0 */
+  l[7]->value.floating = -0.0;
+  h = rasqal_literal_hash(l[7], RASQAL_COMPARE_XQUERY);
+  l[7]->value.floating = 0.0;
+  l[7]->hash_value = 0;
+  if(h != rasqal_literal_hash(l[7], RASQAL_COMPARE_XQUERY)) {
+    fprintf(stderr, "%s: hash of -0.0 and 0.0 differ\n", program);
+    failures++;
+  }
+
+  /* cached value is returned */
+  h = rasqal_literal_hash(l[1], RASQAL_COMPARE_XQUERY);
+  if(!l[1]->hash_value ||
+     h != rasqal_literal_hash(l[1], RASQAL_COMPARE_XQUERY)) {
+    fprintf(stderr, "%s: hash of literal 1 was not cached\n", program);
+    failures++;
+  }
+
+  h = rasqal_literal_hash(l[0], RASQAL_COMPARE_URI);
+  if(!l[0]->hash_rdql ||
+     h != rasqal_literal_hash(l[0], RASQAL_COMPARE_URI)) {
+    fprintf(stderr, "%s: RDQL hash of literal 0 was not cached\n", program);
+    failures++;
+  }
+
+  tidy:
+  for(i = 0; i < 10; i++) {
+    if(l[i])
+      rasqal_free_literal(l[i]);
+  }
+
+  return failures;
+}
+
+
 int
 main(int argc, char *argv[]) 
 {
@@ -5066,7 +5682,9 @@ main(int argc, char *argv[])
       failures++;
     }
   }
-  
+
+  fprintf(stderr, "%s: Testing literal hashes\n", program);
+  failures += rasqal_literal_hash_test(world, program);
 
   tidy:
   rasqal_free_world(world);
@@ -100,8 +100,11 @@ rasqal_new_query(rasqal_world *world, const char *name,
 
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
 
-  /* for compatibility with older binaries that do not call it */
-  rasqal_world_open(world);
+  /* for compatibility with older binaries that do not call it.
+   * Checked first to avoid writing to the world when it is open
+   * since queries may be made concurrently in several threads */
+  if(!world->opened)
+    rasqal_world_open(world);
 
   factory = rasqal_get_query_language_factory(world, name, uri);
   if(!factory)
@@ -114,6 +117,8 @@ rasqal_new_query(rasqal_world *world, const char *name,
   /* set usage first to 1 so we can clean up with rasqal_free_query() on error */
   query->usage = 1;
 
+  RASQAL_MUTEX_INIT(&query->lock);
+
   query->world = world;
 
   query->factory = factory;
@@ -173,10 +178,16 @@ rasqal_new_query(rasqal_world *world, const char *name,
 void
 rasqal_free_query(rasqal_query* query)
 {
+  int usage;
+
   if(!query)
     return;
 
-  if(--query->usage)
+  /* results in other threads may drop their reference at any time */
+  RASQAL_MUTEX_LOCK(&query->lock);
+  usage = --query->usage;
+  RASQAL_MUTEX_UNLOCK(&query->lock);
+  if(usage)
     return;
 
   if(query->factory)
@@ -229,6 +240,9 @@ rasqal_free_query(rasqal_query* query)
   if(query->query_results_formatter_name)
     RASQAL_FREE(char*, query->query_results_formatter_name);
 
+  if(query->set_vars_table)
+    rasqal_free_variables_table(query->set_vars_table);
+
   /* Do this last since most everything above could refer to a variable */
   if(query->vars_table)
     rasqal_free_variables_table(query->vars_table);
@@ -245,6 +259,12 @@ rasqal_free_query(rasqal_query* query)
   if(query->projection)
     rasqal_free_projection(query->projection);
 
+  /* rows still in use keep the pool alive until they are freed */
+  if(query->row_pool)
+    rasqal_free_row_pool(query->row_pool);
+
+  RASQAL_MUTEX_DESTROY(&query->lock);
+
   RASQAL_FREE(rasqal_query, query);
 }
 
@@ -305,6 +325,13 @@ rasqal_query_set_feature(rasqal_query* query, rasqal_feature feature, int value)
   switch(feature) {
     case RASQAL_FEATURE_NO_NET:
     case RASQAL_FEATURE_RAND_SEED:
+    case RASQAL_FEATURE_GROUP_SPILL_LIMIT:
+    case RASQAL_FEATURE_EXECUTION_ARENA:
+    case RASQAL_FEATURE_MEMORY_LIMIT:
+    case RASQAL_FEATURE_TIMEOUT:
+    case RASQAL_FEATURE_PARALLELISM:
+    case RASQAL_FEATURE_PREFETCH:
+    case RASQAL_FEATURE_PROFILE:
 
       if(feature == RASQAL_FEATURE_RAND_SEED)
         query->user_set_rand = 1;
@@ -370,8 +397,18 @@ rasqal_query_get_feature(rasqal_query *query, rasqal_feature feature)
   switch(feature) {
     case RASQAL_FEATURE_NO_NET:
     case RASQAL_FEATURE_RAND_SEED:
+    case RASQAL_FEATURE_PROFILE:
       result = (query->features[RASQAL_GOOD_CAST(int, feature)] != 0);
       break;
+
+    case RASQAL_FEATURE_GROUP_SPILL_LIMIT:
+    case RASQAL_FEATURE_EXECUTION_ARENA:
+    case RASQAL_FEATURE_MEMORY_LIMIT:
+    case RASQAL_FEATURE_TIMEOUT:
+    case RASQAL_FEATURE_PARALLELISM:
+    case RASQAL_FEATURE_PREFETCH:
+      result = query->features[RASQAL_GOOD_CAST(int, feature)];
+      break;
   }
 
   return result;
@@ -675,6 +712,37 @@ rasqal_query_get_data_graph(rasqal_query* query, int idx)
 }
 
 
+/**
+ * rasqal_query_set_shared_triples_source:
+ * @query: #rasqal_query query object
+ * @triples_source: triples source from rasqal_new_shared_triples_source() or NULL
+ *
+ * Set a shared triples source to execute the query against
+ *
+ * Executions of the query then match against @triples_source instead
+ * of loading the query data graphs into a triples source of their
+ * own.  The query data graphs still name the graphs that GRAPH
+ * patterns range over.  Executions given data graphs with
+ * rasqal_query_execute2() load those as before.
+ *
+ * The query does not own @triples_source which must not be freed
+ * before the query and all its results.  Passing NULL goes back to
+ * loading the data graphs on each execution.
+ *
+ * Return value: non-0 on failure
+ **/
+int
+rasqal_query_set_shared_triples_source(rasqal_query* query,
+                                       rasqal_triples_source* triples_source)
+{
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query, rasqal_query, 1);
+
+  query->shared_triples_source = triples_source;
+
+  return 0;
+}
+
+
 /**
  * rasqal_query_dataset_contains_named_graph:
  * @query: #rasqal_query query object
@@ -907,11 +975,31 @@ rasqal_query_set_variable2(rasqal_query* query,
                            const unsigned char *name,
                            rasqal_literal* value)
 {
+  rasqal_variable* v;
+
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query, rasqal_query, 1);
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(name, char*, 1);
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(value, rasqal_literal, 1);
 
-  return rasqal_variables_table_set(query->vars_table, type, name, value);
+  if(rasqal_variables_table_set(query->vars_table, type, name, value))
+    return 1;
+
+  /* remember the value since executions running at the same time
+   * bind the query variables */
+  if(!query->set_vars_table) {
+    query->set_vars_table = rasqal_new_variables_table(query->world);
+    if(!query->set_vars_table)
+      return 1;
+  }
+
+  v = rasqal_variables_table_add2(query->set_vars_table, type, name, 0, NULL);
+  if(!v)
+    return 1;
+
+  rasqal_variable_set_value(v, rasqal_new_literal_from_literal(value));
+  rasqal_free_variable(v);
+
+  return 0;
 }
 
 
@@ -1343,6 +1431,187 @@ rasqal_query_get_engine_by_name(const char* name)
 }
 
 
+/*
+ * rasqal_query_copy_for_execution:
+ * @query: prepared query
+ * @with_data_graphs: non-0 if the copy will load the data graphs of @query
+ *
+ * INTERNAL - Make a private prepared copy of a query for an execution that runs while another uses @query
+ *
+ * Variable values and the evaluation context live in the query
+ * (#rasqal_variable and #rasqal_evaluation_context are public
+ * structures that cannot be extended) so an execution running at the
+ * same time as another must bind a different set.  The copy is made
+ * by preparing the query string again, or the query written as SPARQL
+ * if there is none, and then setting the limit, offset, distinct,
+ * explain and variable values set with the API.  Only strings and
+ * values are read from @query; no object it shares is copied by
+ * reference so this may run at the same time as an execution of
+ * @query in another thread.
+ *
+ * The data graphs of @query are copied by URI.  A graph read from an
+ * iostream can only be read once so it fails if @with_data_graphs is
+ * set; otherwise the copy does not load the graphs and only keeps the
+ * graph name that GRAPH patterns range over.
+ *
+ * Return value: new prepared query or NULL on failure
+ */
+rasqal_query*
+rasqal_query_copy_for_execution(rasqal_query* query, int with_data_graphs)
+{
+  rasqal_world* world = query->world;
+  rasqal_query* copy = NULL;
+  const char* language = query->factory->desc.names[0];
+  unsigned char* query_string = query->query_string;
+  unsigned char* written_string = NULL;
+  raptor_uri* base_uri = NULL;
+  raptor_sequence* data_graphs = NULL;
+  int size;
+  int i;
+
+  if(!query_string) {
+    raptor_iostream* iostr;
+    int rc;
+
+    iostr = raptor_new_iostream_to_string(world->raptor_world_ptr,
+                                          (void**)&written_string, NULL,
+                                          rasqal_alloc_memory);
+    if(!iostr)
+      return NULL;
+    rc = rasqal_query_write(iostr, query, NULL, NULL);
+    raptor_free_iostream(iostr);
+    if(rc || !written_string)
+      goto failed;
+
+    query_string = written_string;
+    language = "sparql11";
+  }
+
+  copy = rasqal_new_query(world, language, NULL);
+  if(!copy)
+    goto failed;
+
+  memcpy(copy->features, query->features, sizeof(query->features));
+  copy->user_set_rand = query->user_set_rand;
+  copy->user_data = query->user_data;
+  copy->shared_triples_source = query->shared_triples_source;
+
+  if(query->base_uri) {
+    base_uri = raptor_new_uri(world->raptor_world_ptr,
+                              raptor_uri_as_string(query->base_uri));
+    if(!base_uri)
+      goto failed;
+  }
+
+  if(rasqal_query_prepare(copy, query_string, base_uri))
+    goto failed;
+
+  copy->store_results = query->store_results;
+
+  /* settings changed with the API after the query was prepared */
+  rasqal_query_set_limit(copy, rasqal_query_get_limit(query));
+  rasqal_query_set_offset(copy, rasqal_query_get_offset(query));
+  if(query->projection)
+    rasqal_query_set_distinct(copy, query->projection->distinct);
+  copy->explain = query->explain;
+
+  if(query->set_vars_table) {
+    rasqal_variable* v;
+
+    for(i = 0; (v = rasqal_variables_table_get(query->set_vars_table, i)); i++) {
+      rasqal_variable* copy_v;
+
+      copy_v = rasqal_variables_table_add2(copy->vars_table, v->type, v->name,
+                                           0, NULL);
+      if(!copy_v)
+        goto failed;
+
+      rasqal_variable_set_value(copy_v, rasqal_new_literal_from_literal(v->value));
+      rasqal_free_variable(copy_v);
+    }
+  }
+
+  /* Replace the data graphs from the query string with all those of
+   * @query which also include any added with the API */
+  data_graphs = raptor_new_sequence((raptor_data_free_handler)rasqal_free_data_graph,
+                                    (raptor_data_print_handler)rasqal_data_graph_print);
+  if(!data_graphs)
+    goto failed;
+
+  size = raptor_sequence_size(query->data_graphs);
+  for(i = 0; i < size; i++) {
+    rasqal_data_graph* dg;
+    rasqal_data_graph* new_dg;
+    raptor_uri* dg_uri;
+    raptor_uri* uri;
+    raptor_uri* name_uri = NULL;
+    raptor_uri* format_uri = NULL;
+
+    dg = (rasqal_data_graph*)raptor_sequence_get_at(query->data_graphs, i);
+
+    dg_uri = dg->uri;
+    if(dg->iostr) {
+      /* an iostream can only be read once */
+      if(with_data_graphs)
+        goto failed;
+
+      if(!dg->name_uri)
+        continue;
+      dg_uri = dg->name_uri;
+    }
+
+    if(!dg_uri)
+      goto failed;
+
+    uri = raptor_new_uri(world->raptor_world_ptr, raptor_uri_as_string(dg_uri));
+    if(dg->name_uri)
+      name_uri = raptor_new_uri(world->raptor_world_ptr,
+                                raptor_uri_as_string(dg->name_uri));
+    if(dg->format_uri)
+      format_uri = raptor_new_uri(world->raptor_world_ptr,
+                                  raptor_uri_as_string(dg->format_uri));
+
+    new_dg = NULL;
+    if(uri && (name_uri || !dg->name_uri) && (format_uri || !dg->format_uri))
+      new_dg = rasqal_new_data_graph_from_uri(world, uri, name_uri, dg->flags,
+                                              dg->format_type, dg->format_name,
+                                              format_uri);
+
+    if(uri)
+      raptor_free_uri(uri);
+    if(name_uri)
+      raptor_free_uri(name_uri);
+    if(format_uri)
+      raptor_free_uri(format_uri);
+
+    if(!new_dg || raptor_sequence_push(data_graphs, new_dg))
+      goto failed;
+  }
+
+  raptor_free_sequence(copy->data_graphs);
+  copy->data_graphs = data_graphs;
+
+  if(base_uri)
+    raptor_free_uri(base_uri);
+  if(written_string)
+    rasqal_free_memory(written_string);
+
+  return copy;
+
+  failed:
+  if(data_graphs)
+    raptor_free_sequence(data_graphs);
+  if(base_uri)
+    raptor_free_uri(base_uri);
+  if(written_string)
+    rasqal_free_memory(written_string);
+  if(copy)
+    rasqal_free_query(copy);
+
+  return NULL;
+}
+
+
 /**
  * rasqal_query_execute_with_engine:
  * @query: the #rasqal_query object
@@ -1350,6 +1619,11 @@ rasqal_query_get_engine_by_name(const char* name)
  *
  * INTERNAL - Excecute a query with a given factory and return results.
  *
+ * The first execution of @query binds variables in @query itself.
+ * Executions started while its results are alive, which may be in
+ * other threads, run over a private copy made by
+ * rasqal_query_copy_for_execution() that the results own.
+ *
  * return value: a #rasqal_query_results structure or NULL on failure.
  **/
 rasqal_query_results*
@@ -1359,6 +1633,8 @@ rasqal_query_execute_with_engine(rasqal_query* query,
 {
   rasqal_query_results *query_results = NULL;
   rasqal_query_results_type type;
+  rasqal_query* exec_query = query;
+  int busy;
 
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query, rasqal_query, NULL);
 
@@ -1369,25 +1645,64 @@ rasqal_query_execute_with_engine(rasqal_query* query,
   if(type == RASQAL_QUERY_RESULTS_UNKNOWN)
     return NULL;
 
-  query_results = rasqal_new_query_results2(query->world, query, type);
+  RASQAL_MUTEX_LOCK(&query->lock);
+  busy = query->executing;
+  query->executing = 1;
+  RASQAL_MUTEX_UNLOCK(&query->lock);
+
+  if(busy) {
+    /* the data graphs are only loaded without a graphs set or a
+     * shared triples source */
+    exec_query = rasqal_query_copy_for_execution(query, !data_graphs &&
+                                                 !query->shared_triples_source);
+    if(!exec_query)
+      return NULL;
+  }
+
+  query_results = rasqal_new_query_results2(query->world, exec_query, type);
   if(!query_results)
-    return NULL;
+    goto tidy;
 
   if(!engine)
     engine = rasqal_query_get_engine_by_name(NULL);
 
   if(rasqal_query_results_execute_with_engine(query_results, engine, data_graphs,
-                                              query->store_results)) {
-    rasqal_free_query_results(query_results);
-    query_results = NULL;
+                                              exec_query->store_results)) {
+    rasqal_query_results_error error;
+
+    /* Keep results that ran out of memory or time so that the caller
+     * can tell why with rasqal_query_results_get_error() */
+    error = rasqal_query_results_get_error(query_results);
+    if(error != RASQAL_QUERY_RESULTS_ERROR_MEMORY_LIMIT &&
+       error != RASQAL_QUERY_RESULTS_ERROR_TIMEOUT &&
+       error != RASQAL_QUERY_RESULTS_ERROR_CANCELLED) {
+      rasqal_free_query_results(query_results);
+      query_results = NULL;
+    }
   }
 
 
-  if(query_results && rasqal_query_add_query_result(query, query_results)) {
+  if(query_results && rasqal_query_add_query_result(exec_query, query_results)) {
     rasqal_free_query_results(query_results);
     query_results = NULL;
   }
 
+  if(query_results && !busy) {
+    RASQAL_MUTEX_LOCK(&query->lock);
+    query->executing_results = query_results;
+    RASQAL_MUTEX_UNLOCK(&query->lock);
+  }
+
+  tidy:
+  if(busy) {
+    /* the results now hold the only reference to the copy */
+    rasqal_free_query(exec_query);
+  } else if(!query_results) {
+    RASQAL_MUTEX_LOCK(&query->lock);
+    query->executing = 0;
+    RASQAL_MUTEX_UNLOCK(&query->lock);
+  }
+
   return query_results;
 }
 
@@ -1398,6 +1713,13 @@ rasqal_query_execute_with_engine(rasqal_query* query,
  *
  * Execute a query - run and return results.
  *
+ * A query may be executed again while the results of other
+ * executions are in use, including from several threads at once
+ * when Rasqal is built with threads.  Each execution binds its own
+ * variables.  Concurrent executions need a raptor world with
+ * #RAPTOR_WORLD_FLAG_URI_INTERNING turned off and data graphs read
+ * from URIs rather than iostreams.
+ *
  * return value: a #rasqal_query_results structure or NULL on failure.
  *
  * This is deprecated in favor of rasqal_query_execute2().
@@ -1416,6 +1738,13 @@ rasqal_query_execute(rasqal_query* query)
  *
  * Execute a query over a dataset - run and return results.
  *
+ * A query may be executed again while the results of other
+ * executions are in use, including from several threads at once
+ * when Rasqal is built with threads.  Each execution binds its own
+ * variables.  Concurrent executions need a raptor world with
+ * #RAPTOR_WORLD_FLAG_URI_INTERNING turned off and data graphs read
+ * from URIs rather than iostreams.
+ *
  * return value: a #rasqal_query_results structure or NULL on failure.
  **/
 rasqal_query_results*
@@ -1584,6 +1913,8 @@ static int
 rasqal_query_add_query_result(rasqal_query* query,
                               rasqal_query_results* query_results)
 {
+  int rc;
+
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query, rasqal_query, 1);
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query_results, rasqal_query_results, 1);
 
@@ -1593,9 +1924,12 @@ rasqal_query_add_query_result(rasqal_query* query,
      as the free handler which calls rasqal_free_query() decrementing
      query->usage */
 
+  RASQAL_MUTEX_LOCK(&query->lock);
   query->usage++;
+  rc = raptor_sequence_push(query->results, query_results);
+  RASQAL_MUTEX_UNLOCK(&query->lock);
 
-  return raptor_sequence_push(query->results, query_results);
+  return rc;
 }
 
 
@@ -1606,21 +1940,33 @@ rasqal_query_remove_query_result(rasqal_query* query,
 {
   int i;
   int size;
+  rasqal_query_results *found = NULL;
 
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query, rasqal_query, 1);
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query_results, rasqal_query_results, 1);
 
+  RASQAL_MUTEX_LOCK(&query->lock);
   size = raptor_sequence_size(query->results);
   for(i = 0 ; i < size; i++) {
     rasqal_query_results *result;
     result = (rasqal_query_results*)raptor_sequence_get_at(query->results, i);
 
     if(result == query_results) {
-      raptor_sequence_set_at(query->results, i, NULL);
+      found = (rasqal_query_results*)raptor_sequence_delete_at(query->results, i);
       break;
     }
   }
 
+  if(query_results == query->executing_results) {
+    query->executing = 0;
+    query->executing_results = NULL;
+  }
+  RASQAL_MUTEX_UNLOCK(&query->lock);
+
+  /* outside the lock as this drops the results' query reference */
+  if(found)
+    rasqal_query_results_remove_query_reference(found);
+
   return 0;
 }
 
@@ -0,0 +1,418 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_query_concurrent_test.c - Rasqal concurrent query execution test
+ *
+ * Copyright (C) 2026, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ * Executes one prepared query from several threads at once, then one
+ * query per thread all sharing one triples source, then the query with
+ * its rows made ahead on a producer thread, and checks every execution
+ * returns the same results as a single-threaded one.  Finally it checks
+ * an execution over a copy of the query keeps a limit set with the API.
+ * Build with -fsanitize=thread to check for data races, for example:
+ *
+ *   make check CFLAGS="-g -O1 -fsanitize=thread" LDFLAGS="-fsanitize=thread"
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#include <stdarg.h>
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+#if defined(RASQAL_QUERY_SPARQL) && defined(RASQAL_THREADS)
+#define QUERY_LANGUAGE "sparql"
+/* 3 triples squared gives 9 rows, each from joining two patterns */
+#define QUERY_FORMAT "SELECT ?s ?o ?a ?c FROM <%s> \
+         WHERE { ?s ?p ?o . ?a ?b ?c }"
+#define EXPECTED_RESULTS_COUNT 9
+#else
+#define NO_QUERY_LANGUAGE
+#endif
+
+/* limit set with the API on a copy made for a second execution */
+#define LIMIT_RESULTS_COUNT 4
+
+#define THREADS_COUNT 4
+#define EXECUTIONS_PER_THREAD 25
+
+
+#ifdef NO_QUERY_LANGUAGE
+int
+main(int argc, char **argv) {
+  const char *program = rasqal_basename(argv[0]);
+  fprintf(stderr, "%s: No supported query language or threads available, skipping test\n", program);
+  return(0);
+}
+#else
+
+typedef struct {
+  rasqal_query* query;
+
+  /* sum of lengths of all values returned by a single-threaded run */
+  size_t expected_checksum;
+
+  /* number of failed executions */
+  int failures;
+} concurrent_test_state;
+
+
+/*
+ * Execute the query and return the number of rows or <0 on failure
+ * setting *@checksum_p to the total length of their values
+ */
+static int
+concurrent_test_execute(rasqal_query* query, size_t* checksum_p)
+{
+  rasqal_query_results* results;
+  int count = 0;
+  size_t checksum = 0;
+
+  results = rasqal_query_execute(query);
+  if(!results)
+    return -1;
+
+  while(!rasqal_query_results_finished(results)) {
+    int i;
+    int size = rasqal_query_results_get_bindings_count(results);
+
+    for(i = 0; i < size; i++) {
+      rasqal_literal* value;
+
+      value = rasqal_query_results_get_binding_value(results, i);
+      if(value) {
+        size_t len = 0;
+        const unsigned char* str;
+
+        str = rasqal_literal_as_counted_string(value, &len, 0, NULL);
+        if(str)
+          checksum += len;
+      }
+    }
+
+    count++;
+    if(rasqal_query_results_next(results))
+      break;
+  }
+
+  if(rasqal_query_results_get_error(results) != RASQAL_QUERY_RESULTS_ERROR_NONE)
+    count = -1;
+
+  rasqal_free_query_results(results);
+
+  *checksum_p = checksum;
+  return count;
+}
+
+
+static void*
+concurrent_test_thread(void* arg)
+{
+  concurrent_test_state* state = (concurrent_test_state*)arg;
+  int failures = 0;
+  int i;
+
+  for(i = 0; i < EXECUTIONS_PER_THREAD; i++) {
+    size_t checksum = 0;
+    int count;
+
+    count = concurrent_test_execute(state->query, &checksum);
+    if(count != EXPECTED_RESULTS_COUNT ||
+       checksum != state->expected_checksum)
+      failures++;
+  }
+
+  /* each thread has its own state */
+  state->failures = failures;
+
+  return NULL;
+}
+
+
+int
+main(int argc, char **argv) {
+  const char *program = rasqal_basename(argv[0]);
+  raptor_world *raptor_world_ptr;
+  rasqal_world *world;
+  rasqal_query *query = NULL;
+  rasqal_query_results *results;
+  raptor_uri *base_uri;
+  unsigned char *data_string;
+  unsigned char *uri_string;
+  unsigned char *query_string;
+  const char *data_file;
+  size_t qs_len;
+  size_t checksum = 0;
+  pthread_t threads[THREADS_COUNT];
+  concurrent_test_state states[THREADS_COUNT];
+  rasqal_query *shared_queries[THREADS_COUNT];
+  rasqal_triples_source *triples_source = NULL;
+  raptor_sequence *data_graphs = NULL;
+  rasqal_data_graph *dg;
+  raptor_uri *data_uri;
+  rasqal_world *interning_world;
+  rasqal_query *interning_query;
+  raptor_uri *interning_base_uri;
+  int count;
+  int failures = 0;
+  int i;
+
+  if((data_file = getenv("RDF_DATA_FILE"))) {
+    /* got data from environment */
+  } else {
+    if(argc != 2) {
+      fprintf(stderr, "USAGE: %s data-filename\n", program);
+      return(1);
+    }
+    data_file = argv[1];
+  }
+
+  /* Interned URIs are shared between all users of the raptor world
+   * so they must be turned off to execute queries concurrently */
+  raptor_world_ptr = raptor_new_world();
+  if(!raptor_world_ptr ||
+     raptor_world_set_flag(raptor_world_ptr, RAPTOR_WORLD_FLAG_URI_INTERNING, 0) ||
+     raptor_world_open(raptor_world_ptr)) {
+    fprintf(stderr, "%s: raptor_world init failed\n", program);
+    return(1);
+  }
+
+  world = rasqal_new_world();
+  if(!world) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+  rasqal_world_set_raptor(world, raptor_world_ptr);
+  if(rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  data_string = raptor_uri_filename_to_uri_string(data_file);
+  data_uri = raptor_new_uri(raptor_world_ptr, data_string);
+  qs_len = strlen(RASQAL_GOOD_CAST(const char*, data_string)) + strlen(QUERY_FORMAT);
+  query_string = RASQAL_MALLOC(unsigned char*, qs_len + 1);
+  snprintf(RASQAL_GOOD_CAST(char*, query_string), qs_len, QUERY_FORMAT,
+           data_string);
+  raptor_free_memory(data_string);
+
+  uri_string = raptor_uri_filename_to_uri_string("");
+  base_uri = raptor_new_uri(raptor_world_ptr, uri_string);
+  raptor_free_memory(uri_string);
+
+  query = rasqal_new_query(world, QUERY_LANGUAGE, NULL);
+  if(!query || rasqal_query_prepare(query, query_string, base_uri)) {
+    fprintf(stderr, "%s: %s query prepare FAILED\n", program,
+            QUERY_LANGUAGE);
+    return(1);
+  }
+
+  /* one query per thread all matching against one triples source */
+  data_graphs = raptor_new_sequence((raptor_data_free_handler)rasqal_free_data_graph,
+                                    NULL);
+  dg = rasqal_new_data_graph_from_uri(world, data_uri, NULL,
+                                      RASQAL_DATA_GRAPH_BACKGROUND,
+                                      NULL, NULL, NULL);
+  if(!data_graphs || !dg || raptor_sequence_push(data_graphs, dg)) {
+    fprintf(stderr, "%s: failed to create data graph\n", program);
+    return(1);
+  }
+
+  triples_source = rasqal_new_shared_triples_source(world, data_graphs);
+  if(!triples_source) {
+    fprintf(stderr, "%s: failed to create shared triples source\n", program);
+    return(1);
+  }
+
+  for(i = 0; i < THREADS_COUNT; i++) {
+    shared_queries[i] = rasqal_new_query(world, QUERY_LANGUAGE, NULL);
+    if(!shared_queries[i] ||
+       rasqal_query_prepare(shared_queries[i], query_string, base_uri) ||
+       rasqal_query_set_shared_triples_source(shared_queries[i],
+                                              triples_source)) {
+      fprintf(stderr, "%s: %s query prepare FAILED\n", program,
+              QUERY_LANGUAGE);
+      return(1);
+    }
+  }
+
+  count = concurrent_test_execute(query, &checksum);
+  if(count != EXPECTED_RESULTS_COUNT) {
+    fprintf(stderr, "%s: query returned %d results, expected %d\n", program,
+            count, EXPECTED_RESULTS_COUNT);
+    return(1);
+  }
+
+  printf("%s: executing query %d times in each of %d threads\n", program,
+         EXECUTIONS_PER_THREAD, THREADS_COUNT);
+
+  for(i = 0; i < THREADS_COUNT; i++) {
+    states[i].query = query;
+    states[i].expected_checksum = checksum;
+    states[i].failures = 0;
+    if(pthread_create(&threads[i], NULL, concurrent_test_thread, &states[i])) {
+      fprintf(stderr, "%s: failed to create thread %d\n", program, i);
+      return(1);
+    }
+  }
+
+  for(i = 0; i < THREADS_COUNT; i++) {
+    pthread_join(threads[i], NULL);
+    if(states[i].failures) {
+      fprintf(stderr, "%s: thread %d had %d bad executions\n", program, i,
+              states[i].failures);
+      failures += states[i].failures;
+    }
+  }
+
+  printf("%s: executing %d queries sharing a triples source %d times each\n",
+         program, THREADS_COUNT, EXECUTIONS_PER_THREAD);
+
+  for(i = 0; i < THREADS_COUNT; i++) {
+    states[i].query = shared_queries[i];
+    states[i].expected_checksum = checksum;
+    states[i].failures = 0;
+    if(pthread_create(&threads[i], NULL, concurrent_test_thread, &states[i])) {
+      fprintf(stderr, "%s: failed to create thread %d\n", program, i);
+      return(1);
+    }
+  }
+
+  for(i = 0; i < THREADS_COUNT; i++) {
+    pthread_join(threads[i], NULL);
+    if(states[i].failures) {
+      fprintf(stderr, "%s: shared triples source thread %d had %d bad executions\n",
+              program, i, states[i].failures);
+      failures += states[i].failures;
+    }
+  }
+
+  printf("%s: executing query with rows made on a producer thread\n",
+         program);
+
+  /* a ring smaller than the results so the producer waits for room */
+  rasqal_query_set_feature(query, RASQAL_FEATURE_PREFETCH, 2);
+  for(i = 0; i < EXECUTIONS_PER_THREAD; i++) {
+    size_t prefetch_checksum = 0;
+
+    count = concurrent_test_execute(query, &prefetch_checksum);
+    if(count != EXPECTED_RESULTS_COUNT || prefetch_checksum != checksum) {
+      fprintf(stderr, "%s: prefetch execution returned %d results, expected %d\n",
+              program, count, EXPECTED_RESULTS_COUNT);
+      failures++;
+    }
+  }
+
+  printf("%s: executing a copy of the query with a limit set by the API\n",
+         program);
+
+  /* open results keep the query busy so the next execution is a copy */
+  rasqal_query_set_feature(query, RASQAL_FEATURE_PREFETCH, 0);
+  rasqal_query_set_limit(query, LIMIT_RESULTS_COUNT);
+  results = rasqal_query_execute(query);
+  count = concurrent_test_execute(query, &checksum);
+  if(!results || count != LIMIT_RESULTS_COUNT) {
+    fprintf(stderr, "%s: query copy returned %d results, expected %d\n",
+            program, count, LIMIT_RESULTS_COUNT);
+    failures++;
+  }
+  if(results)
+    rasqal_free_query_results(results);
+
+  printf("%s: executing query with prefetch in a world interning URIs\n",
+         program);
+
+  if(rasqal_world_get_uri_interning(world)) {
+    fprintf(stderr, "%s: URI interning found in a world with it turned off\n",
+            program);
+    failures++;
+  }
+
+  /* rows are read in this thread since interned URIs are not thread safe */
+  interning_world = rasqal_new_world();
+  if(!interning_world || rasqal_world_open(interning_world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  if(!rasqal_world_get_uri_interning(interning_world)) {
+    fprintf(stderr, "%s: URI interning not found in a default world\n",
+            program);
+    failures++;
+  }
+
+  uri_string = raptor_uri_filename_to_uri_string("");
+  interning_base_uri = raptor_new_uri(interning_world->raptor_world_ptr,
+                                      uri_string);
+  raptor_free_memory(uri_string);
+
+  interning_query = rasqal_new_query(interning_world, QUERY_LANGUAGE, NULL);
+  if(!interning_query ||
+     rasqal_query_prepare(interning_query, query_string, interning_base_uri)) {
+    fprintf(stderr, "%s: %s query prepare FAILED\n", program,
+            QUERY_LANGUAGE);
+    return(1);
+  }
+
+  rasqal_query_set_feature(interning_query, RASQAL_FEATURE_PREFETCH, 2);
+  count = concurrent_test_execute(interning_query, &checksum);
+  if(count != EXPECTED_RESULTS_COUNT) {
+    fprintf(stderr, "%s: prefetch execution interning URIs returned %d results, expected %d\n",
+            program, count, EXPECTED_RESULTS_COUNT);
+    failures++;
+  }
+
+  rasqal_free_query(interning_query);
+  raptor_free_uri(interning_base_uri);
+  rasqal_free_world(interning_world);
+
+  RASQAL_FREE(char*, query_string);
+
+  for(i = 0; i < THREADS_COUNT; i++)
+    rasqal_free_query(shared_queries[i]);
+
+  rasqal_free_shared_triples_source(triples_source);
+
+  raptor_free_sequence(data_graphs);
+
+  rasqal_free_query(query);
+
+  raptor_free_uri(base_uri);
+
+  raptor_free_uri(data_uri);
+
+  rasqal_free_world(world);
+
+  raptor_free_world(raptor_world_ptr);
+
+  return failures;
+}
+
+#endif
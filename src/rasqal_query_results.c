@@ -159,6 +159,15 @@ struct rasqal_query_results_s {
 
   /* non-0 if @vars_table has been initialized from first row */
   int vars_table_init;
+
+  /* Arena for execution-time rows or NULL; see RASQAL_FEATURE_EXECUTION_ARENA */
+  rasqal_arena* arena;
+
+  /* why execution failed when @failed is set */
+  rasqal_query_results_error error;
+
+  /* cancellation and deadline of the execution */
+  rasqal_execution_state execution;
 };
 
 
@@ -344,6 +353,40 @@ rasqal_new_query_results_from_string(rasqal_world* world,
 }
 
 
+/*
+ * rasqal_query_results_set_execution_error:
+ * @query_results: query results
+ * @execution_error: execution engine error
+ *
+ * INTERNAL - Mark the query results as failed from an execution engine error
+ */
+static void
+rasqal_query_results_set_execution_error(rasqal_query_results* query_results,
+                                         rasqal_engine_error execution_error)
+{
+  rasqal_query* query = query_results->query;
+
+  query_results->failed = 1;
+
+  if(execution_error == RASQAL_ENGINE_FAILED_MEMORY_LIMIT) {
+    query_results->error = RASQAL_QUERY_RESULTS_ERROR_MEMORY_LIMIT;
+    rasqal_log_error_simple(query_results->world, RAPTOR_LOG_LEVEL_ERROR,
+                            query ? &query->locator : NULL,
+                            "Query execution exceeded the memory limit of %d kilobytes",
+                            query ? query->features[RASQAL_GOOD_CAST(int, RASQAL_FEATURE_MEMORY_LIMIT)] : 0);
+  } else if(execution_error == RASQAL_ENGINE_FAILED_TIMEOUT) {
+    query_results->error = RASQAL_QUERY_RESULTS_ERROR_TIMEOUT;
+    rasqal_log_error_simple(query_results->world, RAPTOR_LOG_LEVEL_ERROR,
+                            query ? &query->locator : NULL,
+                            "Query execution exceeded the timeout of %d milliseconds",
+                            query ? query->features[RASQAL_GOOD_CAST(int, RASQAL_FEATURE_TIMEOUT)] : 0);
+  } else if(execution_error == RASQAL_ENGINE_FAILED_CANCELLED)
+    query_results->error = RASQAL_QUERY_RESULTS_ERROR_CANCELLED;
+  else
+    query_results->error = RASQAL_QUERY_RESULTS_ERROR_FAILED;
+}
+
+
 /**
  * rasqal_query_results_execute_with_engine:
  * @query_results: the #rasqal_query_results object
@@ -365,6 +408,8 @@ rasqal_query_results_execute_with_engine(rasqal_query_results* query_results,
   size_t ex_data_size;
   rasqal_query* query;
   raptor_sequence* dg_seq;
+  int arena_kb;
+  int memory_limit_kb;
 
 
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query_results, rasqal_query_results, 1);
@@ -381,6 +426,9 @@ rasqal_query_results_execute_with_engine(rasqal_query_results* query_results,
   /* set executed flag early to enable cleanup on error */
   query_results->executed = 1;
 
+  /* Fixes the current datetime unless other executions are running */
+  rasqal_world_begin_execution(query->world);
+
   /* ensure stored results are present if ordering or distincting are being done */
   query_results->store_results = (store_results ||
                                   rasqal_query_get_order_conditions_sequence(query) ||
@@ -395,8 +443,31 @@ rasqal_query_results_execute_with_engine(rasqal_query_results* query_results,
   } else
     query_results->execution_data = NULL;
 
-  /* Update the current datetime once per query execution */
-  rasqal_world_reset_now(query->world);
+  /* Start any timeout from here */
+  if(rasqal_execution_state_init(&query_results->execution,
+                                 query->features[RASQAL_GOOD_CAST(int, RASQAL_FEATURE_TIMEOUT)]))
+    return 1;
+
+  /* Account row memory from here against any limit */
+  memory_limit_kb = query->features[RASQAL_GOOD_CAST(int, RASQAL_FEATURE_MEMORY_LIMIT)];
+  if(memory_limit_kb < 0)
+    memory_limit_kb = 0;
+  if(rasqal_query_reset_row_memory(query, RASQAL_GOOD_CAST(size_t, memory_limit_kb) * 1024))
+    return 1;
+
+  arena_kb = query->features[RASQAL_GOOD_CAST(int, RASQAL_FEATURE_EXECUTION_ARENA)];
+  if(arena_kb > 0 && !query_results->arena) {
+    query_results->arena = rasqal_new_arena(RASQAL_GOOD_CAST(size_t, arena_kb) * 1024);
+    if(!query_results->arena)
+      return 1;
+
+    /* Another execution of this query already owns the query's
+     * arena; run this one from the heap instead */
+    if(rasqal_query_set_row_arena(query, query_results->arena)) {
+      rasqal_free_arena(query_results->arena);
+      query_results->arena = NULL;
+    }
+  }
 
   if(query_results->execution_factory->execute_init) {
     rasqal_engine_error execution_error = RASQAL_ENGINE_OK;
@@ -408,7 +479,8 @@ rasqal_query_results_execute_with_engine(rasqal_query_results* query_results,
     rc = query_results->execution_factory->execute_init(query_results->execution_data, query, query_results, dg_seq, execution_flags, &execution_error);
 
     if(rc || execution_error != RASQAL_ENGINE_OK) {
-      query_results->failed = 1;
+      rasqal_query_results_set_execution_error(query_results,
+                                               execution_error);
       return 1;
     }
   }
@@ -450,6 +522,8 @@ rasqal_free_query_results(rasqal_query_results* query_results)
       query_results->execution_factory->execute_finish(query_results->execution_data, &execution_error);
       /* ignoring failure of execute_finish */
     }
+
+    rasqal_world_end_execution(query_results->world);
   }
 
   if(query_results->execution_data)
@@ -467,6 +541,13 @@ rasqal_free_query_results(rasqal_query_results* query_results)
   if(query_results->vars_table)
     rasqal_free_variables_table(query_results->vars_table);
 
+  /* All rows made by this execution are gone by now: release their
+   * memory in one step */
+  if(query_results->arena) {
+    rasqal_query_set_row_arena(query, NULL);
+    rasqal_free_arena(query_results->arena);
+  }
+
   if(query)
     rasqal_query_remove_query_result(query, query_results);
 
@@ -480,6 +561,9 @@ rasqal_free_query_results(rasqal_query_results* query_results)
  *
  * Get thq query associated with this query result
  *
+ * For an execution started while another execution of the same
+ * query was in progress this is a private copy of that query.
+ *
  * Return value: shared pointer to query object
  **/
 rasqal_query*
@@ -769,14 +853,44 @@ rasqal_query_results_ensure_have_row_internal(rasqal_query_results* query_result
   } else if(query_results->execution_factory &&
             query_results->execution_factory->get_row) {
     rasqal_engine_error execution_error = RASQAL_ENGINE_OK;
+    int offset = 0;
+
+    if(query_results->query)
+      offset = rasqal_query_get_offset(query_results->query);
+
+    /* skip rows before the offset without building them if possible */
+    if(query_results->execution_factory->skip_rows &&
+       offset > query_results->result_count) {
+      int skipped;
+
+      skipped = query_results->execution_factory->skip_rows(query_results->execution_data,
+                                                            offset - query_results->result_count,
+                                                            &execution_error);
+      if(RASQAL_ENGINE_ERROR_IS_FAILURE(execution_error)) {
+        rasqal_query_results_set_execution_error(query_results,
+                                                 execution_error);
+        query_results->finished = 1;
+        return 1;
+      }
+
+      query_results->result_count += skipped;
+    }
 
     /* handle limit/offset for incremental get_row() */
     while(1) {
       int check;
 
+      /* finished at the end of the result range without making a row */
+      if(rasqal_query_check_limit_offset(query_results->query,
+                                         query_results->result_count + 1) > 0) {
+        query_results->finished = 1;
+        break;
+      }
+
       query_results->row = query_results->execution_factory->get_row(query_results->execution_data, &execution_error);
-      if(execution_error == RASQAL_ENGINE_FAILED) {
-        query_results->failed = 1;
+      if(RASQAL_ENGINE_ERROR_IS_FAILURE(execution_error)) {
+        rasqal_query_results_set_execution_error(query_results,
+                                                 execution_error);
         break;
       }
 
@@ -948,6 +1062,60 @@ rasqal_query_results_next(rasqal_query_results* query_results)
 }
 
 
+/**
+ * rasqal_query_results_foreach_row:
+ * @query_results: #rasqal_query_results query_results
+ * @handler: function to call with each row
+ * @user_data: user data for @handler
+ *
+ * Call a handler with the current and each following result row.
+ *
+ * Each row is handed to @handler as made by the query execution
+ * without copying it and is released as soon as @handler returns, so
+ * the values passed must not be used after that without taking a
+ * copy such as with rasqal_new_literal_from_literal().  During the
+ * call the row is also the current result so functions such as
+ * rasqal_query_results_get_binding_value() may be used.
+ *
+ * If @handler returns non-0, the results stay at the row after the
+ * last one given to @handler.
+ *
+ * Return value: non-0 on failure
+ **/
+int
+rasqal_query_results_foreach_row(rasqal_query_results* query_results,
+                                 rasqal_query_results_row_handler handler,
+                                 void* user_data)
+{
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query_results, rasqal_query_results, 1);
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(handler, rasqal_query_results_row_handler, 1);
+
+  if(!rasqal_query_results_is_bindings(query_results))
+    return 1;
+
+  while(!query_results->failed && !query_results->finished) {
+    rasqal_row* row;
+    int stop;
+
+    if(rasqal_query_results_ensure_have_row_internal(query_results))
+      break;
+
+    row = query_results->row;
+    stop = handler(user_data, query_results, row->values, row->size);
+
+    /* release the row now so that its block can be reused for the
+     * next one */
+    query_results->row = NULL;
+    rasqal_free_row(row);
+
+    if(stop)
+      break;
+  }
+
+  return query_results->failed;
+}
+
+
 /**
  * rasqal_query_results_finished:
  * @query_results: #rasqal_query_results query_results
@@ -1668,8 +1836,9 @@ rasqal_query_results_execute_and_store_results(rasqal_query_results* query_resul
     rasqal_engine_error execution_error = RASQAL_ENGINE_OK;
 
     seq = query_results->execution_factory->get_all_rows(query_results->execution_data, &execution_error);
-    if(execution_error == RASQAL_ENGINE_FAILED)
-      query_results->failed = 1;
+    if(RASQAL_ENGINE_ERROR_IS_FAILURE(execution_error))
+      rasqal_query_results_set_execution_error(query_results,
+                                               execution_error);
   }
 
   query_results->results_sequence = seq;
@@ -1744,6 +1913,23 @@ rasqal_query_results_remove_query_reference(rasqal_query_results* query_results)
 }
 
 
+/*
+ * rasqal_query_results_get_execution_state:
+ * @query_results: query results
+ *
+ * INTERNAL - Get the cancellation and deadline state of the query results execution
+ *
+ * Return value: shared pointer to the state
+ */
+rasqal_execution_state*
+rasqal_query_results_get_execution_state(rasqal_query_results* query_results)
+{
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query_results, rasqal_query_results, NULL);
+
+  return &query_results->execution;
+}
+
+
 rasqal_variables_table*
 rasqal_query_results_get_variables_table(rasqal_query_results* query_results)
 {
@@ -1763,6 +1949,178 @@ rasqal_query_results_get_world(rasqal_query_results* query_results)
 }
 
 
+/**
+ * rasqal_query_results_get_error:
+ * @query_results: #rasqal_query_results object
+ *
+ * Get why query execution failed
+ *
+ * Return value: #RASQAL_QUERY_RESULTS_ERROR_NONE if execution has not
+ * failed, otherwise the reason
+ */
+rasqal_query_results_error
+rasqal_query_results_get_error(rasqal_query_results* query_results)
+{
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query_results, rasqal_query_results, RASQAL_QUERY_RESULTS_ERROR_FAILED);
+
+  if(!query_results->failed)
+    return RASQAL_QUERY_RESULTS_ERROR_NONE;
+
+  /* failures not from the execution engine */
+  if(query_results->error == RASQAL_QUERY_RESULTS_ERROR_NONE)
+    return RASQAL_QUERY_RESULTS_ERROR_FAILED;
+
+  return query_results->error;
+}
+
+
+/**
+ * rasqal_query_results_cancel:
+ * @query_results: #rasqal_query_results object
+ *
+ * Cancel the query execution
+ *
+ * The execution stops at the next point it checks for cancelling,
+ * after which reading more results fails and
+ * rasqal_query_results_get_error() returns
+ * #RASQAL_QUERY_RESULTS_ERROR_CANCELLED.  Rows already returned
+ * remain valid.
+ *
+ * This only sets a flag so it may be called from another thread or
+ * a signal handler while the results are being read, but not while
+ * or after they are freed.
+ *
+ * Queries whose results are computed in full when executed, such as
+ * those with ORDER BY, have finished before the results are returned
+ * so use #RASQAL_FEATURE_TIMEOUT to bound those.
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_query_results_cancel(rasqal_query_results* query_results)
+{
+  if(!query_results)
+    return 1;
+
+  RASQAL_FLAG_SET(&query_results->execution.cancelled);
+
+  return 0;
+}
+
+
+/**
+ * rasqal_query_results_write_explain:
+ * @iostr: #raptor_iostream to write the query plan to
+ * @query_results: #rasqal_query_results object
+ * @format: plan format
+ *
+ * Write the query plan of an execution with its estimated and actual rows
+ *
+ * Each node of the plan is a row source, written with its name, the
+ * variables of its rows, an estimate of how many rows it returns and
+ * the rows it has returned and times it was reset so far.  The
+ * estimates are made from the data when first written, or when the
+ * execution starts if #RASQAL_FEATURE_PROFILE is set, which also
+ * records the wall clock and CPU time spent in each node including
+ * its inner nodes.
+ *
+ * Call this after reading all results to get the actual rows of the
+ * whole execution.  With #RASQAL_FEATURE_PREFETCH set, rows are made
+ * on another thread so it may only be called once all results have
+ * been read.
+ *
+ * Return value: non-0 on failure or if the execution has no plan
+ */
+int
+rasqal_query_results_write_explain(raptor_iostream *iostr,
+                                   rasqal_query_results *query_results,
+                                   rasqal_query_explain_format format)
+{
+  rasqal_rowsource* rowsource = NULL;
+
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(iostr, raptor_iostream, 1);
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query_results, rasqal_query_results, 1);
+
+  if(format > RASQAL_QUERY_EXPLAIN_FORMAT_LAST)
+    return 1;
+
+  if(query_results->executed && query_results->execution_factory &&
+     query_results->execution_factory->get_rowsource)
+    rowsource = query_results->execution_factory->get_rowsource(query_results->execution_data);
+
+  if(!rowsource)
+    return 1;
+
+  return rasqal_rowsource_write_explain(rowsource, iostr, format);
+}
+
+
+/**
+ * rasqal_query_results_get_operator_counters:
+ * @query_results: #rasqal_query_results object
+ * @offset: operator index starting from 0
+ * @counters: pointer to #rasqal_operator_counters to fill in
+ *
+ * Get the counters of one operator of the query plan of an execution
+ *
+ * The operators are returned in a depth-first walk of the plan, each
+ * before its inner operators, so iterate by calling this with @offset
+ * 0, 1, 2 and so on until it returns >0.  The shape of the plan is
+ * given by the @depth field of each.  See #rasqal_operator_counters
+ * for the counts kept; setting #RASQAL_FEATURE_PROFILE adds times
+ * and row memory.
+ *
+ * As with rasqal_query_results_write_explain(), call this after
+ * reading all results to get the counts of the whole execution.
+ *
+ * Return value: 0 on success, >0 if @offset is past the last operator or <0 on failure or if the execution has no plan
+ */
+int
+rasqal_query_results_get_operator_counters(rasqal_query_results *query_results,
+                                           int offset,
+                                           rasqal_operator_counters *counters)
+{
+  rasqal_rowsource* rowsource = NULL;
+
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query_results, rasqal_query_results, -1);
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(counters, rasqal_operator_counters, -1);
+
+  if(query_results->executed && query_results->execution_factory &&
+     query_results->execution_factory->get_rowsource)
+    rowsource = query_results->execution_factory->get_rowsource(query_results->execution_data);
+
+  if(!rowsource)
+    return -1;
+
+  return rasqal_rowsource_get_counters(rowsource, offset, counters);
+}
+
+
+/**
+ * rasqal_query_results_get_peak_memory:
+ * @query_results: #rasqal_query_results object
+ *
+ * Get the peak result row memory used while executing the query
+ *
+ * This is the memory accounted against #RASQAL_FEATURE_MEMORY_LIMIT:
+ * the rows held by the execution (including sorted, distinct, grouped
+ * and stored rows) but not the literal values they share.  It is
+ * measured since the latest execution of the query started.
+ *
+ * Return value: peak size in bytes or 0 if not executed from a query
+ */
+size_t
+rasqal_query_results_get_peak_memory(rasqal_query_results* query_results)
+{
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query_results, rasqal_query_results, 0);
+
+  if(!query_results->query || !query_results->executed)
+    return 0;
+
+  return rasqal_query_get_row_memory_peak(query_results->query);
+}
+
+
 /**
  * rasqal_query_results_get_row_by_offset:
  * @query_results: query result
@@ -1773,7 +2131,11 @@ rasqal_query_results_get_world(rasqal_query_results* query_results)
  * The result_offset index is 0-indexed into the subset of results
  * constrained by any query limit and offset.
  *
- * Return value: row or NULL if @result_offset is out of range
+ * If the query feature #RASQAL_FEATURE_EXECUTION_ARENA is set, the
+ * returned row must be freed before @query_results is freed.  Literal
+ * values taken from it may be kept as they are not arena allocated.
+ *
+ * Return value: new row or NULL if @result_offset is out of range
  */
 rasqal_row*
 rasqal_query_results_get_row_by_offset(rasqal_query_results* query_results,
@@ -1960,6 +2322,30 @@ const struct {
 };
 
 
+typedef struct {
+  int rows_count;
+
+  /* number of rows with the wrong size or values */
+  int bad_count;
+  int expected_size;
+} foreach_row_test_state;
+
+
+static int
+foreach_row_test_handler(void *user_data, rasqal_query_results *results,
+                         rasqal_literal **values, int size)
+{
+  foreach_row_test_state* state = (foreach_row_test_state*)user_data;
+
+  state->rows_count++;
+  if(size != state->expected_size ||
+     rasqal_query_results_get_binding_value(results, 0) != values[0])
+    state->bad_count++;
+
+  return 0;
+}
+
+
 #if defined(RASQAL_DEBUG) && RASQAL_DEBUG > 1
 static void
 print_bindings_results_simple(rasqal_query_results *results, FILE* output)
@@ -2027,6 +2413,7 @@ main(int argc, char *argv[])
       failures++;
     } else {
       rasqal_variables_table* vt;
+      foreach_row_test_state state;
 
       vt = rasqal_query_results_get_variables_table(qr);
       vars_count = rasqal_variables_table_get_named_variables_count(vt);
@@ -2038,6 +2425,20 @@ main(int argc, char *argv[])
                 program, i, vars_count, expected_vars_count);
         failures++;
       }
+
+      state.rows_count = 0;
+      state.bad_count = 0;
+      state.expected_size = expected_vars_count;
+      if(rasqal_query_results_foreach_row(qr, foreach_row_test_handler,
+                                          &state) ||
+         state.rows_count != expected_data[i].expected_rows_count ||
+         state.bad_count) {
+        fprintf(stderr,
+                "%s: FAILED query results test %d foreach returned %d rows (%d bad) expected %d rows\n",
+                program, i, state.rows_count, state.bad_count,
+                expected_data[i].expected_rows_count);
+        failures++;
+      }
     }
 
     if(qr)
@@ -48,6 +48,19 @@
          FROM <%s> \
          WHERE \
          { $person $x foaf:Person }"
+/* 3 triples cubed gives 27 stored rows of 9 values */
+#define MEMORY_QUERY_FORMAT "SELECT * FROM <%s> \
+         WHERE { ?s ?p ?o . ?a ?b ?c . ?d ?e ?f } \
+         ORDER BY ?s ?a ?d"
+#define MEMORY_EXPECTED_RESULTS_COUNT 27
+/* 3 triples to the power 12 gives 531441 rows to take far longer
+ * than the timeout */
+#define TIMEOUT_QUERY_FORMAT "SELECT * FROM <%s> \
+         WHERE { ?s1 ?p1 ?o1 . ?s2 ?p2 ?o2 . ?s3 ?p3 ?o3 . ?s4 ?p4 ?o4 . \
+                 ?s5 ?p5 ?o5 . ?s6 ?p6 ?o6 . ?s7 ?p7 ?o7 . ?s8 ?p8 ?o8 . \
+                 ?s9 ?p9 ?o9 . ?s10 ?p10 ?o10 . ?s11 ?p11 ?o11 . \
+                 ?s12 ?p12 ?o12 }"
+#define TIMEOUT_MS 1
 #else
 #define NO_QUERY_LANGUAGE
 #endif
@@ -75,6 +88,8 @@ main(int argc, char **argv) {
   const char *query_language_name=QUERY_LANGUAGE;
   const char *query_format=QUERY_FORMAT;
   unsigned char *query_string;
+  unsigned char *memory_query_string;
+  unsigned char *timeout_query_string;
   int count;
   rasqal_world *world;
   const char *data_file;
@@ -102,6 +117,14 @@ main(int argc, char **argv) {
   IGNORE_FORMAT_NONLITERAL_START
   snprintf(RASQAL_GOOD_CAST(char*, query_string), qs_len, query_format, data_string);
   IGNORE_FORMAT_NONLITERAL_END
+  qs_len = strlen(RASQAL_GOOD_CAST(const char*, data_string)) + strlen(MEMORY_QUERY_FORMAT);
+  memory_query_string = RASQAL_MALLOC(unsigned char*, qs_len + 1);
+  snprintf(RASQAL_GOOD_CAST(char*, memory_query_string), qs_len,
+           MEMORY_QUERY_FORMAT, data_string);
+  qs_len = strlen(RASQAL_GOOD_CAST(const char*, data_string)) + strlen(TIMEOUT_QUERY_FORMAT);
+  timeout_query_string = RASQAL_MALLOC(unsigned char*, qs_len + 1);
+  snprintf(RASQAL_GOOD_CAST(char*, timeout_query_string), qs_len,
+           TIMEOUT_QUERY_FORMAT, data_string);
   raptor_free_memory(data_string);
   
   uri_string=raptor_uri_filename_to_uri_string("");
@@ -200,6 +223,95 @@ main(int argc, char **argv) {
 
   rasqal_free_query_results(results);
 
+  printf("%s: executing query 5 and cancelling it\n", program);
+  results = rasqal_query_execute(query);
+  if(!results) {
+    fprintf(stderr, "%s: query execution 5 FAILED\n", program);
+    return(1);
+  }
+  rasqal_query_results_cancel(results);
+  rasqal_query_results_next(results);
+  if(rasqal_query_results_get_error(results) != RASQAL_QUERY_RESULTS_ERROR_CANCELLED) {
+    fprintf(stderr, "%s: query 5 did not fail with a cancelled error\n",
+            program);
+    return(1);
+  }
+  rasqal_free_query_results(results);
+
+  rasqal_free_query(query);
+
+  query = rasqal_new_query(world, query_language_name, NULL);
+  if(!query || rasqal_query_prepare(query, memory_query_string, base_uri)) {
+    fprintf(stderr, "%s: %s memory query prepare FAILED\n", program,
+            query_language_name);
+    return(1);
+  }
+  RASQAL_FREE(char*, memory_query_string);
+
+  printf("%s: executing memory query without a limit\n", program);
+  results = rasqal_query_execute(query);
+  if(!results) {
+    fprintf(stderr, "%s: memory query execution FAILED\n", program);
+    return(1);
+  }
+  count = 0;
+  while(!rasqal_query_results_finished(results)) {
+    rasqal_query_results_next(results);
+    count++;
+  }
+  if(count != MEMORY_EXPECTED_RESULTS_COUNT ||
+     rasqal_query_results_get_error(results) != RASQAL_QUERY_RESULTS_ERROR_NONE) {
+    fprintf(stderr, "%s: memory query returned %d results, expected %d\n",
+            program, count, MEMORY_EXPECTED_RESULTS_COUNT);
+    return(1);
+  }
+  printf("%s: memory query peak row memory %d bytes\n", program,
+         RASQAL_GOOD_CAST(int, rasqal_query_results_get_peak_memory(results)));
+  if(rasqal_query_results_get_peak_memory(results) < 1024) {
+    fprintf(stderr, "%s: memory query peak row memory is below 1 kilobyte\n",
+            program);
+    return(1);
+  }
+  rasqal_free_query_results(results);
+
+  printf("%s: executing memory query with a 1 kilobyte limit\n", program);
+  rasqal_query_set_feature(query, RASQAL_FEATURE_MEMORY_LIMIT, 1);
+  results = rasqal_query_execute(query);
+  if(!results ||
+     rasqal_query_results_get_error(results) != RASQAL_QUERY_RESULTS_ERROR_MEMORY_LIMIT) {
+    fprintf(stderr, "%s: memory query did not fail with a memory limit error\n",
+            program);
+    return(1);
+  }
+  rasqal_free_query_results(results);
+
+  rasqal_free_query(query);
+
+  query = rasqal_new_query(world, query_language_name, NULL);
+  if(!query || rasqal_query_prepare(query, timeout_query_string, base_uri)) {
+    fprintf(stderr, "%s: %s timeout query prepare FAILED\n", program,
+            query_language_name);
+    return(1);
+  }
+  RASQAL_FREE(char*, timeout_query_string);
+
+  printf("%s: executing timeout query with a %d millisecond timeout\n",
+         program, TIMEOUT_MS);
+  rasqal_query_set_feature(query, RASQAL_FEATURE_TIMEOUT, TIMEOUT_MS);
+  results = rasqal_query_execute(query);
+  if(!results) {
+    fprintf(stderr, "%s: timeout query execution FAILED\n", program);
+    return(1);
+  }
+  while(!rasqal_query_results_finished(results))
+    rasqal_query_results_next(results);
+  if(rasqal_query_results_get_error(results) != RASQAL_QUERY_RESULTS_ERROR_TIMEOUT) {
+    fprintf(stderr, "%s: timeout query did not fail with a timeout error\n",
+            program);
+    return(1);
+  }
+  rasqal_free_query_results(results);
+
   rasqal_free_query(query);
 
   raptor_free_uri(base_uri);
@@ -48,6 +48,13 @@ struct rasqal_raptor_triple_s {
 
 typedef struct rasqal_raptor_triple_s rasqal_raptor_triple;
 
+/* number of triples with one predicate */
+typedef struct {
+  /* shared with the triples */
+  raptor_uri* predicate;
+  long count;
+} rasqal_raptor_predicate_count;
+
 typedef struct {
   rasqal_world* world;
 
@@ -72,12 +79,21 @@ typedef struct {
   unsigned char* mapped_id_base;
   /* length of above string */
   size_t mapped_id_base_len;
+
+  /* number of triples read into the default graph */
+  long default_triples_count;
+
+  /* default graph triple counts sorted by predicate made after
+   * reading or NULL */
+  rasqal_raptor_predicate_count* predicate_counts;
+  int predicate_counts_size;
 } rasqal_raptor_triples_source_user_data;
 
 
 /* prototypes */
 static int rasqal_raptor_init_triples_match(rasqal_triples_match* rtm, rasqal_triples_source *rts, void *user_data, rasqal_triple_meta *m, rasqal_triple *t);
 static int rasqal_raptor_triple_present(rasqal_triples_source *rts, void *user_data, rasqal_triple *t);
+static int rasqal_raptor_triple_count(rasqal_triples_source *rts, void *user_data, rasqal_triple *t, long *count_p);
 static void rasqal_raptor_free_triples_source(void *user_data);
 
 
@@ -121,6 +137,8 @@ rasqal_raptor_statement_handler(void *user_data,
     rtsc->head = triple;
 
   rtsc->tail = triple;
+  if(!triple->triple->origin)
+    rtsc->default_triples_count++;
 }
 
 
@@ -134,7 +152,7 @@ rasqal_raptor_get_genid(rasqal_world* world, const unsigned char* base,
 
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
 
-  /* This is read-only and thread safe */
+  /* Called with the world locked while loading data graphs */
   if(counter < 0)
     counter= world->genid_counter++;
 
@@ -185,6 +203,8 @@ rasqal_raptor_support_feature(void *user_data,
 {
   switch(feature) {
     case RASQAL_TRIPLES_SOURCE_FEATURE_IOSTREAM_DATA_GRAPH:
+    case RASQAL_TRIPLES_SOURCE_FEATURE_SHARED:
+    case RASQAL_TRIPLES_SOURCE_FEATURE_GRAPH_ORIGINS:
       return 1;
       
     default:
@@ -194,6 +214,100 @@ rasqal_raptor_support_feature(void *user_data,
 }
 
 
+/*
+ * rasqal_raptor_prepare_literal_for_sharing:
+ * @l: literal or NULL
+ *
+ * INTERNAL - Fill in the cached fields of a stored literal
+ *
+ * Matching only reads the stored triples but hashing a literal caches
+ * the hash inside it.  Doing that once here means concurrent queries
+ * sharing the triples source do not write the hashes used by joins
+ * and DISTINCT.  The RDQL hash used for GROUP BY is left to be cached
+ * on first use since it is costly to compute for every string.
+ */
+static void
+rasqal_raptor_prepare_literal_for_sharing(rasqal_literal* l)
+{
+  if(!l)
+    return;
+
+  (void)rasqal_literal_hash(l, RASQAL_COMPARE_RDF);
+  (void)rasqal_literal_hash(l, RASQAL_COMPARE_XQUERY);
+}
+
+
+static int
+rasqal_raptor_compare_predicates(const void *a, const void *b)
+{
+  return raptor_uri_compare(*(raptor_uri* const*)a, *(raptor_uri* const*)b);
+}
+
+
+/*
+ * rasqal_raptor_count_predicates:
+ * @rtsc: triples source user data
+ *
+ * INTERNAL - Count the default graph triples read by predicate
+ *
+ * Made once after reading so that counting a default graph triple
+ * pattern with only the predicate fixed is a binary search rather
+ * than a scan.  The table is not made if there is no memory for it;
+ * counts then scan.
+ */
+static void
+rasqal_raptor_count_predicates(rasqal_raptor_triples_source_user_data* rtsc)
+{
+  rasqal_raptor_triple *triple;
+  raptor_uri** predicates;
+  size_t size = 0;
+  size_t i;
+  int counts_size = 0;
+
+  if(!rtsc->default_triples_count)
+    return;
+
+  predicates = RASQAL_MALLOC(raptor_uri**,
+                             RASQAL_GOOD_CAST(size_t, rtsc->default_triples_count) * sizeof(raptor_uri*));
+  if(!predicates)
+    return;
+
+  for(triple = rtsc->head; triple; triple = triple->next) {
+    rasqal_literal* p = triple->triple->predicate;
+
+    if(triple->triple->origin)
+      continue;
+
+    if(p->type != RASQAL_LITERAL_URI) {
+      RASQAL_FREE(raptor_uri**, predicates);
+      return;
+    }
+    predicates[size++] = p->value.uri;
+  }
+
+  qsort(predicates, size, sizeof(raptor_uri*),
+        rasqal_raptor_compare_predicates);
+
+  rtsc->predicate_counts = RASQAL_CALLOC(rasqal_raptor_predicate_count*, size,
+                                         sizeof(rasqal_raptor_predicate_count));
+  if(!rtsc->predicate_counts) {
+    RASQAL_FREE(raptor_uri**, predicates);
+    return;
+  }
+
+  for(i = 0; i < size; i++) {
+    if(!counts_size ||
+       raptor_uri_compare(rtsc->predicate_counts[counts_size - 1].predicate,
+                          predicates[i]))
+      rtsc->predicate_counts[counts_size++].predicate = predicates[i];
+    rtsc->predicate_counts[counts_size - 1].count++;
+  }
+  rtsc->predicate_counts_size = counts_size;
+
+  RASQAL_FREE(raptor_uri**, predicates);
+}
+
+
 static int
 rasqal_raptor_init_triples_source_common(rasqal_world* world,
                                          raptor_sequence* data_graphs,
@@ -213,12 +327,13 @@ rasqal_raptor_init_triples_source_common(rasqal_world* world,
   rtsc = (rasqal_raptor_triples_source_user_data*)user_data;
 
   /* Max API version this triples source generates */
-  rts->version = 2;
+  rts->version = 3;
   
   rts->init_triples_match = rasqal_raptor_init_triples_match;
   rts->triple_present = rasqal_raptor_triple_present;
   rts->free_triples_source = rasqal_raptor_free_triples_source;
   rts->support_feature = rasqal_raptor_support_feature;
+  rts->triple_count = rasqal_raptor_triple_count;
 
   rtsc->world = world;
 
@@ -239,6 +354,11 @@ rasqal_raptor_init_triples_source_common(rasqal_world* world,
     return 0;
   }
 
+  /* The genid handler below is raptor world-wide and the genid
+   * counter is rasqal world-wide so data graphs from concurrent
+   * executions are loaded one at a time */
+  RASQAL_MUTEX_LOCK(&world->lock);
+
   for(i = 0; i < rtsc->sources_count; i++) {
     rasqal_data_graph *dg;
     raptor_uri* uri = NULL;
@@ -323,6 +443,25 @@ rasqal_raptor_init_triples_source_common(rasqal_world* world,
       break;
   }
 
+  RASQAL_MUTEX_UNLOCK(&world->lock);
+
+  if(!rc)
+    rasqal_raptor_count_predicates(rtsc);
+
+  if(!rc && (flags & 2)) {
+    /* to be shared by concurrent queries */
+    rasqal_raptor_triple *triple;
+
+    for(triple = rtsc->head; triple; triple = triple->next) {
+      rasqal_raptor_prepare_literal_for_sharing(triple->triple->subject);
+      rasqal_raptor_prepare_literal_for_sharing(triple->triple->predicate);
+      rasqal_raptor_prepare_literal_for_sharing(triple->triple->object);
+    }
+
+    for(i = 0; i < rtsc->sources_count; i++)
+      rasqal_raptor_prepare_literal_for_sharing(rtsc->source_literals[i]);
+  }
+
   return rc;
 }
 
@@ -491,6 +630,85 @@ rasqal_raptor_triple_present(rasqal_triples_source *rts, void *user_data,
 }
 
 
+/*
+ * rasqal_raptor_triple_count_part:
+ * @l: triple pattern part
+ *
+ * Get the value to match for a triple pattern part: the literal
+ * itself, the value of a bound variable or NULL for a wildcard.
+ */
+static rasqal_literal*
+rasqal_raptor_triple_count_part(rasqal_literal* l)
+{
+  rasqal_variable* v = rasqal_literal_as_variable(l);
+
+  return v ? v->value : l;
+}
+
+
+static int
+rasqal_raptor_triple_count(rasqal_triples_source *rts, void *user_data,
+                           rasqal_triple *t, long *count_p)
+{
+  rasqal_raptor_triples_source_user_data* rtsc;
+  rasqal_raptor_triple *triple;
+  rasqal_triple match;
+  unsigned int parts = RASQAL_TRIPLE_SPO;
+  long count = 0;
+
+  rtsc = (rasqal_raptor_triples_source_user_data*)user_data;
+
+  /* match shares the pattern literals and is not freed */
+  memset(&match, '\0', sizeof(match));
+  match.subject = rasqal_raptor_triple_count_part(t->subject);
+  match.predicate = rasqal_raptor_triple_count_part(t->predicate);
+  match.object = rasqal_raptor_triple_count_part(t->object);
+  if(t->origin) {
+    match.origin = rasqal_raptor_triple_count_part(t->origin);
+    parts = RASQAL_GOOD_CAST(unsigned int, parts | RASQAL_TRIPLE_GRAPH);
+  }
+
+  if(!t->origin && !match.subject && !match.object) {
+    if(!match.predicate) {
+      *count_p = rtsc->default_triples_count;
+      return 0;
+    }
+
+    if(rtsc->predicate_counts && match.predicate->type == RASQAL_LITERAL_URI) {
+      int lo = 0;
+      int hi = rtsc->predicate_counts_size - 1;
+
+      /* binary search of the counts made after reading */
+      while(lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        int c = raptor_uri_compare(rtsc->predicate_counts[mid].predicate,
+                                   match.predicate->value.uri);
+        if(!c) {
+          count = rtsc->predicate_counts[mid].count;
+          break;
+        }
+        if(c < 0)
+          lo = mid + 1;
+        else
+          hi = mid - 1;
+      }
+
+      *count_p = count;
+      return 0;
+    }
+  }
+
+  /* Otherwise scan the statements without binding or copying them */
+  for(triple = rtsc->head; triple; triple = triple->next) {
+    if(rasqal_raptor_triple_match(rtsc->world, triple->triple, &match, parts))
+      count++;
+  }
+
+  *count_p = count;
+
+  return 0;
+}
+
 
 static void
 rasqal_raptor_free_triples_source(void *user_data)
@@ -515,6 +733,9 @@ rasqal_raptor_free_triples_source(void *user_data)
   }
   if(rtsc->source_literals)
     RASQAL_FREE(raptor_literal_ptr, rtsc->source_literals);
+
+  if(rtsc->predicate_counts)
+    RASQAL_FREE(rasqal_raptor_predicate_count*, rtsc->predicate_counts);
 }
 
 
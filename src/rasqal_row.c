@@ -36,6 +36,11 @@
 #include <stdlib.h>
 #endif
 #include <stdarg.h>
+#ifdef STANDALONE
+#ifdef HAVE_TIME_H
+#include <time.h>
+#endif
+#endif
 
 #include "rasqal.h"
 #include "rasqal_internal.h"
@@ -43,26 +48,411 @@
 
 
 
-static rasqal_row*
-rasqal_new_row_common(rasqal_world* world, int size, int order_size)
+/*
+ * Rows are allocated as a single block holding the #rasqal_row
+ * followed by its values array.  Rows made for a query are recycled
+ * through a per-query pool with one free list per row size so that
+ * steady state evaluation does not touch the allocator at all.
+ *
+ * The pool is reference counted: the query holds one reference and
+ * every row in use that came from it holds another, so rows that
+ * outlive the query (such as ones held in results) are safe to free
+ * later.  Like the query, a pool must only be used by one thread
+ * unless it is made threaded with rasqal_query_set_row_pool_threaded()
+ * so that rows can be made on one thread and freed on another.
+ *
+ * While a query execution has an arena attached (see
+ * rasqal_query_set_row_arena()) new row blocks are carved from the
+ * arena instead of the heap.  Such rows are recycled through the free
+ * lists as normal but are never freed individually; the arena
+ * releases them all when the query results are freed, so they must
+ * not be kept beyond the #rasqal_query_results that made them.
+ *
+ * The pool also accounts for the memory of the rows in use (row
+ * blocks, values and order values arrays but not the literals they
+ * point to) so that a query execution can be given a memory limit.
+ */
+
+/* Largest row size kept on a free list */
+#define RASQAL_ROW_POOL_MAX_SIZE 64
+
+/* Maximum number of free rows kept for each size */
+#define RASQAL_ROW_POOL_MAX_FREE 256
+
+struct rasqal_row_pool_s {
+  /* reference count - 1 for the query plus 1 for each row in use */
+  int usage;
+
+  /* free lists indexed by row size */
+  rasqal_row* free_rows[RASQAL_ROW_POOL_MAX_SIZE + 1];
+  int free_count[RASQAL_ROW_POOL_MAX_SIZE + 1];
+
+  /* maximum length of each free list; 0 disables recycling */
+  int max_free;
+
+  /* arena new row blocks are allocated from or NULL for the heap */
+  rasqal_arena* arena;
+
+  /* number of new row blocks allocated */
+  unsigned long alloc_count;
+
+  /* number of rows handed out again from a free list */
+  unsigned long reuse_count;
+
+  /* bytes of rows currently in use and the highest it has been */
+  size_t bytes_in_use;
+  size_t peak_bytes;
+
+  /* bytes of rows made over the life of the pool; never goes down */
+  size_t bytes_allocated;
+
+  /* maximum bytes in use or 0 for no limit */
+  size_t limit_bytes;
+
+  /* non-0 if a row could not be made because of @limit_bytes */
+  int limit_exceeded;
+
+  /* non-0 if @lock must be held to use the pool */
+  int threaded;
+
+  /* lock for the pool when @threaded */
+  rasqal_mutex lock;
+};
+
+
+#define RASQAL_ROW_POOL_LOCK(pool) \
+  do { if((pool)->threaded) RASQAL_MUTEX_LOCK(&(pool)->lock); } while(0)
+#define RASQAL_ROW_POOL_UNLOCK(pool) \
+  do { if((pool)->threaded) RASQAL_MUTEX_UNLOCK(&(pool)->lock); } while(0)
+
+/* bytes accounted for a row of @size values */
+#define RASQAL_ROW_BYTES(size) \
+  (sizeof(rasqal_row) + sizeof(rasqal_literal*) * RASQAL_GOOD_CAST(size_t, size))
+
+
+#ifndef STANDALONE
+
+static rasqal_row_pool*
+rasqal_new_row_pool(void)
 {
-  rasqal_row* row;
-  
-  row = RASQAL_CALLOC(rasqal_row*, 1, sizeof(*row));
-  if(!row)
+  rasqal_row_pool* pool;
+
+  pool = RASQAL_CALLOC(rasqal_row_pool*, 1, sizeof(*pool));
+  if(!pool)
     return NULL;
 
+  pool->usage = 1;
+  pool->max_free = RASQAL_ROW_POOL_MAX_FREE;
+  RASQAL_MUTEX_INIT(&pool->lock);
+
+  return pool;
+}
+
+
+/*
+ * rasqal_free_row_pool:
+ * @pool: row pool
+ *
+ * INTERNAL - Release a reference to a row pool
+ *
+ * The pool and all rows on its free lists are freed when the last
+ * reference goes.
+ */
+void
+rasqal_free_row_pool(rasqal_row_pool* pool)
+{
+  int usage;
+  int i;
+
+  if(!pool)
+    return;
+
+  RASQAL_ROW_POOL_LOCK(pool);
+  usage = --pool->usage;
+  RASQAL_ROW_POOL_UNLOCK(pool);
+  if(usage)
+    return;
+
+  for(i = 0; i <= RASQAL_ROW_POOL_MAX_SIZE; i++) {
+    rasqal_row* row = pool->free_rows[i];
+
+    while(row) {
+      rasqal_row* next = row->next_free;
+      if(!(row->flags & RASQAL_ROW_FLAG_ARENA))
+        RASQAL_FREE(rasqal_row, row);
+      row = next;
+    }
+  }
+
+  RASQAL_MUTEX_DESTROY(&pool->lock);
+  RASQAL_FREE(rasqal_row_pool, pool);
+}
+
+
+static rasqal_row_pool*
+rasqal_query_get_row_pool(rasqal_query* query)
+{
+  if(!query)
+    return NULL;
+
+  if(!query->row_pool)
+    query->row_pool = rasqal_new_row_pool();
+
+  return query->row_pool;
+}
+
+
+static void
+rasqal_row_pool_add_bytes(rasqal_row_pool* pool, size_t bytes)
+{
+  pool->bytes_in_use += bytes;
+  pool->bytes_allocated += bytes;
+  if(pool->bytes_in_use > pool->peak_bytes)
+    pool->peak_bytes = pool->bytes_in_use;
+}
+
+
+static void
+rasqal_row_pool_remove_bytes(rasqal_row_pool* pool, size_t bytes)
+{
+  if(pool->bytes_in_use > bytes)
+    pool->bytes_in_use -= bytes;
+  else
+    pool->bytes_in_use = 0;
+}
+
+
+/*
+ * rasqal_query_reset_row_memory:
+ * @query: query
+ * @limit: maximum bytes of rows in use or 0 for no limit
+ *
+ * INTERNAL - Start accounting row memory for a query execution
+ *
+ * Sets the limit and resets the peak to the rows currently in use.
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_query_reset_row_memory(rasqal_query* query, size_t limit)
+{
+  rasqal_row_pool* pool;
+
+  pool = rasqal_query_get_row_pool(query);
+  if(!pool)
+    return 1;
+
+  pool->limit_bytes = limit;
+  pool->limit_exceeded = 0;
+  pool->peak_bytes = pool->bytes_in_use;
+
+  return 0;
+}
+
+
+/*
+ * rasqal_query_get_row_memory_peak:
+ * @query: query
+ *
+ * INTERNAL - Get the peak bytes of rows in use since the last reset
+ *
+ * Return value: size in bytes
+ */
+size_t
+rasqal_query_get_row_memory_peak(rasqal_query* query)
+{
+  return (query && query->row_pool) ? query->row_pool->peak_bytes : 0;
+}
+
+
+/*
+ * rasqal_query_get_row_bytes_allocated:
+ * @query: query
+ *
+ * INTERNAL - Get the total bytes of rows made for the query so far
+ *
+ * The total only ever goes up so the difference between two calls is
+ * the row memory made in between.
+ *
+ * Return value: size in bytes
+ */
+size_t
+rasqal_query_get_row_bytes_allocated(rasqal_query* query)
+{
+  rasqal_row_pool* pool;
+  size_t bytes;
+
+  pool = query ? query->row_pool : NULL;
+  if(!pool)
+    return 0;
+
+  RASQAL_ROW_POOL_LOCK(pool);
+  bytes = pool->bytes_allocated;
+  RASQAL_ROW_POOL_UNLOCK(pool);
+
+  return bytes;
+}
+
+
+/*
+ * rasqal_query_row_memory_limit_exceeded:
+ * @query: query
+ *
+ * INTERNAL - Check if a row could not be made because of the memory limit
+ *
+ * Return value: non-0 if the limit was exceeded
+ */
+int
+rasqal_query_row_memory_limit_exceeded(rasqal_query* query)
+{
+  return (query && query->row_pool) ? query->row_pool->limit_exceeded : 0;
+}
+
+
+/*
+ * rasqal_query_set_row_arena:
+ * @query: query
+ * @arena: arena to allocate rows from or NULL to stop using one
+ *
+ * INTERNAL - Set or remove the arena rows for this query are allocated from
+ *
+ * Only one arena can be in use at a time.  When it is removed, rows
+ * from it are dropped from the free lists; the caller must ensure no
+ * rows allocated from it are still in use.
+ *
+ * Return value: non-0 on failure or if another arena is already in use
+ */
+int
+rasqal_query_set_row_arena(rasqal_query* query, rasqal_arena* arena)
+{
+  rasqal_row_pool* pool;
+  int i;
+
+  pool = rasqal_query_get_row_pool(query);
+  if(!pool)
+    return 1;
+
+  if(arena) {
+    if(pool->arena)
+      return 1;
+
+    pool->arena = arena;
+    return 0;
+  }
+
+  for(i = 0; i <= RASQAL_ROW_POOL_MAX_SIZE; i++) {
+    rasqal_row** prev = &pool->free_rows[i];
+
+    while(*prev) {
+      rasqal_row* row = *prev;
+
+      if(row->flags & RASQAL_ROW_FLAG_ARENA) {
+        *prev = row->next_free;
+        pool->free_count[i]--;
+      } else
+        prev = &row->next_free;
+    }
+  }
+
+  pool->arena = NULL;
+
+  return 0;
+}
+
+
+/*
+ * rasqal_query_set_row_pool_threaded:
+ * @query: query
+ * @threaded: non-0 to lock the pool on every use
+ *
+ * INTERNAL - Allow or stop rows of a query being made and freed on different threads
+ *
+ * This must only be changed while one thread is using the pool.
+ * Row usage counts are already safe to change from several threads.
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_query_set_row_pool_threaded(rasqal_query* query, int threaded)
+{
+  rasqal_row_pool* pool;
+
+  pool = rasqal_query_get_row_pool(query);
+  if(!pool)
+    return 1;
+
+  pool->threaded = threaded;
+
+  return 0;
+}
+
+
+static rasqal_row*
+rasqal_new_row_common(rasqal_world* world, rasqal_row_pool* pool,
+                      int size, int order_size)
+{
+  rasqal_row* row = NULL;
+  unsigned int arena_flag = 0;
+
+  if(size < 0)
+    size = 0;
+
+  if(pool) {
+    size_t bytes = RASQAL_ROW_BYTES(size);
+
+    if(order_size > 0)
+      bytes += sizeof(rasqal_literal*) * RASQAL_GOOD_CAST(size_t, order_size);
+
+    RASQAL_ROW_POOL_LOCK(pool);
+    if(pool->limit_bytes && pool->bytes_in_use + bytes > pool->limit_bytes) {
+      pool->limit_exceeded = 1;
+      RASQAL_ROW_POOL_UNLOCK(pool);
+      return NULL;
+    }
+  }
+
+  if(pool && size <= RASQAL_ROW_POOL_MAX_SIZE && pool->free_rows[size]) {
+    row = pool->free_rows[size];
+    pool->free_rows[size] = row->next_free;
+    pool->free_count[size]--;
+    pool->reuse_count++;
+
+    arena_flag = (row->flags & RASQAL_ROW_FLAG_ARENA);
+    /* values were all set to NULL when the row was released */
+    row->rowsource = NULL;
+    row->offset = 0;
+    row->order_values = NULL;
+    row->next_free = NULL;
+  } else {
+    size_t block_size;
+
+    block_size = sizeof(*row) + sizeof(rasqal_literal*) * RASQAL_GOOD_CAST(size_t, size);
+    if(pool && pool->arena) {
+      row = RASQAL_GOOD_CAST(rasqal_row*, rasqal_arena_alloc(pool->arena, block_size));
+      arena_flag = RASQAL_ROW_FLAG_ARENA;
+    } else
+      row = RASQAL_CALLOC(rasqal_row*, 1, block_size);
+    if(!row) {
+      if(pool)
+        RASQAL_ROW_POOL_UNLOCK(pool);
+      return NULL;
+    }
+
+    if(pool)
+      pool->alloc_count++;
+  }
+
   row->usage = 1;
   row->size = size;
+  row->values = size > 0 ? RASQAL_GOOD_CAST(rasqal_literal**, row + 1) : NULL;
+  row->flags = RASQAL_ROW_FLAG_INLINE_VALUES | arena_flag;
   row->order_size = order_size;
 
-  if(row->size > 0) {
-    row->values = RASQAL_CALLOC(rasqal_literal**, RASQAL_GOOD_CAST(size_t, row->size),
-                                sizeof(rasqal_literal*));
-    if(!row->values) {
-      rasqal_free_row(row);
-      return NULL;
-    }
+  if(pool) {
+    pool->usage++;
+    row->pool = pool;
+    rasqal_row_pool_add_bytes(pool, RASQAL_ROW_BYTES(size));
+    RASQAL_ROW_POOL_UNLOCK(pool);
   }
 
   if(row->order_size > 0) {
@@ -72,6 +462,12 @@ rasqal_new_row_common(rasqal_world* world, int size, int order_size)
       rasqal_free_row(row);
       return NULL;
     }
+
+    if(pool) {
+      RASQAL_ROW_POOL_LOCK(pool);
+      rasqal_row_pool_add_bytes(pool, sizeof(rasqal_literal*) * RASQAL_GOOD_CAST(size_t, row->order_size));
+      RASQAL_ROW_POOL_UNLOCK(pool);
+    }
   }
 
   row->group_id = -1;
@@ -102,7 +498,9 @@ rasqal_new_row(rasqal_rowsource* rowsource)
 
   size = rasqal_rowsource_get_size(rowsource);
 
-  row = rasqal_new_row_common(rowsource->world, size, order_size);
+  row = rasqal_new_row_common(rowsource->world,
+                              rasqal_query_get_row_pool(rowsource->query),
+                              size, order_size);
   if(row)
     row->rowsource = rowsource;
 
@@ -124,7 +522,30 @@ rasqal_new_row_for_size(rasqal_world* world, int size)
 {
   int order_size = 0;
 
-  return rasqal_new_row_common(world, size, order_size);
+  return rasqal_new_row_common(world, NULL, size, order_size);
+}
+
+
+/**
+ * rasqal_new_row_for_query:
+ * @world: rasqal_world
+ * @query: query the row is made for (or NULL)
+ * @size: width of row
+ *
+ * INTERNAL - Create a new query result row of a given size from a query's row pool
+ *
+ * Rowsources should use this rather than rasqal_new_row_for_size()
+ * so that rows are recycled for the lifetime of the query.
+ *
+ * Return value: a new query result row or NULL on failure
+ */
+rasqal_row*
+rasqal_new_row_for_query(rasqal_world* world, rasqal_query* query, int size)
+{
+  int order_size = 0;
+
+  return rasqal_new_row_common(world, rasqal_query_get_row_pool(query),
+                               size, order_size);
 }
 
 
@@ -139,7 +560,7 @@ rasqal_new_row_for_size(rasqal_world* world, int size)
 rasqal_row*
 rasqal_new_row_from_row(rasqal_row* row)
 {
-  row->usage++;
+  RASQAL_USAGE_INCREMENT(&row->usage);
   return row;
 }
 
@@ -153,19 +574,24 @@ rasqal_new_row_from_row(rasqal_row* row)
 void 
 rasqal_free_row(rasqal_row* row)
 {
+  rasqal_row_pool* pool;
+
   if(!row)
     return;
 
-  if(--row->usage)
+  if(RASQAL_USAGE_DECREMENT(&row->usage))
     return;
   
   if(row->values) {
     int i; 
     for(i = 0; i < row->size; i++) {
-      if(row->values[i])
+      if(row->values[i]) {
         rasqal_free_literal(row->values[i]);
+        row->values[i] = NULL;
+      }
     }
-    RASQAL_FREE(array, row->values);
+    if(!(row->flags & RASQAL_ROW_FLAG_INLINE_VALUES))
+      RASQAL_FREE(array, row->values);
   }
   if(row->order_values) {
     int i; 
@@ -174,12 +600,40 @@ rasqal_free_row(rasqal_row* row)
         rasqal_free_literal(row->order_values[i]);
     }
     RASQAL_FREE(array, row->order_values);
+
+    if(row->pool) {
+      RASQAL_ROW_POOL_LOCK(row->pool);
+      rasqal_row_pool_remove_bytes(row->pool, sizeof(rasqal_literal*) * RASQAL_GOOD_CAST(size_t, row->order_size));
+      RASQAL_ROW_POOL_UNLOCK(row->pool);
+    }
   }
 
   if(row->rowsource)
     rasqal_free_rowsource(row->rowsource);
 
-  RASQAL_FREE(rasqal_row, row);
+  pool = row->pool;
+  if(pool) {
+    RASQAL_ROW_POOL_LOCK(pool);
+    rasqal_row_pool_remove_bytes(pool, RASQAL_ROW_BYTES(row->size));
+  }
+
+  if(pool && (row->flags & RASQAL_ROW_FLAG_INLINE_VALUES) &&
+     row->size <= RASQAL_ROW_POOL_MAX_SIZE &&
+     ((row->flags & RASQAL_ROW_FLAG_ARENA) ||
+      pool->free_count[row->size] < pool->max_free)) {
+    /* return the block to the free list for this size */
+    row->pool = NULL;
+    row->next_free = pool->free_rows[row->size];
+    pool->free_rows[row->size] = row;
+    pool->free_count[row->size]++;
+  } else if(!(row->flags & RASQAL_ROW_FLAG_ARENA))
+    RASQAL_FREE(rasqal_row, row);
+
+  if(pool)
+    RASQAL_ROW_POOL_UNLOCK(pool);
+
+  /* may free the pool and its free lists if this was the last user */
+  rasqal_free_row_pool(pool);
 }
 
 
@@ -587,6 +1041,9 @@ rasqal_row_set_order_size(rasqal_row *row, int order_size)
       row->order_size = -1;
       return 1;
     }
+
+    if(row->pool)
+      rasqal_row_pool_add_bytes(row->pool, sizeof(rasqal_literal*) * RASQAL_GOOD_CAST(size_t, row->order_size));
   }
   
   return 0;
@@ -614,9 +1071,20 @@ rasqal_row_expand_size(rasqal_row *row, int size)
   nvalues = RASQAL_CALLOC(rasqal_literal**, RASQAL_GOOD_CAST(size_t, size), sizeof(rasqal_literal*));
   if(!nvalues)
     return 1;
-  memcpy(nvalues, row->values, RASQAL_GOOD_CAST(size_t, sizeof(rasqal_literal*) * RASQAL_GOOD_CAST(size_t, row->size)));
-  RASQAL_FREE(array, row->values);
+  if(row->values) {
+    memcpy(nvalues, row->values, RASQAL_GOOD_CAST(size_t, sizeof(rasqal_literal*) * RASQAL_GOOD_CAST(size_t, row->size)));
+    if(!(row->flags & RASQAL_ROW_FLAG_INLINE_VALUES))
+      RASQAL_FREE(array, row->values);
+  }
   row->values = nvalues;
+
+  if(row->pool) {
+    rasqal_row_pool_add_bytes(row->pool, RASQAL_ROW_BYTES(size));
+    rasqal_row_pool_remove_bytes(row->pool, RASQAL_ROW_BYTES(row->size));
+  }
+
+  /* the row block is no longer the right shape to be recycled */
+  row->flags = RASQAL_GOOD_CAST(unsigned int, RASQAL_GOOD_CAST(int, row->flags) & ~RASQAL_ROW_FLAG_INLINE_VALUES);
   
   row->size = size;
   return 0;
@@ -720,3 +1188,217 @@ rasqal_row_get_variable_by_offset(rasqal_row* row, int offset)
 
   return rasqal_rowsource_get_variable_by_offset(row->rowsource, offset);
 }
+
+#endif /* not STANDALONE */
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+/*
+ * Benchmark: natural join of two generated rowsequences on a shared
+ * variable, reading and freeing every joined row, with row recycling
+ * disabled, enabled and then with rows allocated from an arena.  The
+ * allocator calls made for joined rows are taken from the pool
+ * counters.
+ */
+#define BENCH_LEFT_ROWS 400
+#define BENCH_RIGHT_ROWS 400
+#define BENCH_KEYS 40
+#define BENCH_ITERATIONS 10
+#define BENCH_EXPECTED_ROWS \
+  ((BENCH_LEFT_ROWS / BENCH_KEYS) * (BENCH_RIGHT_ROWS / BENCH_KEYS) * BENCH_KEYS)
+
+#define BENCH_MODES_COUNT 3
+static const char* const bench_mode_labels[BENCH_MODES_COUNT] = {
+  "recycling off", "recycling on", "arena"
+};
+
+
+static rasqal_rowsource*
+rasqal_row_bench_rowsource(rasqal_world* world, rasqal_query* query,
+                           const char* name1, const char* name2, int count)
+{
+  raptor_sequence* seq;
+  raptor_sequence* vars_seq;
+  rasqal_variables_table* vt = query->vars_table;
+  const char* names[2];
+  int i;
+
+  names[0] = name1;
+  names[1] = name2;
+
+  seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_row,
+                            (raptor_data_print_handler)rasqal_row_print);
+  vars_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_variable,
+                                 (raptor_data_print_handler)rasqal_variable_print);
+  if(!seq || !vars_seq)
+    goto failed;
+
+  for(i = 0; i < 2; i++) {
+    rasqal_variable* v;
+
+    v = rasqal_variables_table_add2(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                    RASQAL_GOOD_CAST(const unsigned char*, names[i]),
+                                    0, NULL);
+    if(!v)
+      goto failed;
+    raptor_sequence_push(vars_seq, v);
+  }
+
+  for(i = 0; i < count; i++) {
+    rasqal_row* row;
+
+    row = rasqal_new_row_for_size(world, 2);
+    if(!row)
+      goto failed;
+    /* the join variable is always called "b" */
+    row->values[0] = rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER,
+                                                !strcmp(name1, "b") ? i % BENCH_KEYS : i);
+    row->values[1] = rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER,
+                                                !strcmp(name2, "b") ? i % BENCH_KEYS : i);
+    raptor_sequence_push(seq, row);
+  }
+
+  /* seq and vars_seq become owned by the rowsource */
+  return rasqal_new_rowsequence_rowsource(world, query, vt, seq, vars_seq);
+
+  failed:
+  if(seq)
+    raptor_free_sequence(seq);
+  if(vars_seq)
+    raptor_free_sequence(vars_seq);
+  return NULL;
+}
+
+
+int
+main(int argc, char *argv[]) 
+{
+  const char *program = rasqal_basename(argv[0]);
+  rasqal_world* world = NULL;
+  rasqal_query* query = NULL;
+  rasqal_row_pool* pool;
+  rasqal_arena* arena = NULL;
+  int failures = 0;
+  int mode;
+
+  world = rasqal_new_world(); rasqal_world_open(world);
+  
+  query = rasqal_new_query(world, "sparql", NULL);
+
+  /* make the query's row pool */
+  rasqal_free_row(rasqal_new_row_for_query(world, query, 0));
+  pool = query->row_pool;
+  if(!pool) {
+    fprintf(stderr, "%s: failed to create query row pool\n", program);
+    failures++;
+    goto tidy;
+  }
+
+  for(mode = 0; mode < BENCH_MODES_COUNT; mode++) {
+    clock_t start;
+    double seconds;
+    int rows = 0;
+    int iteration;
+
+    pool->max_free = mode ? RASQAL_ROW_POOL_MAX_FREE : 0;
+    pool->alloc_count = 0;
+    pool->reuse_count = 0;
+
+    if(mode == 2) {
+      arena = rasqal_new_arena(0);
+      if(!arena || rasqal_query_set_row_arena(query, arena)) {
+        fprintf(stderr, "%s: failed to attach arena\n", program);
+        failures++;
+        goto tidy;
+      }
+    }
+
+    start = clock();
+
+    for(iteration = 0; iteration < BENCH_ITERATIONS; iteration++) {
+      rasqal_rowsource* left_rs;
+      rasqal_rowsource* right_rs;
+      rasqal_rowsource* rowsource;
+      rasqal_row* row;
+
+      left_rs = rasqal_row_bench_rowsource(world, query, "a", "b",
+                                           BENCH_LEFT_ROWS);
+      right_rs = rasqal_row_bench_rowsource(world, query, "b", "c",
+                                            BENCH_RIGHT_ROWS);
+      if(!left_rs || !right_rs) {
+        fprintf(stderr, "%s: failed to create join input rowsources\n",
+                program);
+        if(left_rs)
+          rasqal_free_rowsource(left_rs);
+        if(right_rs)
+          rasqal_free_rowsource(right_rs);
+        failures++;
+        goto tidy;
+      }
+
+      /* left_rs and right_rs become owned by rowsource */
+      rowsource = rasqal_new_join_rowsource(world, query, left_rs, right_rs,
+                                            RASQAL_JOIN_TYPE_NATURAL, NULL);
+      if(!rowsource) {
+        fprintf(stderr, "%s: failed to create join rowsource\n", program);
+        failures++;
+        goto tidy;
+      }
+
+      while((row = rasqal_rowsource_read_row(rowsource))) {
+        rows++;
+        rasqal_free_row(row);
+      }
+
+      rasqal_free_rowsource(rowsource);
+    }
+
+    seconds = RASQAL_GOOD_CAST(double, clock() - start) / CLOCKS_PER_SEC;
+
+    if(rows != BENCH_EXPECTED_ROWS * BENCH_ITERATIONS) {
+      fprintf(stderr, "%s: join returned %d rows, expected %d\n", program,
+              rows, BENCH_EXPECTED_ROWS * BENCH_ITERATIONS);
+      failures++;
+      goto tidy;
+    }
+
+    /* rows used to be allocated as 2 blocks: row + values array */
+    fprintf(stderr,
+            "%s: %s: %d joined rows, %lu row allocations (%d with separate value arrays), %lu reused, %.3f seconds",
+            program, bench_mode_labels[mode], rows, pool->alloc_count,
+            2 * rows, pool->reuse_count, seconds);
+    if(seconds > 0)
+      fprintf(stderr, ", %.0f rows/second", rows / seconds);
+    fputc('\n', stderr);
+
+    if(!mode && pool->reuse_count) {
+      fprintf(stderr, "%s: rows were reused with recycling off\n", program);
+      failures++;
+    }
+    if(mode && pool->alloc_count >= RASQAL_GOOD_CAST(unsigned long, rows)) {
+      fprintf(stderr, "%s: rows were not recycled with %s\n", program,
+              bench_mode_labels[mode]);
+      failures++;
+    }
+  }
+
+  tidy:
+  if(arena) {
+    rasqal_query_set_row_arena(query, NULL);
+    rasqal_free_arena(arena);
+  }
+  if(query)
+    rasqal_free_query(query);
+  if(world)
+    rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif /* STANDALONE */
@@ -0,0 +1,448 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_row_prefetch.c - Rasqal rows evaluated ahead on a producer thread
+ *
+ * Copyright (C) 2026, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+
+#ifndef STANDALONE
+
+/*
+ * A prefetch runs a row handler on a thread of its own and keeps the
+ * rows in a ring of a fixed size until they are read, so that the
+ * thread making rows and the one reading them (for example to format
+ * query results) work at the same time.  The producer waits when the
+ * ring is full.
+ *
+ * This is a dedicated thread rather than a task of the world worker
+ * pool since the handler may itself wait for worker pool tasks.
+ * The handler is the only code that evaluates the query once the
+ * producer has started; the reading thread only takes rows.
+ */
+
+struct rasqal_row_prefetch_s
+{
+  rasqal_row_prefetch_handler handler;
+  void* user_data;
+
+  /* ring of rows made and not yet read */
+  rasqal_row** ring;
+  int size;
+
+  /* index of the oldest row in @ring and number of rows */
+  int head;
+  int count;
+
+  /* lock for the fields below and the ring */
+  rasqal_mutex lock;
+
+  /* signalled when a row is added or read and when the producer ends */
+  rasqal_cond changed;
+
+#ifdef RASQAL_THREADS
+  pthread_t thread;
+#endif
+
+  /* non-0 when the producer thread was started */
+  int started;
+
+  /* non-0 when the producer ended */
+  int finished;
+
+  /* error that ended the producer or RASQAL_ENGINE_OK */
+  rasqal_engine_error error;
+
+  /* non-0 when the producer must stop */
+  int stop;
+};
+
+
+/*
+ * rasqal_new_row_prefetch:
+ * @size: most number of rows to make ahead
+ * @handler: function making rows
+ * @user_data: data for @handler
+ *
+ * INTERNAL - Constructor - create a prefetch of rows made by @handler
+ *
+ * The producer thread starts when the first row is read.
+ *
+ * Return value: new prefetch or NULL on failure or if threads are not available
+ */
+rasqal_row_prefetch*
+rasqal_new_row_prefetch(int size, rasqal_row_prefetch_handler handler,
+                        void* user_data)
+{
+#ifdef RASQAL_THREADS
+  rasqal_row_prefetch* prefetch;
+
+  if(size < 1 || !handler)
+    return NULL;
+
+  prefetch = RASQAL_CALLOC(rasqal_row_prefetch*, 1, sizeof(*prefetch));
+  if(!prefetch)
+    return NULL;
+
+  prefetch->ring = RASQAL_CALLOC(rasqal_row**, RASQAL_GOOD_CAST(size_t, size),
+                                 sizeof(rasqal_row*));
+  if(!prefetch->ring) {
+    RASQAL_FREE(rasqal_row_prefetch, prefetch);
+    return NULL;
+  }
+
+  prefetch->size = size;
+  prefetch->handler = handler;
+  prefetch->user_data = user_data;
+  prefetch->error = RASQAL_ENGINE_OK;
+  RASQAL_MUTEX_INIT(&prefetch->lock);
+  RASQAL_COND_INIT(&prefetch->changed);
+
+  return prefetch;
+#else
+  return NULL;
+#endif
+}
+
+
+/*
+ * rasqal_free_row_prefetch:
+ * @prefetch: prefetch
+ *
+ * INTERNAL - Destructor - stop the producer, wait for it and free the prefetch with any unread rows
+ */
+void
+rasqal_free_row_prefetch(rasqal_row_prefetch* prefetch)
+{
+#ifdef RASQAL_THREADS
+  if(!prefetch)
+    return;
+
+  RASQAL_MUTEX_LOCK(&prefetch->lock);
+  prefetch->stop = 1;
+  RASQAL_COND_BROADCAST(&prefetch->changed);
+  RASQAL_MUTEX_UNLOCK(&prefetch->lock);
+
+  if(prefetch->started)
+    pthread_join(prefetch->thread, NULL);
+
+  while(prefetch->count) {
+    rasqal_free_row(prefetch->ring[prefetch->head]);
+    prefetch->head = (prefetch->head + 1) % prefetch->size;
+    prefetch->count--;
+  }
+
+  RASQAL_COND_DESTROY(&prefetch->changed);
+  RASQAL_MUTEX_DESTROY(&prefetch->lock);
+
+  RASQAL_FREE(rasqal_row**, prefetch->ring);
+  RASQAL_FREE(rasqal_row_prefetch, prefetch);
+#endif
+}
+
+
+#ifdef RASQAL_THREADS
+/* producer thread */
+static void*
+rasqal_row_prefetch_thread(void* arg)
+{
+  rasqal_row_prefetch* prefetch = (rasqal_row_prefetch*)arg;
+  rasqal_row* rows[RASQAL_ROWSOURCE_BATCH_SIZE];
+  int size = prefetch->size;
+  rasqal_engine_error error = RASQAL_ENGINE_OK;
+
+  if(size > RASQAL_ROWSOURCE_BATCH_SIZE)
+    size = RASQAL_ROWSOURCE_BATCH_SIZE;
+
+  while(1) {
+    int count;
+    int i;
+
+    count = prefetch->handler(prefetch->user_data, rows, size, &error);
+    if(count <= 0) {
+      if(count < 0 && error == RASQAL_ENGINE_OK)
+        error = RASQAL_ENGINE_FAILED;
+      break;
+    }
+
+    RASQAL_MUTEX_LOCK(&prefetch->lock);
+    for(i = 0; i < count; i++) {
+      while(!prefetch->stop && prefetch->count == prefetch->size)
+        RASQAL_COND_WAIT(&prefetch->changed, &prefetch->lock);
+      if(prefetch->stop)
+        break;
+
+      prefetch->ring[(prefetch->head + prefetch->count) % prefetch->size] = rows[i];
+      prefetch->count++;
+      RASQAL_COND_BROADCAST(&prefetch->changed);
+    }
+    RASQAL_MUTEX_UNLOCK(&prefetch->lock);
+
+    if(i < count) {
+      /* stopped */
+      for(; i < count; i++)
+        rasqal_free_row(rows[i]);
+      break;
+    }
+  }
+
+  RASQAL_MUTEX_LOCK(&prefetch->lock);
+  prefetch->finished = 1;
+  prefetch->error = error;
+  RASQAL_COND_BROADCAST(&prefetch->changed);
+  RASQAL_MUTEX_UNLOCK(&prefetch->lock);
+
+  return NULL;
+}
+#endif
+
+
+/*
+ * rasqal_row_prefetch_next:
+ * @prefetch: prefetch
+ * @row_p: pointer to store the row
+ * @error_p: pointer to store the error that ended the producer
+ *
+ * INTERNAL - Read the next row waiting for the producer if needed
+ *
+ * Starts the producer thread on the first call.  The row becomes
+ * owned by the caller.
+ *
+ * Return value: >0 if a row was returned, 0 when finished or <0 on failure
+ */
+int
+rasqal_row_prefetch_next(rasqal_row_prefetch* prefetch, rasqal_row** row_p,
+                         rasqal_engine_error* error_p)
+{
+#ifdef RASQAL_THREADS
+  int rc = 0;
+
+  RASQAL_MUTEX_LOCK(&prefetch->lock);
+  if(!prefetch->started) {
+    if(pthread_create(&prefetch->thread, NULL, rasqal_row_prefetch_thread,
+                      prefetch)) {
+      RASQAL_MUTEX_UNLOCK(&prefetch->lock);
+      *error_p = RASQAL_ENGINE_FAILED;
+      return -1;
+    }
+    prefetch->started = 1;
+  }
+
+  while(!prefetch->count && !prefetch->finished)
+    RASQAL_COND_WAIT(&prefetch->changed, &prefetch->lock);
+
+  if(prefetch->count) {
+    *row_p = prefetch->ring[prefetch->head];
+    prefetch->ring[prefetch->head] = NULL;
+    prefetch->head = (prefetch->head + 1) % prefetch->size;
+    prefetch->count--;
+    /* room for another row */
+    RASQAL_COND_BROADCAST(&prefetch->changed);
+    rc = 1;
+  } else if(prefetch->error != RASQAL_ENGINE_OK) {
+    *error_p = prefetch->error;
+    rc = -1;
+  }
+  RASQAL_MUTEX_UNLOCK(&prefetch->lock);
+
+  return rc;
+#else
+  *error_p = RASQAL_ENGINE_FAILED;
+  return -1;
+#endif
+}
+
+#endif /* not STANDALONE */
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+#define PREFETCH_TEST_ROWS 1000
+
+typedef struct
+{
+  rasqal_world* world;
+
+  /* number of rows made so far */
+  int made;
+
+  /* make rows until this many then fail or finish */
+  int limit;
+  int fail;
+} prefetch_test_state;
+
+
+static int
+prefetch_test_handler(void* user_data, rasqal_row** rows, int size,
+                      rasqal_engine_error* error_p)
+{
+  prefetch_test_state* state = (prefetch_test_state*)user_data;
+  int count = 0;
+
+  while(count < size && state->made < state->limit) {
+    rows[count] = rasqal_new_row_for_size(state->world, 1);
+    if(!rows[count])
+      break;
+    rows[count]->offset = state->made++;
+    count++;
+  }
+
+  if(!count && state->fail) {
+    *error_p = RASQAL_ENGINE_FAILED;
+    return -1;
+  }
+
+  return count;
+}
+
+
+/* read all rows; return number read or <0 on failure */
+static int
+prefetch_test_read(rasqal_row_prefetch* prefetch, int* in_order_p,
+                   rasqal_engine_error* error_p)
+{
+  int count = 0;
+
+  *in_order_p = 1;
+  while(1) {
+    rasqal_row* row = NULL;
+    int rc;
+
+    rc = rasqal_row_prefetch_next(prefetch, &row, error_p);
+    if(rc < 0)
+      return -1;
+    if(!rc)
+      break;
+
+    if(row->offset != count)
+      *in_order_p = 0;
+    rasqal_free_row(row);
+    count++;
+  }
+
+  return count;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = rasqal_basename(argv[0]);
+#ifdef RASQAL_THREADS
+  rasqal_world* world;
+  rasqal_row_prefetch* prefetch;
+  prefetch_test_state state;
+  rasqal_row* row = NULL;
+  rasqal_engine_error error = RASQAL_ENGINE_OK;
+  int in_order = 0;
+  int count;
+  int failures = 0;
+
+  world = rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  /* a ring smaller than a batch so that the producer waits */
+  memset(&state, 0, sizeof(state));
+  state.world = world;
+  state.limit = PREFETCH_TEST_ROWS;
+  prefetch = rasqal_new_row_prefetch(7, prefetch_test_handler, &state);
+  if(!prefetch) {
+    fprintf(stderr, "%s: failed to create prefetch\n", program);
+    return(1);
+  }
+
+  count = prefetch_test_read(prefetch, &in_order, &error);
+  if(count != PREFETCH_TEST_ROWS || !in_order) {
+    fprintf(stderr, "%s: read %d rows%s, expected %d in order\n", program,
+            count, in_order ? "" : " out of order", PREFETCH_TEST_ROWS);
+    failures++;
+  }
+  rasqal_free_row_prefetch(prefetch);
+
+  /* a failing producer */
+  memset(&state, 0, sizeof(state));
+  state.world = world;
+  state.limit = 10;
+  state.fail = 1;
+  prefetch = rasqal_new_row_prefetch(64, prefetch_test_handler, &state);
+  if(!prefetch) {
+    fprintf(stderr, "%s: failed to create prefetch\n", program);
+    return(1);
+  }
+
+  count = prefetch_test_read(prefetch, &in_order, &error);
+  if(count >= 0 || error != RASQAL_ENGINE_FAILED) {
+    fprintf(stderr, "%s: failing producer returned %d, expected failure\n",
+            program, count);
+    failures++;
+  }
+  rasqal_free_row_prefetch(prefetch);
+
+  /* freed while the producer waits for room */
+  memset(&state, 0, sizeof(state));
+  state.world = world;
+  state.limit = PREFETCH_TEST_ROWS;
+  prefetch = rasqal_new_row_prefetch(4, prefetch_test_handler, &state);
+  if(!prefetch) {
+    fprintf(stderr, "%s: failed to create prefetch\n", program);
+    return(1);
+  }
+
+  if(rasqal_row_prefetch_next(prefetch, &row, &error) <= 0) {
+    fprintf(stderr, "%s: failed to read first row\n", program);
+    failures++;
+  } else
+    rasqal_free_row(row);
+  rasqal_free_row_prefetch(prefetch);
+
+  rasqal_free_world(world);
+
+  return failures;
+#else
+  fprintf(stderr, "%s: Threads not available, skipping test\n", program);
+  return(0);
+#endif
+}
+
+#endif /* STANDALONE */
@@ -46,6 +46,47 @@
 
 static void rasqal_rowsource_print_header(rasqal_rowsource* rowsource, FILE* fh);
 
+
+/* measurements taken before a handler call when profiling */
+typedef struct {
+  double wall;
+  double cpu;
+  size_t bytes;
+} rasqal_rowsource_profile_mark;
+
+
+/* start measuring a handler call into @start if profiling */
+static void
+rasqal_rowsource_profile_start(rasqal_rowsource* rowsource,
+                               rasqal_rowsource_profile_mark* start)
+{
+  if(!rowsource->profile)
+    return;
+
+  rasqal_engine_get_times(&start->wall, &start->cpu);
+  start->bytes = rasqal_query_get_row_bytes_allocated(rowsource->query);
+}
+
+
+/* add the time and row bytes since rasqal_rowsource_profile_start()
+ * to the statistics */
+static void
+rasqal_rowsource_profile_end(rasqal_rowsource* rowsource,
+                             rasqal_rowsource_profile_mark* start)
+{
+  double wall;
+  double cpu;
+
+  if(!rowsource->profile)
+    return;
+
+  rasqal_engine_get_times(&wall, &cpu);
+  rowsource->stats.wall_time += wall - start->wall;
+  rowsource->stats.cpu_time += cpu - start->cpu;
+  rowsource->stats.bytes += rasqal_query_get_row_bytes_allocated(rowsource->query) - start->bytes;
+}
+
+
 /**
  * rasqal_new_rowsource_from_handler:
  * @query: query object
@@ -71,7 +112,7 @@ rasqal_new_rowsource_from_handler(rasqal_world* world,
   if(!world || !handler)
     return NULL;
 
-  if(handler->version < 1 || handler->version > 1)
+  if(handler->version < 1 || handler->version > 3)
     return NULL;
 
   rowsource = RASQAL_CALLOC(rasqal_rowsource*, 1, sizeof(*rowsource));
@@ -91,6 +132,8 @@ rasqal_new_rowsource_from_handler(rasqal_world* world,
   rowsource->size = 0;
 
   rowsource->generate_group = 0;
+
+  rowsource->rows_needed = -1;
   
   if(vars_table)
     rowsource->vars_table = rasqal_new_variables_table_from_variables_table(vars_table);
@@ -129,7 +172,7 @@ rasqal_new_rowsource_from_rowsource(rasqal_rowsource* rowsource)
   if(!rowsource)
     return NULL;
 
-  rowsource->usage++;
+  RASQAL_USAGE_INCREMENT(&rowsource->usage);
   return rowsource;
 }
 
@@ -146,7 +189,7 @@ rasqal_free_rowsource(rasqal_rowsource *rowsource)
   if(!rowsource)
     return;
 
-  if(--rowsource->usage)
+  if(RASQAL_USAGE_DECREMENT(&rowsource->usage))
     return;
 
   if(rowsource->handler->finish)
@@ -246,10 +289,16 @@ rasqal_row*
 rasqal_rowsource_read_row(rasqal_rowsource *rowsource)
 {
   rasqal_row* row = NULL;
+  /* non-0 if the row was counted when all rows were read */
+  int counted = 0;
+  rasqal_rowsource_profile_mark start;
   
   if(!rowsource || rowsource->finished)
     return NULL;
 
+  if(RASQAL_EXECUTION_CHECK(rowsource->execution))
+    return NULL;
+
   if(rowsource->flags & RASQAL_ROWSOURCE_FLAGS_SAVED_ROWS) {
     /* return row from saved rows sequence at offset */
     row = (rasqal_row*)raptor_sequence_get_at(rowsource->rows_sequence,
@@ -271,7 +320,9 @@ rasqal_rowsource_read_row(rasqal_rowsource *rowsource)
       return NULL;
 
     if(rowsource->handler->read_row) {
+      rasqal_rowsource_profile_start(rowsource, &start);
       row = rowsource->handler->read_row(rowsource, rowsource->user_data);
+      rasqal_rowsource_profile_end(rowsource, &start);
       /* row is owned by us */
 
       if(row && rowsource->flags & RASQAL_ROWSOURCE_FLAGS_SAVE_ROWS) {
@@ -305,6 +356,7 @@ rasqal_rowsource_read_row(rasqal_rowsource *rowsource)
           row = rasqal_new_row_from_row(row);
         /* row is owned by us */
       }
+      counted = 1;
     }
   }
   
@@ -314,6 +366,8 @@ rasqal_rowsource_read_row(rasqal_rowsource *rowsource)
       rowsource->flags |= RASQAL_ROWSOURCE_FLAGS_SAVED_ROWS;
   } else {
     rowsource->count++;
+    if(!counted)
+      rowsource->stats.rows++;
 
     /* Generate a group around all rows if there are no groups returned */
     if(rowsource->generate_group && row->group_id < 0)
@@ -334,6 +388,157 @@ rasqal_rowsource_read_row(rasqal_rowsource *rowsource)
 }
 
 
+/**
+ * rasqal_rowsource_skip_rows:
+ * @rowsource: rasqal rowsource
+ * @count: number of rows to skip
+ *
+ * Skip over rows from the rowsource without returning them.
+ *
+ * Uses the handler skip_rows method when there is one so that the
+ * skipped rows need not be built, otherwise reads and frees the rows.
+ * Rows that must be saved for a reset are always read.
+ *
+ * Return value: number of rows skipped (less than @count if the rowsource finished) or < 0 on failure
+ **/
+int
+rasqal_rowsource_skip_rows(rasqal_rowsource *rowsource, int count)
+{
+  int skipped = 0;
+  rasqal_rowsource_profile_mark start;
+
+  if(!rowsource || count < 0)
+    return -1;
+
+  if(rowsource->finished || !count)
+    return 0;
+
+  if(RASQAL_EXECUTION_CHECK(rowsource->execution))
+    return -1;
+
+  if(rowsource->handler->version >= 2 && rowsource->handler->skip_rows &&
+     !(rowsource->flags & (RASQAL_ROWSOURCE_FLAGS_SAVE_ROWS |
+                           RASQAL_ROWSOURCE_FLAGS_SAVED_ROWS))) {
+    if(rasqal_rowsource_ensure_variables(rowsource))
+      return -1;
+
+    rasqal_rowsource_profile_start(rowsource, &start);
+    skipped = rowsource->handler->skip_rows(rowsource, rowsource->user_data,
+                                            count);
+    rasqal_rowsource_profile_end(rowsource, &start);
+    RASQAL_DEBUG5("%s rowsource %p skipped %d of %d rows\n",
+                  rowsource->handler->name, rowsource, skipped, count);
+    if(skipped < 0)
+      return -1;
+
+    rowsource->count += skipped;
+    rowsource->stats.rows += skipped;
+    if(skipped < count)
+      rowsource->finished = 1;
+
+    return skipped;
+  }
+
+  while(skipped < count) {
+    rasqal_row* row;
+
+    row = rasqal_rowsource_read_row(rowsource);
+    if(!row)
+      break;
+
+    rasqal_free_row(row);
+    skipped++;
+  }
+
+  return skipped;
+}
+
+
+/**
+ * rasqal_rowsource_read_batch:
+ * @rowsource: rasqal rowsource
+ * @rows: array to fill with rows
+ * @size: size of @rows array
+ *
+ * Read up to @size query result rows from the rowsource.
+ *
+ * Uses the handler read_batch method when there is one, otherwise
+ * reads rows one at a time with rasqal_rowsource_read_row().  Fewer
+ * than @size rows may be returned before the rowsource is exhausted.
+ *
+ * The rows returned are owned by the caller.  Unlike
+ * rasqal_rowsource_read_row(), the variables are not left bound to
+ * the values of each row in turn so callers evaluating expressions
+ * over the rows must bind them with rasqal_row_bind_variables().
+ *
+ * Return value: number of rows stored in @rows, 0 when no more rows are available or < 0 on failure
+ **/
+int
+rasqal_rowsource_read_batch(rasqal_rowsource *rowsource,
+                            rasqal_row** rows, int size)
+{
+  int count = 0;
+  rasqal_rowsource_profile_mark start;
+
+  if(!rowsource || !rows || size < 0)
+    return -1;
+
+  if(rowsource->finished || !size)
+    return 0;
+
+  if(RASQAL_EXECUTION_CHECK(rowsource->execution))
+    return -1;
+
+  if(rowsource->handler->version >= 2 && rowsource->handler->read_batch &&
+     !(rowsource->flags & (RASQAL_ROWSOURCE_FLAGS_SAVE_ROWS |
+                           RASQAL_ROWSOURCE_FLAGS_SAVED_ROWS))) {
+    int i;
+
+    if(rasqal_rowsource_ensure_variables(rowsource))
+      return -1;
+
+    rasqal_rowsource_profile_start(rowsource, &start);
+    count = rowsource->handler->read_batch(rowsource, rowsource->user_data,
+                                           rows, size);
+    rasqal_rowsource_profile_end(rowsource, &start);
+    RASQAL_DEBUG4("%s rowsource %p returned a batch of %d rows\n",
+                  rowsource->handler->name, rowsource, count);
+    if(count < 0)
+      return -1;
+
+    if(!count) {
+      rowsource->finished = 1;
+      return 0;
+    }
+
+    rowsource->count += count;
+    rowsource->stats.rows += count;
+
+    /* Generate a group around all rows if there are no groups returned */
+    if(rowsource->generate_group) {
+      for(i = 0; i < count; i++) {
+        if(rows[i]->group_id < 0)
+          rows[i]->group_id = 0;
+      }
+    }
+
+    return count;
+  }
+
+  while(count < size) {
+    rasqal_row* row;
+
+    row = rasqal_rowsource_read_row(rowsource);
+    if(!row)
+      break;
+
+    rows[count++] = row;
+  }
+
+  return count;
+}
+
+
 /**
  * rasqal_rowsource_get_row_count:
  * @rowsource: rasqal rowsource
@@ -367,6 +572,7 @@ raptor_sequence*
 rasqal_rowsource_read_all_rows(rasqal_rowsource *rowsource)
 {
   raptor_sequence* seq;
+  rasqal_rowsource_profile_mark start;
 
   if(!rowsource)
     return NULL;
@@ -380,15 +586,22 @@ rasqal_rowsource_read_all_rows(rasqal_rowsource *rowsource)
     RASQAL_DEBUG4("%s rowsource %p returning a sequence of %d saved rows\n",
                   rowsource->handler->name, rowsource,
                   raptor_sequence_size(new_seq));
+    if(new_seq)
+      rowsource->stats.rows += raptor_sequence_size(new_seq);
     return new_seq;
   }
 
+  if(RASQAL_EXECUTION_CHECK(rowsource->execution))
+    return NULL;
+
   /* Execute */
   if(rasqal_rowsource_ensure_variables(rowsource))
     return NULL;
 
   if(rowsource->handler->read_all_rows) {
+    rasqal_rowsource_profile_start(rowsource, &start);
     seq = rowsource->handler->read_all_rows(rowsource, rowsource->user_data);
+    rasqal_rowsource_profile_end(rowsource, &start);
     if(!seq) {
       seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_row,
                                 (raptor_data_print_handler)rasqal_row_print);
@@ -407,6 +620,9 @@ rasqal_rowsource_read_all_rows(rasqal_rowsource *rowsource)
       }
     }
 
+    if(seq)
+      rowsource->stats.rows += raptor_sequence_size(seq);
+
     goto done;
   }
 
@@ -626,6 +842,7 @@ rasqal_rowsource_reset(rasqal_rowsource* rowsource)
 {
   rowsource->finished = 0;
   rowsource->count = 0;
+  rowsource->stats.resets++;
 
   if(rowsource->handler->reset)
     return rowsource->handler->reset(rowsource, rowsource->user_data);
@@ -724,15 +941,129 @@ rasqal_rowsource_set_origin(rasqal_rowsource* rowsource,
 }
 
 
+static int
+rasqal_rowsource_visitor_set_execution_state(rasqal_rowsource* rowsource,
+                                             void *user_data)
+{
+  rowsource->execution = (rasqal_execution_state*)user_data;
+
+  return 0;
+}
+
+
+/*
+ * rasqal_rowsource_set_execution_state:
+ * @rowsource: rasqal rowsource
+ * @state: execution state or NULL
+ *
+ * INTERNAL - Set the execution state checked by a rowsource and all its inner rowsources
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_rowsource_set_execution_state(rasqal_rowsource* rowsource,
+                                     rasqal_execution_state* state)
+{
+  return rasqal_rowsource_visit(rowsource,
+                                rasqal_rowsource_visitor_set_execution_state,
+                                state);
+}
+
+
+static int
+rasqal_rowsource_visitor_ensure_variables(rasqal_rowsource* rowsource,
+                                          void *user_data)
+{
+  return rasqal_rowsource_ensure_variables(rowsource) ? -1 : 0;
+}
+
+
+static int
+rasqal_rowsource_visitor_set_profile(rasqal_rowsource* rowsource,
+                                     void *user_data)
+{
+  rowsource->profile = (*(int*)user_data != 0);
+
+  if(rowsource->profile)
+    rasqal_rowsource_estimate_rows(rowsource);
+
+  return 0;
+}
+
+
+/*
+ * rasqal_rowsource_set_profile:
+ * @rowsource: rasqal rowsource
+ * @profile: non-0 to record handler times
+ *
+ * INTERNAL - Set a rowsource and all its inner rowsources to record the time spent in their handlers
+ *
+ * When profiling is turned on, the row estimates are also made now
+ * so that they are from before any rows are read.
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_rowsource_set_profile(rasqal_rowsource* rowsource, int profile)
+{
+  return rasqal_rowsource_visit(rowsource,
+                                rasqal_rowsource_visitor_set_profile,
+                                &profile);
+}
+
+
+/*
+ * rasqal_rowsource_estimate_rows:
+ * @rowsource: rasqal rowsource
+ *
+ * INTERNAL - Estimate how many rows a rowsource returns
+ *
+ * Uses the handler estimate_rows method when there is one, otherwise
+ * the estimate of the first inner rowsource.  The estimate is made
+ * once, the first time it is asked for, and may need to match triple
+ * patterns against the data.
+ *
+ * Return value: estimated number of rows or <0 if unknown
+ */
+long
+rasqal_rowsource_estimate_rows(rasqal_rowsource* rowsource)
+{
+  long estimate;
+
+  if(!rowsource)
+    return -1;
+
+  if(rowsource->estimated)
+    return rowsource->estimated_rows;
+
+  if(rowsource->handler->version >= 3 && rowsource->handler->estimate_rows)
+    estimate = rowsource->handler->estimate_rows(rowsource,
+                                                 rowsource->user_data);
+  else
+    estimate = rasqal_rowsource_estimate_rows(rasqal_rowsource_get_inner_rowsource(rowsource, 0));
+
+  rowsource->estimated_rows = (estimate < 0) ? -1 : estimate;
+  rowsource->estimated = 1;
+
+  return rowsource->estimated_rows;
+}
+
+
 static int
 rasqal_rowsource_visitor_set_requirements(rasqal_rowsource* rowsource,
                                           void *user_data)
 {
   unsigned int flags = *(unsigned int*)user_data;
 
-  if(rowsource->handler->set_requirements)
-    return rowsource->handler->set_requirements(rowsource, rowsource->user_data,
-                                                flags);
+  if(rowsource->handler->set_requirements) {
+    int rc;
+    
+    rc = rowsource->handler->set_requirements(rowsource, rowsource->user_data,
+                                              flags);
+    /* non-0: handled here (>0) or failed (<0) */
+    if(rc)
+      return rc;
+  }
 
   if(flags & RASQAL_ROWSOURCE_REQUIRE_RESET) {
     if(!rowsource->handler->reset) {
@@ -759,6 +1090,41 @@ rasqal_rowsource_set_requirements(rasqal_rowsource* rowsource, unsigned int flag
 }
 
 
+/**
+ * rasqal_rowsource_set_rows_needed:
+ * @rowsource: rasqal rowsource
+ * @rows_needed: maximum number of rows that will be read or <0 for all
+ *
+ * INTERNAL - Tell a rowsource how many rows its consumer will read at most
+ *
+ * This is a hint only: the rowsource may still return more rows.
+ * It is not passed to inner rowsources automatically; handlers that
+ * can compute the number of input rows they need forward it from
+ * their set_requirements method with the
+ * #RASQAL_ROWSOURCE_REQUIRE_ROWS_LIMIT flag.
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_rowsource_set_rows_needed(rasqal_rowsource* rowsource, int rows_needed)
+{
+  if(!rowsource)
+    return 1;
+
+  if(rows_needed < 0)
+    rows_needed = -1;
+
+  rowsource->rows_needed = rows_needed;
+
+  if(rowsource->handler->set_requirements)
+    return (rowsource->handler->set_requirements(rowsource,
+                                                 rowsource->user_data,
+                                                 RASQAL_ROWSOURCE_REQUIRE_ROWS_LIMIT) < 0);
+
+  return 0;
+}
+
+
 int
 rasqal_rowsource_request_grouping(rasqal_rowsource* rowsource)
 {
@@ -830,6 +1196,287 @@ rasqal_rowsource_write(rasqal_rowsource *rowsource, raptor_iostream *iostr)
 }
   
 
+/* write a number of seconds as milliseconds */
+static void
+rasqal_rowsource_write_milliseconds(raptor_iostream* iostr, double seconds)
+{
+  char buffer[32];
+
+  snprintf(buffer, sizeof(buffer), "%.3f", seconds * 1000.0);
+  raptor_iostream_string_write(buffer, iostr);
+}
+
+
+/* write a count or estimate that may be <0 for unknown */
+static void
+rasqal_rowsource_write_count(raptor_iostream* iostr, long count,
+                             const char* unknown)
+{
+  char buffer[32];
+
+  if(count < 0) {
+    raptor_iostream_string_write(unknown, iostr);
+    return;
+  }
+
+  snprintf(buffer, sizeof(buffer), "%ld", count);
+  raptor_iostream_string_write(buffer, iostr);
+}
+
+
+static int
+rasqal_rowsource_write_explain_text(rasqal_rowsource* rowsource,
+                                    raptor_iostream* iostr,
+                                    unsigned int indent)
+{
+  rasqal_rowsource* inner_rowsource;
+  int offset;
+  int i;
+
+  rasqal_rowsource_write_indent(iostr, indent);
+  raptor_iostream_string_write(rowsource->handler->name, iostr);
+
+  raptor_iostream_counted_string_write(" (", 2, iostr);
+  for(i = 0; i < rowsource->size; i++) {
+    rasqal_variable* v = rasqal_rowsource_get_variable_by_offset(rowsource, i);
+
+    if(i > 0)
+      raptor_iostream_write_byte(' ', iostr);
+    raptor_iostream_write_byte('?', iostr);
+    raptor_iostream_string_write(v->name, iostr);
+  }
+  raptor_iostream_counted_string_write(")", 1, iostr);
+
+  raptor_iostream_string_write(" estimated rows=", iostr);
+  rasqal_rowsource_write_count(iostr, rasqal_rowsource_estimate_rows(rowsource),
+                               "?");
+  raptor_iostream_string_write(" rows=", iostr);
+  rasqal_rowsource_write_count(iostr, rowsource->stats.rows, "?");
+  raptor_iostream_string_write(" resets=", iostr);
+  raptor_iostream_decimal_write(rowsource->stats.resets, iostr);
+  if(rowsource->profile) {
+    raptor_iostream_string_write(" wall=", iostr);
+    rasqal_rowsource_write_milliseconds(iostr, rowsource->stats.wall_time);
+    raptor_iostream_string_write("ms cpu=", iostr);
+    rasqal_rowsource_write_milliseconds(iostr, rowsource->stats.cpu_time);
+    raptor_iostream_string_write("ms", iostr);
+  }
+  raptor_iostream_write_byte('\n', iostr);
+
+  for(offset = 0;
+      (inner_rowsource = rasqal_rowsource_get_inner_rowsource(rowsource, offset));
+      offset++) {
+    if(rasqal_rowsource_write_explain_text(inner_rowsource, iostr, indent + 2))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/* write a string as a JSON string */
+static void
+rasqal_rowsource_write_json_string(raptor_iostream* iostr,
+                                   const unsigned char* string)
+{
+  raptor_iostream_write_byte('"', iostr);
+  raptor_string_ntriples_write(string,
+                               strlen(RASQAL_GOOD_CAST(const char*, string)),
+                               '"', iostr);
+  raptor_iostream_write_byte('"', iostr);
+}
+
+
+static int
+rasqal_rowsource_write_explain_json(rasqal_rowsource* rowsource,
+                                    raptor_iostream* iostr,
+                                    unsigned int indent)
+{
+  rasqal_rowsource* inner_rowsource;
+  int offset;
+  int i;
+
+  raptor_iostream_string_write("{\n", iostr);
+  indent += 2;
+
+  rasqal_rowsource_write_indent(iostr, indent);
+  raptor_iostream_string_write("\"name\": ", iostr);
+  rasqal_rowsource_write_json_string(iostr,
+                                     RASQAL_GOOD_CAST(const unsigned char*, rowsource->handler->name));
+  raptor_iostream_string_write(",\n", iostr);
+
+  rasqal_rowsource_write_indent(iostr, indent);
+  raptor_iostream_string_write("\"variables\": [", iostr);
+  for(i = 0; i < rowsource->size; i++) {
+    rasqal_variable* v = rasqal_rowsource_get_variable_by_offset(rowsource, i);
+
+    if(i > 0)
+      raptor_iostream_counted_string_write(", ", 2, iostr);
+    rasqal_rowsource_write_json_string(iostr, v->name);
+  }
+  raptor_iostream_string_write("],\n", iostr);
+
+  rasqal_rowsource_write_indent(iostr, indent);
+  raptor_iostream_string_write("\"estimated_rows\": ", iostr);
+  rasqal_rowsource_write_count(iostr, rasqal_rowsource_estimate_rows(rowsource),
+                               "null");
+  raptor_iostream_string_write(",\n", iostr);
+
+  rasqal_rowsource_write_indent(iostr, indent);
+  raptor_iostream_string_write("\"rows\": ", iostr);
+  rasqal_rowsource_write_count(iostr, rowsource->stats.rows, "null");
+  raptor_iostream_string_write(",\n", iostr);
+
+  rasqal_rowsource_write_indent(iostr, indent);
+  raptor_iostream_string_write("\"resets\": ", iostr);
+  raptor_iostream_decimal_write(rowsource->stats.resets, iostr);
+  raptor_iostream_string_write(",\n", iostr);
+
+  if(rowsource->profile) {
+    rasqal_rowsource_write_indent(iostr, indent);
+    raptor_iostream_string_write("\"wall_ms\": ", iostr);
+    rasqal_rowsource_write_milliseconds(iostr, rowsource->stats.wall_time);
+    raptor_iostream_string_write(",\n", iostr);
+
+    rasqal_rowsource_write_indent(iostr, indent);
+    raptor_iostream_string_write("\"cpu_ms\": ", iostr);
+    rasqal_rowsource_write_milliseconds(iostr, rowsource->stats.cpu_time);
+    raptor_iostream_string_write(",\n", iostr);
+  }
+
+  rasqal_rowsource_write_indent(iostr, indent);
+  raptor_iostream_string_write("\"children\": [", iostr);
+  for(offset = 0;
+      (inner_rowsource = rasqal_rowsource_get_inner_rowsource(rowsource, offset));
+      offset++) {
+    raptor_iostream_string_write(offset ? ",\n" : "\n", iostr);
+    rasqal_rowsource_write_indent(iostr, indent + 2);
+    if(rasqal_rowsource_write_explain_json(inner_rowsource, iostr, indent + 2))
+      return 1;
+  }
+  if(offset) {
+    raptor_iostream_write_byte('\n', iostr);
+    rasqal_rowsource_write_indent(iostr, indent);
+  }
+  raptor_iostream_string_write("]\n", iostr);
+
+  indent -= 2;
+  rasqal_rowsource_write_indent(iostr, indent);
+  raptor_iostream_write_byte('}', iostr);
+
+  return 0;
+}
+
+
+/*
+ * rasqal_rowsource_write_explain:
+ * @rowsource: rasqal rowsource
+ * @iostr: iostream to write to
+ * @format: format to write
+ *
+ * INTERNAL - Write a rowsource tree as a query plan with its estimated and actual rows
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_rowsource_write_explain(rasqal_rowsource* rowsource,
+                               raptor_iostream* iostr,
+                               rasqal_query_explain_format format)
+{
+  int rc;
+
+  if(!rowsource || !iostr)
+    return 1;
+
+  if(rasqal_rowsource_visit(rowsource,
+                            rasqal_rowsource_visitor_ensure_variables, NULL))
+    return 1;
+
+  if(format == RASQAL_QUERY_EXPLAIN_FORMAT_JSON) {
+    rc = rasqal_rowsource_write_explain_json(rowsource, iostr, 0);
+    raptor_iostream_write_byte('\n', iostr);
+  } else
+    rc = rasqal_rowsource_write_explain_text(rowsource, iostr, 0);
+
+  return rc;
+}
+
+
+/* find the rowsource at pre-order position *@offset_p below @rowsource
+ * counting *@offset_p down */
+static rasqal_rowsource*
+rasqal_rowsource_find_by_offset(rasqal_rowsource* rowsource, int* offset_p,
+                                int depth, int* depth_p)
+{
+  rasqal_rowsource* inner_rowsource;
+  int offset;
+
+  if(!(*offset_p)--) {
+    *depth_p = depth;
+    return rowsource;
+  }
+
+  for(offset = 0;
+      (inner_rowsource = rasqal_rowsource_get_inner_rowsource(rowsource, offset));
+      offset++) {
+    rasqal_rowsource* found;
+
+    found = rasqal_rowsource_find_by_offset(inner_rowsource, offset_p,
+                                            depth + 1, depth_p);
+    if(found)
+      return found;
+  }
+
+  return NULL;
+}
+
+
+/*
+ * rasqal_rowsource_get_counters:
+ * @rowsource: top rowsource of a tree
+ * @offset: position of the rowsource in a depth-first walk of the tree
+ * @counters: counters to fill in
+ *
+ * INTERNAL - Get the statistics of one rowsource of a tree as counters
+ *
+ * Return value: 0 on success, >0 if @offset is past the end of the tree or <0 on failure
+ */
+int
+rasqal_rowsource_get_counters(rasqal_rowsource* rowsource, int offset,
+                              rasqal_operator_counters* counters)
+{
+  rasqal_rowsource* inner_rowsource;
+  int depth = 0;
+  int i;
+
+  if(!rowsource || !counters || offset < 0)
+    return -1;
+
+  rowsource = rasqal_rowsource_find_by_offset(rowsource, &offset, 0, &depth);
+  if(!rowsource)
+    return 1;
+
+  memset(counters, '\0', sizeof(*counters));
+  counters->name = rowsource->handler->name;
+  counters->depth = depth;
+  counters->rows_produced = rowsource->stats.rows;
+  counters->resets = rowsource->stats.resets;
+  counters->wall_time = rowsource->stats.wall_time;
+  counters->cpu_time = rowsource->stats.cpu_time;
+  counters->bytes_allocated = rowsource->stats.bytes;
+  counters->triples_matches = rowsource->stats.triples_matches;
+  counters->triples_next_matches = rowsource->stats.triples_next_matches;
+  counters->expression_evaluations = rowsource->stats.expressions;
+
+  for(i = 0;
+      (inner_rowsource = rasqal_rowsource_get_inner_rowsource(rowsource, i));
+      i++)
+    counters->rows_consumed += inner_rowsource->stats.rows;
+
+  return 0;
+}
+
+
 /**
  * rasqal_rowsource_print:
  * @rs: the #rasqal_rowsource object
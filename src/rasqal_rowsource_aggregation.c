@@ -34,6 +34,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
@@ -80,6 +81,70 @@ typedef struct
   rasqal_map* map;
 } rasqal_agg_expr_data;
 
+
+/*
+ * rasqal_agg_group_expr_state:
+ *
+ * INTERNAL - aggregate execution state of one expression in one group
+ */
+typedef struct 
+{
+  /* as created by rasqal_builtin_agg_expression_execute_init() */
+  void* agg_user_data;
+
+  /* map for distincting literal values or NULL */
+  rasqal_map* map;
+} rasqal_agg_group_expr_state;
+
+
+/*
+ * rasqal_agg_group:
+ *
+ * INTERNAL - one group when aggregating ungrouped input by hashing
+ *
+ * Holds only the group key, the first input row and the running
+ * aggregate state for each expression; the other input rows of the
+ * group are not kept.
+ */
+typedef struct rasqal_agg_group_s
+{
+  /* next group in the same hash bucket */
+  struct rasqal_agg_group_s* next;
+
+  /* hash of @literals */
+  unsigned int hash;
+
+  /* Key of this group (seq of literals) or NULL for the group
+   * generated when there is no input */
+  raptor_sequence* literals;
+
+  /* first input row of the group, providing the values copied through */
+  rasqal_row* row;
+
+  /* array of aggregate states, one per expression */
+  rasqal_agg_group_expr_state* states;
+} rasqal_agg_group;
+
+
+/*
+ * rasqal_agg_run:
+ *
+ * INTERNAL - sorted run of aggregation output rows spilled to disk
+ *
+ * Each record is a group key followed by the output row values.
+ */
+typedef struct
+{
+  /* temporary file */
+  FILE* fh;
+
+  /* key of the next record or NULL when the run is exhausted */
+  raptor_sequence* literals;
+
+  /* output row of the next record */
+  rasqal_row* row;
+} rasqal_agg_run;
+
   
 /*
  * rasqal_aggregation_rowsource_context:
@@ -128,6 +193,43 @@ typedef struct
 
   /* step into current group */
   int step_count;
+
+  /* GROUP BY expressions when grouping the input here by hashing
+   * or NULL if the input rowsource is already grouped */
+  raptor_sequence* group_exprs_seq;
+
+  /* non-0 if input has been grouped and aggregated */
+  int processed;
+
+  /* hash table of #rasqal_agg_group chained by the next field */
+  rasqal_agg_group** groups;
+
+  /* number of buckets in @groups */
+  int groups_size;
+
+  /* number of groups */
+  int groups_count;
+
+  /* groups in output order after all input is read */
+  rasqal_agg_group** sorted_groups;
+
+  /* index of next group in @sorted_groups to return */
+  int sorted_groups_index;
+
+  /* GROUP BY state memory budget in bytes or 0 for no limit */
+  size_t spill_limit;
+
+  /* estimated bytes of group state held in the current pass */
+  size_t groups_memory;
+
+  /* sorted runs of output rows spilled to temporary files */
+  rasqal_agg_run* runs;
+
+  /* number of used runs */
+  int runs_count;
+
+  /* allocated size of @runs */
+  int runs_size;
 } rasqal_aggregation_rowsource_context;
 
 
@@ -240,6 +342,55 @@ rasqal_builtin_agg_expression_execute_reset(void* user_data)
 }
 
 
+/*
+ * rasqal_builtin_agg_expression_execute_accumulate:
+ * @b: aggregate state for AVG, MAX, MIN or SUM
+ * @l: literal
+ *
+ * INTERNAL - Accumulate a literal into the computation literal
+ *
+ * Return value: new computation literal or NULL on error
+ */
+static rasqal_literal*
+rasqal_builtin_agg_expression_execute_accumulate(rasqal_builtin_agg_expression_execute* b,
+                                                 rasqal_literal* l)
+{
+  rasqal_literal* result = NULL;
+
+  if(!b->l)
+    result = rasqal_new_literal_from_literal(l);
+  else {
+    if(b->expr->op == RASQAL_EXPR_SUM || b->expr->op == RASQAL_EXPR_AVG) {
+      result = rasqal_literal_add(b->l, l, &b->error);
+    } else if(b->expr->op == RASQAL_EXPR_MIN) {
+      int cmp = rasqal_literal_compare(b->l, l, 0, &b->error);
+      if(cmp <= 0)
+        result = rasqal_new_literal_from_literal(b->l);
+      else
+        result = rasqal_new_literal_from_literal(l);
+    } else if(b->expr->op == RASQAL_EXPR_MAX) {
+      int cmp = rasqal_literal_compare(b->l, l, 0, &b->error);
+      if(cmp >= 0)
+        result = rasqal_new_literal_from_literal(b->l);
+      else
+        result = rasqal_new_literal_from_literal(l);
+    } else {
+      RASQAL_FATAL2("Builtin aggregation operation %u is not implemented",
+                    b->expr->op);
+    }
+
+    rasqal_free_literal(b->l);
+
+    if(!result)
+      b->error = 1;
+  }
+    
+  b->l = result;
+
+  return result;
+}
+
+
 static int
 rasqal_builtin_agg_expression_execute_step(void* user_data,
                                            raptor_sequence* literals)
@@ -269,8 +420,6 @@ rasqal_builtin_agg_expression_execute_step(void* user_data,
   b->count++;
 
   for(i = 0; (l = (rasqal_literal*)raptor_sequence_get_at(literals, i)); i++) {
-    rasqal_literal* result = NULL;
-
     if(b->expr->op == RASQAL_EXPR_SAMPLE) {
       /* Sample chooses the first literal it sees */
       if(!b->l)
@@ -295,39 +444,11 @@ rasqal_builtin_agg_expression_execute_step(void* user_data,
     }
   
     
-    if(!b->l)
-      result = rasqal_new_literal_from_literal(l);
-    else {
-      if(b->expr->op == RASQAL_EXPR_SUM || b->expr->op == RASQAL_EXPR_AVG) {
-        result = rasqal_literal_add(b->l, l, &b->error);
-      } else if(b->expr->op == RASQAL_EXPR_MIN) {
-        int cmp = rasqal_literal_compare(b->l, l, 0, &b->error);
-        if(cmp <= 0)
-          result = rasqal_new_literal_from_literal(b->l);
-        else
-          result = rasqal_new_literal_from_literal(l);
-      } else if(b->expr->op == RASQAL_EXPR_MAX) {
-        int cmp = rasqal_literal_compare(b->l, l, 0, &b->error);
-        if(cmp >= 0)
-          result = rasqal_new_literal_from_literal(b->l);
-        else
-          result = rasqal_new_literal_from_literal(l);
-      } else {
-        RASQAL_FATAL2("Builtin aggregation operation %u is not implemented",
-                      b->expr->op);
-      }
-
-      rasqal_free_literal(b->l);
-
-      if(!result)
-        b->error = 1;
-    }
-    
-    b->l = result;
+    rasqal_builtin_agg_expression_execute_accumulate(b, l);
 
 #if defined(RASQAL_DEBUG) && RASQAL_DEBUG > 1
     RASQAL_DEBUG3("Aggregation step result %s (error=%d)\n", 
-                  (result ? RASQAL_GOOD_CAST(const char*, rasqal_literal_as_string(result)) : "(NULL)"),
+                  (b->l ? RASQAL_GOOD_CAST(const char*, rasqal_literal_as_string(b->l)) : "(NULL)"),
                   b->error);
 #endif
   }
@@ -407,10 +528,357 @@ rasqal_builtin_agg_expression_execute_result(void* user_data)
 
 
 
+/* initial number of buckets in the group hash table */
+#define RASQAL_AGG_GROUPS_INITIAL_SIZE 64
+
+/* flags used to hash, match and order group keys; the same as used
+ * by the GROUP BY rowsource so group membership is unchanged */
+#define RASQAL_AGG_GROUP_COMPARE_FLAGS RASQAL_COMPARE_URI
+
+
+static void
+rasqal_free_agg_group(rasqal_aggregation_rowsource_context* con,
+                      rasqal_agg_group* group)
+{
+  if(!group)
+    return;
+
+  if(group->states) {
+    int i;
+
+    for(i = 0; i < con->expr_count; i++) {
+      rasqal_agg_group_expr_state* state = &group->states[i];
+
+      if(state->agg_user_data)
+        rasqal_builtin_agg_expression_execute_finish(state->agg_user_data);
+
+      if(state->map)
+        rasqal_free_map(state->map);
+    }
+
+    RASQAL_FREE(rasqal_agg_group_expr_state*, group->states);
+  }
+
+  if(group->literals)
+    raptor_free_sequence(group->literals);
+
+  if(group->row)
+    rasqal_free_row(group->row);
+
+  RASQAL_FREE(rasqal_agg_group, group);
+}
+
+
+/*
+ * rasqal_new_agg_group:
+ * @rowsource: aggregation rowsource
+ * @con: aggregation rowsource context
+ * @literals: group key (or NULL)
+ *
+ * INTERNAL - Create a new group with fresh aggregate state
+ *
+ * @literals becomes owned by the new group and is freed on failure
+ *
+ * Return value: new group or NULL on failure
+ */
+static rasqal_agg_group*
+rasqal_new_agg_group(rasqal_rowsource* rowsource,
+                     rasqal_aggregation_rowsource_context* con,
+                     raptor_sequence* literals)
+{
+  rasqal_agg_group* group;
+  int i;
+
+  group = RASQAL_CALLOC(rasqal_agg_group*, 1, sizeof(*group));
+  if(!group) {
+    if(literals)
+      raptor_free_sequence(literals);
+    return NULL;
+  }
+
+  group->literals = literals;
+
+  group->states = RASQAL_CALLOC(rasqal_agg_group_expr_state*,
+                                RASQAL_GOOD_CAST(size_t, con->expr_count),
+                                sizeof(rasqal_agg_group_expr_state));
+  if(!group->states)
+    goto fail;
+
+  for(i = 0; i < con->expr_count; i++) {
+    rasqal_agg_expr_data* expr_data = &con->expr_data[i];
+    rasqal_agg_group_expr_state* state = &group->states[i];
+
+    state->agg_user_data = rasqal_builtin_agg_expression_execute_init(rowsource->world,
+                                                                      expr_data->expr);
+    if(!state->agg_user_data)
+      goto fail;
+
+    if(expr_data->expr->flags & RASQAL_EXPR_FLAG_DISTINCT) {
+      state->map = rasqal_new_literal_sequence_sort_map(1 /* is_distinct */,
+                                                        0 /* compare_flags */);
+      if(!state->map)
+        goto fail;
+    }
+  }
+
+  return group;
+
+  fail:
+  rasqal_free_agg_group(con, group);
+  return NULL;
+}
+
+
+static unsigned int
+rasqal_agg_group_hash_literals(raptor_sequence* literals)
+{
+  unsigned int hash = 0;
+  rasqal_literal* l;
+  int i;
+
+  for(i = 0; i < raptor_sequence_size(literals); i++) {
+    l = (rasqal_literal*)raptor_sequence_get_at(literals, i);
+    hash = (hash * 31) + rasqal_literal_hash(l, RASQAL_AGG_GROUP_COMPARE_FLAGS);
+  }
+
+  return hash;
+}
+
+
+static int
+rasqal_agg_groups_grow(rasqal_aggregation_rowsource_context* con)
+{
+  rasqal_agg_group** new_groups;
+  int new_size = con->groups_size ? (con->groups_size << 1) :
+                 RASQAL_AGG_GROUPS_INITIAL_SIZE;
+  int i;
+
+  new_groups = RASQAL_CALLOC(rasqal_agg_group**,
+                             RASQAL_GOOD_CAST(size_t, new_size),
+                             sizeof(rasqal_agg_group*));
+  if(!new_groups)
+    return 1;
+
+  for(i = 0; i < con->groups_size; i++) {
+    rasqal_agg_group* group = con->groups[i];
+
+    while(group) {
+      rasqal_agg_group* next = group->next;
+      unsigned int bucket;
+
+      bucket = group->hash & RASQAL_GOOD_CAST(unsigned int, new_size - 1);
+      group->next = new_groups[bucket];
+      new_groups[bucket] = group;
+
+      group = next;
+    }
+  }
+
+  if(con->groups)
+    RASQAL_FREE(rasqal_agg_group**, con->groups);
+
+  con->groups = new_groups;
+  con->groups_size = new_size;
+
+  return 0;
+}
+
+
+/*
+ * rasqal_agg_group_keys_equal:
+ * @a: group key
+ * @b: group key
+ *
+ * INTERNAL - Match two group keys of the same length
+ *
+ * Unlike rasqal_literal_sequence_compare(), a pair of literals that
+ * cannot be compared is not equal, so that a key only ever matches
+ * keys with which its hash is consistent.
+ *
+ * Return value: non-0 if the keys are equal
+ */
+static int
+rasqal_agg_group_keys_equal(raptor_sequence* a, raptor_sequence* b)
+{
+  int size = raptor_sequence_size(a);
+  int i;
+
+  for(i = 0; i < size; i++) {
+    rasqal_literal* literal_a;
+    rasqal_literal* literal_b;
+    int error = 0;
+
+    literal_a = (rasqal_literal*)raptor_sequence_get_at(a, i);
+    literal_b = (rasqal_literal*)raptor_sequence_get_at(b, i);
+
+    if(!literal_a || !literal_b) {
+      if(literal_a != literal_b)
+        return 0;
+      continue;
+    }
+
+    if(rasqal_literal_compare(literal_a, literal_b,
+                              RASQAL_AGG_GROUP_COMPARE_FLAGS, &error) ||
+       error)
+      return 0;
+  }
+
+  return 1;
+}
+
+
+/*
+ * rasqal_agg_groups_find:
+ * @con: aggregation rowsource context
+ * @literals: group key
+ * @hash: hash of @literals from rasqal_agg_group_hash_literals()
+ *
+ * INTERNAL - Find the group for a key
+ *
+ * Keys are hashed with rasqal_literal_hash() and then matched with
+ * rasqal_agg_group_keys_equal() both using
+ * RASQAL_AGG_GROUP_COMPARE_FLAGS.
+ *
+ * Return value: shared pointer to group or NULL if not found
+ */
+static rasqal_agg_group*
+rasqal_agg_groups_find(rasqal_aggregation_rowsource_context* con,
+                       raptor_sequence* literals, unsigned int hash)
+{
+  rasqal_agg_group* group;
+  unsigned int bucket;
+
+  bucket = hash & RASQAL_GOOD_CAST(unsigned int, con->groups_size - 1);
+
+  for(group = con->groups[bucket]; group; group = group->next) {
+    if(group->hash == hash &&
+       rasqal_agg_group_keys_equal(group->literals, literals))
+      return group;
+  }
+
+  return NULL;
+}
+
+
+/*
+ * rasqal_agg_groups_add:
+ * @rowsource: aggregation rowsource
+ * @con: aggregation rowsource context
+ * @literals: group key
+ * @hash: hash of @literals from rasqal_agg_group_hash_literals()
+ *
+ * INTERNAL - Add a new group for a key not yet in the hash table
+ *
+ * @literals becomes owned by this function.
+ *
+ * Return value: shared pointer to new group or NULL on failure
+ */
+static rasqal_agg_group*
+rasqal_agg_groups_add(rasqal_rowsource* rowsource,
+                      rasqal_aggregation_rowsource_context* con,
+                      raptor_sequence* literals, unsigned int hash)
+{
+  rasqal_agg_group* group;
+  unsigned int bucket;
+
+  if(con->groups_count >= con->groups_size) {
+    if(rasqal_agg_groups_grow(con)) {
+      raptor_free_sequence(literals);
+      return NULL;
+    }
+  }
+
+  group = rasqal_new_agg_group(rowsource, con, literals);
+  if(!group)
+    return NULL;
+
+  bucket = hash & RASQAL_GOOD_CAST(unsigned int, con->groups_size - 1);
+  group->hash = hash;
+  group->next = con->groups[bucket];
+  con->groups[bucket] = group;
+  con->groups_count++;
+
+  return group;
+}
+
+
+static int
+rasqal_agg_group_compare(const void *a, const void *b)
+{
+  rasqal_agg_group* group_a = *(rasqal_agg_group**)a;
+  rasqal_agg_group* group_b = *(rasqal_agg_group**)b;
+
+  return rasqal_literal_sequence_compare(RASQAL_AGG_GROUP_COMPARE_FLAGS,
+                                         group_a->literals, group_b->literals);
+}
+
+
+static void
+rasqal_aggregation_rowsource_free_groups(rasqal_aggregation_rowsource_context* con)
+{
+  int i;
+
+  if(con->groups) {
+    for(i = 0; i < con->groups_size; i++) {
+      rasqal_agg_group* group = con->groups[i];
+
+      while(group) {
+        rasqal_agg_group* next = group->next;
+
+        rasqal_free_agg_group(con, group);
+        group = next;
+      }
+    }
+
+    RASQAL_FREE(rasqal_agg_group**, con->groups);
+    con->groups = NULL;
+  }
+
+  if(con->sorted_groups) {
+    for(i = con->sorted_groups_index; i < con->groups_count; i++)
+      rasqal_free_agg_group(con, con->sorted_groups[i]);
+
+    RASQAL_FREE(rasqal_agg_group**, con->sorted_groups);
+    con->sorted_groups = NULL;
+  }
+
+  con->groups_size = 0;
+  con->groups_count = 0;
+  con->sorted_groups_index = 0;
+}
+
+
+static void
+rasqal_aggregation_rowsource_free_runs(rasqal_aggregation_rowsource_context* con)
+{
+  int i;
+
+  if(!con->runs)
+    return;
+
+  for(i = 0; i < con->runs_count; i++) {
+    rasqal_agg_run* run = &con->runs[i];
+
+    if(run->fh)
+      fclose(run->fh);
+    if(run->literals)
+      raptor_free_sequence(run->literals);
+    if(run->row)
+      rasqal_free_row(run->row);
+  }
+
+  RASQAL_FREE(rasqal_agg_run*, con->runs);
+  con->runs = NULL;
+  con->runs_count = 0;
+  con->runs_size = 0;
+}
+
+
 static int
 rasqal_aggregation_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
 {
   rasqal_aggregation_rowsource_context* con;
+  int spill_limit;
 
   con = (rasqal_aggregation_rowsource_context*)user_data;
 
@@ -422,8 +890,14 @@ rasqal_aggregation_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
   con->offset = 0;
   con->step_count = 0;
   
-  if(rasqal_rowsource_request_grouping(con->rowsource))
+  /* input is grouped here when hashing */
+  if(!con->group_exprs_seq &&
+     rasqal_rowsource_request_grouping(con->rowsource))
     return 1;
+
+  spill_limit = rowsource->query->features[RASQAL_GOOD_CAST(int, RASQAL_FEATURE_GROUP_SPILL_LIMIT)];
+  if(spill_limit > 0)
+    con->spill_limit = 1024 * RASQAL_GOOD_CAST(size_t, spill_limit);
   
   return 0;
 }
@@ -474,6 +948,13 @@ rasqal_aggregation_rowsource_finish(rasqal_rowsource* rowsource,
   if(con->input_values)
     raptor_free_sequence(con->input_values);
 
+  rasqal_aggregation_rowsource_free_groups(con);
+
+  rasqal_aggregation_rowsource_free_runs(con);
+
+  if(con->group_exprs_seq)
+    raptor_free_sequence(con->group_exprs_seq);
+
   RASQAL_FREE(rasqal_aggregation_rowsource_context, con);
 
   return 0;
@@ -512,6 +993,69 @@ rasqal_aggregation_rowsource_ensure_variables(rasqal_rowsource* rowsource,
 }
 
 
+/*
+ * rasqal_aggregation_rowsource_step_expr:
+ * @rowsource: aggregation rowsource
+ * @i: expression index (for debugging)
+ * @expr_data: expression data
+ * @agg_user_data: aggregate execution state to step
+ * @map: map for distincting literal values or NULL
+ *
+ * INTERNAL - Evaluate the arguments of one aggregate expression over the currently bound row and run one aggregation step
+ *
+ * Return value: non-0 if the arguments failed to evaluate
+ */
+static int
+rasqal_aggregation_rowsource_step_expr(rasqal_rowsource* rowsource, int i,
+                                       rasqal_agg_expr_data* expr_data,
+                                       void* agg_user_data,
+                                       rasqal_map* map)
+{
+  raptor_sequence* seq;
+  int error = 0;
+
+  /* SPARQL Aggregation uses ListEvalE() to evaluate - ignoring
+   * errors and filtering out expressions that fail
+   */
+  seq = rasqal_expression_sequence_evaluate(rowsource->query,
+                                            expr_data->exprs_seq,
+                                            /* ignore_errors */ 1,
+                                            &error);
+  rowsource->stats.expressions += raptor_sequence_size(expr_data->exprs_seq);
+  if(error)
+    return error;
+
+  if(map) {
+    if(rasqal_literal_sequence_sort_map_add_literal_sequence(map, seq)) {
+      /* duplicate found
+       *
+       * The above function just freed seq so no data is lost
+       */
+      return 0;
+    }
+  }
+
+#ifdef RASQAL_DEBUG
+  RASQAL_DEBUG2("Aggregation expr %d step over literals: ", i);
+  raptor_sequence_print(seq, DEBUG_FH);
+  fputc('\n', DEBUG_FH);
+#endif
+
+  error = rasqal_builtin_agg_expression_execute_step(agg_user_data, seq);
+  /* when DISTINCTing, seq remains owned by the map
+   * otherwise seq is local and must be freed
+   */
+  if(!map)
+    raptor_free_sequence(seq);
+
+  if(error) {
+    RASQAL_DEBUG2("Aggregation expr %d returned error\n", i);
+  }
+
+  return 0;
+}
+
+
 static rasqal_row*
 rasqal_aggregation_rowsource_read_row(rasqal_rowsource* rowsource,
                                       void *user_data)
@@ -636,47 +1180,10 @@ rasqal_aggregation_rowsource_read_row(rasqal_rowsource* rowsource,
       
       for(i = 0; i < con->expr_count; i++) {
         rasqal_agg_expr_data* expr_data = &con->expr_data[i];
-        raptor_sequence* seq;
-        
-        /* SPARQL Aggregation uses ListEvalE() to evaluate - ignoring
-         * errors and filtering out expressions that fail
-         */
-        seq = rasqal_expression_sequence_evaluate(rowsource->query,
-                                                  expr_data->exprs_seq,
-                                                  /* ignore_errors */ 1,
-                                                  &error);
-        if(error)
-          continue;
-
-        if(expr_data->map) {
-          if(rasqal_literal_sequence_sort_map_add_literal_sequence(expr_data->map, 
-                                                                   seq)) {
-            /* duplicate found
-             *
-             * The above function just freed seq so no data is lost
-             */
-            continue;
-          }
-        }
-
-#ifdef RASQAL_DEBUG
-        RASQAL_DEBUG2("Aggregation expr %d step over literals: ", i);
-        raptor_sequence_print(seq, DEBUG_FH);
-        fputc('\n', DEBUG_FH);
-#endif
 
-        error = rasqal_builtin_agg_expression_execute_step(expr_data->agg_user_data,
-                                                           seq);
-        /* when DISTINCTing, seq remains owned by the map
-         * otherwise seq is local and must be freed
-         */
-        if(!expr_data->map)
-          raptor_free_sequence(seq);
-
-        if(error) {
-          RASQAL_DEBUG2("Aggregation expr %d returned error\n", i);
-          error = 0;
-        }
+        error = rasqal_aggregation_rowsource_step_expr(rowsource, i, expr_data,
+                                                       expr_data->agg_user_data,
+                                                       expr_data->map);
       }
     }
 
@@ -760,6 +1267,833 @@ rasqal_aggregation_rowsource_read_row(rasqal_rowsource* rowsource,
 }
 
 
+/* number of temporary files input rows are hash-partitioned into */
+#define RASQAL_AGG_SPILL_PARTITIONS_BITS 4
+#define RASQAL_AGG_SPILL_PARTITIONS (1 << RASQAL_AGG_SPILL_PARTITIONS_BITS)
+
+/* partitioning passes before the memory budget is ignored; each
+ * level uses different hash bits */
+#define RASQAL_AGG_SPILL_MAX_LEVEL 4
+
+/* bits in a group key hash, which is an unsigned int of any size;
+ * partition numbers are taken from the top bits down */
+#define RASQAL_AGG_HASH_BITS (RASQAL_GOOD_CAST(int, sizeof(unsigned int)) * CHAR_BIT)
+
+/* rough size of a #rasqal_builtin_agg_expression_execute and its
+ * allocations used when estimating group memory */
+#define RASQAL_AGG_STATE_SIZE_ESTIMATE 64
+
+/* spill file literal tags */
+#define RASQAL_AGG_SPILL_NULL    0
+#define RASQAL_AGG_SPILL_URI     1
+#define RASQAL_AGG_SPILL_BLANK   2
+#define RASQAL_AGG_SPILL_LITERAL 3
+
+
+static int
+rasqal_agg_spill_write_string(FILE* fh, const unsigned char* str, size_t len)
+{
+  /* (size_t)-1 length marks a NULL string */
+  if(!str)
+    len = RASQAL_GOOD_CAST(size_t, -1);
+
+  if(fwrite(&len, sizeof(len), 1, fh) != 1)
+    return 1;
+
+  if(str && len && fwrite(str, 1, len, fh) != len)
+    return 1;
+
+  return 0;
+}
+
+
+/*
+ * rasqal_agg_spill_read_string:
+ * @fh: file handle
+ * @str_p: pointer to store new string or NULL if NULL was written
+ *
+ * INTERNAL - Read a string written by rasqal_agg_spill_write_string()
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_agg_spill_read_string(FILE* fh, unsigned char** str_p)
+{
+  unsigned char* str;
+  size_t len;
+
+  *str_p = NULL;
+
+  if(fread(&len, sizeof(len), 1, fh) != 1)
+    return 1;
+
+  if(len == RASQAL_GOOD_CAST(size_t, -1))
+    return 0;
+
+  str = RASQAL_MALLOC(unsigned char*, len + 1);
+  if(!str)
+    return 1;
+
+  if(len && fread(str, 1, len, fh) != len) {
+    RASQAL_FREE(char*, str);
+    return 1;
+  }
+  str[len] = '\0';
+
+  *str_p = str;
+  return 0;
+}
+
+
+/*
+ * rasqal_agg_spill_write_literal:
+ * @fh: file handle
+ * @l: literal or NULL
+ *
+ * INTERNAL - Write an RDF term literal to a spill file
+ *
+ * Typed literals are written as lexical form and datatype and are
+ * converted back to the same native type when read.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_agg_spill_write_literal(FILE* fh, rasqal_literal* l)
+{
+  const unsigned char* str;
+  size_t len = 0;
+  raptor_uri* dt;
+  int error = 0;
+
+  if(l)
+    l = rasqal_literal_value(l);
+
+  if(!l)
+    return (fputc(RASQAL_AGG_SPILL_NULL, fh) == EOF);
+
+  switch(rasqal_literal_get_rdf_term_type(l)) {
+    case RASQAL_LITERAL_URI:
+      if(fputc(RASQAL_AGG_SPILL_URI, fh) == EOF)
+        return 1;
+      str = raptor_uri_as_counted_string(l->value.uri, &len);
+      return rasqal_agg_spill_write_string(fh, str, len);
+
+    case RASQAL_LITERAL_BLANK:
+      if(fputc(RASQAL_AGG_SPILL_BLANK, fh) == EOF)
+        return 1;
+      return rasqal_agg_spill_write_string(fh, l->string, l->string_len);
+
+    case RASQAL_LITERAL_STRING:
+      if(fputc(RASQAL_AGG_SPILL_LITERAL, fh) == EOF)
+        return 1;
+      str = rasqal_literal_as_counted_string(l, &len, 0, &error);
+      if(error || rasqal_agg_spill_write_string(fh, str, len))
+        return 1;
+
+      str = RASQAL_GOOD_CAST(const unsigned char*, l->language);
+      if(rasqal_agg_spill_write_string(fh, str,
+                                       str ? strlen(l->language) : 0))
+        return 1;
+
+      dt = rasqal_literal_datatype(l);
+      if(!dt && l->type != RASQAL_LITERAL_STRING)
+        dt = rasqal_xsd_datatype_type_to_uri(l->world, l->type);
+      str = dt ? raptor_uri_as_counted_string(dt, &len) : NULL;
+      return rasqal_agg_spill_write_string(fh, str, len);
+
+    case RASQAL_LITERAL_UNKNOWN:
+    case RASQAL_LITERAL_XSD_STRING:
+    case RASQAL_LITERAL_BOOLEAN:
+    case RASQAL_LITERAL_INTEGER:
+    case RASQAL_LITERAL_FLOAT:
+    case RASQAL_LITERAL_DOUBLE:
+    case RASQAL_LITERAL_DECIMAL:
+    case RASQAL_LITERAL_DATETIME:
+    case RASQAL_LITERAL_UDT:
+    case RASQAL_LITERAL_PATTERN:
+    case RASQAL_LITERAL_QNAME:
+    case RASQAL_LITERAL_VARIABLE:
+    case RASQAL_LITERAL_INTEGER_SUBTYPE:
+    case RASQAL_LITERAL_DATE:
+    default:
+      return 1;
+  }
+}
+
+
+/*
+ * rasqal_agg_spill_read_literal:
+ * @world: world
+ * @fh: file handle
+ * @l_p: pointer to store new literal (may be NULL)
+ *
+ * INTERNAL - Read a literal written by rasqal_agg_spill_write_literal()
+ *
+ * Return value: <0 on failure, >0 at end of file, 0 on success
+ */
+static int
+rasqal_agg_spill_read_literal(rasqal_world* world, FILE* fh,
+                              rasqal_literal** l_p)
+{
+  unsigned char* str = NULL;
+  unsigned char* language = NULL;
+  unsigned char* dt_string = NULL;
+  raptor_uri* dt = NULL;
+  int tag;
+
+  *l_p = NULL;
+
+  tag = fgetc(fh);
+  if(tag == EOF)
+    return ferror(fh) ? -1 : 1;
+
+  if(tag == RASQAL_AGG_SPILL_NULL)
+    return 0;
+
+  if(rasqal_agg_spill_read_string(fh, &str) || !str)
+    goto fail;
+
+  if(tag == RASQAL_AGG_SPILL_URI) {
+    raptor_uri* uri;
+
+    uri = raptor_new_uri(world->raptor_world_ptr, str);
+    RASQAL_FREE(char*, str);
+    if(!uri)
+      return -1;
+
+    *l_p = rasqal_new_uri_literal(world, uri);
+  } else if(tag == RASQAL_AGG_SPILL_BLANK) {
+    *l_p = rasqal_new_simple_literal(world, RASQAL_LITERAL_BLANK, str);
+  } else if(tag == RASQAL_AGG_SPILL_LITERAL) {
+    if(rasqal_agg_spill_read_string(fh, &language) ||
+       rasqal_agg_spill_read_string(fh, &dt_string))
+      goto fail;
+
+    if(dt_string) {
+      dt = raptor_new_uri(world->raptor_world_ptr, dt_string);
+      RASQAL_FREE(char*, dt_string);
+      if(!dt)
+        goto fail;
+    }
+
+    *l_p = rasqal_new_string_literal(world, str,
+                                     RASQAL_GOOD_CAST(const char*, language),
+                                     dt, NULL);
+  } else
+    goto fail;
+
+  return *l_p ? 0 : -1;
+
+  fail:
+  if(str)
+    RASQAL_FREE(char*, str);
+  if(language)
+    RASQAL_FREE(char*, language);
+  return -1;
+}
+
+
+static int
+rasqal_agg_spill_write_literals(FILE* fh, rasqal_literal** values, int size)
+{
+  int i;
+
+  for(i = 0; i < size; i++) {
+    if(rasqal_agg_spill_write_literal(fh, values[i]))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_agg_spill_read_row:
+ * @rowsource: rowsource the new row belongs to
+ * @fh: file handle
+ * @row_p: pointer to store new row
+ *
+ * INTERNAL - Read a row written by rasqal_agg_spill_write_literals()
+ *
+ * Return value: <0 on failure, >0 at end of file, 0 on success
+ */
+static int
+rasqal_agg_spill_read_row(rasqal_rowsource* rowsource, FILE* fh,
+                          rasqal_row** row_p)
+{
+  rasqal_row* row;
+  int i;
+  int rc = 0;
+
+  *row_p = NULL;
+
+  row = rasqal_new_row(rowsource);
+  if(!row)
+    return -1;
+
+  for(i = 0; i < row->size; i++) {
+    rc = rasqal_agg_spill_read_literal(rowsource->world, fh, &row->values[i]);
+    if(rc) {
+      /* end of file is only expected before the first value */
+      if(rc > 0 && i)
+        rc = -1;
+      break;
+    }
+  }
+
+  if(rc) {
+    rasqal_free_row(row);
+    return rc;
+  }
+
+  *row_p = row;
+  return 0;
+}
+
+
+static size_t
+rasqal_agg_group_memory_estimate(rasqal_aggregation_rowsource_context* con,
+                                 rasqal_agg_group* group)
+{
+  size_t size;
+  rasqal_literal* l;
+  int i;
+
+  size = sizeof(rasqal_agg_group) +
+    RASQAL_GOOD_CAST(size_t, con->expr_count) *
+    (sizeof(rasqal_agg_group_expr_state) + RASQAL_AGG_STATE_SIZE_ESTIMATE);
+
+  for(i = 0; (l = (rasqal_literal*)raptor_sequence_get_at(group->literals, i)); i++)
+    size += sizeof(*l) + l->string_len;
+
+  if(group->row) {
+    size += sizeof(rasqal_row) +
+      RASQAL_GOOD_CAST(size_t, group->row->size) * sizeof(rasqal_literal*);
+
+    for(i = 0; i < group->row->size; i++) {
+      l = group->row->values[i];
+      if(l)
+        size += sizeof(*l) + l->string_len;
+    }
+  }
+
+  return size;
+}
+
+
+/*
+ * rasqal_agg_group_to_row:
+ * @rowsource: aggregation rowsource
+ * @con: aggregation rowsource context
+ * @group: group
+ *
+ * INTERNAL - Make the output row for a group from its first row and aggregate results
+ *
+ * Return value: new row or NULL on failure
+ */
+static rasqal_row*
+rasqal_agg_group_to_row(rasqal_rowsource* rowsource,
+                        rasqal_aggregation_rowsource_context* con,
+                        rasqal_agg_group* group)
+{
+  rasqal_row* row;
+  int offset = 0;
+  int i;
+
+  row = rasqal_new_row(rowsource);
+  if(!row)
+    return NULL;
+
+  /* Copy scalar values of the first row of the group through */
+  for(i = 0; i < con->input_values_count; i++) {
+    rasqal_row_set_value_at(row, offset, group->row->values[i]);
+    offset++;
+  }
+
+  /* Set aggregate results */
+  for(i = 0; i < con->expr_count; i++) {
+    rasqal_literal* result;
+
+    result = rasqal_builtin_agg_expression_execute_result(group->states[i].agg_user_data);
+
+    rasqal_row_set_value_at(row, offset, result);
+
+    if(result)
+      rasqal_free_literal(result);
+
+    offset++;
+  }
+
+  return row;
+}
+
+
+/*
+ * rasqal_aggregation_rowsource_sort_groups:
+ * @con: aggregation rowsource context
+ *
+ * INTERNAL - Move groups from the hash table into @sorted_groups in key order
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_aggregation_rowsource_sort_groups(rasqal_aggregation_rowsource_context* con)
+{
+  rasqal_agg_group* group;
+  int i;
+
+  con->sorted_groups = RASQAL_CALLOC(rasqal_agg_group**,
+                                     RASQAL_GOOD_CAST(size_t, con->groups_count + 1),
+                                     sizeof(rasqal_agg_group*));
+  if(!con->sorted_groups)
+    return 1;
+
+  con->sorted_groups_index = 0;
+  for(i = 0; i < con->groups_size; i++) {
+    for(group = con->groups[i]; group; group = group->next)
+      con->sorted_groups[con->sorted_groups_index++] = group;
+  }
+  con->sorted_groups_index = 0;
+
+  RASQAL_FREE(rasqal_agg_group**, con->groups);
+  con->groups = NULL;
+  con->groups_size = 0;
+
+  qsort(con->sorted_groups, RASQAL_GOOD_CAST(size_t, con->groups_count),
+        sizeof(rasqal_agg_group*), rasqal_agg_group_compare);
+
+  return 0;
+}
+
+
+static int
+rasqal_aggregation_rowsource_read_run(rasqal_rowsource* rowsource,
+                                      rasqal_agg_run* run)
+{
+  int count;
+  int i;
+  int rc;
+
+  if(fread(&count, sizeof(count), 1, run->fh) != 1)
+    /* end of run unless the read failed */
+    return (ferror(run->fh) != 0);
+
+  run->literals = raptor_new_sequence((raptor_data_free_handler)rasqal_free_literal,
+                                      (raptor_data_print_handler)rasqal_literal_print);
+  if(!run->literals)
+    return 1;
+
+  for(i = 0; i < count; i++) {
+    rasqal_literal* l;
+
+    if(rasqal_agg_spill_read_literal(rowsource->world, run->fh, &l))
+      return 1;
+    raptor_sequence_push(run->literals, l);
+  }
+
+  rc = rasqal_agg_spill_read_row(rowsource, run->fh, &run->row);
+  return (rc != 0);
+}
+
+
+/*
+ * rasqal_aggregation_rowsource_write_run:
+ * @rowsource: aggregation rowsource
+ * @con: aggregation rowsource context
+ *
+ * INTERNAL - Write the output rows of the sorted groups to a new run and free the groups
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_aggregation_rowsource_write_run(rasqal_rowsource* rowsource,
+                                       rasqal_aggregation_rowsource_context* con)
+{
+  rasqal_agg_run* run;
+  int i;
+
+  if(con->runs_count == con->runs_size) {
+    int new_size = con->runs_size ? (con->runs_size << 1) : 8;
+    rasqal_agg_run* new_runs;
+
+    new_runs = RASQAL_CALLOC(rasqal_agg_run*, RASQAL_GOOD_CAST(size_t, new_size),
+                             sizeof(rasqal_agg_run));
+    if(!new_runs)
+      return 1;
+
+    if(con->runs) {
+      memcpy(new_runs, con->runs,
+             RASQAL_GOOD_CAST(size_t, con->runs_count) * sizeof(rasqal_agg_run));
+      RASQAL_FREE(rasqal_agg_run*, con->runs);
+    }
+    con->runs = new_runs;
+    con->runs_size = new_size;
+  }
+
+  run = &con->runs[con->runs_count];
+  run->fh = tmpfile();
+  if(!run->fh)
+    return 1;
+  con->runs_count++;
+  rowsource->stats.spilled_runs++;
+
+  for(i = 0; i < con->groups_count; i++) {
+    rasqal_agg_group* group = con->sorted_groups[i];
+    rasqal_row* row;
+    int count;
+    int rc;
+
+    row = rasqal_agg_group_to_row(rowsource, con, group);
+    if(!row)
+      return 1;
+
+    count = group->literals ? raptor_sequence_size(group->literals) : 0;
+    rc = (fwrite(&count, sizeof(count), 1, run->fh) != 1);
+    if(!rc && count) {
+      rasqal_literal* l;
+      int j;
+
+      for(j = 0; !rc && (l = (rasqal_literal*)raptor_sequence_get_at(group->literals, j)); j++)
+        rc = rasqal_agg_spill_write_literal(run->fh, l);
+    }
+    if(!rc)
+      rc = rasqal_agg_spill_write_literals(run->fh, row->values, row->size);
+
+    rasqal_free_row(row);
+    if(rc)
+      return 1;
+
+    rasqal_free_agg_group(con, group);
+    con->sorted_groups[i] = NULL;
+  }
+
+  RASQAL_FREE(rasqal_agg_group**, con->sorted_groups);
+  con->sorted_groups = NULL;
+  con->groups_count = 0;
+
+  /* buffered writes may only fail here */
+  if(fflush(run->fh))
+    return 1;
+  rewind(run->fh);
+
+  return rasqal_aggregation_rowsource_read_run(rowsource, run);
+}
+
+
+/*
+ * rasqal_aggregation_rowsource_hash_rows:
+ * @rowsource: aggregation rowsource
+ * @con: aggregation rowsource context
+ * @input_rowsource: rowsource to read or NULL to read @input
+ * @input: spilled input rows to read if @input_rowsource is NULL
+ * @spill_files: array of RASQAL_AGG_SPILL_PARTITIONS partition files or NULL to never spill
+ * @spilling_p: pointer to flag set once over the memory budget
+ * @level: partitioning level (0 for the inner rowsource)
+ *
+ * INTERNAL - Group input rows into the context hash table, running aggregation steps as they arrive
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_aggregation_rowsource_hash_rows(rasqal_rowsource* rowsource,
+                                       rasqal_aggregation_rowsource_context* con,
+                                       rasqal_rowsource* input_rowsource,
+                                       FILE* input, FILE** spill_files,
+                                       int* spilling_p, int level)
+{
+  rasqal_agg_group* group;
+  int i;
+
+  while(1) {
+    rasqal_row* row;
+    raptor_sequence* literal_seq;
+    unsigned int hash;
+
+    if(input_rowsource) {
+      row = rasqal_rowsource_read_row(input_rowsource);
+      if(!row)
+        break;
+    } else {
+      int rc = rasqal_agg_spill_read_row(con->rowsource, input, &row);
+      if(rc < 0)
+        return 1;
+      if(rc > 0)
+        break;
+    }
+
+    rasqal_row_bind_variables(row, rowsource->query->vars_table);
+
+    literal_seq = rasqal_expression_sequence_evaluate(rowsource->query,
+                                                      con->group_exprs_seq,
+                                                      /* ignore_errors */ 0,
+                                                      /* error_p */ NULL);
+    rowsource->stats.expressions += raptor_sequence_size(con->group_exprs_seq);
+    if(!literal_seq) {
+      /* same as GROUP BY rowsource: rows with key errors are skipped */
+      rasqal_free_row(row);
+      continue;
+    }
+
+    hash = rasqal_agg_group_hash_literals(literal_seq);
+    group = rasqal_agg_groups_find(con, literal_seq, hash);
+    if(group)
+      raptor_free_sequence(literal_seq);
+    else if(*spilling_p) {
+      unsigned int p;
+      int rc;
+
+      /* use different hash bits at each level, from the top down */
+      p = (hash >> (RASQAL_AGG_HASH_BITS -
+                    RASQAL_AGG_SPILL_PARTITIONS_BITS * (level + 1))) &
+          (RASQAL_AGG_SPILL_PARTITIONS - 1);
+      raptor_free_sequence(literal_seq);
+
+      if(!spill_files[p])
+        spill_files[p] = tmpfile();
+
+      rc = !spill_files[p] ||
+           rasqal_agg_spill_write_literals(spill_files[p], row->values,
+                                           row->size);
+      rasqal_free_row(row);
+      if(rc)
+        return 1;
+      continue;
+    } else {
+      group = rasqal_agg_groups_add(rowsource, con, literal_seq, hash);
+      if(!group) {
+        rasqal_free_row(row);
+        return 1;
+      }
+    }
+
+    for(i = 0; i < con->expr_count; i++)
+      rasqal_aggregation_rowsource_step_expr(rowsource, i, &con->expr_data[i],
+                                             group->states[i].agg_user_data,
+                                             group->states[i].map);
+
+    if(!group->row) {
+      /* group now owns the row */
+      group->row = row;
+
+      con->groups_memory += rasqal_agg_group_memory_estimate(con, group);
+      if(spill_files && con->spill_limit &&
+         con->groups_memory > con->spill_limit &&
+         level < RASQAL_AGG_SPILL_MAX_LEVEL) {
+        RASQAL_DEBUG3("Aggregation spilling at level %d after %d groups\n",
+                      level, con->groups_count);
+        *spilling_p = 1;
+      }
+    } else
+      rasqal_free_row(row);
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_aggregation_rowsource_aggregate_pass:
+ * @rowsource: aggregation rowsource
+ * @con: aggregation rowsource context
+ * @input: spilled input rows to read or NULL to read the inner rowsource
+ * @level: partitioning level (0 for the inner rowsource)
+ *
+ * INTERNAL - Group input rows by hashing, running aggregation steps as they arrive
+ *
+ * Only the first row of each group is kept.  When there is no input,
+ * one group with no key is made over an empty row as done by the
+ * GROUP BY rowsource.
+ *
+ * If the estimated group state goes over the memory budget, no more
+ * groups are added and rows for other keys are hash-partitioned into
+ * temporary files.  The groups in memory are then written as a
+ * sorted run and each partition is aggregated by another pass.  A
+ * group's rows all go to one partition, in input order, so the
+ * results are the same as aggregating in memory.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_aggregation_rowsource_aggregate_pass(rasqal_rowsource* rowsource,
+                                            rasqal_aggregation_rowsource_context* con,
+                                            FILE* input, int level)
+{
+  FILE* spill_files[RASQAL_AGG_SPILL_PARTITIONS];
+  int spilling = 0;
+  rasqal_agg_group* group;
+  int rc;
+  int i;
+
+  memset(spill_files, '\0', sizeof(spill_files));
+
+  con->groups_memory = 0;
+  if(rasqal_agg_groups_grow(con))
+    return 1;
+
+  rc = rasqal_aggregation_rowsource_hash_rows(rowsource, con,
+                                              input ? NULL : con->rowsource,
+                                              input, spill_files, &spilling,
+                                              level);
+  if(rc)
+    goto failed;
+
+  if(!level && !con->groups_count) {
+    rasqal_row* row;
+
+    /* inner rowsource with no rows - generate 1 group of 1 empty row */
+    row = rasqal_new_row(con->rowsource);
+    if(!row)
+      goto failed;
+
+    group = rasqal_new_agg_group(rowsource, con, NULL);
+    if(!group) {
+      rasqal_free_row(row);
+      goto failed;
+    }
+
+    group->row = row;
+    con->groups[0] = group;
+    con->groups_count = 1;
+
+    rasqal_row_bind_variables(row, rowsource->query->vars_table);
+    for(i = 0; i < con->expr_count; i++)
+      rasqal_aggregation_rowsource_step_expr(rowsource, i, &con->expr_data[i],
+                                             group->states[i].agg_user_data,
+                                             group->states[i].map);
+  }
+
+  if(rasqal_aggregation_rowsource_sort_groups(con))
+    goto failed;
+
+  /* Everything fitted in memory: return rows from the sorted groups */
+  if(!level && !spilling)
+    return 0;
+
+  if(rasqal_aggregation_rowsource_write_run(rowsource, con))
+    goto failed;
+
+  for(i = 0; i < RASQAL_AGG_SPILL_PARTITIONS; i++) {
+    if(!spill_files[i])
+      continue;
+
+    /* buffered writes may only fail here */
+    if(fflush(spill_files[i]))
+      goto failed;
+    rewind(spill_files[i]);
+    rc = rasqal_aggregation_rowsource_aggregate_pass(rowsource, con,
+                                                     spill_files[i], level + 1);
+    fclose(spill_files[i]);
+    spill_files[i] = NULL;
+    if(rc)
+      goto failed;
+  }
+
+  return 0;
+
+  failed:
+  for(i = 0; i < RASQAL_AGG_SPILL_PARTITIONS; i++) {
+    if(spill_files[i])
+      fclose(spill_files[i]);
+  }
+
+  return 1;
+}
+
+
+static void
+rasqal_aggregation_rowsource_bind_results(rasqal_rowsource* rowsource,
+                                          rasqal_aggregation_rowsource_context* con,
+                                          rasqal_row* row)
+{
+  int offset;
+
+  for(offset = con->input_values_count; offset < row->size; offset++) {
+    rasqal_variable* v;
+    rasqal_literal* result = row->values[offset];
+
+    v = rasqal_rowsource_get_variable_by_offset(rowsource, offset);
+    if(result)
+      result = rasqal_new_literal_from_literal(result);
+    /* it is OK to bind to NULL */
+    rasqal_variable_set_value(v, result);
+  }
+}
+
+
+static rasqal_row*
+rasqal_aggregation_rowsource_read_hashed_row(rasqal_rowsource* rowsource,
+                                             void *user_data)
+{
+  rasqal_aggregation_rowsource_context* con;
+  rasqal_row* row = NULL;
+
+  con = (rasqal_aggregation_rowsource_context*)user_data;
+
+  if(con->finished)
+    return NULL;
+
+  if(!con->processed) {
+    con->processed = 1;
+    if(rasqal_aggregation_rowsource_aggregate_pass(rowsource, con, NULL, 0)) {
+      rasqal_execution_state_fail(rowsource->execution, RASQAL_ENGINE_FAILED);
+      con->finished = 1;
+      return NULL;
+    }
+  }
+
+  if(con->runs_count) {
+    rasqal_agg_run* min_run = NULL;
+    int i;
+
+    /* Merge the sorted runs */
+    for(i = 0; i < con->runs_count; i++) {
+      rasqal_agg_run* run = &con->runs[i];
+
+      if(!run->row)
+        continue;
+
+      if(!min_run ||
+         rasqal_literal_sequence_compare(RASQAL_AGG_GROUP_COMPARE_FLAGS,
+                                         run->literals, min_run->literals) < 0)
+        min_run = run;
+    }
+
+    if(min_run) {
+      row = min_run->row;
+      min_run->row = NULL;
+      raptor_free_sequence(min_run->literals);
+      min_run->literals = NULL;
+
+      if(rasqal_aggregation_rowsource_read_run(rowsource, min_run)) {
+        rasqal_execution_state_fail(rowsource->execution,
+                                    RASQAL_ENGINE_FAILED);
+        rasqal_free_row(row);
+        row = NULL;
+      }
+    }
+  } else if(con->sorted_groups_index < con->groups_count) {
+    rasqal_agg_group* group;
+
+    group = con->sorted_groups[con->sorted_groups_index];
+    con->sorted_groups[con->sorted_groups_index++] = NULL;
+
+    row = rasqal_agg_group_to_row(rowsource, con, group);
+    rasqal_free_agg_group(con, group);
+  }
+
+  if(!row) {
+    con->finished = 1;
+    return NULL;
+  }
+
+  rasqal_aggregation_rowsource_bind_results(rowsource, con, row);
+
+  row->offset = con->offset++;
+
+  return row;
+}
+
+
 static rasqal_rowsource*
 rasqal_aggregation_rowsource_get_inner_rowsource(rasqal_rowsource* rowsource,
                                                  void *user_data, int offset)
@@ -786,50 +2120,40 @@ static const rasqal_rowsource_handler rasqal_aggregation_rowsource_handler = {
   /* .set_requirements = */ NULL,
   /* .get_inner_rowsource = */ rasqal_aggregation_rowsource_get_inner_rowsource,
   /* .set_origin = */ NULL,
+  /* .skip_rows = */ NULL,
+  /* .read_batch = */ NULL,
+  /* .estimate_rows = */ NULL
 };
 
 
-/**
- * rasqal_new_aggregation_rowsource:
- * @world: world
- * @query: query
- * @rowsource: input (grouped) rowsource - typically constructed by rasqal_new_groupby_rowsource()
- * @exprs_seq: sequence of #rasqal_expression
- * @vars_seq: sequence of #rasqal_variable to bind in output rows
- *
- * INTERNAL - Create a new rowsource for a aggregration
- *
- * The @rowsource becomes owned by the new rowsource.  The @exprs_seq
- * and @vars_seq are not. 
- *
- * For example with the SPARQL 1.1 example queries
- *
- * SELECT (MAX(?y) AS ?agg) WHERE { ?x ?y ?z } GROUP BY ?x
- * the aggregation part corresponds to
- *   exprs_seq : [ expr MAX with sequence of expression args [?y] }
- *   vars_seq  : [ {internal variable name} ]
- *
- * SELECT (ex:agg(?y, ?z) AS ?agg) WHERE { ?x ?y ?z } GROUP BY ?x
- * the aggregation part corresponds to
- *   exprs_seq : [ expr ex:agg with sequence of expression args [?y, ?z] ]
- *   vars_seq  : [ {internal variable name} ]
- *
- * SELECT ?x, (MIN(?z) AS ?agg) WHERE { ?x ?y ?z } GROUP BY ?x
- * the aggregation part corresponds to
- *   exprs_seq : [ non-aggregate expression ?x,
- *                 expr MIN with sequence of expression args [?z] ]
- *   vars_seq  : [ ?x, {internal variable name} ]
- *
- * Return value: new rowsource or NULL on failure
-*/
+static const rasqal_rowsource_handler rasqal_hash_aggregation_rowsource_handler = {
+  /* .version = */ 1,
+  "hash aggregation",
+  /* .init = */ rasqal_aggregation_rowsource_init,
+  /* .finish = */ rasqal_aggregation_rowsource_finish,
+  /* .ensure_variables = */ rasqal_aggregation_rowsource_ensure_variables,
+  /* .read_row = */ rasqal_aggregation_rowsource_read_hashed_row,
+  /* .read_all_rows = */ NULL,
+  /* .reset = */ NULL,
+  /* .set_requirements = */ NULL,
+  /* .get_inner_rowsource = */ rasqal_aggregation_rowsource_get_inner_rowsource,
+  /* .set_origin = */ NULL,
+  /* .skip_rows = */ NULL,
+  /* .read_batch = */ NULL,
+  /* .estimate_rows = */ NULL
+};
 
-rasqal_rowsource*
-rasqal_new_aggregation_rowsource(rasqal_world *world, rasqal_query* query,
-                                 rasqal_rowsource* rowsource,
-                                 raptor_sequence* exprs_seq,
-                                 raptor_sequence* vars_seq)
+
+static rasqal_rowsource*
+rasqal_new_aggregation_rowsource_common(rasqal_world *world,
+                                        rasqal_query* query,
+                                        rasqal_rowsource* rowsource,
+                                        raptor_sequence* group_exprs_seq,
+                                        raptor_sequence* exprs_seq,
+                                        raptor_sequence* vars_seq)
 {
   rasqal_aggregation_rowsource_context* con = NULL;
+  const rasqal_rowsource_handler* handler;
   int flags = 0;
   int size;
   int i;
@@ -855,6 +2179,14 @@ rasqal_new_aggregation_rowsource(rasqal_world *world, rasqal_query* query,
 
   con->exprs_seq = exprs_seq;
   con->vars_seq = vars_seq;
+
+  if(group_exprs_seq) {
+    con->group_exprs_seq = rasqal_expression_copy_expression_sequence(group_exprs_seq);
+    if(!con->group_exprs_seq)
+      goto fail;
+    handler = &rasqal_hash_aggregation_rowsource_handler;
+  } else
+    handler = &rasqal_aggregation_rowsource_handler;
   
   /* allocate per-expr data */
   con->expr_count = size;
@@ -891,7 +2223,7 @@ rasqal_new_aggregation_rowsource(rasqal_world *world, rasqal_query* query,
   
   return rasqal_new_rowsource_from_handler(world, query,
                                            con,
-                                           &rasqal_aggregation_rowsource_handler,
+                                           handler,
                                            query->vars_table,
                                            flags);
 
@@ -909,6 +2241,125 @@ rasqal_new_aggregation_rowsource(rasqal_world *world, rasqal_query* query,
   return NULL;
 }
 
+
+/**
+ * rasqal_new_aggregation_rowsource:
+ * @world: world
+ * @query: query
+ * @rowsource: input (grouped) rowsource - typically constructed by rasqal_new_groupby_rowsource()
+ * @exprs_seq: sequence of #rasqal_expression
+ * @vars_seq: sequence of #rasqal_variable to bind in output rows
+ *
+ * INTERNAL - Create a new rowsource for a aggregration
+ *
+ * The @rowsource becomes owned by the new rowsource.  The @exprs_seq
+ * and @vars_seq are not. 
+ *
+ * For example with the SPARQL 1.1 example queries
+ *
+ * SELECT (MAX(?y) AS ?agg) WHERE { ?x ?y ?z } GROUP BY ?x
+ * the aggregation part corresponds to
+ *   exprs_seq : [ expr MAX with sequence of expression args [?y] }
+ *   vars_seq  : [ {internal variable name} ]
+ *
+ * SELECT (ex:agg(?y, ?z) AS ?agg) WHERE { ?x ?y ?z } GROUP BY ?x
+ * the aggregation part corresponds to
+ *   exprs_seq : [ expr ex:agg with sequence of expression args [?y, ?z] ]
+ *   vars_seq  : [ {internal variable name} ]
+ *
+ * SELECT ?x, (MIN(?z) AS ?agg) WHERE { ?x ?y ?z } GROUP BY ?x
+ * the aggregation part corresponds to
+ *   exprs_seq : [ non-aggregate expression ?x,
+ *                 expr MIN with sequence of expression args [?z] ]
+ *   vars_seq  : [ ?x, {internal variable name} ]
+ *
+ * Return value: new rowsource or NULL on failure
+*/
+
+rasqal_rowsource*
+rasqal_new_aggregation_rowsource(rasqal_world *world, rasqal_query* query,
+                                 rasqal_rowsource* rowsource,
+                                 raptor_sequence* exprs_seq,
+                                 raptor_sequence* vars_seq)
+{
+  return rasqal_new_aggregation_rowsource_common(world, query, rowsource,
+                                                 NULL, exprs_seq, vars_seq);
+}
+
+
+/**
+ * rasqal_new_hash_aggregation_rowsource:
+ * @world: world
+ * @query: query
+ * @rowsource: input (ungrouped) rowsource
+ * @group_exprs_seq: sequence of GROUP BY #rasqal_expression
+ * @exprs_seq: sequence of #rasqal_expression
+ * @vars_seq: sequence of #rasqal_variable to bind in output rows
+ *
+ * INTERNAL - Create a new rowsource for a GROUP BY and aggregation by hashing
+ *
+ * Equivalent to rasqal_new_aggregation_rowsource() over
+ * rasqal_new_groupby_rowsource() but the input rows are not buffered;
+ * each group keeps only its first row and running aggregate state.
+ * The aggregate expressions must pass
+ * rasqal_aggregation_expressions_can_hash().  All input rows are
+ * aggregated by this rowsource; there is no operation to combine the
+ * aggregate states of separately aggregated parts of the input.
+ *
+ * The @rowsource becomes owned by the new rowsource.  The
+ * @group_exprs_seq, @exprs_seq and @vars_seq are not.
+ *
+ * Return value: new rowsource or NULL on failure
+ */
+rasqal_rowsource*
+rasqal_new_hash_aggregation_rowsource(rasqal_world *world, rasqal_query* query,
+                                      rasqal_rowsource* rowsource,
+                                      raptor_sequence* group_exprs_seq,
+                                      raptor_sequence* exprs_seq,
+                                      raptor_sequence* vars_seq)
+{
+  if(!group_exprs_seq || !raptor_sequence_size(group_exprs_seq)) {
+    if(rowsource)
+      rasqal_free_rowsource(rowsource);
+    return NULL;
+  }
+
+  return rasqal_new_aggregation_rowsource_common(world, query, rowsource,
+                                                 group_exprs_seq,
+                                                 exprs_seq, vars_seq);
+}
+
+
+/**
+ * rasqal_aggregation_expressions_can_hash:
+ * @exprs_seq: sequence of aggregate #rasqal_expression
+ *
+ * INTERNAL - Check if aggregate expressions can be executed incrementally per group by rasqal_new_hash_aggregation_rowsource()
+ *
+ * Return value: non-0 if all expressions are built-in aggregates
+ */
+int
+rasqal_aggregation_expressions_can_hash(raptor_sequence* exprs_seq)
+{
+  rasqal_expression* expr;
+  int i;
+
+  if(!exprs_seq)
+    return 0;
+
+  for(i = 0; (expr = (rasqal_expression*)raptor_sequence_get_at(exprs_seq, i)); i++) {
+    if(expr->op != RASQAL_EXPR_COUNT &&
+       expr->op != RASQAL_EXPR_SUM &&
+       expr->op != RASQAL_EXPR_AVG &&
+       expr->op != RASQAL_EXPR_MIN &&
+       expr->op != RASQAL_EXPR_MAX &&
+       expr->op != RASQAL_EXPR_SAMPLE &&
+       expr->op != RASQAL_EXPR_GROUP_CONCAT)
+      return 0;
+  }
+
+  return 1;
+}
 #endif /* not STANDALONE */
 
 
@@ -1070,6 +2521,477 @@ make_test_expr(rasqal_world* world,
 }
 
 
+#define SPILL_TEST_ROWS 500
+#define SPILL_TEST_GROUPS 50
+
+/*
+ * Make a rowsource over rows @start to @end - 1 of the spill test data
+ */
+static rasqal_rowsource*
+spill_test_input(rasqal_world* world, rasqal_query* query, int start, int end)
+{
+  static char cells[SPILL_TEST_ROWS][2][8];
+  const char* data[(SPILL_TEST_ROWS + 2) * 4];
+  rasqal_variables_table* vt = query->vars_table;
+  raptor_sequence* row_seq;
+  raptor_sequence* vars_seq = NULL;
+  int i;
+
+  memset(data, '\0', sizeof(data));
+  data[0] = "x";
+  data[2] = "y";
+  for(i = start; i < end; i++) {
+    int r = i - start + 1;
+
+    /* spread the groups through the input */
+    sprintf(cells[i][0], "%d", (i * 7) % SPILL_TEST_GROUPS);
+    sprintf(cells[i][1], "%d", i);
+    data[r * 4] = cells[i][0];
+    data[r * 4 + 2] = cells[i][1];
+  }
+
+  row_seq = rasqal_new_row_sequence(world, vt, data, 2, &vars_seq);
+  if(!row_seq)
+    return NULL;
+
+  return rasqal_new_rowsequence_rowsource(world, query, vt, row_seq, vars_seq);
+}
+
+
+/*
+ * Run SELECT ?x (SUM(?y) AS ?fake) ... GROUP BY ?x over SPILL_TEST_ROWS
+ * rows by hash aggregation with a GROUP BY memory budget of
+ * @spill_limit KB and return the result rows.  The number of sorted
+ * runs spilled is stored in *@runs_count_p.
+ */
+static raptor_sequence*
+spill_test_run(rasqal_world* world, rasqal_query* query, int spill_limit,
+               int* runs_count_p)
+{
+  rasqal_variables_table* vt = query->vars_table;
+  raptor_sequence* vars_seq = NULL;
+  raptor_sequence* group_exprs_seq = NULL;
+  raptor_sequence* exprs_seq = NULL;
+  raptor_sequence* expr_args_seq = NULL;
+  raptor_sequence* seq = NULL;
+  rasqal_rowsource* input_rs = NULL;
+  rasqal_rowsource* rowsource = NULL;
+  rasqal_variable* v;
+  rasqal_expression* e;
+
+  input_rs = spill_test_input(world, query, 0, SPILL_TEST_ROWS);
+  if(!input_rs)
+    goto tidy;
+
+  group_exprs_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                                        (raptor_data_print_handler)rasqal_expression_print);
+  expr_args_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                                      (raptor_data_print_handler)rasqal_expression_print);
+  exprs_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                                  (raptor_data_print_handler)rasqal_expression_print);
+  vars_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_variable,
+                                 (raptor_data_print_handler)rasqal_variable_print);
+  if(!group_exprs_seq || !expr_args_seq || !exprs_seq || !vars_seq)
+    goto tidy;
+
+  v = rasqal_variables_table_get_by_name(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                         RASQAL_GOOD_CAST(const unsigned char*, "x"));
+  v = rasqal_new_variable_from_variable(v);
+  raptor_sequence_push(group_exprs_seq,
+                       rasqal_new_literal_expression(world,
+                                                     rasqal_new_variable_literal(world, v)));
+
+  v = rasqal_variables_table_get_by_name(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                         RASQAL_GOOD_CAST(const unsigned char*, "y"));
+  v = rasqal_new_variable_from_variable(v);
+  raptor_sequence_push(expr_args_seq,
+                       rasqal_new_literal_expression(world,
+                                                     rasqal_new_variable_literal(world, v)));
+  e = make_test_expr(world, expr_args_seq, RASQAL_EXPR_SUM);
+  expr_args_seq = NULL;
+  if(!e)
+    goto tidy;
+  raptor_sequence_push(exprs_seq, e);
+
+  raptor_sequence_push(vars_seq,
+                       rasqal_variables_table_add2(vt, RASQAL_VARIABLE_TYPE_ANONYMOUS,
+                                                   RASQAL_GOOD_CAST(const unsigned char*, "fake"),
+                                                   4, NULL));
+
+  rasqal_query_set_feature(query, RASQAL_FEATURE_GROUP_SPILL_LIMIT,
+                           spill_limit);
+
+  rowsource = rasqal_new_hash_aggregation_rowsource(world, query, input_rs,
+                                                    group_exprs_seq,
+                                                    exprs_seq, vars_seq);
+  input_rs = NULL;
+  if(rowsource) {
+    seq = rasqal_rowsource_read_all_rows(rowsource);
+    *runs_count_p = rowsource->stats.spilled_runs;
+  }
+
+  rasqal_query_set_feature(query, RASQAL_FEATURE_GROUP_SPILL_LIMIT, 0);
+
+  tidy:
+  if(rowsource)
+    rasqal_free_rowsource(rowsource);
+  if(input_rs)
+    rasqal_free_rowsource(input_rs);
+  if(vars_seq)
+    raptor_free_sequence(vars_seq);
+  if(exprs_seq)
+    raptor_free_sequence(exprs_seq);
+  if(expr_args_seq)
+    raptor_free_sequence(expr_args_seq);
+  if(group_exprs_seq)
+    raptor_free_sequence(group_exprs_seq);
+
+  return seq;
+}
+
+
+/*
+ * Check that hash aggregation with a GROUP BY memory budget of
+ * @spill_limit KB returns the same rows as aggregating in memory.
+ */
+static int
+spill_test(rasqal_world* world, rasqal_query* query, const char* program,
+           int spill_limit)
+{
+  raptor_sequence* memory_seq;
+  raptor_sequence* spill_seq;
+  int memory_runs = 0;
+  int spill_runs = 0;
+  int failures = 0;
+  int i;
+
+  memory_seq = spill_test_run(world, query, 0, &memory_runs);
+  spill_seq = spill_test_run(world, query, spill_limit, &spill_runs);
+
+  if(!memory_seq || !spill_seq) {
+    fprintf(stderr, "%s: spill test (limit %d) failed to aggregate\n",
+            program, spill_limit);
+    failures++;
+    goto tidy;
+  }
+
+  /* a budget must have made the groups spill to disk */
+  if(memory_runs || (spill_limit && !spill_runs)) {
+    fprintf(stderr, "%s: spill test (limit %d) spilled %d and %d runs\n",
+            program, spill_limit, memory_runs, spill_runs);
+    failures++;
+    goto tidy;
+  }
+
+  if(raptor_sequence_size(memory_seq) != SPILL_TEST_GROUPS ||
+     raptor_sequence_size(spill_seq) != SPILL_TEST_GROUPS) {
+    fprintf(stderr, "%s: spill test (limit %d) returned %d and %d rows, expected %d\n",
+            program, spill_limit,
+            raptor_sequence_size(memory_seq),
+            raptor_sequence_size(spill_seq), SPILL_TEST_GROUPS);
+    failures++;
+    goto tidy;
+  }
+
+  for(i = 0; i < SPILL_TEST_GROUPS; i++) {
+    rasqal_row* row1 = (rasqal_row*)raptor_sequence_get_at(memory_seq, i);
+    rasqal_row* row2 = (rasqal_row*)raptor_sequence_get_at(spill_seq, i);
+    int j;
+
+    for(j = 0; j < row1->size; j++) {
+      if(!rasqal_literal_equals(row1->values[j], row2->values[j])) {
+        fprintf(stderr, "%s: spill test (limit %d) row #%d value #%d differs\n",
+                program, spill_limit, i, j);
+        failures++;
+        goto tidy;
+      }
+    }
+  }
+
+  tidy:
+  if(memory_seq)
+    raptor_free_sequence(memory_seq);
+  if(spill_seq)
+    raptor_free_sequence(spill_seq);
+
+  return failures;
+}
+
+
+
+#define MIXED_KEY_TEST_ROWS 8
+#define MIXED_KEY_TEST_GROUPS 3
+
+/* Group keys of mixed types that are equal with RDQL promotion */
+static const struct {
+  const char* string;
+  rasqal_literal_type type;
+} mixed_key_test_data[2][MIXED_KEY_TEST_ROWS] = {
+  /* integers and plain literals of the same numbers */
+  {
+    { "1", RASQAL_LITERAL_INTEGER }, { "2", RASQAL_LITERAL_STRING },
+    { "1", RASQAL_LITERAL_STRING }, { "3", RASQAL_LITERAL_INTEGER },
+    { "2", RASQAL_LITERAL_INTEGER }, { "1", RASQAL_LITERAL_INTEGER },
+    { "3", RASQAL_LITERAL_STRING }, { "2", RASQAL_LITERAL_STRING }
+  },
+  /* plain and xsd:string literals */
+  {
+    { "abc", RASQAL_LITERAL_STRING }, { "def", RASQAL_LITERAL_XSD_STRING },
+    { "abc", RASQAL_LITERAL_XSD_STRING }, { "ghi", RASQAL_LITERAL_STRING },
+    { "def", RASQAL_LITERAL_STRING }, { "abc", RASQAL_LITERAL_STRING },
+    { "ghi", RASQAL_LITERAL_XSD_STRING }, { "def", RASQAL_LITERAL_XSD_STRING }
+  }
+};
+
+/* SUM(?y) GROUP BY ?x result for both key sets */
+static const int mixed_key_test_sums[MIXED_KEY_TEST_GROUPS] = { 3, 3, 2 };
+
+
+static rasqal_literal*
+mixed_key_test_literal(rasqal_world* world, const char* string,
+                       rasqal_literal_type type)
+{
+  size_t len = strlen(string);
+  unsigned char* val;
+  raptor_uri* dt_uri = NULL;
+
+  if(type == RASQAL_LITERAL_INTEGER)
+    return rasqal_new_integer_literal(world, type, atoi(string));
+
+  val = RASQAL_MALLOC(unsigned char*, len + 1);
+  if(!val)
+    return NULL;
+  memcpy(val, string, len + 1);
+
+  if(type == RASQAL_LITERAL_XSD_STRING)
+    dt_uri = raptor_uri_copy(rasqal_xsd_datatype_type_to_uri(world, type));
+
+  return rasqal_new_string_literal(world, val, NULL, dt_uri, NULL);
+}
+
+
+/*
+ * Make a rowsource with ?x bound to the keys of mixed key test @set
+ * and ?y bound to 1
+ */
+static rasqal_rowsource*
+mixed_key_test_input(rasqal_world* world, rasqal_query* query, int set)
+{
+  rasqal_variables_table* vt = query->vars_table;
+  raptor_sequence* row_seq;
+  raptor_sequence* vars_seq;
+  rasqal_literal* one;
+  int i;
+
+  row_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_row,
+                                (raptor_data_print_handler)rasqal_row_print);
+  vars_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_variable,
+                                 (raptor_data_print_handler)rasqal_variable_print);
+  one = rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER, 1);
+  if(!row_seq || !vars_seq || !one)
+    goto fail;
+
+  raptor_sequence_push(vars_seq,
+                       rasqal_variables_table_add2(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                                   RASQAL_GOOD_CAST(const unsigned char*, "x"),
+                                                   1, NULL));
+  raptor_sequence_push(vars_seq,
+                       rasqal_variables_table_add2(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                                   RASQAL_GOOD_CAST(const unsigned char*, "y"),
+                                                   1, NULL));
+
+  for(i = 0; i < MIXED_KEY_TEST_ROWS; i++) {
+    rasqal_row* row;
+    rasqal_literal* key;
+
+    key = mixed_key_test_literal(world, mixed_key_test_data[set][i].string,
+                                 mixed_key_test_data[set][i].type);
+    row = rasqal_new_row_for_size(world, 2);
+    if(!key || !row) {
+      if(key)
+        rasqal_free_literal(key);
+      if(row)
+        rasqal_free_row(row);
+      goto fail;
+    }
+
+    rasqal_row_set_value_at(row, 0, key);
+    rasqal_row_set_value_at(row, 1, one);
+    rasqal_free_literal(key);
+    raptor_sequence_push(row_seq, row);
+  }
+
+  rasqal_free_literal(one);
+
+  return rasqal_new_rowsequence_rowsource(world, query, vt, row_seq, vars_seq);
+
+  fail:
+  if(one)
+    rasqal_free_literal(one);
+  if(vars_seq)
+    raptor_free_sequence(vars_seq);
+  if(row_seq)
+    raptor_free_sequence(row_seq);
+
+  return NULL;
+}
+
+
+/*
+ * Run SELECT (SUM(?y) AS ?fake) ... GROUP BY ?x over mixed key test
+ * @set either by hash aggregation or with a GROUP BY rowsource and
+ * return the result rows.
+ */
+static raptor_sequence*
+mixed_key_test_run(rasqal_world* world, rasqal_query* query, int set,
+                   int hashed)
+{
+  rasqal_variables_table* vt = query->vars_table;
+  raptor_sequence* vars_seq = NULL;
+  raptor_sequence* group_exprs_seq = NULL;
+  raptor_sequence* exprs_seq = NULL;
+  raptor_sequence* expr_args_seq = NULL;
+  raptor_sequence* seq = NULL;
+  rasqal_rowsource* input_rs;
+  rasqal_rowsource* rowsource = NULL;
+  rasqal_variable* v;
+  rasqal_expression* e;
+
+  input_rs = mixed_key_test_input(world, query, set);
+  if(!input_rs)
+    return NULL;
+
+  group_exprs_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                                        (raptor_data_print_handler)rasqal_expression_print);
+  expr_args_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                                      (raptor_data_print_handler)rasqal_expression_print);
+  exprs_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                                  (raptor_data_print_handler)rasqal_expression_print);
+  vars_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_variable,
+                                 (raptor_data_print_handler)rasqal_variable_print);
+  if(!group_exprs_seq || !expr_args_seq || !exprs_seq || !vars_seq)
+    goto tidy;
+
+  v = rasqal_variables_table_get_by_name(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                         RASQAL_GOOD_CAST(const unsigned char*, "x"));
+  v = rasqal_new_variable_from_variable(v);
+  raptor_sequence_push(group_exprs_seq,
+                       rasqal_new_literal_expression(world,
+                                                     rasqal_new_variable_literal(world, v)));
+
+  v = rasqal_variables_table_get_by_name(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                         RASQAL_GOOD_CAST(const unsigned char*, "y"));
+  v = rasqal_new_variable_from_variable(v);
+  raptor_sequence_push(expr_args_seq,
+                       rasqal_new_literal_expression(world,
+                                                     rasqal_new_variable_literal(world, v)));
+  e = make_test_expr(world, expr_args_seq, RASQAL_EXPR_SUM);
+  expr_args_seq = NULL;
+  if(!e)
+    goto tidy;
+  raptor_sequence_push(exprs_seq, e);
+
+  raptor_sequence_push(vars_seq,
+                       rasqal_variables_table_add2(vt, RASQAL_VARIABLE_TYPE_ANONYMOUS,
+                                                   RASQAL_GOOD_CAST(const unsigned char*, "fake"),
+                                                   4, NULL));
+
+  if(hashed)
+    rowsource = rasqal_new_hash_aggregation_rowsource(world, query, input_rs,
+                                                      group_exprs_seq,
+                                                      exprs_seq, vars_seq);
+  else {
+    input_rs = rasqal_new_groupby_rowsource(world, query, input_rs,
+                                            group_exprs_seq);
+    if(input_rs)
+      rowsource = rasqal_new_aggregation_rowsource(world, query, input_rs,
+                                                   exprs_seq, vars_seq);
+  }
+  input_rs = NULL;
+
+  if(rowsource)
+    seq = rasqal_rowsource_read_all_rows(rowsource);
+
+  tidy:
+  if(rowsource)
+    rasqal_free_rowsource(rowsource);
+  if(input_rs)
+    rasqal_free_rowsource(input_rs);
+  if(vars_seq)
+    raptor_free_sequence(vars_seq);
+  if(exprs_seq)
+    raptor_free_sequence(exprs_seq);
+  if(expr_args_seq)
+    raptor_free_sequence(expr_args_seq);
+  if(group_exprs_seq)
+    raptor_free_sequence(group_exprs_seq);
+
+  return seq;
+}
+
+
+/*
+ * Check that hash aggregation groups keys of mixed types the same
+ * way as the GROUP BY rowsource.
+ */
+static int
+mixed_key_test(rasqal_world* world, rasqal_query* query, const char* program)
+{
+  int failures = 0;
+  int set;
+
+  for(set = 0; set < 2; set++) {
+    raptor_sequence* groupby_seq;
+    raptor_sequence* hash_seq;
+    int i;
+
+    groupby_seq = mixed_key_test_run(world, query, set, 0);
+    hash_seq = mixed_key_test_run(world, query, set, 1);
+
+    if(!groupby_seq || !hash_seq) {
+      fprintf(stderr, "%s: mixed key test %d failed to aggregate\n",
+              program, set);
+      failures++;
+      goto tidy;
+    }
+
+    if(raptor_sequence_size(groupby_seq) != MIXED_KEY_TEST_GROUPS ||
+       raptor_sequence_size(hash_seq) != MIXED_KEY_TEST_GROUPS) {
+      fprintf(stderr, "%s: mixed key test %d returned %d groups by GROUP BY and %d by hashing, expected %d\n",
+              program, set, raptor_sequence_size(groupby_seq),
+              raptor_sequence_size(hash_seq), MIXED_KEY_TEST_GROUPS);
+      failures++;
+      goto tidy;
+    }
+
+    for(i = 0; i < MIXED_KEY_TEST_GROUPS; i++) {
+      rasqal_row* row1 = (rasqal_row*)raptor_sequence_get_at(groupby_seq, i);
+      rasqal_row* row2 = (rasqal_row*)raptor_sequence_get_at(hash_seq, i);
+      rasqal_literal* sum1 = row1->values[row1->size - 1];
+      rasqal_literal* sum2 = row2->values[row2->size - 1];
+
+      if(!sum1 || !sum2 ||
+         rasqal_literal_as_integer(sum1, NULL) != mixed_key_test_sums[i] ||
+         rasqal_literal_as_integer(sum2, NULL) != mixed_key_test_sums[i] ||
+         rasqal_literal_compare(row1->values[0], row2->values[0],
+                                RASQAL_COMPARE_URI, NULL)) {
+        fprintf(stderr, "%s: mixed key test %d group #%d differs between GROUP BY and hashing\n",
+                program, set, i);
+        failures++;
+        goto tidy;
+      }
+    }
+
+    tidy:
+    if(groupby_seq)
+      raptor_free_sequence(groupby_seq);
+    if(hash_seq)
+      raptor_free_sequence(hash_seq);
+  }
+
+  return failures;
+}
+
 int
 main(int argc, char *argv[]) 
 {
@@ -1084,6 +3006,8 @@ main(int argc, char *argv[])
   rasqal_rowsource *input_rs = NULL;
   raptor_sequence* vars_seq = NULL;
   raptor_sequence* exprs_seq = NULL;
+  raptor_sequence* group_exprs_seq = NULL;
+  int test_index;
   int test_id;
 
   world = rasqal_new_world();
@@ -1096,7 +3020,11 @@ main(int argc, char *argv[])
 
   vt = query->vars_table;
   
-  for(test_id = 0; test_id < AGGREGATION_TESTS_COUNT; test_id++) {
+  /* Run every test over grouped input and then by hash aggregation */
+  for(test_index = 0, test_id = 0;
+      test_index < 2 * AGGREGATION_TESTS_COUNT;
+      test_index++, test_id = test_index % AGGREGATION_TESTS_COUNT) {
+    int hashed = (test_index >= AGGREGATION_TESTS_COUNT);
     int input_vars_count = test_data[test_id].input_vars;
     int output_rows_count = test_data[test_id].output_rows;
     int output_vars_count = test_data[test_id].output_vars;
@@ -1127,7 +3055,8 @@ main(int argc, char *argv[])
     row_seq = rasqal_new_row_sequence(world, vt, test_data[test_id].data,
                                       test_data[test_id].input_vars, &vars_seq);
     if(row_seq) {
-      for(i = 0; i < test_data[test_id].input_rows; i++) {
+      /* hash aggregation groups the input itself */
+      for(i = 0; !hashed && i < test_data[test_id].input_rows; i++) {
         rasqal_row* row = (rasqal_row*)raptor_sequence_get_at(row_seq, i);
         row->group_id = input_group_ids[i];
       }
@@ -1200,8 +3129,39 @@ main(int argc, char *argv[])
     /* output_var is now owned by vars_seq */
     output_var = NULL;
 
-    rowsource = rasqal_new_aggregation_rowsource(world, query, input_rs,
-                                                 exprs_seq, vars_seq);
+    if(hashed) {
+      rasqal_variable* v;
+      rasqal_literal* l = NULL;
+      rasqal_expression* e = NULL;
+
+      /* all tests group by ?x */
+      v = rasqal_variables_table_get_by_name(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                             RASQAL_GOOD_CAST(const unsigned char*, "x"));
+      if(v) {
+        v = rasqal_new_variable_from_variable(v);
+        l = rasqal_new_variable_literal(world, v);
+      }
+      if(l)
+        e = rasqal_new_literal_expression(world, l);
+
+      group_exprs_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                                            (raptor_data_print_handler)rasqal_expression_print);
+      if(!e || !group_exprs_seq) {
+        fprintf(stderr, "%s: failed to create group by expression\n", program);
+        if(e)
+          rasqal_free_expression(e);
+        failures++;
+        goto tidy;
+      }
+      raptor_sequence_push(group_exprs_seq, e);
+
+      rowsource = rasqal_new_hash_aggregation_rowsource(world, query, input_rs,
+                                                        group_exprs_seq,
+                                                        exprs_seq, vars_seq);
+      raptor_free_sequence(group_exprs_seq); group_exprs_seq = NULL;
+    } else
+      rowsource = rasqal_new_aggregation_rowsource(world, query, input_rs,
+                                                   exprs_seq, vars_seq);
     /* input_rs is now owned by rowsource */
     input_rs = NULL;
     /* these are no longer needed; agg rowsource made copies */
@@ -1390,9 +3350,17 @@ main(int argc, char *argv[])
       raptor_free_sequence(expr_args_seq);
     expr_args_seq = NULL;
   }
+
+  /* spilling to disk with a few groups or only one in memory */
+  failures += spill_test(world, query, program, 4);
+  failures += spill_test(world, query, program, 1);
+  /* keys equal only with type promotion */
+  failures += mixed_key_test(world, query, program);
   
   
   tidy:
+  if(group_exprs_seq)
+    raptor_free_sequence(group_exprs_seq);
   if(exprs_seq)
     raptor_free_sequence(exprs_seq);
   if(vars_seq)
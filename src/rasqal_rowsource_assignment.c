@@ -111,6 +111,7 @@ rasqal_assignment_rowsource_read_row(rasqal_rowsource* rowsource, void *user_dat
   RASQAL_DEBUG1("evaluating assignment expression\n");
   result = rasqal_expression_evaluate2(con->expr, query->eval_context,
                                        &error);
+  rowsource->stats.expressions++;
 #ifdef RASQAL_DEBUG
   RASQAL_DEBUG2("assignment %s expression result: ", con->var->name);
   if(error)
@@ -122,7 +123,8 @@ rasqal_assignment_rowsource_read_row(rasqal_rowsource* rowsource, void *user_dat
 
   if(!error) {
     rasqal_variable_set_value(con->var, result);
-    row = rasqal_new_row_for_size(rowsource->world, rowsource->size);
+    row = rasqal_new_row_for_query(rowsource->world, rowsource->query,
+                                   rowsource->size);
     if(row) {
       rasqal_row_set_rowsource(row, rowsource);
       row->offset = con->offset++;
@@ -166,6 +168,9 @@ static const rasqal_rowsource_handler rasqal_assignment_rowsource_handler = {
   /* .set_requirements = */ NULL,
   /* .get_inner_rowsource = */ rasqal_assignment_rowsource_get_inner_rowsource,
   /* .set_origin =       */ NULL,
+  /* .skip_rows =        */ NULL,
+  /* .read_batch =       */ NULL,
+  /* .estimate_rows =    */ NULL
 };
 
 
@@ -138,8 +138,23 @@ rasqal_bindings_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
 }
 
 
+static long
+rasqal_bindings_rowsource_estimate_rows(rasqal_rowsource* rowsource,
+                                        void *user_data)
+{
+  rasqal_bindings_rowsource_context *con;
+
+  con = (rasqal_bindings_rowsource_context*)user_data;
+
+  if(!con->bindings->rows)
+    return 0;
+
+  return raptor_sequence_size(con->bindings->rows);
+}
+
+
 static const rasqal_rowsource_handler rasqal_bindings_rowsource_handler = {
-  /* .version =          */ 1,
+  /* .version =          */ 3,
   "bindings",
   /* .init =             */ rasqal_bindings_rowsource_init,
   /* .finish =           */ rasqal_bindings_rowsource_finish,
@@ -150,6 +165,9 @@ static const rasqal_rowsource_handler rasqal_bindings_rowsource_handler = {
   /* .set_requirements = */ NULL,
   /* .get_inner_rowsource = */ NULL,
   /* .set_origin =       */ NULL,
+  /* .skip_rows =        */ NULL,
+  /* .read_batch =       */ NULL,
+  /* .estimate_rows =    */ rasqal_bindings_rowsource_estimate_rows
 };
 
 
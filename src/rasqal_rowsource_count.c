@@ -0,0 +1,462 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_rowsource_count.c - Rasqal triple pattern count rowsource class
+ *
+ * Copyright (C) 2026, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include <raptor.h>
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+
+#define DEBUG_FH stderr
+
+
+/*
+ * rasqal_count_rowsource_context:
+ *
+ * INTERNAL - Triple pattern count rowsource context
+ *
+ * Returns the single row that aggregating COUNT over the matches of
+ * one triple pattern with no GROUP BY would: the values of the
+ * pattern variables in the first match followed by the count.
+ */
+typedef struct
+{
+  /* source of triple pattern matches */
+  rasqal_triples_source* triples_source;
+
+  /* triple pattern SHARED with query */
+  rasqal_triple* triple;
+
+  /* variable to count distinct values of or NULL to count matches */
+  rasqal_variable* distinct_variable;
+
+  /* variable to bind the count to */
+  rasqal_variable* variable;
+
+  /* pattern match metadata */
+  rasqal_triple_meta triple_meta;
+
+  /* offset into results for current row */
+  int offset;
+
+  /* GRAPH origin to use */
+  rasqal_literal *origin;
+} rasqal_count_rowsource_context;
+
+
+static int
+rasqal_count_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
+{
+  return 0;
+}
+
+
+static int
+rasqal_count_rowsource_ensure_variables(rasqal_rowsource* rowsource,
+                                        void *user_data)
+{
+  rasqal_count_rowsource_context *con;
+  rasqal_triple *t;
+  int size;
+  int i;
+
+  con = (rasqal_count_rowsource_context*)user_data;
+  t = con->triple;
+
+  rowsource->size = 0;
+
+  /* Same variable order as the triples rowsource */
+  size = rasqal_variables_table_get_total_variables_count(rowsource->vars_table);
+  for(i = 0; i < size; i++) {
+    rasqal_variable* v = rasqal_variables_table_get(rowsource->vars_table, i);
+
+    if(v == rasqal_literal_as_variable(t->subject) ||
+       v == rasqal_literal_as_variable(t->predicate) ||
+       v == rasqal_literal_as_variable(t->object)) {
+      if(rasqal_rowsource_add_variable(rowsource, v) < 0)
+        return 1;
+    }
+  }
+
+  if(rasqal_rowsource_add_variable(rowsource, con->variable) < 0)
+    return 1;
+
+  return 0;
+}
+
+
+static int
+rasqal_count_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
+{
+  rasqal_count_rowsource_context *con;
+  con = (rasqal_count_rowsource_context*)user_data;
+
+  rasqal_reset_triple_meta(&con->triple_meta);
+
+  if(con->variable)
+    rasqal_free_variable(con->variable);
+
+  if(con->distinct_variable)
+    rasqal_free_variable(con->distinct_variable);
+
+  if(con->origin)
+    rasqal_free_literal(con->origin);
+
+  RASQAL_FREE(rasqal_count_rowsource_context, con);
+
+  return 0;
+}
+
+
+/*
+ * rasqal_count_rowsource_count:
+ * @rowsource: count rowsource
+ * @con: count rowsource context
+ * @row: row to set the first match values in
+ * @count_p: pointer to store count
+ *
+ * INTERNAL - Count the matches of the triple pattern without making rows
+ *
+ * Plain counts come from the triples source if it can count, asked
+ * before anything is bound so the pattern variables match anything,
+ * otherwise by stepping the match without binding.  The first match is
+ * bound to get the sampled values.  DISTINCT counts bind only the
+ * counted variable and add its values to a literal sort map as the
+ * aggregation rowsource does.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_count_rowsource_count(rasqal_rowsource* rowsource,
+                             rasqal_count_rowsource_context *con,
+                             rasqal_row* row, long* count_p)
+{
+  rasqal_triple_meta *m = &con->triple_meta;
+  rasqal_map* map = NULL;
+  unsigned int distinct_parts = 0;
+  long count = 0;
+  long store_count = -1;
+  int rc = 1;
+  int i;
+
+  m->triples_match = rasqal_new_triples_match(rowsource->query,
+                                              con->triples_source,
+                                              m, con->triple);
+  if(!m->triples_match)
+    return 1;
+  rowsource->stats.triples_matches++;
+
+  if(con->distinct_variable) {
+    map = rasqal_new_literal_sequence_sort_map(1 /* is_distinct */,
+                                               0 /* compare_flags */);
+    if(!map)
+      goto tidy;
+
+    /* after the first match only bind the counted variable */
+    if(m->bindings[0] == con->distinct_variable)
+      distinct_parts = RASQAL_TRIPLE_SUBJECT;
+    else if(m->bindings[1] == con->distinct_variable)
+      distinct_parts = RASQAL_TRIPLE_PREDICATE;
+    else
+      distinct_parts = RASQAL_TRIPLE_OBJECT;
+  }
+
+  if(!map) {
+    if(rasqal_triples_source_triple_count(con->triples_source, con->triple,
+                                          &store_count))
+      store_count = -1;
+    else {
+      RASQAL_DEBUG2("Triples source counted %ld matches\n", store_count);
+    }
+  }
+
+  while(!rasqal_triples_match_is_end(m->triples_match)) {
+    if(!count) {
+      /* First match provides the values copied through */
+      if(!rasqal_triples_match_bind_match(m->triples_match, m->bindings,
+                                          m->parts))
+        goto tidy;
+
+      for(i = 0; i < row->size - 1; i++) {
+        rasqal_variable* v = rasqal_rowsource_get_variable_by_offset(rowsource, i);
+        rasqal_row_set_value_at(row, i, v->value);
+      }
+
+      if(store_count >= 0)
+        break;
+    } else if(map) {
+      if(!rasqal_triples_match_bind_match(m->triples_match, m->bindings,
+                                          (rasqal_triple_parts)distinct_parts))
+        goto tidy;
+    }
+
+    if(map) {
+      raptor_sequence* seq;
+
+      seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_literal,
+                                (raptor_data_print_handler)rasqal_literal_print);
+      if(!seq)
+        goto tidy;
+      raptor_sequence_push(seq,
+                           rasqal_new_literal_from_literal(con->distinct_variable->value));
+
+      /* map owns seq if new otherwise seq was freed */
+      if(!rasqal_literal_sequence_sort_map_add_literal_sequence(map, seq))
+        count++;
+    } else
+      count++;
+
+    rasqal_triples_match_next_match(m->triples_match);
+    rowsource->stats.triples_next_matches++;
+  }
+
+  *count_p = (store_count >= 0) ? store_count : count;
+  rc = 0;
+
+  tidy:
+  if(map)
+    rasqal_free_map(map);
+
+  /* unbinds the pattern variables */
+  rasqal_reset_triple_meta(m);
+
+  return rc;
+}
+
+
+static rasqal_row*
+rasqal_count_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
+{
+  rasqal_count_rowsource_context *con;
+  rasqal_literal* result;
+  rasqal_row *row = NULL;
+  long count = 0;
+
+  con = (rasqal_count_rowsource_context*)user_data;
+
+  if(con->offset)
+    return NULL;
+
+  row = rasqal_new_row(rowsource);
+  if(!row)
+    return NULL;
+
+  if(rasqal_count_rowsource_count(rowsource, con, row, &count)) {
+    rasqal_free_row(row);
+    return NULL;
+  }
+
+  result = rasqal_new_numeric_literal_from_long(rowsource->world,
+                                                RASQAL_LITERAL_INTEGER, count);
+  if(!result) {
+    rasqal_free_row(row);
+    return NULL;
+  }
+
+  rasqal_row_set_value_at(row, row->size - 1, result);
+  /* it is OK to bind to NULL */
+  rasqal_variable_set_value(con->variable, result);
+
+  row->offset = con->offset++;
+
+  return row;
+}
+
+
+static int
+rasqal_count_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
+{
+  rasqal_count_rowsource_context *con;
+  con = (rasqal_count_rowsource_context*)user_data;
+
+  con->offset = 0;
+
+  return 0;
+}
+
+
+static int
+rasqal_count_rowsource_set_origin(rasqal_rowsource *rowsource,
+                                  void *user_data,
+                                  rasqal_literal *origin)
+{
+  rasqal_count_rowsource_context *con;
+  rasqal_triple *t;
+
+  con = (rasqal_count_rowsource_context*)user_data;
+  if(con->origin)
+    rasqal_free_literal(con->origin);
+  con->origin = rasqal_new_literal_from_literal(origin);
+
+  t = con->triple;
+  if(t->origin)
+    rasqal_free_literal(t->origin);
+  t->origin = rasqal_new_literal_from_literal(con->origin);
+
+  return 0;
+}
+
+
+static const rasqal_rowsource_handler rasqal_count_rowsource_handler = {
+  /* .version =          */ 1,
+  "count",
+  /* .init =             */ rasqal_count_rowsource_init,
+  /* .finish =           */ rasqal_count_rowsource_finish,
+  /* .ensure_variables = */ rasqal_count_rowsource_ensure_variables,
+  /* .read_row =         */ rasqal_count_rowsource_read_row,
+  /* .read_all_rows =    */ NULL,
+  /* .reset =            */ rasqal_count_rowsource_reset,
+  /* .set_requirements = */ NULL,
+  /* .get_inner_rowsource = */ NULL,
+  /* .set_origin =       */ rasqal_count_rowsource_set_origin,
+  /* .skip_rows =        */ NULL,
+  /* .read_batch =       */ NULL,
+  /* .estimate_rows =    */ NULL
+};
+
+
+/**
+ * rasqal_new_count_rowsource:
+ * @world: world object
+ * @query: query object
+ * @triples_source: shared triples source
+ * @triples: shared triples sequence
+ * @column: column of the triple pattern in @triples
+ * @distinct_variable: variable to count distinct values of or NULL
+ * @variable: variable to bind the count to
+ *
+ * INTERNAL - create a new rowsource for COUNT over one triple pattern
+ *
+ * Equivalent to rasqal_new_aggregation_rowsource() with one COUNT(*)
+ * or COUNT(DISTINCT ?v) expression over rasqal_new_triples_rowsource()
+ * for the single pattern but no input rows are made.  The pattern
+ * must be checked with rasqal_count_rowsource_pattern_parts() first.
+ *
+ * Return value: new rowsource or NULL on failure
+ */
+rasqal_rowsource*
+rasqal_new_count_rowsource(rasqal_world *world,
+                           rasqal_query *query,
+                           rasqal_triples_source* triples_source,
+                           raptor_sequence* triples, int column,
+                           rasqal_variable* distinct_variable,
+                           rasqal_variable* variable)
+{
+  rasqal_count_rowsource_context *con;
+  rasqal_triple_parts parts;
+  int flags = 0;
+
+  if(!world || !query || !triples_source || !triples || !variable)
+    return NULL;
+
+  parts = rasqal_count_rowsource_pattern_parts(query, triples, column);
+  if(!parts)
+    return NULL;
+
+  con = RASQAL_CALLOC(rasqal_count_rowsource_context*, 1, sizeof(*con));
+  if(!con)
+    return NULL;
+
+  con->triples_source = triples_source;
+  con->triple = (rasqal_triple*)raptor_sequence_get_at(triples, column);
+  con->triple_meta.parts = parts;
+  con->variable = rasqal_new_variable_from_variable(variable);
+  if(distinct_variable)
+    con->distinct_variable = rasqal_new_variable_from_variable(distinct_variable);
+
+  return rasqal_new_rowsource_from_handler(world, query,
+                                           con,
+                                           &rasqal_count_rowsource_handler,
+                                           query->vars_table,
+                                           flags);
+}
+
+
+/**
+ * rasqal_count_rowsource_pattern_parts:
+ * @query: query object
+ * @triples: shared triples sequence
+ * @column: column of the triple pattern in @triples
+ *
+ * INTERNAL - check if a triple pattern can be counted by rasqal_new_count_rowsource()
+ *
+ * The pattern must have no GRAPH, at least one variable, no
+ * variable more than once and bind all its variables.
+ *
+ * Return value: parts of the pattern that are variables or 0 if it cannot be counted
+ */
+rasqal_triple_parts
+rasqal_count_rowsource_pattern_parts(rasqal_query* query,
+                                     raptor_sequence* triples, int column)
+{
+  rasqal_triple *t;
+  rasqal_variable* s;
+  rasqal_variable* p;
+  rasqal_variable* o;
+  unsigned int parts = 0;
+
+  t = (rasqal_triple*)raptor_sequence_get_at(triples, column);
+  if(!t || t->origin)
+    return (rasqal_triple_parts)0;
+
+  s = rasqal_literal_as_variable(t->subject);
+  p = rasqal_literal_as_variable(t->predicate);
+  o = rasqal_literal_as_variable(t->object);
+
+  if((s && (s == p || s == o)) || (p && p == o))
+    return (rasqal_triple_parts)0;
+
+  if(s) {
+    if(!(rasqal_query_variable_bound_in_triple(query, s, column) & RASQAL_TRIPLE_SUBJECT))
+      return (rasqal_triple_parts)0;
+    parts |= RASQAL_TRIPLE_SUBJECT;
+  }
+
+  if(p) {
+    if(!(rasqal_query_variable_bound_in_triple(query, p, column) & RASQAL_TRIPLE_PREDICATE))
+      return (rasqal_triple_parts)0;
+    parts |= RASQAL_TRIPLE_PREDICATE;
+  }
+
+  if(o) {
+    if(!(rasqal_query_variable_bound_in_triple(query, o, column) & RASQAL_TRIPLE_OBJECT))
+      return (rasqal_triple_parts)0;
+    parts |= RASQAL_TRIPLE_OBJECT;
+  }
+
+  return (rasqal_triple_parts)parts;
+}
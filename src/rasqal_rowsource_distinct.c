@@ -201,6 +201,9 @@ static const rasqal_rowsource_handler rasqal_distinct_rowsource_handler = {
   /* .set_requirements = */ NULL,
   /* .get_inner_rowsource = */ rasqal_distinct_rowsource_get_inner_rowsource,
   /* .set_origin =       */ NULL,
+  /* .skip_rows =        */ NULL,
+  /* .read_batch =       */ NULL,
+  /* .estimate_rows =    */ NULL
 };
 
 
@@ -100,8 +100,16 @@ rasqal_empty_rowsource_read_all_rows(rasqal_rowsource* rowsource,
   return seq;
 }
 
+static long
+rasqal_empty_rowsource_estimate_rows(rasqal_rowsource* rowsource,
+                                     void *user_data)
+{
+  /* the one row with no variables */
+  return 1;
+}
+
 static const rasqal_rowsource_handler rasqal_empty_rowsource_handler = {
-  /* .version = */ 1,
+  /* .version = */ 3,
   "empty",
   /* .init = */ NULL,
   /* .finish = */ rasqal_empty_rowsource_finish,
@@ -112,6 +120,9 @@ static const rasqal_rowsource_handler rasqal_empty_rowsource_handler = {
   /* .set_requirements = */ NULL,
   /* .get_inner_rowsource = */ NULL,
   /* .set_origin = */ NULL,
+  /* .skip_rows = */ NULL,
+  /* .read_batch = */ NULL,
+  /* .estimate_rows = */ rasqal_empty_rowsource_estimate_rows
 };
 
 
@@ -102,48 +102,67 @@ rasqal_filter_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
 }
 
 
+/*
+ * rasqal_filter_rowsource_evaluate:
+ * @rowsource: filter rowsource
+ * @con: filter rowsource context
+ *
+ * INTERNAL - Evaluate the filter expression over the current variable bindings
+ *
+ * Return value: non-0 if the constraint succeeded
+ */
+static int
+rasqal_filter_rowsource_evaluate(rasqal_rowsource* rowsource,
+                                 rasqal_filter_rowsource_context *con)
+{
+  rasqal_query *query = rowsource->query;
+  rasqal_literal* result;
+  int bresult = 1;
+  int error = 0;
+
+  result = rasqal_expression_evaluate2(con->expr, query->eval_context,
+                                       &error);
+  rowsource->stats.expressions++;
+#ifdef RASQAL_DEBUG
+  RASQAL_DEBUG1("filter expression result: ");
+  if(error)
+    fputs("type error", DEBUG_FH);
+  else
+    rasqal_literal_print(result, DEBUG_FH);
+  fputc('\n', DEBUG_FH);
+#endif
+  if(error) {
+    bresult = 0;
+  } else {
+    error = 0;
+    bresult = rasqal_literal_as_boolean(result, &error);
+#ifdef RASQAL_DEBUG
+    if(error)
+      RASQAL_DEBUG1("filter boolean expression returned error\n");
+    else
+      RASQAL_DEBUG2("filter boolean expression result: %d\n", bresult);
+#endif
+    rasqal_free_literal(result);
+  }
+
+  return bresult;
+}
+
+
 static rasqal_row*
 rasqal_filter_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
 {
-  rasqal_query *query = rowsource->query;
   rasqal_filter_rowsource_context *con;
   rasqal_row *row = NULL;
   
   con = (rasqal_filter_rowsource_context*)user_data;
 
   while(1) {
-    rasqal_literal* result;
-    int bresult = 1;
-    int error = 0;
-    
     row = rasqal_rowsource_read_row(con->rowsource);
     if(!row)
       break;
 
-    result = rasqal_expression_evaluate2(con->expr, query->eval_context,
-                                         &error);
-#ifdef RASQAL_DEBUG
-    RASQAL_DEBUG1("filter expression result: ");
-    if(error)
-      fputs("type error", DEBUG_FH);
-    else
-      rasqal_literal_print(result, DEBUG_FH);
-    fputc('\n', DEBUG_FH);
-#endif
-    if(error) {
-      bresult = 0;
-    } else {
-      error = 0;
-      bresult = rasqal_literal_as_boolean(result, &error);
-#ifdef RASQAL_DEBUG
-      if(error)
-        RASQAL_DEBUG1("filter boolean expression returned error\n");
-      else
-        RASQAL_DEBUG2("filter boolean expression result: %d\n", bresult);
-#endif
-      rasqal_free_literal(result);
-    }
-    if(bresult)
+    if(rasqal_filter_rowsource_evaluate(rowsource, con))
       /* Constraint succeeded so end */
       break;
 
@@ -168,6 +187,49 @@ rasqal_filter_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
 }
 
 
+static int
+rasqal_filter_rowsource_read_batch(rasqal_rowsource* rowsource,
+                                   void *user_data,
+                                   rasqal_row** rows, int size)
+{
+  rasqal_filter_rowsource_context *con;
+  int count = 0;
+  
+  con = (rasqal_filter_rowsource_context*)user_data;
+
+  /* read input batches until at least one row passes or input ends */
+  while(!count) {
+    int input_count;
+    int i;
+
+    input_count = rasqal_rowsource_read_batch(con->rowsource, rows, size);
+    if(input_count <= 0)
+      return input_count;
+
+    for(i = 0; i < input_count; i++) {
+      rasqal_row* row = rows[i];
+
+      /* the row values are the variable values for the expression */
+      if(rasqal_row_bind_variables(row, rowsource->query->vars_table)) {
+        while(i < input_count)
+          rasqal_free_row(rows[i++]);
+        while(count > 0)
+          rasqal_free_row(rows[--count]);
+        return -1;
+      }
+
+      if(rasqal_filter_rowsource_evaluate(rowsource, con)) {
+        row->offset = con->offset++;
+        rows[count++] = row;
+      } else
+        rasqal_free_row(row);
+    }
+  }
+
+  return count;
+}
+
+
 static int
 rasqal_filter_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
 {
@@ -192,7 +254,7 @@ rasqal_filter_rowsource_get_inner_rowsource(rasqal_rowsource* rowsource,
 
 
 static const rasqal_rowsource_handler rasqal_filter_rowsource_handler = {
-  /* .version =          */ 1,
+  /* .version =          */ 2,
   "filter",
   /* .init =             */ rasqal_filter_rowsource_init,
   /* .finish =           */ rasqal_filter_rowsource_finish,
@@ -203,6 +265,9 @@ static const rasqal_rowsource_handler rasqal_filter_rowsource_handler = {
   /* .set_requirements = */ NULL,
   /* .get_inner_rowsource = */ rasqal_filter_rowsource_get_inner_rowsource,
   /* .set_origin =       */ NULL,
+  /* .skip_rows =        */ NULL,
+  /* .read_batch =       */ rasqal_filter_rowsource_read_batch,
+  /* .estimate_rows =    */ NULL
 };
 
 
@@ -89,6 +89,15 @@ typedef struct
 
   int finished;
 
+  /* subplan evaluating @rowsource on worker threads or NULL */
+  rasqal_subplan* subplan;
+
+  /* non-0 if rows may be returned in any named graph order */
+  int unordered;
+
+  /* tasks evaluating @subplan, one per named graph, or NULL
+   * before the first read */
+  rasqal_subplan_tasks* tasks;
 } rasqal_graph_rowsource_context;
 
 
@@ -135,6 +144,93 @@ rasqal_graph_next_dg(rasqal_graph_rowsource_context *con)
 }
 
 
+/*
+ * rasqal_graph_rowsource_start_tasks:
+ * @rowsource: graph rowsource
+ * @con: graph rowsource context
+ *
+ * INTERNAL - Create a task evaluating the subplan for each named graph
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_graph_rowsource_start_tasks(rasqal_rowsource* rowsource,
+                                   rasqal_graph_rowsource_context* con)
+{
+  rasqal_query *query = rowsource->query;
+  int i;
+
+  con->tasks = rasqal_new_subplan_tasks(con->dg_size, con->unordered);
+  if(!con->tasks)
+    return 1;
+
+  for(i = 0; i < con->dg_size; i++) {
+    rasqal_data_graph *dg = rasqal_query_get_data_graph(query, i);
+    rasqal_literal *o;
+
+    if(!dg || !dg->name_uri)
+      continue;
+
+    o = rasqal_new_uri_literal(query->world, raptor_uri_copy(dg->name_uri));
+    if(!o || rasqal_subplan_tasks_add(con->tasks, con->subplan, o, 0, -1))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_graph_rowsource_read_parallel_row:
+ * @rowsource: graph rowsource
+ * @con: graph rowsource context
+ *
+ * INTERNAL - Read the next row from the named graph tasks
+ *
+ * Return value: row or NULL when finished or on failure
+ */
+static rasqal_row*
+rasqal_graph_rowsource_read_parallel_row(rasqal_rowsource* rowsource,
+                                         rasqal_graph_rowsource_context* con)
+{
+  rasqal_literal** values;
+  rasqal_row* row;
+  int index;
+  int size;
+  int i;
+
+  if(!con->tasks && rasqal_graph_rowsource_start_tasks(rowsource, con)) {
+    con->finished = 1;
+    return NULL;
+  }
+
+  if(rasqal_subplan_tasks_next(con->tasks, rowsource->execution,
+                               &index, &values) <= 0) {
+    con->finished = 1;
+    return NULL;
+  }
+
+  size = rasqal_subplan_get_size(con->subplan);
+  row = rasqal_new_row_for_query(rowsource->world, rowsource->query, 1 + size);
+  if(!row) {
+    rasqal_subplan_free_values(con->subplan, values);
+    con->finished = 1;
+    return NULL;
+  }
+
+  rasqal_row_set_rowsource(row, rowsource);
+  row->offset = con->offset++;
+
+  /* Put GRAPH variable value first in result row */
+  row->values[0] = rasqal_new_literal_from_literal(rasqal_subplan_tasks_get_origin(con->tasks, index));
+  for(i = 0; i < size; i++)
+    row->values[i + 1] = values[i];
+  RASQAL_FREE(rasqal_literal**, values);
+
+  return row;
+}
+
+
 static int
 rasqal_graph_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
 {
@@ -157,7 +253,8 @@ rasqal_graph_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
    * error). rasqal_graph_rowsource_read_row() will deal with
    * returning NULL for an empty result.
    */
-  rasqal_graph_next_dg(con);
+  if(!con->subplan)
+    rasqal_graph_next_dg(con);
 
   return 0;
 }
@@ -169,6 +266,12 @@ rasqal_graph_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
   rasqal_graph_rowsource_context *con;
   con = (rasqal_graph_rowsource_context*)user_data;
 
+  if(con->tasks)
+    rasqal_free_subplan_tasks(con->tasks);
+
+  if(con->subplan)
+    rasqal_free_subplan(con->subplan);
+
   if(con->rowsource)
     rasqal_free_rowsource(con->rowsource);
   
@@ -210,6 +313,9 @@ rasqal_graph_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
   if(con->finished)
     return NULL;
   
+  if(con->subplan)
+    return rasqal_graph_rowsource_read_parallel_row(rowsource, con);
+
   while(1) {
     row = rasqal_rowsource_read_row(con->rowsource);
     if(row)
@@ -230,7 +336,8 @@ rasqal_graph_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
     rasqal_row* nrow;
     int i;
     
-    nrow = rasqal_new_row_for_size(rowsource->world, 1 + row->size);
+    nrow = rasqal_new_row_for_query(rowsource->world, rowsource->query,
+                                    1 + row->size);
     if(!nrow) {
       rasqal_free_row(row);
       row = NULL;
@@ -263,6 +370,15 @@ rasqal_graph_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
   con->dg_offset = -1;
   con->offset = 0;
 
+  if(con->subplan) {
+    /* tasks are started again by the next read */
+    if(con->tasks) {
+      rasqal_free_subplan_tasks(con->tasks);
+      con->tasks = NULL;
+    }
+    return 0;
+  }
+
   rasqal_graph_next_dg(con);
   
   return rasqal_rowsource_reset(con->rowsource);
@@ -294,6 +410,9 @@ static const rasqal_rowsource_handler rasqal_graph_rowsource_handler = {
   /* .set_requirements = */ NULL,
   /* .get_inner_rowsource = */ rasqal_graph_rowsource_get_inner_rowsource,
   /* .set_origin =       */ NULL,
+  /* .skip_rows =        */ NULL,
+  /* .read_batch =       */ NULL,
+  /* .estimate_rows =    */ NULL
 };
 
 
@@ -303,10 +422,14 @@ static const rasqal_rowsource_handler rasqal_graph_rowsource_handler = {
  * @query: query object
  * @rowsource: input rowsource
  * @var: graph variable
+ * @subplan: subplan evaluating @rowsource on worker threads or NULL
+ * @unordered: non-0 if rows of different named graphs may be returned in any order
  *
  * INTERNAL - create a new GRAPH rowsource that binds a variable
  *
- * The @rowsource becomes owned by the new rowsource
+ * The @rowsource and @subplan become owned by the new rowsource.
+ * With a @subplan the named graphs are evaluated in parallel and
+ * @rowsource only provides the variables.
  *
  * Return value: new rowsource or NULL on failure
  */
@@ -314,7 +437,9 @@ rasqal_rowsource*
 rasqal_new_graph_rowsource(rasqal_world *world,
                            rasqal_query *query,
                            rasqal_rowsource* rowsource,
-                           rasqal_variable *var)
+                           rasqal_variable *var,
+                           rasqal_subplan* subplan,
+                           int unordered)
 {
   rasqal_graph_rowsource_context *con;
   int flags = 0;
@@ -328,6 +453,8 @@ rasqal_new_graph_rowsource(rasqal_world *world,
 
   con->rowsource = rowsource;
   con->var = var;
+  con->subplan = subplan;
+  con->unordered = unordered;
 
   return rasqal_new_rowsource_from_handler(world, query,
                                            con,
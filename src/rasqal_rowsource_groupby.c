@@ -287,6 +287,7 @@ rasqal_groupby_rowsource_process(rasqal_rowsource* rowsource,
                                                         con->exprs_seq,
                                                         /* ignore_errors */ 0,
                                                         /* error_p */ NULL);
+      rowsource->stats.expressions += raptor_sequence_size(con->exprs_seq);
       
       if(!literal_seq) {
         /* FIXME - what to do on errors? */
@@ -455,6 +456,9 @@ static const rasqal_rowsource_handler rasqal_groupby_rowsource_handler = {
   /* .set_requirements = */ NULL,
   /* .get_inner_rowsource = */ rasqal_groupby_rowsource_get_inner_rowsource,
   /* .set_origin = */ NULL,
+  /* .skip_rows = */ NULL,
+  /* .read_batch = */ NULL,
+  /* .estimate_rows = */ NULL
 };
 
 
@@ -124,6 +124,7 @@ rasqal_having_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
                                                        con->exprs_seq,
                                                        /* ignore_errors */ 0,
                                                        &error);
+    rowsource->stats.expressions += raptor_sequence_size(con->exprs_seq);
     if(error) {
       if(literal_seq)
         raptor_free_sequence(literal_seq);
@@ -225,6 +226,9 @@ static const rasqal_rowsource_handler rasqal_having_rowsource_handler = {
   /* .set_requirements = */ NULL,
   /* .get_inner_rowsource = */ rasqal_having_rowsource_get_inner_rowsource,
   /* .set_origin =       */ NULL,
+  /* .skip_rows =        */ NULL,
+  /* .read_batch =       */ NULL,
+  /* .estimate_rows =    */ NULL
 };
 
 
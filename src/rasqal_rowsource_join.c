@@ -110,6 +110,7 @@ rasqal_join_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
     
     result = rasqal_expression_evaluate2(con->expr, query->eval_context,
                                          &error);
+    rowsource->stats.expressions++;
 
 #ifdef RASQAL_DEBUG
     RASQAL_DEBUG1("join expression condition is constant: ");
@@ -252,7 +253,8 @@ rasqal_join_rowsource_build_merged_row(rasqal_rowsource* rowsource,
   rasqal_row *row;
   int i;
 
-  row = rasqal_new_row_for_size(rowsource->world, rowsource->size);
+  row = rasqal_new_row_for_query(rowsource->world, rowsource->query,
+                                 rowsource->size);
   if(!row) {
     if(right_row)
       rasqal_free_row(right_row);
@@ -316,6 +318,9 @@ rasqal_join_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
     int bresult = 1;
     int compatible = 1;
 
+    if(RASQAL_EXECUTION_CHECK(rowsource->execution))
+      return NULL;
+
     if(con->state == JS_START) {
       /* start / re-start left */
       if(con->left_row)
@@ -403,6 +408,7 @@ rasqal_join_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
       
       result = rasqal_expression_evaluate2(con->expr, query->eval_context,
                                            &error);
+      rowsource->stats.expressions++;
 #ifdef RASQAL_DEBUG
       RASQAL_DEBUG1("join expression result: ");
       if(error)
@@ -548,6 +554,9 @@ static const rasqal_rowsource_handler rasqal_join_rowsource_handler = {
   /* .set_requirements = */ NULL,
   /* .get_inner_rowsource = */ rasqal_join_rowsource_get_inner_rowsource,
   /* .set_origin = */ NULL,
+  /* .skip_rows = */ NULL,
+  /* .read_batch = */ NULL,
+  /* .estimate_rows = */ NULL
 };
 
 
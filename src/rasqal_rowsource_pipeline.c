@@ -0,0 +1,466 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_rowsource_pipeline.c - Rasqal fused triples, filter, project and slice rowsource class
+ *
+ * Copyright (C) 2026, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include <raptor.h>
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+
+#define DEBUG_FH stderr
+
+
+/*
+ * rasqal_pipeline_rowsource_context:
+ *
+ * INTERNAL - Pipeline rowsource context
+ *
+ * A pipeline runs the operators of a linear SLICE, PROJECT and
+ * FILTER chain over a triple pattern rowsource in one loop.  The
+ * filters are evaluated over the variable bindings of each triple
+ * pattern match and only matches that pass all filters and are in
+ * the slice range are turned into (projected) rows, so there are no
+ * intermediate rows.
+ */
+typedef struct
+{
+  /* inner triple pattern rowsource */
+  rasqal_rowsource *rowsource;
+
+  /* sequence of FILTER #rasqal_expression (or NULL) */
+  raptor_sequence* filters_seq;
+
+  /* variables to project to (or NULL for all variables) */
+  raptor_sequence* projection_variables;
+
+  /* variables projection array: [output row var index]=input row var index */
+  int* projection;
+
+  /* slice limit or <0 for no limit */
+  int row_limit;
+
+  /* slice offset or <=0 for no offset */
+  int row_offset;
+
+  /* offset for the next match that passes the filters */
+  int input_offset;
+
+  /* offset for output row */
+  int output_offset;
+
+  int failed;
+} rasqal_pipeline_rowsource_context;
+
+
+static int
+rasqal_pipeline_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
+{
+  rasqal_pipeline_rowsource_context *con;
+
+  con = (rasqal_pipeline_rowsource_context*)user_data;
+
+  con->input_offset = 1;
+  con->output_offset = 1;
+  con->failed = 0;
+
+  return 0;
+}
+
+
+static int
+rasqal_pipeline_rowsource_ensure_variables(rasqal_rowsource* rowsource,
+                                           void *user_data)
+{
+  rasqal_pipeline_rowsource_context* con;
+  int size;
+  int i;
+
+  con = (rasqal_pipeline_rowsource_context*)user_data;
+
+  if(rasqal_rowsource_ensure_variables(con->rowsource))
+    return 1;
+
+  rowsource->size = 0;
+
+  if(!con->projection_variables)
+    return rasqal_rowsource_copy_variables(rowsource, con->rowsource);
+
+  size = raptor_sequence_size(con->projection_variables);
+
+  con->projection = RASQAL_MALLOC(int*, RASQAL_GOOD_CAST(size_t,
+                                                         sizeof(int) * RASQAL_GOOD_CAST(size_t, size)));
+  if(!con->projection)
+    return 1;
+
+  for(i = 0; i < size; i++) {
+    rasqal_variable* v;
+
+    v = (rasqal_variable*)raptor_sequence_get_at(con->projection_variables, i);
+    if(!v)
+      break;
+
+    rasqal_rowsource_add_variable(rowsource, v);
+    con->projection[i] = rasqal_rowsource_get_variable_offset_by_name(con->rowsource,
+                                                                      v->name);
+  }
+
+  return 0;
+}
+
+
+static int
+rasqal_pipeline_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
+{
+  rasqal_pipeline_rowsource_context *con;
+
+  con = (rasqal_pipeline_rowsource_context*)user_data;
+
+  if(con->rowsource)
+    rasqal_free_rowsource(con->rowsource);
+
+  if(con->filters_seq)
+    raptor_free_sequence(con->filters_seq);
+
+  if(con->projection_variables)
+    raptor_free_sequence(con->projection_variables);
+
+  if(con->projection)
+    RASQAL_FREE(int*, con->projection);
+
+  RASQAL_FREE(rasqal_pipeline_rowsource_context, con);
+
+  return 0;
+}
+
+
+/*
+ * rasqal_pipeline_rowsource_next_match:
+ * @rowsource: pipeline rowsource
+ * @con: pipeline rowsource context
+ *
+ * INTERNAL - Bind the variables to the next match in the slice range
+ *
+ * Return value: 0 if there is a match, >0 if finished or <0 on failure
+ */
+static int
+rasqal_pipeline_rowsource_next_match(rasqal_rowsource* rowsource,
+                                     rasqal_pipeline_rowsource_context *con)
+{
+  rasqal_query *query = rowsource->query;
+
+  if(con->failed)
+    return -1;
+
+  while(1) {
+    int rc;
+    int check;
+    int i;
+    int size;
+
+    /* finished if the slice range has already been returned */
+    if(rasqal_query_check_limit_offset_core(con->input_offset,
+                                            con->row_limit,
+                                            con->row_offset) > 0)
+      return 1;
+
+    rc = rasqal_triples_rowsource_bind_next(con->rowsource);
+    if(rc) {
+      if(rc < 0)
+        con->failed = 1;
+      return rc;
+    }
+
+    /* evaluate the filters over the bindings */
+    size = con->filters_seq ? raptor_sequence_size(con->filters_seq) : 0;
+    for(i = 0; i < size; i++) {
+      rasqal_expression* e;
+      rasqal_literal* result;
+      int error = 0;
+      int bresult;
+
+      e = (rasqal_expression*)raptor_sequence_get_at(con->filters_seq, i);
+      result = rasqal_expression_evaluate2(e, query->eval_context, &error);
+      rowsource->stats.expressions++;
+      if(error)
+        break;
+
+      bresult = rasqal_literal_as_boolean(result, &error);
+      rasqal_free_literal(result);
+      if(error || !bresult)
+        break;
+    }
+
+    /* a filter failed so try the next match */
+    if(i < size)
+      continue;
+
+    check = rasqal_query_check_limit_offset_core(con->input_offset,
+                                                 con->row_limit,
+                                                 con->row_offset);
+    con->input_offset++;
+
+    if(check > 0)
+      return 1;
+
+    /* in range */
+    if(!check)
+      return 0;
+
+    /* otherwise before the start of the slice range so continue */
+  }
+}
+
+
+/*
+ * rasqal_pipeline_rowsource_make_row:
+ * @rowsource: pipeline rowsource
+ * @con: pipeline rowsource context
+ *
+ * INTERNAL - Make the projected row from the current variable bindings
+ *
+ * Return value: new row or NULL on failure
+ */
+static rasqal_row*
+rasqal_pipeline_rowsource_make_row(rasqal_rowsource* rowsource,
+                                   rasqal_pipeline_rowsource_context *con)
+{
+  rasqal_query *query = rowsource->query;
+  rasqal_row* row;
+  int i;
+
+  row = rasqal_new_row_for_query(rowsource->world, rowsource->query,
+                                 rowsource->size);
+  if(!row)
+    return NULL;
+
+  rasqal_row_set_rowsource(row, rowsource);
+  row->offset = con->output_offset++;
+
+  for(i = 0; i < rowsource->size; i++) {
+    rasqal_variable* v;
+
+    if(!con->projection) {
+      v = rasqal_rowsource_get_variable_by_offset(rowsource, i);
+      row->values[i] = rasqal_new_literal_from_literal(v->value);
+      continue;
+    }
+
+    if(con->projection[i] >= 0) {
+      v = rasqal_rowsource_get_variable_by_offset(con->rowsource,
+                                                  con->projection[i]);
+      row->values[i] = rasqal_new_literal_from_literal(v->value);
+      continue;
+    }
+
+    v = (rasqal_variable*)raptor_sequence_get_at(con->projection_variables, i);
+    if(v && v->expression) {
+      int error = 0;
+
+      if(v->value)
+        rasqal_free_literal(v->value);
+
+      v->value = rasqal_expression_evaluate2(v->expression,
+                                             query->eval_context,
+                                             &error);
+      rowsource->stats.expressions++;
+      /* errors leave the value unbound as for a project rowsource */
+      if(!error)
+        row->values[i] = rasqal_new_literal_from_literal(v->value);
+    }
+  }
+
+  return row;
+}
+
+
+static rasqal_row*
+rasqal_pipeline_rowsource_read_row(rasqal_rowsource* rowsource,
+                                   void *user_data)
+{
+  rasqal_pipeline_rowsource_context *con;
+
+  con = (rasqal_pipeline_rowsource_context*)user_data;
+
+  if(rasqal_pipeline_rowsource_next_match(rowsource, con))
+    return NULL;
+
+  return rasqal_pipeline_rowsource_make_row(rowsource, con);
+}
+
+
+static int
+rasqal_pipeline_rowsource_skip_rows(rasqal_rowsource* rowsource,
+                                    void *user_data, int count)
+{
+  rasqal_pipeline_rowsource_context *con;
+  int skipped = 0;
+
+  con = (rasqal_pipeline_rowsource_context*)user_data;
+
+  /* the matches are filtered but no rows are made */
+  while(skipped < count) {
+    int rc;
+
+    rc = rasqal_pipeline_rowsource_next_match(rowsource, con);
+    if(rc < 0)
+      return -1;
+    if(rc > 0)
+      break;
+
+    con->output_offset++;
+    skipped++;
+  }
+
+  return skipped;
+}
+
+
+static int
+rasqal_pipeline_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
+{
+  rasqal_pipeline_rowsource_context *con;
+
+  con = (rasqal_pipeline_rowsource_context*)user_data;
+
+  con->input_offset = 1;
+  con->output_offset = 1;
+  con->failed = 0;
+
+  return rasqal_rowsource_reset(con->rowsource);
+}
+
+
+static rasqal_rowsource*
+rasqal_pipeline_rowsource_get_inner_rowsource(rasqal_rowsource* rowsource,
+                                              void *user_data, int offset)
+{
+  rasqal_pipeline_rowsource_context *con;
+  con = (rasqal_pipeline_rowsource_context*)user_data;
+
+  if(offset == 0)
+    return con->rowsource;
+
+  return NULL;
+}
+
+
+static const rasqal_rowsource_handler rasqal_pipeline_rowsource_handler = {
+  /* .version =          */ 2,
+  "pipeline",
+  /* .init =             */ rasqal_pipeline_rowsource_init,
+  /* .finish =           */ rasqal_pipeline_rowsource_finish,
+  /* .ensure_variables = */ rasqal_pipeline_rowsource_ensure_variables,
+  /* .read_row =         */ rasqal_pipeline_rowsource_read_row,
+  /* .read_all_rows =    */ NULL,
+  /* .reset =            */ rasqal_pipeline_rowsource_reset,
+  /* .set_requirements = */ NULL,
+  /* .get_inner_rowsource = */ rasqal_pipeline_rowsource_get_inner_rowsource,
+  /* .set_origin =       */ NULL,
+  /* .skip_rows =        */ rasqal_pipeline_rowsource_skip_rows,
+  /* .read_batch =       */ NULL,
+  /* .estimate_rows =    */ NULL
+};
+
+
+/**
+ * rasqal_new_pipeline_rowsource:
+ * @world: world object
+ * @query: query object
+ * @triples_rowsource: input triple pattern rowsource
+ * @filters_seq: sequence of FILTER #rasqal_expression to apply in order (or NULL)
+ * @projection_variables: sequence of variables to project to (or NULL)
+ * @limit: slice limit or <0 for no limit
+ * @offset: slice offset or <=0 for no offset
+ *
+ * INTERNAL - create a new fused FILTER, PROJECT and SLICE rowsource over a triple pattern rowsource
+ *
+ * Gives the same rows as a slice rowsource over a project rowsource
+ * over filter rowsources over @triples_rowsource but without making
+ * intermediate rows.  @triples_rowsource must be made by
+ * rasqal_new_triples_rowsource().
+ *
+ * The @triples_rowsource and @filters_seq become owned by the new
+ * rowsource.  @projection_variables is copied.
+ *
+ * Return value: new rowsource or NULL on failure
+ */
+rasqal_rowsource*
+rasqal_new_pipeline_rowsource(rasqal_world *world,
+                              rasqal_query *query,
+                              rasqal_rowsource* triples_rowsource,
+                              raptor_sequence* filters_seq,
+                              raptor_sequence* projection_variables,
+                              int limit,
+                              int offset)
+{
+  rasqal_pipeline_rowsource_context *con;
+  int flags = 0;
+
+  if(!world || !query || !triples_rowsource)
+    goto fail;
+
+  con = RASQAL_CALLOC(rasqal_pipeline_rowsource_context*, 1, sizeof(*con));
+  if(!con)
+    goto fail;
+
+  con->rowsource = triples_rowsource;
+  con->filters_seq = filters_seq;
+  if(projection_variables) {
+    con->projection_variables = rasqal_variable_copy_variable_sequence(projection_variables);
+    if(!con->projection_variables) {
+      triples_rowsource = NULL;
+      filters_seq = NULL;
+      rasqal_pipeline_rowsource_finish(NULL, con);
+      goto fail;
+    }
+  }
+  con->row_limit = limit;
+  con->row_offset = offset;
+
+  return rasqal_new_rowsource_from_handler(world, query,
+                                           con,
+                                           &rasqal_pipeline_rowsource_handler,
+                                           query->vars_table,
+                                           flags);
+
+  fail:
+  if(triples_rowsource)
+    rasqal_free_rowsource(triples_rowsource);
+  if(filters_seq)
+    raptor_free_sequence(filters_seq);
+  return NULL;
+}
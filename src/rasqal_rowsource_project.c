@@ -57,6 +57,9 @@ typedef struct
   /* variables projection array: [output row var index]=input row var index */
   int* projection;
 
+  /* non-0 if any projected variable is set from an expression */
+  int has_expressions;
+
 } rasqal_project_rowsource_context;
 
 
@@ -106,6 +109,8 @@ rasqal_project_rowsource_ensure_variables(rasqal_rowsource* rowsource,
 
     rasqal_rowsource_add_variable(rowsource, v);
     con->projection[i] = offset;
+    if(offset < 0 && v->expression)
+      con->has_expressions = 1;
   }
 
   return 0;
@@ -133,67 +138,134 @@ rasqal_project_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
 }
 
 
+/*
+ * rasqal_project_rowsource_project_row:
+ * @rowsource: project rowsource
+ * @con: project rowsource context
+ * @row: input row (freed)
+ *
+ * INTERNAL - Make the projected row for an input row
+ *
+ * Return value: new row or NULL on failure
+ */
 static rasqal_row*
-rasqal_project_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
+rasqal_project_rowsource_project_row(rasqal_rowsource* rowsource,
+                                     rasqal_project_rowsource_context *con,
+                                     rasqal_row* row)
 {
-  rasqal_project_rowsource_context *con;
-  rasqal_row *row = NULL;
   rasqal_row* nrow = NULL;
-  
-  con = (rasqal_project_rowsource_context*)user_data;
-
-  row = rasqal_rowsource_read_row(con->rowsource);
-  if(row) {
-    int i;
+  int i;
     
-    nrow = rasqal_new_row_for_size(rowsource->world, rowsource->size);
-    if(!nrow)
-      goto failed;
+  nrow = rasqal_new_row_for_query(rowsource->world, rowsource->query,
+                                  rowsource->size);
+  if(!nrow)
+    goto failed;
 
-    rasqal_row_set_rowsource(nrow, rowsource);
-    nrow->offset = row->offset;
+  rasqal_row_set_rowsource(nrow, rowsource);
+  nrow->offset = row->offset;
       
-    for(i = 0; i < rowsource->size; i++) {
-      int offset = con->projection[i];
-      if(offset >= 0)
-        nrow->values[i] = rasqal_new_literal_from_literal(row->values[offset]);
-      else {
-        rasqal_variable* v;
-        rasqal_query *query = rowsource->query;
+  for(i = 0; i < rowsource->size; i++) {
+    int offset = con->projection[i];
+    if(offset >= 0)
+      nrow->values[i] = rasqal_new_literal_from_literal(row->values[offset]);
+    else {
+      rasqal_variable* v;
+      rasqal_query *query = rowsource->query;
         
-        v = (rasqal_variable*)raptor_sequence_get_at(con->projection_variables, i);
-        if(v && v->expression) {
-          int error = 0;
+      v = (rasqal_variable*)raptor_sequence_get_at(con->projection_variables, i);
+      if(v && v->expression) {
+        int error = 0;
 
-          if(v->value)
-            rasqal_free_literal(v->value);
+        if(v->value)
+          rasqal_free_literal(v->value);
           
-          v->value = rasqal_expression_evaluate2(v->expression,
-                                                 query->eval_context,
-                                                 &error);
-          if(error) {
-            /* FIXME: Errors are ignored - check this */
+        v->value = rasqal_expression_evaluate2(v->expression,
+                                               query->eval_context,
+                                               &error);
+        rowsource->stats.expressions++;
+        if(error) {
+          /* FIXME: Errors are ignored - check this */
 #if 0
-            goto failed;
+          goto failed;
 #endif
-          } else
-            nrow->values[i] = rasqal_new_literal_from_literal(v->value);
+        } else
+          nrow->values[i] = rasqal_new_literal_from_literal(v->value);
 
-        }
       }
     }
-
-    rasqal_free_row(row);
-    row = nrow;
   }
-  
-  return row;
 
   failed:
+  rasqal_free_row(row);
+  
+  return nrow;
+}
+
+
+static rasqal_row*
+rasqal_project_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
+{
+  rasqal_project_rowsource_context *con;
+  rasqal_row *row = NULL;
+  
+  con = (rasqal_project_rowsource_context*)user_data;
+
+  row = rasqal_rowsource_read_row(con->rowsource);
   if(row)
-    rasqal_free_row(row);
+    row = rasqal_project_rowsource_project_row(rowsource, con, row);
   
-  return NULL;
+  return row;
+}
+
+
+static int
+rasqal_project_rowsource_read_batch(rasqal_rowsource* rowsource,
+                                    void *user_data,
+                                    rasqal_row** rows, int size)
+{
+  rasqal_project_rowsource_context *con;
+  int count;
+  int i;
+  
+  con = (rasqal_project_rowsource_context*)user_data;
+
+  /* input rows are projected in place in @rows */
+  count = rasqal_rowsource_read_batch(con->rowsource, rows, size);
+  if(count <= 0)
+    return count;
+
+  for(i = 0; i < count; i++) {
+    /* expressions are evaluated over the variables so bind them */
+    if(con->has_expressions)
+      rasqal_row_bind_variables(rows[i], rowsource->query->vars_table);
+
+    rows[i] = rasqal_project_rowsource_project_row(rowsource, con, rows[i]);
+    if(!rows[i]) {
+      int j;
+
+      /* free the projected rows before and the input rows after */
+      for(j = 0; j < count; j++) {
+        if(j != i)
+          rasqal_free_row(rows[j]);
+      }
+      return -1;
+    }
+  }
+
+  return count;
+}
+
+
+static int
+rasqal_project_rowsource_skip_rows(rasqal_rowsource* rowsource,
+                                   void *user_data, int count)
+{
+  rasqal_project_rowsource_context *con;
+  con = (rasqal_project_rowsource_context*)user_data;
+
+  /* one output row per input row and the projected expressions
+   * have no effect on skipped rows */
+  return rasqal_rowsource_skip_rows(con->rowsource, count);
 }
 
 
@@ -207,6 +279,21 @@ rasqal_project_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
 }
 
 
+static int
+rasqal_project_rowsource_set_requirements(rasqal_rowsource* rowsource,
+                                          void *user_data, unsigned int flags)
+{
+  rasqal_project_rowsource_context *con;
+  con = (rasqal_project_rowsource_context*)user_data;
+
+  if(flags & RASQAL_ROWSOURCE_REQUIRE_ROWS_LIMIT)
+    /* one output row per input row */
+    rasqal_rowsource_set_rows_needed(con->rowsource, rowsource->rows_needed);
+
+  return 0;
+}
+
+
 static rasqal_rowsource*
 rasqal_project_rowsource_get_inner_rowsource(rasqal_rowsource* rowsource,
                                              void *user_data, int offset)
@@ -221,7 +308,7 @@ rasqal_project_rowsource_get_inner_rowsource(rasqal_rowsource* rowsource,
 
 
 static const rasqal_rowsource_handler rasqal_project_rowsource_handler = {
-  /* .version =          */ 1,
+  /* .version =          */ 2,
   "project",
   /* .init =             */ rasqal_project_rowsource_init,
   /* .finish =           */ rasqal_project_rowsource_finish,
@@ -229,9 +316,12 @@ static const rasqal_rowsource_handler rasqal_project_rowsource_handler = {
   /* .read_row =         */ rasqal_project_rowsource_read_row,
   /* .read_all_rows =    */ NULL,
   /* .reset =            */ rasqal_project_rowsource_reset,
-  /* .set_requirements = */ NULL,
+  /* .set_requirements = */ rasqal_project_rowsource_set_requirements,
   /* .get_inner_rowsource = */ rasqal_project_rowsource_get_inner_rowsource,
   /* .set_origin =       */ NULL,
+  /* .skip_rows =        */ rasqal_project_rowsource_skip_rows,
+  /* .read_batch =       */ rasqal_project_rowsource_read_batch,
+  /* .estimate_rows =    */ NULL
 };
 
 
@@ -310,6 +400,218 @@ const char* const project_1_var_names[] = { "c", "b" };
 #define EXPECTED_COLUMNS_COUNT 2
 
 
+/* rows of ?x = 0.. and ?y = ?x mod 3 for the batch test, enough to
+ * need several batches after the FILTER(?y != 0) */
+#define BATCH_TEST_ROWS_COUNT (3 * RASQAL_ROWSOURCE_BATCH_SIZE)
+#define BATCH_TEST_EXPECTED_ROWS_COUNT (2 * RASQAL_ROWSOURCE_BATCH_SIZE)
+
+
+/* make SELECT ?x WHERE { ... FILTER(?y != 0) } over the batch test rows */
+static rasqal_rowsource*
+project_batch_test_new_rowsource(rasqal_world* world, rasqal_query* query,
+                                 rasqal_variable* x, rasqal_variable* y,
+                                 raptor_sequence* projection_seq)
+{
+  rasqal_rowsource* rs;
+  raptor_sequence* seq;
+  raptor_sequence* vars_seq;
+  rasqal_expression* arg1;
+  rasqal_expression* arg2;
+  rasqal_expression* expr;
+  rasqal_literal* l;
+  int i;
+
+  seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_row,
+                            (raptor_data_print_handler)rasqal_row_print);
+  vars_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_variable,
+                                 (raptor_data_print_handler)rasqal_variable_print);
+  if(!seq || !vars_seq)
+    goto failed;
+
+  raptor_sequence_push(vars_seq, rasqal_new_variable_from_variable(x));
+  raptor_sequence_push(vars_seq, rasqal_new_variable_from_variable(y));
+
+  for(i = 0; i < BATCH_TEST_ROWS_COUNT; i++) {
+    rasqal_row* row = rasqal_new_row_for_size(world, 2);
+    if(!row)
+      goto failed;
+
+    l = rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER, i);
+    rasqal_row_set_value_at(row, 0, l);
+    rasqal_free_literal(l);
+    l = rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER, i % 3);
+    rasqal_row_set_value_at(row, 1, l);
+    rasqal_free_literal(l);
+
+    raptor_sequence_push(seq, row);
+  }
+
+  rs = rasqal_new_rowsequence_rowsource(world, query, query->vars_table,
+                                        seq, vars_seq);
+  /* seq and vars_seq are now owned by rs */
+  seq = vars_seq = NULL;
+  if(!rs)
+    goto failed;
+
+  l = rasqal_new_variable_literal(world, rasqal_new_variable_from_variable(y));
+  arg1 = rasqal_new_literal_expression(world, l);
+  l = rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER, 0);
+  arg2 = rasqal_new_literal_expression(world, l);
+  expr = rasqal_new_2op_expression(world, RASQAL_EXPR_NEQ, arg1, arg2);
+  if(!expr) {
+    rasqal_free_rowsource(rs);
+    goto failed;
+  }
+
+  /* rs and expr are freed on failure */
+  rs = rasqal_new_filter_rowsource(world, query, rs, expr);
+  if(!rs)
+    goto failed;
+  rasqal_free_expression(expr);
+
+  return rasqal_new_project_rowsource(world, query, rs, projection_seq);
+
+  failed:
+  if(seq)
+    raptor_free_sequence(seq);
+  if(vars_seq)
+    raptor_free_sequence(vars_seq);
+  return NULL;
+}
+
+
+/*
+ * Read filtered and projected rows in batches and one at a time and
+ * check both return the same rows in the same order
+ */
+static int
+project_batch_test(const char* program, rasqal_world* world)
+{
+  rasqal_query* query;
+  rasqal_variable* x = NULL;
+  rasqal_variable* y = NULL;
+  raptor_sequence* projection_seq = NULL;
+  rasqal_rowsource* batch_rs = NULL;
+  rasqal_rowsource* row_rs = NULL;
+  rasqal_row* rows[RASQAL_ROWSOURCE_BATCH_SIZE];
+  raptor_sequence* batch_seq = NULL;
+  int failures = 0;
+  int count;
+  int i;
+
+  query = rasqal_new_query(world, "sparql", NULL);
+  if(!query) {
+    fprintf(stderr, "%s: failed to create query\n", program);
+    return 1;
+  }
+
+  x = rasqal_variables_table_add2(query->vars_table, RASQAL_VARIABLE_TYPE_NORMAL,
+                                  (const unsigned char*)"x", 1, NULL);
+  y = rasqal_variables_table_add2(query->vars_table, RASQAL_VARIABLE_TYPE_NORMAL,
+                                  (const unsigned char*)"y", 1, NULL);
+  projection_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_variable,
+                                       (raptor_data_print_handler)rasqal_variable_print);
+  batch_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_row,
+                                  (raptor_data_print_handler)rasqal_row_print);
+  if(!x || !y || !projection_seq || !batch_seq) {
+    fprintf(stderr, "%s: failed to create batch test variables\n", program);
+    failures++;
+    goto tidy;
+  }
+  raptor_sequence_push(projection_seq, rasqal_new_variable_from_variable(x));
+
+  batch_rs = project_batch_test_new_rowsource(world, query, x, y,
+                                              projection_seq);
+  row_rs = project_batch_test_new_rowsource(world, query, x, y,
+                                            projection_seq);
+  if(!batch_rs || !row_rs) {
+    fprintf(stderr, "%s: failed to create batch test rowsources\n", program);
+    failures++;
+    goto tidy;
+  }
+
+  while(1) {
+    count = rasqal_rowsource_read_batch(batch_rs, rows,
+                                        RASQAL_ROWSOURCE_BATCH_SIZE);
+    if(count < 0) {
+      fprintf(stderr, "%s: read_batch failed for a project rowsource\n",
+              program);
+      failures++;
+      goto tidy;
+    }
+    if(!count)
+      break;
+
+    for(i = 0; i < count; i++)
+      raptor_sequence_push(batch_seq, rows[i]);
+  }
+
+  count = raptor_sequence_size(batch_seq);
+  if(count != BATCH_TEST_EXPECTED_ROWS_COUNT) {
+    fprintf(stderr,
+            "%s: read_batch returned %d rows for a project rowsource, expected %d\n",
+            program, count, BATCH_TEST_EXPECTED_ROWS_COUNT);
+    failures++;
+    goto tidy;
+  }
+
+  for(i = 0; i < count; i++) {
+    rasqal_row* batch_row = (rasqal_row*)raptor_sequence_get_at(batch_seq, i);
+    rasqal_row* row = rasqal_rowsource_read_row(row_rs);
+    /* the i-th value of ?x not a multiple of 3 */
+    int expected = i + i / 2 + 1;
+    int error = 0;
+    int value;
+
+    if(!row) {
+      fprintf(stderr,
+              "%s: read_row returned %d rows for a project rowsource, expected %d\n",
+              program, i, count);
+      failures++;
+      goto tidy;
+    }
+
+    value = rasqal_literal_as_integer(batch_row->values[0], &error);
+    if(batch_row->size != 1 || error || value != expected ||
+       row->size != 1 ||
+       !rasqal_literal_equals(batch_row->values[0], row->values[0])) {
+      fprintf(stderr,
+              "%s: read_batch row %d differs from read_row or expected ?x = %d\n",
+              program, i, expected);
+      failures++;
+      rasqal_free_row(row);
+      goto tidy;
+    }
+
+    rasqal_free_row(row);
+  }
+
+  if(rasqal_rowsource_read_row(row_rs)) {
+    fprintf(stderr,
+            "%s: read_row returned more rows than read_batch for a project rowsource\n",
+            program);
+    failures++;
+  }
+
+  tidy:
+  if(batch_seq)
+    raptor_free_sequence(batch_seq);
+  if(batch_rs)
+    rasqal_free_rowsource(batch_rs);
+  if(row_rs)
+    rasqal_free_rowsource(row_rs);
+  if(projection_seq)
+    raptor_free_sequence(projection_seq);
+  if(x)
+    rasqal_free_variable(x);
+  if(y)
+    rasqal_free_variable(y);
+  rasqal_free_query(query);
+
+  return failures;
+}
+
+
 int
 main(int argc, char *argv[]) 
 {
@@ -444,8 +746,11 @@ main(int argc, char *argv[])
     rasqal_free_rowsource(rowsource);
   if(query)
     rasqal_free_query(query);
-  if(world)
+
+  if(world) {
+    failures += project_batch_test(program, world);
     rasqal_free_world(world);
+  }
 
   return failures;
 }
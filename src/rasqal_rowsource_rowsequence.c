@@ -188,6 +188,34 @@ rasqal_rowsequence_rowsource_read_all_rows(rasqal_rowsource* rowsource,
 }
 
 
+static int
+rasqal_rowsequence_rowsource_skip_rows(rasqal_rowsource* rowsource,
+                                       void *user_data, int count)
+{
+  rasqal_rowsequence_rowsource_context* con;
+  int size;
+  int skipped;
+  
+  con = (rasqal_rowsequence_rowsource_context*)user_data;
+  if(con->failed || con->offset < 0)
+    return 0;
+
+  size = raptor_sequence_size(con->seq);
+  skipped = size - con->offset;
+  if(skipped > count)
+    skipped = count;
+  if(skipped < 0)
+    skipped = 0;
+
+  con->offset += skipped;
+  if(skipped < count)
+    /* finished */
+    con->offset = -1;
+
+  return skipped;
+}
+
+
 static int
 rasqal_rowsequence_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
 {
@@ -201,8 +229,20 @@ rasqal_rowsequence_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
 }
 
 
+static long
+rasqal_rowsequence_rowsource_estimate_rows(rasqal_rowsource* rowsource,
+                                           void *user_data)
+{
+  rasqal_rowsequence_rowsource_context* con;
+
+  con = (rasqal_rowsequence_rowsource_context*)user_data;
+
+  return raptor_sequence_size(con->seq);
+}
+
+
 static const rasqal_rowsource_handler rasqal_rowsequence_rowsource_handler = {
-  /* .version = */ 1,
+  /* .version = */ 3,
   "rowsequence",
   /* .init = */ rasqal_rowsequence_rowsource_init,
   /* .finish = */ rasqal_rowsequence_rowsource_finish,
@@ -213,6 +253,9 @@ static const rasqal_rowsource_handler rasqal_rowsequence_rowsource_handler = {
   /* .set_requirements = */ NULL,
   /* .get_inner_rowsource = */ NULL,
   /* .set_origin = */ NULL,
+  /* .skip_rows = */ rasqal_rowsequence_rowsource_skip_rows,
+  /* .read_batch = */ NULL,
+  /* .estimate_rows = */ rasqal_rowsequence_rowsource_estimate_rows
 };
 
 
@@ -461,6 +504,73 @@ main(int argc, char *argv[])
   rasqal_free_rowsource(rowsource); rowsource = NULL;
   rasqal_free_variables_table(vt); vt = NULL;
 
+  /* test skipping rows in a 3-row rowsource */
+  rows_count = 3;
+
+#ifdef RASQAL_DEBUG  
+  RASQAL_DEBUG2("Testing skipping rows in %d-row rowsource\n", rows_count);
+#endif
+
+  vt = rasqal_new_variables_table(world);
+
+  seq = rasqal_new_row_sequence(world, vt, test_3_rows, 4, &vars_seq);
+  if(!seq) {
+    fprintf(stderr, "%s: failed to create sequence of %d rows\n",
+            program, rows_count);
+    failures++;
+    goto tidy;
+  }
+
+  rowsource = rasqal_new_rowsequence_rowsource(world, query, vt, seq, vars_seq);
+  if(!rowsource) {
+    fprintf(stderr, "%s: failed to create %d-row sequence rowsource\n",
+            program, rows_count);
+    failures++;
+    goto tidy;
+  }
+  /* vars_seq and seq are now owned by rowsource */
+  vars_seq = seq = NULL;
+
+  count = rasqal_rowsource_skip_rows(rowsource, 2);
+  if(count != 2) {
+    fprintf(stderr,
+            "%s: skip_rows returned %d instead of 2 for a %d-row sequence rowsource\n",
+            program, count, rows_count);
+    failures++;
+    goto tidy;
+  }
+
+  row = rasqal_rowsource_read_row(rowsource);
+  if(!row) {
+    fprintf(stderr,
+            "%s: read_row returned no row after skipping 2 rows in a %d-row sequence rowsource\n",
+            program, rows_count);
+    failures++;
+    goto tidy;
+  }
+  rasqal_free_row(row); row = NULL;
+
+  count = rasqal_rowsource_skip_rows(rowsource, 5);
+  if(count != 0) {
+    fprintf(stderr,
+            "%s: skip_rows returned %d instead of 0 at the end of a %d-row sequence rowsource\n",
+            program, count, rows_count);
+    failures++;
+    goto tidy;
+  }
+
+  count = rasqal_rowsource_get_rows_count(rowsource);
+  if(count != rows_count) {
+    fprintf(stderr,
+            "%s: rows count %d instead of %d after skipping rows in a %d-row sequence rowsource\n",
+            program, count, rows_count, rows_count);
+    failures++;
+    goto tidy;
+  }
+
+  rasqal_free_rowsource(rowsource); rowsource = NULL;
+  rasqal_free_variables_table(vt); vt = NULL;
+
 
   tidy:
   if(row)
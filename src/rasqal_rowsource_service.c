@@ -149,6 +149,9 @@ static const rasqal_rowsource_handler rasqal_service_rowsource_handler = {
   /* .set_preserve = */ NULL,
   /* .get_inner_rowsource = */ NULL,
   /* .set_origin = */ NULL,
+  /* .skip_rows = */ NULL,
+  /* .read_batch = */ NULL,
+  /* .estimate_rows = */ NULL
 };
 
 
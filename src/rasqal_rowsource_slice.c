@@ -34,6 +34,10 @@
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
+/* for INT_MAX */
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
 
 #include <raptor.h>
 
@@ -79,6 +83,36 @@ rasqal_slice_rowsource_ensure_variables(rasqal_rowsource* rowsource,
 }
 
 
+/*
+ * rasqal_slice_rowsource_input_rows_needed:
+ * @rowsource: slice rowsource
+ * @con: slice rowsource context
+ *
+ * INTERNAL - Calculate the number of rows needed from the inner rowsource
+ *
+ * This is the offset plus the smaller of the limit and the number of
+ * rows needed by the consumer of this rowsource.
+ *
+ * Return value: number of rows or <0 if all rows are needed
+ */
+static int
+rasqal_slice_rowsource_input_rows_needed(rasqal_rowsource* rowsource,
+                                         rasqal_slice_rowsource_context *con)
+{
+  int limit = con->row_limit;
+  int offset = (con->row_offset > 0) ? con->row_offset : 0;
+
+  if(rowsource->rows_needed >= 0 &&
+     (limit < 0 || rowsource->rows_needed < limit))
+    limit = rowsource->rows_needed;
+
+  if(limit < 0 || limit > INT_MAX - offset)
+    return -1;
+
+  return offset + limit;
+}
+
+
 static int
 rasqal_slice_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
 {
@@ -89,6 +123,9 @@ rasqal_slice_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
   con->input_offset = 1;
   con->output_offset = 1;
 
+  rasqal_rowsource_set_rows_needed(con->rowsource,
+                                   rasqal_slice_rowsource_input_rows_needed(rowsource, con));
+
   return 0;
 }
 
@@ -109,6 +146,34 @@ rasqal_slice_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
 }
 
 
+/*
+ * rasqal_slice_rowsource_skip_offset:
+ * @con: slice rowsource context
+ *
+ * INTERNAL - Skip inner rowsource rows before the start of the range
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_slice_rowsource_skip_offset(rasqal_slice_rowsource_context *con)
+{
+  int count = con->row_offset - con->input_offset + 1;
+  int skipped;
+
+  if(count <= 0)
+    return 0;
+
+  skipped = rasqal_rowsource_skip_rows(con->rowsource, count);
+  if(skipped < 0)
+    return 1;
+
+  RASQAL_DEBUG3("slice skipped %d of %d rows before range\n", skipped, count);
+  con->input_offset += skipped;
+
+  return 0;
+}
+
+
 static rasqal_row*
 rasqal_slice_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
 {
@@ -117,9 +182,19 @@ rasqal_slice_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
   
   con = (rasqal_slice_rowsource_context*)user_data;
 
+  if(rasqal_slice_rowsource_skip_offset(con))
+    return NULL;
+
   while(1) {
     int check;
 
+    /* do not pull another row from the inner rowsource if the
+     * range has already been returned */
+    if(rasqal_query_check_limit_offset_core(con->input_offset,
+                                            con->row_limit,
+                                            con->row_offset) > 0)
+      break;
+
     row = rasqal_rowsource_read_row(con->rowsource);
     if(!row)
       break;
@@ -154,6 +229,77 @@ rasqal_slice_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
 }
 
 
+static int
+rasqal_slice_rowsource_read_batch(rasqal_rowsource* rowsource,
+                                  void *user_data,
+                                  rasqal_row** rows, int size)
+{
+  rasqal_slice_rowsource_context *con;
+  int count;
+  int i;
+
+  con = (rasqal_slice_rowsource_context*)user_data;
+
+  if(rasqal_slice_rowsource_skip_offset(con))
+    return -1;
+
+  /* do not read past the end of the range */
+  if(con->row_limit >= 0) {
+    int offset = (con->row_offset > 0) ? con->row_offset : 0;
+    int remaining = offset + con->row_limit - con->input_offset + 1;
+
+    if(remaining <= 0)
+      return 0;
+    if(size > remaining)
+      size = remaining;
+  }
+
+  count = rasqal_rowsource_read_batch(con->rowsource, rows, size);
+  if(count <= 0)
+    return count;
+
+  con->input_offset += count;
+  for(i = 0; i < count; i++)
+    rows[i]->offset = con->output_offset++;
+
+  return count;
+}
+
+
+static int
+rasqal_slice_rowsource_skip_rows(rasqal_rowsource* rowsource,
+                                 void *user_data, int count)
+{
+  rasqal_slice_rowsource_context *con;
+  int skipped;
+
+  con = (rasqal_slice_rowsource_context*)user_data;
+
+  if(rasqal_slice_rowsource_skip_offset(con))
+    return -1;
+
+  /* do not skip past the end of the range */
+  if(con->row_limit >= 0) {
+    int offset = (con->row_offset > 0) ? con->row_offset : 0;
+    int remaining = offset + con->row_limit - con->input_offset + 1;
+
+    if(remaining < 0)
+      remaining = 0;
+    if(count > remaining)
+      count = remaining;
+  }
+
+  skipped = rasqal_rowsource_skip_rows(con->rowsource, count);
+  if(skipped < 0)
+    return -1;
+
+  con->input_offset += skipped;
+  con->output_offset += skipped;
+
+  return skipped;
+}
+
+
 static int
 rasqal_slice_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
 {
@@ -168,6 +314,22 @@ rasqal_slice_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
 }
 
 
+static int
+rasqal_slice_rowsource_set_requirements(rasqal_rowsource* rowsource,
+                                        void *user_data, unsigned int flags)
+{
+  rasqal_slice_rowsource_context *con;
+
+  con = (rasqal_slice_rowsource_context*)user_data;
+
+  if(flags & RASQAL_ROWSOURCE_REQUIRE_ROWS_LIMIT)
+    rasqal_rowsource_set_rows_needed(con->rowsource,
+                                     rasqal_slice_rowsource_input_rows_needed(rowsource, con));
+
+  return 0;
+}
+
+
 static rasqal_rowsource*
 rasqal_slice_rowsource_get_inner_rowsource(rasqal_rowsource* rowsource,
                                             void *user_data, int offset)
@@ -182,8 +344,31 @@ rasqal_slice_rowsource_get_inner_rowsource(rasqal_rowsource* rowsource,
 }
 
 
+static long
+rasqal_slice_rowsource_estimate_rows(rasqal_rowsource* rowsource,
+                                     void *user_data)
+{
+  rasqal_slice_rowsource_context *con;
+  long estimate;
+
+  con = (rasqal_slice_rowsource_context*)user_data;
+
+  estimate = rasqal_rowsource_estimate_rows(con->rowsource);
+  if(estimate >= 0 && con->row_offset > 0) {
+    estimate -= con->row_offset;
+    if(estimate < 0)
+      estimate = 0;
+  }
+
+  if(con->row_limit >= 0 && (estimate < 0 || estimate > con->row_limit))
+    estimate = con->row_limit;
+
+  return estimate;
+}
+
+
 static const rasqal_rowsource_handler rasqal_slice_rowsource_handler = {
-  /* .version =          */ 1,
+  /* .version =          */ 3,
   "slice",
   /* .init =             */ rasqal_slice_rowsource_init,
   /* .finish =           */ rasqal_slice_rowsource_finish,
@@ -191,9 +376,12 @@ static const rasqal_rowsource_handler rasqal_slice_rowsource_handler = {
   /* .read_row =         */ rasqal_slice_rowsource_read_row,
   /* .read_all_rows =    */ NULL,
   /* .reset =            */ rasqal_slice_rowsource_reset,
-  /* .set_requirements = */ NULL,
+  /* .set_requirements = */ rasqal_slice_rowsource_set_requirements,
   /* .get_inner_rowsource = */ rasqal_slice_rowsource_get_inner_rowsource,
   /* .set_origin =       */ NULL,
+  /* .skip_rows =        */ rasqal_slice_rowsource_skip_rows,
+  /* .read_batch =       */ rasqal_slice_rowsource_read_batch,
+  /* .estimate_rows =    */ rasqal_slice_rowsource_estimate_rows
 };
 
 
@@ -100,6 +100,116 @@ rasqal_sort_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
 }
 
 
+/*
+ * rasqal_sort_rowsource_process_top:
+ * @rowsource: sort rowsource
+ * @con: sort rowsource context
+ * @top_size: number of rows to keep
+ *
+ * INTERNAL - Sort keeping only the first @top_size rows in order
+ *
+ * Used when the consumer has said it will read at most @top_size
+ * rows, such as ORDER BY with LIMIT.  Keeps a sorted array of at
+ * most @top_size rows so that memory use does not grow with the
+ * number of input rows and rows that sort after the last kept row
+ * are freed straight away.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_sort_rowsource_process_top(rasqal_rowsource* rowsource,
+                                  rasqal_sort_rowsource_context* con,
+                                  int top_size)
+{
+  rasqal_query* query = rowsource->query;
+  rasqal_row** top = NULL;
+  int top_count = 0;
+  int offset = 0;
+  int rc = 0;
+  int i;
+
+  /* the map is not used for a top sort */
+  if(con->map) {
+    rasqal_free_map(con->map);
+    con->map = NULL;
+  }
+
+  if(top_size > 0) {
+    top = RASQAL_CALLOC(rasqal_row**, RASQAL_GOOD_CAST(size_t, top_size),
+                        sizeof(rasqal_row*));
+    if(!top)
+      return 1;
+  }
+
+  while(top_size > 0) {
+    rasqal_row* row;
+    int low;
+    int high;
+
+    row = rasqal_rowsource_read_row(con->rowsource);
+    if(!row)
+      break;
+
+    if(rasqal_row_set_order_size(row, con->order_size)) {
+      rasqal_free_row(row);
+      rc = 1;
+      break;
+    }
+
+    rasqal_engine_rowsort_calculate_order_values(query, con->order_seq, row);
+    rowsource->stats.expressions += con->order_size;
+
+    row->offset = offset++;
+
+    /* full and the row sorts after the last kept row: discard it */
+    if(top_count == top_size &&
+       rasqal_engine_rowsort_compare_rows(query->compare_flags, con->order_seq,
+                                          row, top[top_count - 1]) > 0) {
+      rasqal_free_row(row);
+      continue;
+    }
+
+    /* binary search for the insertion point */
+    low = 0;
+    high = top_count;
+    while(low < high) {
+      int mid = low + (high - low) / 2;
+
+      if(rasqal_engine_rowsort_compare_rows(query->compare_flags,
+                                            con->order_seq,
+                                            row, top[mid]) < 0)
+        high = mid;
+      else
+        low = mid + 1;
+    }
+
+    if(top_count == top_size) {
+      top_count--;
+      rasqal_free_row(top[top_count]);
+    }
+
+    if(low < top_count)
+      memmove(&top[low + 1], &top[low],
+              RASQAL_GOOD_CAST(size_t, top_count - low) * sizeof(rasqal_row*));
+    top[low] = row;
+    top_count++;
+  }
+
+  /* move the kept rows into the result sequence in order */
+  for(i = 0; i < top_count; i++) {
+    if(rc)
+      rasqal_free_row(top[i]);
+    else if(raptor_sequence_push(con->seq, top[i]))
+      rc = 1;
+  }
+
+  if(top)
+    RASQAL_FREE(rasqal_row**, top);
+
+  return rc;
+}
+
+
 static int
 rasqal_sort_rowsource_process(rasqal_rowsource* rowsource,
                               rasqal_sort_rowsource_context* con)
@@ -114,6 +224,11 @@ rasqal_sort_rowsource_process(rasqal_rowsource* rowsource,
                                  (raptor_data_print_handler)rasqal_row_print);
   if(!con->seq)
     return 1;
+
+  /* only the first rows_needed rows will be read so keep just those */
+  if(!con->distinct && rowsource->rows_needed >= 0)
+    return rasqal_sort_rowsource_process_top(rowsource, con,
+                                             rowsource->rows_needed);
   
   while(1) {
     rasqal_row* row;
@@ -128,6 +243,7 @@ rasqal_sort_rowsource_process(rasqal_rowsource* rowsource,
     }
 
     rasqal_engine_rowsort_calculate_order_values(rowsource->query, con->order_seq, row);
+    rowsource->stats.expressions += con->order_size;
 
     row->offset = offset;
 
@@ -241,6 +357,9 @@ static const rasqal_rowsource_handler rasqal_sort_rowsource_handler = {
   /* .set_requirements = */ NULL,
   /* .get_inner_rowsource = */ rasqal_sort_rowsource_get_inner_rowsource,
   /* .set_origin =       */ NULL,
+  /* .skip_rows =        */ NULL,
+  /* .read_batch =       */ NULL,
+  /* .estimate_rows =    */ NULL
 };
 
 
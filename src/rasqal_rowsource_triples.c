@@ -75,9 +75,74 @@ typedef struct
 
   /* GRAPH origin to use */
   rasqal_literal *origin;
+
+  /* range of matches of the first triple pattern to use: from
+   * @range_start up to and excluding @range_end or to the end if <0 */
+  int range_start;
+  int range_end;
+
+  /* index of the current match of the first triple pattern */
+  int first_index;
+
+  /* subplan evaluating morsels of the first triple pattern matches on
+   * worker threads or NULL */
+  rasqal_subplan* subplan;
+
+  /* number and size of the morsels */
+  int morsels;
+  int morsel_size;
+
+  /* non-0 if rows may be returned in any order */
+  int unordered;
+
+  /* morsel tasks once started or NULL */
+  rasqal_subplan_tasks* tasks;
 } rasqal_triples_rowsource_context;
 
 
+/*
+ * rasqal_triples_rowsource_origin_bound:
+ * @con: triples rowsource context
+ * @v: variable
+ * @column: triple pattern column
+ *
+ * INTERNAL - Test if a triple pattern before @column has origin variable @v
+ *
+ * Return value: non-0 if @v is bound as an origin before @column
+ */
+static int
+rasqal_triples_rowsource_origin_bound(rasqal_triples_rowsource_context *con,
+                                      rasqal_variable* v, int column)
+{
+  int i;
+
+  for(i = con->start_column; i < column; i++) {
+    rasqal_triple *t;
+
+    t = (rasqal_triple*)raptor_sequence_get_at(con->triples, i);
+    if(t->origin && rasqal_literal_as_variable(t->origin) == v)
+      return 1;
+  }
+
+  return 0;
+}
+
+
+static int
+rasqal_triples_rowsource_has_variable(rasqal_rowsource* rowsource,
+                                      rasqal_variable* v)
+{
+  int i;
+
+  for(i = 0; i < raptor_sequence_size(rowsource->variables_sequence); i++) {
+    if(raptor_sequence_get_at(rowsource->variables_sequence, i) == v)
+      return 1;
+  }
+
+  return 0;
+}
+
+
 static int
 rasqal_triples_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
 {
@@ -134,6 +199,20 @@ rasqal_triples_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
        rasqal_query_variable_bound_in_triple(query, v, column) & RASQAL_TRIPLE_OBJECT)
       m->parts = (rasqal_triple_parts)(m->parts | RASQAL_TRIPLE_OBJECT);
 
+    /* A GRAPH variable origin is bound from the matched triple's
+     * origin by the first triple pattern that has it */
+    if(t->origin && (v = rasqal_literal_as_variable(t->origin)) &&
+       !rasqal_triples_rowsource_origin_bound(con, v, column)) {
+      m->parts = (rasqal_triple_parts)(m->parts | RASQAL_TRIPLE_ORIGIN);
+
+      if(!rasqal_triples_rowsource_has_variable(rowsource, v)) {
+        v = rasqal_new_variable_from_variable(v);
+        if(raptor_sequence_push(rowsource->variables_sequence, v))
+          return -1;
+        con->size++;
+      }
+    }
+
     RASQAL_DEBUG4("triple pattern column %d has parts %s (%u)\n", column,
                   rasqal_engine_get_parts_string(m->parts), m->parts);
 
@@ -177,6 +256,12 @@ rasqal_triples_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
   if(con->origin)
     rasqal_free_literal(con->origin);
 
+  if(con->tasks)
+    rasqal_free_subplan_tasks(con->tasks);
+
+  if(con->subplan)
+    rasqal_free_subplan(con->subplan);
+
   RASQAL_FREE(rasqal_triples_rowsource_context, con);
 
   return 0;
@@ -194,6 +279,12 @@ rasqal_triples_rowsource_get_next_row(rasqal_rowsource* rowsource,
     rasqal_triple_meta *m;
     rasqal_triple *t;
 
+    /* stop a long search if the execution was cancelled or timed out */
+    if(RASQAL_EXECUTION_CHECK(rowsource->execution)) {
+      error = rowsource->execution->error;
+      break;
+    }
+
     m = &con->triple_meta[con->column - con->start_column];
     t = (rasqal_triple*)raptor_sequence_get_at(con->triples, con->column);
 
@@ -211,10 +302,28 @@ rasqal_triples_rowsource_get_next_row(rasqal_rowsource* rowsource,
         error = RASQAL_ENGINE_FAILED;
         break;
       }
+      rowsource->stats.triples_matches++;
       RASQAL_DEBUG2("made new triples match for column %d\n", con->column);
     }
 
 
+    if(con->column == con->start_column) {
+      /* step over the matches before the range without binding */
+      while(con->first_index < con->range_start &&
+            !rasqal_triples_match_is_end(m->triples_match)) {
+        rasqal_triples_match_next_match(m->triples_match);
+        rowsource->stats.triples_next_matches++;
+        con->first_index++;
+      }
+
+      if(con->range_end >= 0 && con->first_index >= con->range_end) {
+        RASQAL_DEBUG2("end of range of first triple pattern at match %d\n",
+                      con->first_index);
+        error = RASQAL_ENGINE_FINISHED;
+        break;
+      }
+    }
+
     if(rasqal_triples_match_is_end(m->triples_match)) {
       RASQAL_DEBUG2("end of pattern triples match for column %d\n",
                     con->column);
@@ -237,6 +346,9 @@ rasqal_triples_rowsource_get_next_row(rasqal_rowsource* rowsource,
                     con->column, rasqal_engine_get_parts_string(parts), parts);
       if(!parts) {
         rasqal_triples_match_next_match(m->triples_match);
+        rowsource->stats.triples_next_matches++;
+        if(con->column == con->start_column)
+          con->first_index++;
         continue;
       }
     } else {
@@ -244,6 +356,9 @@ rasqal_triples_rowsource_get_next_row(rasqal_rowsource* rowsource,
     }
 
     rasqal_triples_match_next_match(m->triples_match);
+    rowsource->stats.triples_next_matches++;
+    if(con->column == con->start_column)
+      con->first_index++;
 
     if(con->column == con->end_column)
       /* finished matching all columns - return result */
@@ -257,16 +372,139 @@ rasqal_triples_rowsource_get_next_row(rasqal_rowsource* rowsource,
 }
 
 
+/*
+ * rasqal_triples_rowsource_make_row:
+ * @rowsource: triples rowsource
+ * @con: triples rowsource context
+ *
+ * INTERNAL - Make a row from the current variable bindings
+ *
+ * Return value: new row or NULL on failure
+ */
+static rasqal_row*
+rasqal_triples_rowsource_make_row(rasqal_rowsource* rowsource,
+                                  rasqal_triples_rowsource_context *con)
+{
+  rasqal_row* row;
+  int i;
+
+  row = rasqal_new_row(rowsource);
+  if(!row)
+    return NULL;
+
+  for(i = 0; i < row->size; i++) {
+    rasqal_variable* v;
+    v = rasqal_rowsource_get_variable_by_offset(rowsource, i);
+    if(row->values[i])
+      rasqal_free_literal(row->values[i]);
+    row->values[i] = rasqal_new_literal_from_literal(v->value);
+  }
+
+  row->offset = con->offset++;
+
+  return row;
+}
+
+
+/*
+ * rasqal_triples_rowsource_start_tasks:
+ * @con: triples rowsource context
+ *
+ * INTERNAL - Create a task evaluating the subplan for each morsel
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_triples_rowsource_start_tasks(rasqal_triples_rowsource_context *con)
+{
+  int i;
+
+  con->tasks = rasqal_new_subplan_tasks(con->morsels, con->unordered);
+  if(!con->tasks)
+    return 1;
+
+  for(i = 0; i < con->morsels; i++) {
+    int range_end;
+
+    /* the last morsel takes any matches beyond the expected count */
+    range_end = (i == con->morsels - 1) ? -1 : (i + 1) * con->morsel_size;
+    if(rasqal_subplan_tasks_add(con->tasks, con->subplan, NULL,
+                                i * con->morsel_size, range_end))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_triples_rowsource_read_parallel_row:
+ * @rowsource: triples rowsource
+ * @con: triples rowsource context
+ * @error_p: pointer to store error
+ *
+ * INTERNAL - Read the next row from the morsel tasks
+ *
+ * Return value: row or NULL when finished or on failure
+ */
+static rasqal_row*
+rasqal_triples_rowsource_read_parallel_row(rasqal_rowsource* rowsource,
+                                           rasqal_triples_rowsource_context *con,
+                                           rasqal_engine_error *error_p)
+{
+  rasqal_literal** values;
+  rasqal_row* row;
+  int index;
+  int rc;
+  int i;
+
+  *error_p = RASQAL_ENGINE_FAILED;
+
+  if(!con->tasks && rasqal_triples_rowsource_start_tasks(con))
+    return NULL;
+
+  rc = rasqal_subplan_tasks_next(con->tasks, rowsource->execution,
+                                 &index, &values);
+  if(rc <= 0) {
+    if(!rc)
+      *error_p = RASQAL_ENGINE_FINISHED;
+    return NULL;
+  }
+
+  row = rasqal_new_row(rowsource);
+  if(!row) {
+    rasqal_subplan_free_values(con->subplan, values);
+    return NULL;
+  }
+
+  /* the subplan values are in the variable order of this rowsource */
+  for(i = 0; i < row->size; i++) {
+    if(row->values[i])
+      rasqal_free_literal(row->values[i]);
+    row->values[i] = values[i];
+  }
+  RASQAL_FREE(rasqal_literal**, values);
+
+  row->offset = con->offset++;
+
+  *error_p = RASQAL_ENGINE_OK;
+
+  return row;
+}
+
+
 static rasqal_row*
 rasqal_triples_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
 {
   rasqal_triples_rowsource_context *con;
-  int i;
   rasqal_row* row = NULL;
   rasqal_engine_error error = RASQAL_ENGINE_OK;
 
   con = (rasqal_triples_rowsource_context*)user_data;
 
+  if(con->subplan)
+    return rasqal_triples_rowsource_read_parallel_row(rowsource, con, &error);
+
   error = rasqal_triples_rowsource_get_next_row(rowsource, con);
   RASQAL_DEBUG2("rasqal_triples_rowsource_get_next_row() returned error %s\n",
                 rasqal_engine_error_as_string(error));
@@ -277,6 +515,7 @@ rasqal_triples_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
 #ifdef RASQAL_DEBUG
   if(1) {
     int values_returned = 0;
+    int i;
     /* Count actual bound values */
     for(i = 0; i < con->size; i++) {
       rasqal_variable* v;
@@ -288,25 +527,106 @@ rasqal_triples_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
   }
 #endif
 
-  row = rasqal_new_row(rowsource);
-  if(!row) {
-    error = RASQAL_ENGINE_FAILED;
-    goto done;
-  }
+  row = rasqal_triples_rowsource_make_row(rowsource, con);
 
-  for(i = 0; i < row->size; i++) {
-    rasqal_variable* v;
-    v = rasqal_rowsource_get_variable_by_offset(rowsource, i);
-    if(row->values[i])
-      rasqal_free_literal(row->values[i]);
-    row->values[i] = rasqal_new_literal_from_literal(v->value);
+  done:
+
+  return row;
+}
+
+
+static int
+rasqal_triples_rowsource_read_batch(rasqal_rowsource* rowsource,
+                                    void *user_data,
+                                    rasqal_row** rows, int size)
+{
+  rasqal_triples_rowsource_context *con;
+  int count = 0;
+
+  con = (rasqal_triples_rowsource_context*)user_data;
+
+  while(count < size) {
+    rasqal_engine_error error;
+    rasqal_row* row;
+
+    if(con->subplan) {
+      row = rasqal_triples_rowsource_read_parallel_row(rowsource, con,
+                                                       &error);
+      if(RASQAL_ENGINE_ERROR_IS_FAILURE(error))
+        goto failed;
+
+      if(!row)
+        break;
+
+      rows[count++] = row;
+      continue;
+    }
+
+    error = rasqal_triples_rowsource_get_next_row(rowsource, con);
+    if(RASQAL_ENGINE_ERROR_IS_FAILURE(error))
+      goto failed;
+
+    if(error != RASQAL_ENGINE_OK)
+      break;
+
+    row = rasqal_triples_rowsource_make_row(rowsource, con);
+    if(!row)
+      goto failed;
+
+    rows[count++] = row;
   }
 
-  row->offset = con->offset++;
+  return count;
 
-  done:
+  failed:
+  while(count > 0)
+    rasqal_free_row(rows[--count]);
 
-  return row;
+  return -1;
+}
+
+
+static int
+rasqal_triples_rowsource_skip_rows(rasqal_rowsource* rowsource,
+                                   void *user_data, int count)
+{
+  rasqal_triples_rowsource_context *con;
+  int skipped = 0;
+
+  con = (rasqal_triples_rowsource_context*)user_data;
+
+  /* advance the matches without making rows or copying values */
+  while(skipped < count) {
+    rasqal_engine_error error;
+
+    if(con->subplan) {
+      rasqal_row* row;
+
+      row = rasqal_triples_rowsource_read_parallel_row(rowsource, con,
+                                                       &error);
+      if(RASQAL_ENGINE_ERROR_IS_FAILURE(error))
+        return -1;
+
+      if(!row)
+        break;
+
+      rasqal_free_row(row);
+      skipped++;
+      continue;
+    }
+
+    error = rasqal_triples_rowsource_get_next_row(rowsource, con);
+    if(RASQAL_ENGINE_ERROR_IS_FAILURE(error))
+      return -1;
+
+    if(error != RASQAL_ENGINE_OK)
+      break;
+
+    con->offset++;
+    skipped++;
+  }
+
+  return skipped;
 }
 
 
@@ -328,7 +648,13 @@ rasqal_triples_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
 
   con = (rasqal_triples_rowsource_context*)user_data;
 
+  if(con->tasks) {
+    rasqal_free_subplan_tasks(con->tasks);
+    con->tasks = NULL;
+  }
+
   con->column = con->start_column;
+  con->first_index = 0;
   for(column = con->start_column; column <= con->end_column; column++) {
     rasqal_triple_meta *m;
 
@@ -356,6 +682,12 @@ rasqal_triples_rowsource_set_origin(rasqal_rowsource *rowsource,
   for(column = con->start_column; column <= con->end_column; column++) {
     rasqal_triple *t;
     t = (rasqal_triple*)raptor_sequence_get_at(con->triples, column);
+
+    /* an inner GRAPH variable binds from the triple origins whatever
+     * the graph of an enclosing GRAPH is */
+    if(t->origin && rasqal_literal_as_variable(t->origin))
+      continue;
+
     if(t->origin)
       rasqal_free_literal(t->origin);
     t->origin = rasqal_new_literal_from_literal(con->origin);
@@ -365,8 +697,53 @@ rasqal_triples_rowsource_set_origin(rasqal_rowsource *rowsource,
 }
 
 
+/*
+ * Estimate from the fewest matches of any one triple pattern; a
+ * join of the patterns cannot return more rows than that unless they
+ * share no variables.
+ */
+static long
+rasqal_triples_rowsource_estimate_rows(rasqal_rowsource* rowsource,
+                                       void *user_data)
+{
+  rasqal_triples_rowsource_context *con;
+  long estimate = -1;
+  int column;
+
+  con = (rasqal_triples_rowsource_context*)user_data;
+
+  for(column = con->start_column; column <= con->end_column; column++) {
+    rasqal_triple *t;
+    rasqal_variable *s, *p, *o;
+    long count;
+
+    t = (rasqal_triple*)raptor_sequence_get_at(con->triples, column);
+
+    /* a count is only defined with each variable used once */
+    s = rasqal_literal_as_variable(t->subject);
+    p = rasqal_literal_as_variable(t->predicate);
+    o = rasqal_literal_as_variable(t->object);
+    if((s && (s == p || s == o)) || (p && p == o))
+      continue;
+
+    if(rasqal_triples_source_triple_count(con->triples_source, t, &count))
+      continue;
+
+    /* a morsel only uses a range of the first pattern matches */
+    if(column == con->start_column && con->range_end >= 0 &&
+       count > con->range_end - con->range_start)
+      count = con->range_end - con->range_start;
+
+    if(estimate < 0 || count < estimate)
+      estimate = count;
+  }
+
+  return estimate;
+}
+
+
 static const rasqal_rowsource_handler rasqal_triples_rowsource_handler = {
-  /* .version = */ 1,
+  /* .version = */ 3,
   "triple pattern",
   /* .init = */ rasqal_triples_rowsource_init,
   /* .finish = */ rasqal_triples_rowsource_finish,
@@ -376,7 +753,10 @@ static const rasqal_rowsource_handler rasqal_triples_rowsource_handler = {
   /* .reset = */ rasqal_triples_rowsource_reset,
   /* .set_requirements = */ NULL,
   /* .get_inner_rowsource = */ NULL,
-  /* .set_origin = */ rasqal_triples_rowsource_set_origin
+  /* .set_origin = */ rasqal_triples_rowsource_set_origin,
+  /* .skip_rows = */ rasqal_triples_rowsource_skip_rows,
+  /* .read_batch = */ rasqal_triples_rowsource_read_batch,
+  /* .estimate_rows = */ rasqal_triples_rowsource_estimate_rows
 };
 
 
@@ -419,6 +799,7 @@ rasqal_new_triples_rowsource(rasqal_world *world,
   con->start_column = start_column;
   con->end_column = end_column;
   con->column = -1;
+  con->range_end = -1;
 
   con->triples_count = con->end_column - con->start_column + 1;
 
@@ -437,6 +818,119 @@ rasqal_new_triples_rowsource(rasqal_world *world,
 }
 
 
+/**
+ * rasqal_triples_rowsource_bind_next:
+ * @rowsource: triples rowsource
+ *
+ * INTERNAL - Move to the next match and bind the variables without making a row
+ *
+ * For rowsources that evaluate over the variable bindings directly,
+ * such as a fused pipeline.  The match does not count as a row read
+ * from @rowsource.
+ *
+ * Return value: 0 if there is a match, >0 if finished or <0 on failure
+ */
+int
+rasqal_triples_rowsource_bind_next(rasqal_rowsource* rowsource)
+{
+  rasqal_triples_rowsource_context *con;
+  rasqal_engine_error error;
+
+  if(!rowsource || rowsource->handler != &rasqal_triples_rowsource_handler)
+    return -1;
+
+  if(rowsource->finished)
+    return 1;
+
+  con = (rasqal_triples_rowsource_context*)rowsource->user_data;
+
+  error = rasqal_triples_rowsource_get_next_row(rowsource, con);
+  if(error == RASQAL_ENGINE_OK) {
+    con->offset++;
+    return 0;
+  }
+
+  rowsource->finished = 1;
+
+  return RASQAL_ENGINE_ERROR_IS_FAILURE(error) ? -1 : 1;
+}
+
+
+/**
+ * rasqal_triples_rowsource_set_range:
+ * @rowsource: triples rowsource
+ * @range_start: first match of the first triple pattern to use
+ * @range_end: match of the first triple pattern to stop at or <0 for all
+ *
+ * INTERNAL - Only use a range of the matches of the first triple pattern
+ *
+ * The matches are counted in the order the triples source returns
+ * them so the ranges of one triples source are disjoint.  The matches
+ * before the range are stepped over without binding.
+ *
+ * Return value: non-0 on failure or if @rowsource is not a triples rowsource
+ */
+int
+rasqal_triples_rowsource_set_range(rasqal_rowsource* rowsource,
+                                   int range_start, int range_end)
+{
+  rasqal_triples_rowsource_context *con;
+
+  if(!rowsource || rowsource->handler != &rasqal_triples_rowsource_handler)
+    return 1;
+
+  con = (rasqal_triples_rowsource_context*)rowsource->user_data;
+  con->range_start = range_start;
+  con->range_end = range_end;
+
+  return 0;
+}
+
+
+/**
+ * rasqal_triples_rowsource_set_subplan:
+ * @rowsource: triples rowsource
+ * @subplan: subplan evaluating the rowsource BGP; becomes owned by @rowsource
+ * @morsels: number of morsels
+ * @morsel_size: number of first triple pattern matches in each morsel
+ * @unordered: non-0 if rows may be returned in any order
+ *
+ * INTERNAL - Evaluate a triples rowsource in morsels on worker threads
+ *
+ * The matches of the first triple pattern are split into @morsels
+ * ranges of @morsel_size, the last one taking any more, and each is
+ * evaluated against the rest of the triple patterns by a task.  The
+ * rows are returned in morsel order unless @unordered, so the same
+ * order as matching in this thread.
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_triples_rowsource_set_subplan(rasqal_rowsource* rowsource,
+                                     rasqal_subplan* subplan,
+                                     int morsels, int morsel_size,
+                                     int unordered)
+{
+  rasqal_triples_rowsource_context *con;
+
+  if(!rowsource || rowsource->handler != &rasqal_triples_rowsource_handler ||
+     morsels < 1 || morsel_size < 1) {
+    rasqal_free_subplan(subplan);
+    return 1;
+  }
+
+  con = (rasqal_triples_rowsource_context*)rowsource->user_data;
+  if(con->subplan)
+    rasqal_free_subplan(con->subplan);
+  con->subplan = subplan;
+  con->morsels = morsels;
+  con->morsel_size = morsel_size;
+  con->unordered = unordered;
+
+  return 0;
+}
+
+
 #endif /* not STANDALONE */
 
 
@@ -596,6 +1090,26 @@ main(int argc, char *argv[])
       break;
   }
 
+  /* the range of the first triple pattern matches is after the only one */
+  if(!failures) {
+    rasqal_row* row;
+
+    if(rasqal_triples_rowsource_set_range(rowsource, 1, -1) ||
+       rasqal_rowsource_reset(rowsource)) {
+      fprintf(stderr, "%s: failed to set triples rowsource range\n", program);
+      failures++;
+      goto tidy;
+    }
+
+    row = rasqal_rowsource_read_row(rowsource);
+    if(row) {
+      fprintf(stderr, "%s: range after the only match returned a row\n",
+              program);
+      rasqal_free_row(row);
+      failures++;
+    }
+  }
+
   tidy:
   raptor_free_uri(base_uri);
   if(s_uri)
@@ -64,6 +64,20 @@ typedef struct
 
   /* row offset for read_row() */
   int offset;
+
+  /* sequence of #rasqal_subplan evaluating each UNION branch on
+   * worker threads or NULL */
+  raptor_sequence* subplans;
+
+  /* non-0 if rows may be returned in any branch order */
+  int unordered;
+
+  /* tasks evaluating @subplans or NULL before the first read */
+  rasqal_subplan_tasks* tasks;
+
+  /* array of arrays, one per subplan, mapping subplan values to row
+   * offsets */
+  int** subplan_maps;
 } rasqal_union_rowsource_context;
 
 
@@ -101,6 +115,22 @@ rasqal_union_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
   if(con->right_tmp_values)
     RASQAL_FREE(ptrarray, con->right_tmp_values);
   
+  if(con->tasks)
+    rasqal_free_subplan_tasks(con->tasks);
+
+  if(con->subplan_maps) {
+    int i;
+
+    for(i = 0; i < raptor_sequence_size(con->subplans); i++) {
+      if(con->subplan_maps[i])
+        RASQAL_FREE(int*, con->subplan_maps[i]);
+    }
+    RASQAL_FREE(int**, con->subplan_maps);
+  }
+
+  if(con->subplans)
+    raptor_free_sequence(con->subplans);
+
   RASQAL_FREE(rasqal_union_rowsource_context, con);
 
   return 0;
@@ -183,6 +213,129 @@ rasqal_union_rowsource_adjust_right_row(rasqal_rowsource *rowsource,
 }
 
 
+/*
+ * rasqal_union_rowsource_start_tasks:
+ * @rowsource: union rowsource
+ * @con: union rowsource context
+ *
+ * INTERNAL - Create a task evaluating each UNION branch subplan
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_union_rowsource_start_tasks(rasqal_rowsource* rowsource,
+                                   rasqal_union_rowsource_context* con)
+{
+  int count = raptor_sequence_size(con->subplans);
+  int i;
+
+  if(!con->subplan_maps) {
+    con->subplan_maps = RASQAL_CALLOC(int**, RASQAL_GOOD_CAST(size_t, count),
+                                      sizeof(int*));
+    if(!con->subplan_maps)
+      return 1;
+
+    for(i = 0; i < count; i++) {
+      rasqal_subplan* subplan;
+      int size;
+      int j;
+
+      subplan = (rasqal_subplan*)raptor_sequence_get_at(con->subplans, i);
+      size = rasqal_subplan_get_size(subplan);
+      con->subplan_maps[i] = RASQAL_CALLOC(int*,
+                                           RASQAL_GOOD_CAST(size_t, size + 1),
+                                           sizeof(int));
+      if(!con->subplan_maps[i])
+        return 1;
+
+      for(j = 0; j < size; j++) {
+        const unsigned char* name;
+
+        name = rasqal_subplan_get_variable_name(subplan, j);
+        con->subplan_maps[i][j] = rasqal_rowsource_get_variable_offset_by_name(rowsource, name);
+      }
+    }
+  }
+
+  con->tasks = rasqal_new_subplan_tasks(count, con->unordered);
+  if(!con->tasks)
+    return 1;
+
+  for(i = 0; i < count; i++) {
+    rasqal_subplan* subplan;
+
+    subplan = (rasqal_subplan*)raptor_sequence_get_at(con->subplans, i);
+    if(rasqal_subplan_tasks_add(con->tasks, subplan, NULL, 0, -1))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_union_rowsource_read_parallel_row:
+ * @rowsource: union rowsource
+ * @con: union rowsource context
+ *
+ * INTERNAL - Read the next row from the UNION branch tasks
+ *
+ * Return value: row or NULL when finished or on failure
+ */
+static rasqal_row*
+rasqal_union_rowsource_read_parallel_row(rasqal_rowsource* rowsource,
+                                         rasqal_union_rowsource_context* con)
+{
+  rasqal_subplan* subplan;
+  rasqal_literal** values;
+  rasqal_row* row;
+  int index;
+  int size;
+  int rc;
+  int i;
+
+  if(!con->tasks && rasqal_union_rowsource_start_tasks(rowsource, con)) {
+    con->failed = 1;
+    return NULL;
+  }
+
+  rc = rasqal_subplan_tasks_next(con->tasks, rowsource->execution,
+                                 &index, &values);
+  if(rc <= 0) {
+    if(rc < 0)
+      con->failed = 1;
+    con->state = 2;
+    return NULL;
+  }
+
+  subplan = (rasqal_subplan*)raptor_sequence_get_at(con->subplans, index);
+  row = rasqal_new_row_for_query(rowsource->world, rowsource->query,
+                                 rowsource->size);
+  if(!row) {
+    rasqal_subplan_free_values(subplan, values);
+    con->failed = 1;
+    return NULL;
+  }
+
+  rasqal_row_set_rowsource(row, rowsource);
+  row->offset = con->offset++;
+
+  /* map the branch values into the order of the result row */
+  size = rasqal_subplan_get_size(subplan);
+  for(i = 0; i < size; i++) {
+    int offset = con->subplan_maps[index][i];
+
+    if(offset >= 0)
+      row->values[offset] = values[i];
+    else if(values[i])
+      rasqal_free_literal(values[i]);
+  }
+  RASQAL_FREE(rasqal_literal**, values);
+
+  return row;
+}
+
+
 static rasqal_row*
 rasqal_union_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
 {
@@ -194,6 +347,9 @@ rasqal_union_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
   if(con->failed || con->state > 1)
     return NULL;
 
+  if(con->subplans)
+    return rasqal_union_rowsource_read_parallel_row(rowsource, con);
+
   if(con->state == 0) {
     row = rasqal_rowsource_read_row(con->left);
 #ifdef RASQAL_DEBUG
@@ -264,6 +420,29 @@ rasqal_union_rowsource_read_all_rows(rasqal_rowsource* rowsource,
   if(con->failed)
     return NULL;
   
+  if(con->subplans) {
+    rasqal_row* row;
+
+    seq1 = raptor_new_sequence((raptor_data_free_handler)rasqal_free_row,
+                               (raptor_data_print_handler)rasqal_row_print);
+    if(!seq1)
+      return NULL;
+
+    while((row = rasqal_union_rowsource_read_parallel_row(rowsource, con))) {
+      if(raptor_sequence_push(seq1, row)) {
+        con->failed = 1;
+        break;
+      }
+    }
+
+    if(con->failed) {
+      raptor_free_sequence(seq1);
+      seq1 = NULL;
+    }
+
+    return seq1;
+  }
+
   seq1 = rasqal_rowsource_read_all_rows(con->left);
   if(!seq1) {
     con->failed = 1;
@@ -317,6 +496,135 @@ rasqal_union_rowsource_read_all_rows(rasqal_rowsource* rowsource,
 }
 
 
+static int
+rasqal_union_rowsource_read_batch(rasqal_rowsource* rowsource,
+                                  void *user_data,
+                                  rasqal_row** rows, int size)
+{
+  rasqal_union_rowsource_context* con;
+  int count = 0;
+  int i;
+
+  con = (rasqal_union_rowsource_context*)user_data;
+
+  if(con->failed || con->state > 1)
+    return 0;
+
+  if(con->subplans) {
+    while(count < size) {
+      rows[count] = rasqal_union_rowsource_read_parallel_row(rowsource, con);
+      if(!rows[count])
+        break;
+      count++;
+    }
+    if(con->failed)
+      goto failed;
+
+    return count;
+  }
+
+  if(con->state == 0) {
+    count = rasqal_rowsource_read_batch(con->left, rows, size);
+    if(count < 0)
+      goto failed;
+
+    if(!count)
+      con->state = 1;
+    else {
+      /* rows from left are correct order but wrong size */
+      for(i = 0; i < count; i++) {
+        if(rasqal_row_expand_size(rows[i], rowsource->size))
+          goto failed;
+      }
+    }
+  }
+
+  if(!count && con->state == 1) {
+    count = rasqal_rowsource_read_batch(con->right, rows, size);
+    if(count < 0)
+      goto failed;
+
+    if(!count)
+      /* finished */
+      con->state = 2;
+    else {
+      for(i = 0; i < count; i++) {
+        if(rasqal_row_expand_size(rows[i], rowsource->size))
+          goto failed;
+        /* transform row from right to match new projection */
+        rasqal_union_rowsource_adjust_right_row(rowsource, con, rows[i]);
+      }
+    }
+  }
+
+  for(i = 0; i < count; i++) {
+    rasqal_row_set_rowsource(rows[i], rowsource);
+    rows[i]->offset = con->offset++;
+  }
+
+  return count;
+
+  failed:
+  while(count > 0)
+    rasqal_free_row(rows[--count]);
+  con->failed = 1;
+
+  return -1;
+}
+
+
+static int
+rasqal_union_rowsource_skip_rows(rasqal_rowsource* rowsource,
+                                 void *user_data, int count)
+{
+  rasqal_union_rowsource_context* con;
+  int skipped = 0;
+  int rc;
+
+  con = (rasqal_union_rowsource_context*)user_data;
+
+  if(con->failed || con->state > 1)
+    return 0;
+
+  if(con->subplans) {
+    rasqal_row* row;
+
+    while(skipped < count &&
+          (row = rasqal_union_rowsource_read_parallel_row(rowsource, con))) {
+      rasqal_free_row(row);
+      skipped++;
+    }
+
+    return con->failed ? -1 : skipped;
+  }
+
+  if(con->state == 0) {
+    rc = rasqal_rowsource_skip_rows(con->left, count);
+    if(rc < 0)
+      return -1;
+
+    skipped += rc;
+    if(skipped < count)
+      con->state = 1;
+  }
+
+  if(skipped < count && con->state == 1) {
+    rc = rasqal_rowsource_skip_rows(con->right, count - skipped);
+    if(rc < 0)
+      return -1;
+
+    skipped += rc;
+    if(skipped < count)
+      /* finished */
+      con->state = 2;
+  }
+
+  con->offset += skipped;
+
+  return skipped;
+}
+
+
 static int
 rasqal_union_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
 {
@@ -328,6 +636,12 @@ rasqal_union_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
   con->state = 0;
   con->failed = 0;
 
+  if(con->tasks) {
+    /* tasks are started again by the next read */
+    rasqal_free_subplan_tasks(con->tasks);
+    con->tasks = NULL;
+  }
+
   rc = rasqal_rowsource_reset(con->left);
   if(rc)
     return rc;
@@ -336,6 +650,23 @@ rasqal_union_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
 }
 
 
+static int
+rasqal_union_rowsource_set_requirements(rasqal_rowsource* rowsource,
+                                        void *user_data, unsigned int flags)
+{
+  rasqal_union_rowsource_context *con;
+  con = (rasqal_union_rowsource_context*)user_data;
+
+  if(flags & RASQAL_ROWSOURCE_REQUIRE_ROWS_LIMIT) {
+    /* either side on its own may have to provide all the rows */
+    rasqal_rowsource_set_rows_needed(con->left, rowsource->rows_needed);
+    rasqal_rowsource_set_rows_needed(con->right, rowsource->rows_needed);
+  }
+
+  return 0;
+}
+
+
 static rasqal_rowsource*
 rasqal_union_rowsource_get_inner_rowsource(rasqal_rowsource* rowsource,
                                            void *user_data, int offset)
@@ -352,8 +683,27 @@ rasqal_union_rowsource_get_inner_rowsource(rasqal_rowsource* rowsource,
 }
 
 
+static long
+rasqal_union_rowsource_estimate_rows(rasqal_rowsource* rowsource,
+                                     void *user_data)
+{
+  rasqal_union_rowsource_context *con;
+  long left;
+  long right;
+
+  con = (rasqal_union_rowsource_context*)user_data;
+
+  left = rasqal_rowsource_estimate_rows(con->left);
+  right = rasqal_rowsource_estimate_rows(con->right);
+  if(left < 0 || right < 0)
+    return -1;
+
+  return left + right;
+}
+
+
 static const rasqal_rowsource_handler rasqal_union_rowsource_handler = {
-  /* .version = */ 1,
+  /* .version = */ 3,
   "union",
   /* .init = */ rasqal_union_rowsource_init,
   /* .finish = */ rasqal_union_rowsource_finish,
@@ -361,9 +711,12 @@ static const rasqal_rowsource_handler rasqal_union_rowsource_handler = {
   /* .read_row = */ rasqal_union_rowsource_read_row,
   /* .read_all_rows = */ rasqal_union_rowsource_read_all_rows,
   /* .reset = */ rasqal_union_rowsource_reset,
-  /* .set_requirements = */ NULL,
+  /* .set_requirements = */ rasqal_union_rowsource_set_requirements,
   /* .get_inner_rowsource = */ rasqal_union_rowsource_get_inner_rowsource,
   /* .set_origin = */ NULL,
+  /* .skip_rows = */ rasqal_union_rowsource_skip_rows,
+  /* .read_batch = */ rasqal_union_rowsource_read_batch,
+  /* .estimate_rows = */ rasqal_union_rowsource_estimate_rows
 };
 
 
@@ -373,6 +726,8 @@ static const rasqal_rowsource_handler rasqal_union_rowsource_handler = {
  * @query: query object
  * @left: left (first) rowsource
  * @right: right (second) rowsource
+ * @subplans: sequence of #rasqal_subplan evaluating the UNION branches in parallel or NULL
+ * @unordered: non-0 if rows of different branches may be returned in any order
  *
  * INTERNAL - create a new UNION over two rowsources
  *
@@ -381,7 +736,10 @@ static const rasqal_rowsource_handler rasqal_union_rowsource_handler = {
  * sequence are the same.  If not, construction fails and NULL is
  * returned.
  *
- * The @left and @right rowsources become owned by the new rowsource.
+ * The @left and @right rowsources and @subplans become owned by the
+ * new rowsource.  With @subplans, which may cover the branches of
+ * nested UNIONs in @left and @right, the branches are evaluated on
+ * worker threads and @left and @right only provide the variables.
  *
  * Return value: new rowsource or NULL on failure
  */
@@ -389,7 +747,9 @@ rasqal_rowsource*
 rasqal_new_union_rowsource(rasqal_world *world,
                            rasqal_query* query,
                            rasqal_rowsource* left,
-                           rasqal_rowsource* right)
+                           rasqal_rowsource* right,
+                           raptor_sequence* subplans,
+                           int unordered)
 {
   rasqal_union_rowsource_context* con;
   int flags = 0;
@@ -403,6 +763,8 @@ rasqal_new_union_rowsource(rasqal_world *world,
 
   con->left = left;
   con->right = right;
+  con->subplans = subplans;
+  con->unordered = unordered;
   
   return rasqal_new_rowsource_from_handler(world, query,
                                            con,
@@ -415,6 +777,8 @@ rasqal_new_union_rowsource(rasqal_world *world,
     rasqal_free_rowsource(left);
   if(right)
     rasqal_free_rowsource(right);
+  if(subplans)
+    raptor_free_sequence(subplans);
   return NULL;
 }
 
@@ -487,6 +851,7 @@ main(int argc, char *argv[])
   int expected_size = EXPECTED_COLUMNS_COUNT;
   int i;
   raptor_sequence* vars_seq = NULL;
+  rasqal_operator_counters counters;
   
   world = rasqal_new_world(); rasqal_world_open(world);
   
@@ -536,7 +901,8 @@ main(int argc, char *argv[])
   /* vars_seq and seq are now owned by right_rs */
   vars_seq = seq = NULL;
 
-  rowsource = rasqal_new_union_rowsource(world, query, left_rs, right_rs);
+  rowsource = rasqal_new_union_rowsource(world, query, left_rs, right_rs,
+                                         NULL, 0);
   if(!rowsource) {
     fprintf(stderr, "%s: failed to create union rowsource\n", program);
     failures++;
@@ -597,6 +963,95 @@ main(int argc, char *argv[])
   rasqal_rowsource_print_row_sequence(rowsource, seq, DEBUG_FH);
 #endif
 
+  /* read the rows again in batches of 2 rows */
+  if(rasqal_rowsource_reset(rowsource)) {
+    fprintf(stderr, "%s: failed to reset union rowsource\n", program);
+    failures++;
+    goto tidy;
+  }
+
+  count = 0;
+  while(1) {
+    rasqal_row* batch[2];
+    int batch_count;
+
+    batch_count = rasqal_rowsource_read_batch(rowsource, batch, 2);
+    if(batch_count < 0) {
+      fprintf(stderr, "%s: read_batch failed for a union rowsource\n",
+              program);
+      failures++;
+      goto tidy;
+    }
+    if(!batch_count)
+      break;
+
+    for(i = 0; i < batch_count; i++) {
+      if(batch[i]->size != expected_size) {
+        fprintf(stderr,
+                "%s: read_batch returned a row of size %d for a union rowsource, expected %d\n",
+                program, batch[i]->size, expected_size);
+        failures++;
+      }
+      rasqal_free_row(batch[i]);
+    }
+    count += batch_count;
+  }
+  if(count != expected_count) {
+    fprintf(stderr,
+            "%s: read_batch returned %d rows for a union rowsource, expected %d\n",
+            program, count, expected_count);
+    failures++;
+    goto tidy;
+  }
+
+  /* the rows of both reads and the reset are counted */
+  if(rowsource->stats.rows != 2 * expected_count ||
+     rowsource->stats.resets != 1) {
+    fprintf(stderr,
+            "%s: union rowsource counted %ld rows and %d resets, expected %d and 1\n",
+            program, rowsource->stats.rows, rowsource->stats.resets,
+            2 * expected_count);
+    failures++;
+    goto tidy;
+  }
+
+  if(rasqal_rowsource_estimate_rows(rowsource) != expected_count) {
+    fprintf(stderr,
+            "%s: union rowsource estimated %ld rows, expected %d\n",
+            program, rasqal_rowsource_estimate_rows(rowsource),
+            expected_count);
+    failures++;
+    goto tidy;
+  }
+
+  /* the union consumes every row of its two inner rowsources */
+  if(rasqal_rowsource_get_counters(rowsource, 0, &counters) ||
+     strcmp(counters.name, "union") || counters.depth != 0 ||
+     counters.rows_produced != 2 * expected_count ||
+     counters.rows_consumed != 2 * expected_count) {
+    fprintf(stderr,
+            "%s: union rowsource counters were wrong\n", program);
+    failures++;
+    goto tidy;
+  }
+
+  for(i = 1; !rasqal_rowsource_get_counters(rowsource, i, &counters); i++) {
+    if(counters.depth != 1) {
+      fprintf(stderr,
+              "%s: union rowsource operator #%d has depth %d, expected 1\n",
+              program, i, counters.depth);
+      failures++;
+      goto tidy;
+    }
+  }
+  if(i != 3) {
+    fprintf(stderr,
+            "%s: union rowsource had %d operators, expected 3\n",
+            program, i);
+    failures++;
+    goto tidy;
+  }
+
   tidy:
   if(seq)
     raptor_free_sequence(seq);
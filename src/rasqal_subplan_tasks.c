@@ -0,0 +1,397 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_subplan_tasks.c - Rasqal subplans evaluated on worker threads
+ *
+ * Copyright (C) 2026, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+
+/*
+ * A set of tasks each evaluating a subplan on a worker thread for a
+ * rowsource that reads their rows in the executing thread.  Each task
+ * buffers at most RASQAL_SUBPLAN_TASK_BUFFER_SIZE rows and then waits
+ * for them to be read.  At most subplan parallelism tasks run at once
+ * and they are started in the order they were added.  Rows are read
+ * in task order or, if unordered, from whichever task has some first.
+ */
+
+/* most rows a task buffers before waiting for them to be read */
+#define RASQAL_SUBPLAN_TASK_BUFFER_SIZE 1024
+
+typedef struct
+{
+  rasqal_subplan_tasks* tasks;
+
+  rasqal_subplan* subplan;
+
+  /* origin for the subplan or NULL */
+  rasqal_literal* origin;
+
+  /* range of first triple pattern matches for the subplan */
+  int range_start;
+  int range_end;
+
+  /* values arrays of rows not yet read */
+  raptor_sequence* rows;
+
+  /* non-0 when the task has finished */
+  int finished;
+
+  /* error that stopped the task or RASQAL_ENGINE_OK */
+  rasqal_engine_error error;
+} rasqal_subplan_task;
+
+
+struct rasqal_subplan_tasks_s
+{
+  /* array of tasks */
+  rasqal_subplan_task* tasks;
+  int size;
+  int count;
+
+  /* non-0 if rows may be read from tasks in any order */
+  int unordered;
+
+  /* execution the tasks are part of or NULL */
+  rasqal_execution_state* execution;
+
+  /* index of the next task to submit and to read rows from */
+  int next_submit;
+  int next_read;
+
+  /* lock for the tasks and the fields below */
+  rasqal_mutex lock;
+
+  /* signalled when a task adds a row or finishes and when rows are read */
+  rasqal_cond changed;
+
+  /* tasks submitted and not finished */
+  int running;
+
+  /* non-0 when tasks must stop */
+  int stop;
+};
+
+
+/*
+ * rasqal_new_subplan_tasks:
+ * @size: most number of tasks
+ * @unordered: non-0 if rows may be read from tasks in any order
+ *
+ * INTERNAL - Constructor - create an empty set of subplan tasks
+ *
+ * Return value: new tasks or NULL on failure
+ */
+rasqal_subplan_tasks*
+rasqal_new_subplan_tasks(int size, int unordered)
+{
+  rasqal_subplan_tasks* tasks;
+
+  tasks = RASQAL_CALLOC(rasqal_subplan_tasks*, 1, sizeof(*tasks));
+  if(!tasks)
+    return NULL;
+
+  tasks->tasks = RASQAL_CALLOC(rasqal_subplan_task*,
+                               RASQAL_GOOD_CAST(size_t, size + 1),
+                               sizeof(rasqal_subplan_task));
+  if(!tasks->tasks) {
+    RASQAL_FREE(rasqal_subplan_tasks, tasks);
+    return NULL;
+  }
+
+  tasks->size = size;
+  tasks->unordered = unordered;
+  RASQAL_MUTEX_INIT(&tasks->lock);
+  RASQAL_COND_INIT(&tasks->changed);
+
+  return tasks;
+}
+
+
+/*
+ * rasqal_free_subplan_tasks:
+ * @tasks: subplan tasks
+ *
+ * INTERNAL - Destructor - stop the tasks, wait for them and free them with any unread rows
+ */
+void
+rasqal_free_subplan_tasks(rasqal_subplan_tasks* tasks)
+{
+  int i;
+
+  if(!tasks)
+    return;
+
+  RASQAL_MUTEX_LOCK(&tasks->lock);
+  tasks->stop = 1;
+  RASQAL_COND_BROADCAST(&tasks->changed);
+  while(tasks->running)
+    RASQAL_COND_WAIT(&tasks->changed, &tasks->lock);
+  RASQAL_MUTEX_UNLOCK(&tasks->lock);
+
+  for(i = 0; i < tasks->count; i++) {
+    rasqal_subplan_task* task = &tasks->tasks[i];
+
+    if(task->rows) {
+      rasqal_literal** values;
+
+      while((values = (rasqal_literal**)raptor_sequence_unshift(task->rows)))
+        rasqal_subplan_free_values(task->subplan, values);
+      raptor_free_sequence(task->rows);
+    }
+    if(task->origin)
+      rasqal_free_literal(task->origin);
+  }
+
+  RASQAL_COND_DESTROY(&tasks->changed);
+  RASQAL_MUTEX_DESTROY(&tasks->lock);
+
+  RASQAL_FREE(rasqal_subplan_task*, tasks->tasks);
+  RASQAL_FREE(rasqal_subplan_tasks, tasks);
+}
+
+
+/*
+ * rasqal_subplan_tasks_add:
+ * @tasks: subplan tasks
+ * @subplan: subplan to evaluate
+ * @origin: origin for the subplan or NULL; becomes owned by @tasks
+ * @range_start: first match of the first triple pattern to use
+ * @range_end: match of the first triple pattern to stop at or <0 for all
+ *
+ * INTERNAL - Add a task; tasks are submitted when rows are first read
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_subplan_tasks_add(rasqal_subplan_tasks* tasks, rasqal_subplan* subplan,
+                         rasqal_literal* origin, int range_start,
+                         int range_end)
+{
+  rasqal_subplan_task* task;
+
+  if(tasks->count == tasks->size) {
+    if(origin)
+      rasqal_free_literal(origin);
+    return 1;
+  }
+
+  task = &tasks->tasks[tasks->count];
+  task->rows = raptor_new_sequence(NULL, NULL);
+  if(!task->rows) {
+    if(origin)
+      rasqal_free_literal(origin);
+    return 1;
+  }
+
+  task->tasks = tasks;
+  task->subplan = subplan;
+  task->origin = origin;
+  task->range_start = range_start;
+  task->range_end = range_end;
+  tasks->count++;
+
+  return 0;
+}
+
+
+/*
+ * rasqal_subplan_tasks_get_origin:
+ * @tasks: subplan tasks
+ * @index: task index
+ *
+ * INTERNAL - Get the origin of a task
+ *
+ * Return value: shared origin literal or NULL
+ */
+rasqal_literal*
+rasqal_subplan_tasks_get_origin(rasqal_subplan_tasks* tasks, int index)
+{
+  return tasks->tasks[index].origin;
+}
+
+
+/* called on a worker thread with each row of a task */
+static int
+rasqal_subplan_tasks_task_row(void* user_data, rasqal_literal** values)
+{
+  rasqal_subplan_task* task = (rasqal_subplan_task*)user_data;
+  rasqal_subplan_tasks* tasks = task->tasks;
+  int rc = 0;
+
+  RASQAL_MUTEX_LOCK(&tasks->lock);
+  while(!tasks->stop &&
+        raptor_sequence_size(task->rows) >= RASQAL_SUBPLAN_TASK_BUFFER_SIZE)
+    RASQAL_COND_WAIT(&tasks->changed, &tasks->lock);
+
+  if(tasks->stop || raptor_sequence_push(task->rows, values)) {
+    if(!tasks->stop)
+      task->error = RASQAL_ENGINE_FAILED;
+    rc = 1;
+  } else {
+    values = NULL;
+    RASQAL_COND_BROADCAST(&tasks->changed);
+  }
+  RASQAL_MUTEX_UNLOCK(&tasks->lock);
+
+  if(values)
+    rasqal_subplan_free_values(task->subplan, values);
+
+  return rc;
+}
+
+
+/* worker thread task evaluating one subplan */
+static void
+rasqal_subplan_tasks_run_task(void* task_data)
+{
+  rasqal_subplan_task* task = (rasqal_subplan_task*)task_data;
+  rasqal_subplan_tasks* tasks = task->tasks;
+  rasqal_engine_error error = RASQAL_ENGINE_OK;
+  int stop;
+
+  RASQAL_MUTEX_LOCK(&tasks->lock);
+  stop = tasks->stop;
+  RASQAL_MUTEX_UNLOCK(&tasks->lock);
+
+  if(!stop)
+    rasqal_subplan_execute(task->subplan, tasks->execution, task->origin,
+                           task->range_start, task->range_end,
+                           rasqal_subplan_tasks_task_row, task, &error);
+
+  RASQAL_MUTEX_LOCK(&tasks->lock);
+  task->finished = 1;
+  if(task->error == RASQAL_ENGINE_OK)
+    task->error = error;
+  tasks->running--;
+  RASQAL_COND_BROADCAST(&tasks->changed);
+  RASQAL_MUTEX_UNLOCK(&tasks->lock);
+}
+
+
+/*
+ * rasqal_subplan_tasks_next:
+ * @tasks: subplan tasks
+ * @execution: execution the tasks are part of or NULL
+ * @index_p: pointer to store the task index of the row
+ * @values_p: pointer to store the row values
+ *
+ * INTERNAL - Read the next row of the tasks waiting for one if needed
+ *
+ * The values array of the subplan size becomes owned by the caller.
+ * If a task fails, its error is set on @execution so the execution
+ * fails rather than returning part of the results.
+ *
+ * Return value: >0 if a row was returned, 0 when finished or <0 on failure
+ */
+int
+rasqal_subplan_tasks_next(rasqal_subplan_tasks* tasks,
+                          rasqal_execution_state* execution,
+                          int* index_p, rasqal_literal*** values_p)
+{
+  rasqal_literal** values = NULL;
+  rasqal_engine_error error = RASQAL_ENGINE_OK;
+  int index = 0;
+  int parallelism;
+
+  if(!tasks->count)
+    return 0;
+
+  parallelism = rasqal_subplan_get_parallelism(tasks->tasks[0].subplan);
+
+  RASQAL_MUTEX_LOCK(&tasks->lock);
+  if(!tasks->next_submit)
+    tasks->execution = execution;
+
+  while(1) {
+    while(tasks->running < parallelism && tasks->next_submit < tasks->count) {
+      if(rasqal_subplan_submit(tasks->tasks[tasks->next_submit].subplan,
+                               rasqal_subplan_tasks_run_task,
+                               &tasks->tasks[tasks->next_submit])) {
+        error = RASQAL_ENGINE_FAILED;
+        break;
+      }
+      tasks->running++;
+      tasks->next_submit++;
+    }
+    if(error != RASQAL_ENGINE_OK)
+      break;
+
+    /* skip finished tasks with no more rows */
+    while(tasks->next_read < tasks->next_submit) {
+      rasqal_subplan_task* task = &tasks->tasks[tasks->next_read];
+
+      if(!task->finished || raptor_sequence_size(task->rows))
+        break;
+      if(task->error != RASQAL_ENGINE_OK) {
+        error = task->error;
+        break;
+      }
+      tasks->next_read++;
+    }
+    if(error != RASQAL_ENGINE_OK || tasks->next_read == tasks->count)
+      break;
+
+    for(index = tasks->next_read; index < tasks->next_submit; index++) {
+      values = (rasqal_literal**)raptor_sequence_unshift(tasks->tasks[index].rows);
+      if(values || !tasks->unordered)
+        break;
+    }
+    if(values) {
+      /* room for another row */
+      RASQAL_COND_BROADCAST(&tasks->changed);
+      break;
+    }
+
+    if(RASQAL_EXECUTION_CHECK(execution))
+      break;
+
+    RASQAL_COND_WAIT(&tasks->changed, &tasks->lock);
+  }
+  RASQAL_MUTEX_UNLOCK(&tasks->lock);
+
+  if(error != RASQAL_ENGINE_OK) {
+    rasqal_execution_state_fail(execution, error);
+    return -1;
+  }
+
+  if(!values)
+    return 0;
+
+  *index_p = index;
+  *values_p = values;
+  return 1;
+}
@@ -167,6 +167,9 @@ rasqal_new_triples_source(rasqal_query* query, raptor_sequence* data_graphs)
 
     if(query->features[RASQAL_FEATURE_NO_NET])
       flags |= 1;
+    /* matched from worker threads with private query copies */
+    if(query->features[RASQAL_FEATURE_PARALLELISM] > 0)
+      flags |= 2;
     rc = rtsf->init_triples_source2(query->world, data_graphs,
                                     rtsf->user_data, rts->user_data, rts,
                                     rasqal_triples_source_error_handler2,
@@ -243,6 +246,99 @@ rasqal_free_triples_source(rasqal_triples_source *rts)
 }
 
 
+/**
+ * rasqal_new_shared_triples_source:
+ * @world: rasqal_world object
+ * @data_graphs: sequence of #rasqal_data_graph to load (or NULL)
+ *
+ * Constructor - create a triples source for sharing between queries
+ *
+ * The data graphs are loaded once, here, and the triples source is
+ * not tied to any query.  It can then be set on any number of queries
+ * with rasqal_query_set_shared_triples_source() including queries
+ * executing at the same time in different threads.  Queries only
+ * read from a shared triples source.
+ *
+ * This needs a #rasqal_triples_source_factory of API version 3 that
+ * supports #RASQAL_TRIPLES_SOURCE_FEATURE_SHARED such as the default
+ * one using raptor.  For concurrent queries the raptor world must
+ * also have URI interning turned off with raptor_world_set_flag().
+ *
+ * Return value: a new triples source or NULL on failure
+ **/
+rasqal_triples_source*
+rasqal_new_shared_triples_source(rasqal_world* world,
+                                 raptor_sequence* data_graphs)
+{
+  rasqal_triples_source_factory* rtsf;
+  rasqal_triples_source* rts;
+  int rc;
+
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
+
+  if(!world->opened)
+    rasqal_world_open(world);
+
+  rtsf = &world->triples_source_factory;
+  if(rtsf->version < 3 || !rtsf->init_triples_source2) {
+    rasqal_log_error_simple(world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                            "Shared triples sources are supported only with rasqal_triples_source_factory version >=3");
+    return NULL;
+  }
+
+  rts = RASQAL_CALLOC(rasqal_triples_source*, 1, sizeof(*rts));
+  if(!rts)
+    return NULL;
+
+  rts->user_data = RASQAL_CALLOC(void*, 1, rtsf->user_data_size);
+  if(!rts->user_data) {
+    RASQAL_FREE(rasqal_triples_source, rts);
+    return NULL;
+  }
+  /* not owned by any query */
+  rts->query = NULL;
+
+  rc = rtsf->init_triples_source2(world, data_graphs,
+                                  rtsf->user_data, rts->user_data, rts,
+                                  rasqal_triples_source_error_handler2,
+                                  2 /* shared */);
+  if(rc) {
+    /* error already reported via the error handler */
+    RASQAL_FREE(user_data, rts->user_data);
+    RASQAL_FREE(rasqal_triples_source, rts);
+    return NULL;
+  }
+
+  if(!rasqal_triples_source_support_feature(rts,
+                                            RASQAL_TRIPLES_SOURCE_FEATURE_SHARED)) {
+    rasqal_log_error_simple(world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                            "Triples source cannot be shared between queries");
+    rasqal_free_triples_source(rts);
+    return NULL;
+  }
+
+  return rts;
+}
+
+
+/**
+ * rasqal_free_shared_triples_source:
+ * @triples_source: triples source
+ *
+ * Destructor - destroy a triples source made by rasqal_new_shared_triples_source()
+ *
+ * No query using @triples_source may still exist.
+ **/
+void
+rasqal_free_shared_triples_source(rasqal_triples_source* triples_source)
+{
+  if(!triples_source)
+    return;
+
+  rasqal_free_triples_source(triples_source);
+}
+
+
 int
 rasqal_triples_source_triple_present(rasqal_triples_source *rts,
                                      rasqal_triple *t)
@@ -282,7 +378,8 @@ rasqal_new_triples_match(rasqal_query* query,
     rtm->is_exact = 1;
     if(rasqal_literal_as_variable(t->predicate) ||
        rasqal_literal_as_variable(t->subject) ||
-       rasqal_literal_as_variable(t->object))
+       rasqal_literal_as_variable(t->object) ||
+       (t->origin && rasqal_literal_as_variable(t->origin)))
       rtm->is_exact = 0;
 
     if(rtm->is_exact) {
@@ -404,3 +501,27 @@ rasqal_triples_source_support_feature(rasqal_triples_source *rts,
 }
 
 
+/*
+ * rasqal_triples_source_triple_count:
+ * @rts: triples source
+ * @t: triple pattern
+ * @count_p: pointer to store count
+ *
+ * INTERNAL - Count the triples matching a pattern without enumerating them, if the triples source can
+ *
+ * Unbound variables in @t match anything; a variable must not
+ * appear more than once.
+ *
+ * Return value: 0 if *@count_p was set, non-0 if the count is not available
+ */
+int
+rasqal_triples_source_triple_count(rasqal_triples_source *rts,
+                                   rasqal_triple *t, long *count_p)
+{
+  if(rts->version >= 3 && rts->triple_count)
+    return rts->triple_count(rts, rts->user_data, t, count_p);
+  else
+    return 1;
+}
+
+
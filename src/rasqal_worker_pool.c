@@ -0,0 +1,657 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_worker_pool.c - Rasqal pool of worker threads
+ *
+ * Copyright (C) 2026, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+
+#ifndef STANDALONE
+
+/*
+ * A worker pool runs tasks on a fixed number of threads.  Each thread
+ * has its own queue of tasks submitted by tasks running on it which
+ * it takes from the newest end, while idle threads steal the oldest
+ * tasks from the queues of the others.  Tasks submitted from outside
+ * the pool go into a shared queue and start in the order they were
+ * submitted, so an executing query can wait for the rows of an
+ * earlier task while later ones wait for it to read theirs.  Tasks
+ * submitted by pool threads may start in any order and a task that
+ * waits for the tasks it submitted relies on another thread being
+ * free to steal them.  Without threads no pool can be created and
+ * callers evaluate everything in the calling thread.
+ */
+
+#ifdef RASQAL_THREADS
+
+typedef struct rasqal_worker_task_s {
+  struct rasqal_worker_task_s* prev;
+  struct rasqal_worker_task_s* next;
+
+  rasqal_worker_task_handler handler;
+
+  void* task_data;
+} rasqal_worker_task;
+
+/* double-ended queue of tasks */
+typedef struct {
+  rasqal_worker_task* head;
+  rasqal_worker_task* tail;
+} rasqal_worker_queue;
+
+typedef struct {
+  rasqal_worker_pool* pool;
+
+  /* index of this thread in the pool */
+  int index;
+
+  pthread_t thread;
+
+  /* lock for @queue */
+  rasqal_mutex lock;
+
+  /* tasks submitted by tasks running on this thread */
+  rasqal_worker_queue queue;
+} rasqal_worker;
+
+struct rasqal_worker_pool_s {
+  /* lock for all the fields below */
+  rasqal_mutex lock;
+
+  /* signalled when a task is queued or the pool is shutting down */
+  rasqal_cond work;
+
+  /* tasks submitted from outside the pool */
+  rasqal_worker_queue queue;
+
+  /* number of tasks queued in all the queues */
+  int pending;
+
+  /* non-0 when the threads must exit once all queues are empty */
+  int shutdown;
+
+  /* key for the rasqal_worker of the calling pool thread */
+  pthread_key_t worker_key;
+
+  /* threads */
+  rasqal_worker* workers;
+  int size;
+
+  /* number of tasks taken from the queue of another thread */
+  int steals;
+};
+
+
+static void
+rasqal_worker_queue_push_tail(rasqal_worker_queue* queue,
+                              rasqal_worker_task* task)
+{
+  task->next = NULL;
+  task->prev = queue->tail;
+  if(queue->tail)
+    queue->tail->next = task;
+  else
+    queue->head = task;
+  queue->tail = task;
+}
+
+
+static rasqal_worker_task*
+rasqal_worker_queue_pop_head(rasqal_worker_queue* queue)
+{
+  rasqal_worker_task* task = queue->head;
+
+  if(task) {
+    queue->head = task->next;
+    if(queue->head)
+      queue->head->prev = NULL;
+    else
+      queue->tail = NULL;
+  }
+
+  return task;
+}
+
+
+static rasqal_worker_task*
+rasqal_worker_queue_pop_tail(rasqal_worker_queue* queue)
+{
+  rasqal_worker_task* task = queue->tail;
+
+  if(task) {
+    queue->tail = task->prev;
+    if(queue->tail)
+      queue->tail->next = NULL;
+    else
+      queue->head = NULL;
+  }
+
+  return task;
+}
+
+
+/*
+ * rasqal_worker_pool_take_task:
+ * @pool: worker pool
+ * @worker: calling pool thread
+ *
+ * INTERNAL - Take the next task for a pool thread
+ *
+ * The newest task of the thread's own queue comes first, then the
+ * oldest task submitted from outside the pool and last the oldest
+ * task of another thread's queue.
+ *
+ * Return value: task or NULL if there are none
+ */
+static rasqal_worker_task*
+rasqal_worker_pool_take_task(rasqal_worker_pool* pool, rasqal_worker* worker)
+{
+  rasqal_worker_task* task;
+  int i;
+
+  RASQAL_MUTEX_LOCK(&worker->lock);
+  task = rasqal_worker_queue_pop_tail(&worker->queue);
+  RASQAL_MUTEX_UNLOCK(&worker->lock);
+
+  if(!task) {
+    RASQAL_MUTEX_LOCK(&pool->lock);
+    task = rasqal_worker_queue_pop_head(&pool->queue);
+    if(task)
+      pool->pending--;
+    RASQAL_MUTEX_UNLOCK(&pool->lock);
+
+    if(task)
+      return task;
+  }
+
+  for(i = 1; !task && i < pool->size; i++) {
+    rasqal_worker* victim = &pool->workers[(worker->index + i) % pool->size];
+
+    RASQAL_MUTEX_LOCK(&victim->lock);
+    task = rasqal_worker_queue_pop_head(&victim->queue);
+    RASQAL_MUTEX_UNLOCK(&victim->lock);
+
+    if(task) {
+      RASQAL_MUTEX_LOCK(&pool->lock);
+      pool->steals++;
+      RASQAL_MUTEX_UNLOCK(&pool->lock);
+    }
+  }
+
+  if(task) {
+    RASQAL_MUTEX_LOCK(&pool->lock);
+    pool->pending--;
+    RASQAL_MUTEX_UNLOCK(&pool->lock);
+  }
+
+  return task;
+}
+
+
+static void*
+rasqal_worker_pool_thread(void* arg)
+{
+  rasqal_worker* worker = (rasqal_worker*)arg;
+  rasqal_worker_pool* pool = worker->pool;
+
+  pthread_setspecific(pool->worker_key, worker);
+
+  while(1) {
+    rasqal_worker_task* task;
+    int done;
+
+    task = rasqal_worker_pool_take_task(pool, worker);
+    if(task) {
+      task->handler(task->task_data);
+      RASQAL_FREE(rasqal_worker_task, task);
+      continue;
+    }
+
+    RASQAL_MUTEX_LOCK(&pool->lock);
+    while(!pool->pending && !pool->shutdown)
+      RASQAL_COND_WAIT(&pool->work, &pool->lock);
+    /* all queues are empty and shutting down */
+    done = !pool->pending && pool->shutdown;
+    RASQAL_MUTEX_UNLOCK(&pool->lock);
+
+    if(done)
+      break;
+  }
+
+  return NULL;
+}
+
+#endif /* RASQAL_THREADS */
+
+
+/*
+ * rasqal_new_worker_pool:
+ * @size: number of threads
+ *
+ * INTERNAL - Constructor - create a pool of worker threads
+ *
+ * Return value: new pool or NULL on failure or if threads are not available
+ */
+rasqal_worker_pool*
+rasqal_new_worker_pool(int size)
+{
+#ifdef RASQAL_THREADS
+  rasqal_worker_pool* pool;
+  int i;
+
+  if(size < 1)
+    return NULL;
+
+  pool = RASQAL_CALLOC(rasqal_worker_pool*, 1, sizeof(*pool));
+  if(!pool)
+    return NULL;
+
+  pool->workers = RASQAL_CALLOC(rasqal_worker*, RASQAL_GOOD_CAST(size_t, size),
+                                sizeof(rasqal_worker));
+  if(!pool->workers) {
+    RASQAL_FREE(rasqal_worker_pool, pool);
+    return NULL;
+  }
+
+  if(pthread_key_create(&pool->worker_key, NULL)) {
+    RASQAL_FREE(rasqal_worker*, pool->workers);
+    RASQAL_FREE(rasqal_worker_pool, pool);
+    return NULL;
+  }
+
+  RASQAL_MUTEX_INIT(&pool->lock);
+  RASQAL_COND_INIT(&pool->work);
+
+  for(i = 0; i < size; i++) {
+    pool->workers[i].pool = pool;
+    pool->workers[i].index = i;
+    RASQAL_MUTEX_INIT(&pool->workers[i].lock);
+  }
+
+  /* the threads take this lock before looking at pool->size */
+  RASQAL_MUTEX_LOCK(&pool->lock);
+  for(pool->size = 0; pool->size < size; pool->size++) {
+    if(pthread_create(&pool->workers[pool->size].thread, NULL,
+                      rasqal_worker_pool_thread, &pool->workers[pool->size]))
+      break;
+  }
+  RASQAL_MUTEX_UNLOCK(&pool->lock);
+
+  for(i = pool->size; i < size; i++)
+    RASQAL_MUTEX_DESTROY(&pool->workers[i].lock);
+
+  if(!pool->size) {
+    rasqal_free_worker_pool(pool);
+    return NULL;
+  }
+
+  RASQAL_DEBUG2("Created worker pool with %d threads\n", pool->size);
+
+  return pool;
+#else
+  return NULL;
+#endif
+}
+
+
+/*
+ * rasqal_free_worker_pool:
+ * @pool: worker pool
+ *
+ * INTERNAL - Destructor - run any queued tasks then stop the threads and free the pool
+ */
+void
+rasqal_free_worker_pool(rasqal_worker_pool* pool)
+{
+#ifdef RASQAL_THREADS
+  int i;
+
+  if(!pool)
+    return;
+
+  RASQAL_MUTEX_LOCK(&pool->lock);
+  pool->shutdown = 1;
+  RASQAL_COND_BROADCAST(&pool->work);
+  RASQAL_MUTEX_UNLOCK(&pool->lock);
+
+  for(i = 0; i < pool->size; i++)
+    pthread_join(pool->workers[i].thread, NULL);
+
+  RASQAL_DEBUG2("Worker pool threads stole %d tasks\n", pool->steals);
+
+  for(i = 0; i < pool->size; i++)
+    RASQAL_MUTEX_DESTROY(&pool->workers[i].lock);
+
+  pthread_key_delete(pool->worker_key);
+
+  RASQAL_COND_DESTROY(&pool->work);
+  RASQAL_MUTEX_DESTROY(&pool->lock);
+
+  RASQAL_FREE(rasqal_worker*, pool->workers);
+  RASQAL_FREE(rasqal_worker_pool, pool);
+#endif
+}
+
+
+/*
+ * rasqal_worker_pool_submit:
+ * @pool: worker pool
+ * @handler: function to run on a worker thread
+ * @task_data: data for @handler
+ *
+ * INTERNAL - Queue a task to run on one of the pool threads
+ *
+ * A task submitted by a task running on a pool thread goes on the
+ * queue of that thread where other idle threads can steal it.
+ * If this succeeds, @handler is always called once even if the pool
+ * is freed before the task starts.
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_worker_pool_submit(rasqal_worker_pool* pool,
+                          rasqal_worker_task_handler handler,
+                          void* task_data)
+{
+#ifdef RASQAL_THREADS
+  rasqal_worker_task* task;
+  rasqal_worker* worker;
+
+  if(!pool || !handler)
+    return 1;
+
+  task = RASQAL_CALLOC(rasqal_worker_task*, 1, sizeof(*task));
+  if(!task)
+    return 1;
+
+  task->handler = handler;
+  task->task_data = task_data;
+
+  worker = (rasqal_worker*)pthread_getspecific(pool->worker_key);
+  if(worker) {
+    RASQAL_MUTEX_LOCK(&worker->lock);
+    rasqal_worker_queue_push_tail(&worker->queue, task);
+    RASQAL_MUTEX_UNLOCK(&worker->lock);
+  }
+
+  RASQAL_MUTEX_LOCK(&pool->lock);
+  if(!worker)
+    rasqal_worker_queue_push_tail(&pool->queue, task);
+  pool->pending++;
+  RASQAL_COND_SIGNAL(&pool->work);
+  RASQAL_MUTEX_UNLOCK(&pool->lock);
+
+  return 0;
+#else
+  return 1;
+#endif
+}
+
+
+/*
+ * rasqal_worker_pool_get_size:
+ * @pool: worker pool
+ *
+ * INTERNAL - Get the number of threads in the pool
+ *
+ * Return value: number of threads
+ */
+int
+rasqal_worker_pool_get_size(rasqal_worker_pool* pool)
+{
+#ifdef RASQAL_THREADS
+  return pool ? pool->size : 0;
+#else
+  return 0;
+#endif
+}
+
+
+/*
+ * rasqal_world_get_worker_pool:
+ * @world: rasqal world
+ * @size: number of threads if the pool has to be created and the world does not set one
+ *
+ * INTERNAL - Get the world worker pool creating it on first use
+ *
+ * The pool is shared by all queries of the world and freed by
+ * rasqal_free_world().  It has #RASQAL_WORLD_FEATURE_WORKER_THREADS
+ * threads if that is set or else @size of the first call.
+ *
+ * Return value: pool or NULL on failure or if threads are not available
+ */
+rasqal_worker_pool*
+rasqal_world_get_worker_pool(rasqal_world* world, int size)
+{
+  rasqal_worker_pool* pool;
+
+  RASQAL_MUTEX_LOCK(&world->lock);
+  if(!world->worker_pool) {
+    if(world->worker_threads > 0)
+      size = world->worker_threads;
+    world->worker_pool = rasqal_new_worker_pool(size);
+  }
+  pool = world->worker_pool;
+  RASQAL_MUTEX_UNLOCK(&world->lock);
+
+  return pool;
+}
+
+#endif /* not STANDALONE */
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+#ifdef RASQAL_THREADS
+
+#include <time.h>
+
+#define TASKS_COUNT 100
+#define STEAL_TASKS_COUNT 8
+/* seconds to wait for stolen tasks before failing */
+#define STEAL_TIMEOUT 10
+
+typedef struct {
+  rasqal_mutex lock;
+
+  rasqal_worker_pool* pool;
+
+  int sum;
+
+  /* signalled when a task is stolen and run */
+  rasqal_cond stolen;
+
+  int stolen_count;
+} worker_pool_test_state;
+
+static worker_pool_test_state test_state;
+
+
+static void
+worker_pool_test_child_task(void* task_data)
+{
+  int value = *(int*)task_data;
+
+  RASQAL_MUTEX_LOCK(&test_state.lock);
+  test_state.sum += value;
+  RASQAL_MUTEX_UNLOCK(&test_state.lock);
+}
+
+
+/* adds its value twice, once in a task submitted from the pool thread */
+static void
+worker_pool_test_task(void* task_data)
+{
+  worker_pool_test_child_task(task_data);
+
+  if(rasqal_worker_pool_submit(test_state.pool, worker_pool_test_child_task,
+                               task_data))
+    worker_pool_test_child_task(task_data);
+}
+
+
+static void
+worker_pool_test_steal_child_task(void* task_data)
+{
+  RASQAL_MUTEX_LOCK(&test_state.lock);
+  test_state.stolen_count++;
+  RASQAL_COND_BROADCAST(&test_state.stolen);
+  RASQAL_MUTEX_UNLOCK(&test_state.lock);
+}
+
+
+/*
+ * Submits tasks to the queue of its own thread and then blocks that
+ * thread until they have run, which needs another thread to steal them
+ */
+static void
+worker_pool_test_steal_task(void* task_data)
+{
+  int* ok_p = (int*)task_data;
+  struct timespec deadline;
+  int submitted = 0;
+  int i;
+
+  for(i = 0; i < STEAL_TASKS_COUNT; i++) {
+    if(!rasqal_worker_pool_submit(test_state.pool,
+                                  worker_pool_test_steal_child_task, NULL))
+      submitted++;
+  }
+
+  deadline.tv_sec = time(NULL) + STEAL_TIMEOUT;
+  deadline.tv_nsec = 0;
+
+  RASQAL_MUTEX_LOCK(&test_state.lock);
+  while(test_state.stolen_count < submitted) {
+    if(pthread_cond_timedwait(&test_state.stolen, &test_state.lock,
+                              &deadline))
+      break;
+  }
+  *ok_p = (submitted == STEAL_TASKS_COUNT &&
+           test_state.stolen_count == submitted);
+  RASQAL_MUTEX_UNLOCK(&test_state.lock);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = rasqal_basename(argv[0]);
+  rasqal_worker_pool* pool;
+  int values[TASKS_COUNT];
+  int steal_ok = 0;
+  int expected = 0;
+  int failures = 0;
+  int i;
+
+  RASQAL_MUTEX_INIT(&test_state.lock);
+  test_state.sum = 0;
+
+  pool = rasqal_new_worker_pool(4);
+  if(!pool) {
+    fprintf(stderr, "%s: failed to create worker pool\n", program);
+    return 1;
+  }
+  test_state.pool = pool;
+
+  for(i = 0; i < TASKS_COUNT; i++) {
+    values[i] = i + 1;
+    if(rasqal_worker_pool_submit(pool, worker_pool_test_task, &values[i])) {
+      fprintf(stderr, "%s: failed to submit task %d\n", program, i);
+      failures++;
+    } else
+      expected += 2 * values[i];
+  }
+
+  /* queued tasks and the tasks they submit all run before the pool
+   * is freed */
+  rasqal_free_worker_pool(pool);
+
+  if(test_state.sum != expected) {
+    fprintf(stderr, "%s: tasks summed to %d, expected %d\n", program,
+            test_state.sum, expected);
+    failures++;
+  }
+
+  /* tasks queued by a blocked pool thread are run by the others */
+  RASQAL_COND_INIT(&test_state.stolen);
+  test_state.stolen_count = 0;
+
+  pool = rasqal_new_worker_pool(2);
+  test_state.pool = pool;
+  if(!pool || rasqal_worker_pool_submit(pool, worker_pool_test_steal_task,
+                                        &steal_ok)) {
+    fprintf(stderr, "%s: failed to start the stealing task\n", program);
+    failures++;
+  }
+  if(pool)
+    rasqal_free_worker_pool(pool);
+
+  if(pool && !steal_ok) {
+    fprintf(stderr, "%s: %d of %d tasks were stolen from a blocked thread\n",
+            program, test_state.stolen_count, STEAL_TASKS_COUNT);
+    failures++;
+  }
+
+  RASQAL_COND_DESTROY(&test_state.stolen);
+  RASQAL_MUTEX_DESTROY(&test_state.lock);
+
+  return failures;
+}
+
+#else
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = rasqal_basename(argv[0]);
+
+  if(rasqal_new_worker_pool(4)) {
+    fprintf(stderr, "%s: created a worker pool without threads\n", program);
+    return 1;
+  }
+
+  return 0;
+}
+
+#endif /* RASQAL_THREADS */
+
+#endif /* STANDALONE */
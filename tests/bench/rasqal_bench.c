@@ -0,0 +1,524 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_bench.c - Rasqal query benchmark driver
+ *
+ * Copyright (C) 2026, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ * Loads a graph made by rasqal_bench_gen into a shared triples source
+ * then runs a fixed mix of SPARQL queries over it a number of times
+ * each, reading every result.  Writes the load time, the latency
+ * percentiles of each query and the peak resident memory as JSON for
+ * bench-compare to check against a saved baseline.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+
+#ifdef RASQAL_QUERY_SPARQL
+
+#define QUERY_LANGUAGE "sparql"
+
+#define BENCH_PREFIXES "\
+PREFIX rdfs: <http://www.w3.org/2000/01/rdf-schema#> \n\
+PREFIX bsbm: <http://www4.wiwiss.fu-berlin.de/bizer/bsbm/v01/vocabulary/> \n\
+PREFIX inst: <http://www4.wiwiss.fu-berlin.de/bizer/bsbm/v01/instances/> \n\
+PREFIX rev: <http://purl.org/stuff/rev#> \n"
+
+typedef struct {
+  const char* name;
+  const char* query;
+} bench_query;
+
+/* The query mix; change it only with a new baseline */
+static const bench_query bench_queries[] = {
+  { "bgp-join",
+    BENCH_PREFIXES "\
+SELECT ?product ?label ?value WHERE { \n\
+  ?product rdfs:label ?label ; \n\
+    bsbm:productType inst:ProductType3 ; \n\
+    bsbm:productFeature inst:ProductFeature7 ; \n\
+    bsbm:productPropertyNumeric1 ?value \n\
+}" },
+  { "bgp-star",
+    BENCH_PREFIXES "\
+SELECT ?offer ?label ?price WHERE { \n\
+  ?offer bsbm:product ?product ; \n\
+    bsbm:vendor ?vendor ; \n\
+    bsbm:price ?price . \n\
+  ?vendor bsbm:country inst:Country1 . \n\
+  ?product rdfs:label ?label \n\
+}" },
+  { "optional",
+    BENCH_PREFIXES "\
+SELECT ?product ?label ?text ?rating WHERE { \n\
+  ?product a bsbm:Product ; \n\
+    rdfs:label ?label . \n\
+  OPTIONAL { ?product bsbm:productPropertyTextual1 ?text } \n\
+  OPTIONAL { ?review bsbm:reviewFor ?product ; bsbm:rating1 ?rating } \n\
+}" },
+  { "filter",
+    BENCH_PREFIXES "\
+SELECT ?offer ?price ?days WHERE { \n\
+  ?offer bsbm:price ?price ; \n\
+    bsbm:deliveryDays ?days . \n\
+  FILTER (?price < 2000 && ?days <= 3) \n\
+}" },
+  { "order-by",
+    BENCH_PREFIXES "\
+SELECT ?product ?value WHERE { \n\
+  ?product bsbm:productPropertyNumeric1 ?value \n\
+} ORDER BY DESC(?value) ?product LIMIT 10" },
+  { "group-by",
+    BENCH_PREFIXES "\
+SELECT ?producer (COUNT(?product) AS ?count) (AVG(?value) AS ?average) WHERE { \n\
+  ?product bsbm:producer ?producer ; \n\
+    bsbm:productPropertyNumeric2 ?value \n\
+} GROUP BY ?producer" },
+  { "distinct",
+    BENCH_PREFIXES "\
+SELECT DISTINCT ?country WHERE { \n\
+  ?review bsbm:reviewFor ?product ; \n\
+    rev:reviewer ?reviewer . \n\
+  ?reviewer bsbm:country ?country \n\
+}" },
+  { "union",
+    BENCH_PREFIXES "\
+SELECT ?product ?label WHERE { \n\
+  { ?product bsbm:productFeature inst:ProductFeature1 } \n\
+  UNION \n\
+  { ?product bsbm:productFeature inst:ProductFeature2 } \n\
+  ?product rdfs:label ?label \n\
+}" },
+  { NULL, NULL }
+};
+
+#define BENCH_COUNT_QUERY "SELECT (COUNT(*) AS ?count) WHERE { ?s ?p ?o }"
+
+#define BENCH_DEFAULT_ITERATIONS 10
+#define BENCH_DEFAULT_WARMUP 1
+
+#else
+#define NO_QUERY_LANGUAGE
+#endif
+
+
+#ifdef NO_QUERY_LANGUAGE
+int
+main(int argc, char **argv) {
+  const char *program = rasqal_basename(argv[0]);
+  fprintf(stderr, "%s: No supported query language available, skipping benchmark\n", program);
+  return(0);
+}
+#else
+
+/* percentiles written for each query */
+static const int bench_percentiles[] = { 50, 90, 99 };
+#define BENCH_PERCENTILES_COUNT 3
+
+
+/* peak resident memory of the process in kilobytes or -1 if unknown */
+static long
+bench_get_peak_rss(void)
+{
+#if defined(HAVE_GETRUSAGE) && defined(HAVE_SYS_RESOURCE_H)
+  struct rusage usage;
+
+  if(getrusage(RUSAGE_SELF, &usage))
+    return -1;
+
+#ifdef __APPLE__
+  /* bytes rather than kilobytes */
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#else
+  return -1;
+#endif
+}
+
+
+static double
+bench_get_time(void)
+{
+  double wall;
+  double cpu;
+
+  rasqal_engine_get_times(&wall, &cpu);
+  return wall;
+}
+
+
+static int
+bench_compare_doubles(const void* a, const void* b)
+{
+  double d1 = *(const double*)a;
+  double d2 = *(const double*)b;
+
+  return (d1 > d2) - (d1 < d2);
+}
+
+
+/* nearest rank percentile of sorted @values */
+static double
+bench_percentile(const double* values, int count, int percentile)
+{
+  int rank = (percentile * count + 99) / 100;
+
+  if(rank < 1)
+    rank = 1;
+  return values[rank - 1];
+}
+
+
+static void
+bench_write_json_string(FILE* fh, const char* str)
+{
+  fputc('"', fh);
+  for(; *str; str++) {
+    if(*str == '"' || *str == '\\')
+      fputc('\\', fh);
+    fputc(*str, fh);
+  }
+  fputc('"', fh);
+}
+
+
+static void
+bench_write_peak_rss(FILE* fh, const char* name, long rss)
+{
+  fprintf(fh, "  \"%s\": ", name);
+  if(rss < 0)
+    fputs("null", fh);
+  else
+    fprintf(fh, "%ld", rss);
+}
+
+
+/*
+ * Execute @query reading every result and return the number of rows
+ * or <0 on failure setting *@peak_memory_p to the row memory peak
+ */
+static long
+bench_execute(rasqal_query* query, size_t* peak_memory_p)
+{
+  rasqal_query_results* results;
+  long count = 0;
+
+  results = rasqal_query_execute(query);
+  if(!results)
+    return -1;
+
+  if(rasqal_query_results_is_bindings(results)) {
+    while(!rasqal_query_results_finished(results)) {
+      count++;
+      if(rasqal_query_results_next(results))
+        break;
+    }
+  }
+
+  if(rasqal_query_results_get_error(results) != RASQAL_QUERY_RESULTS_ERROR_NONE)
+    count = -1;
+
+  *peak_memory_p = rasqal_query_results_get_peak_memory(results);
+
+  rasqal_free_query_results(results);
+
+  return count;
+}
+
+
+static rasqal_query*
+bench_new_query(rasqal_world* world, const char* query_string,
+                raptor_uri* base_uri, rasqal_triples_source* triples_source)
+{
+  rasqal_query* query;
+
+  query = rasqal_new_query(world, QUERY_LANGUAGE, NULL);
+  if(!query)
+    return NULL;
+
+  if(rasqal_query_prepare(query,
+                          RASQAL_GOOD_CAST(const unsigned char*, query_string),
+                          base_uri) ||
+     rasqal_query_set_shared_triples_source(query, triples_source)) {
+    rasqal_free_query(query);
+    return NULL;
+  }
+
+  return query;
+}
+
+
+/* count the triples loaded so that results of different data are not compared */
+static long
+bench_count_triples(rasqal_world* world, raptor_uri* base_uri,
+                    rasqal_triples_source* triples_source)
+{
+  rasqal_query* query;
+  rasqal_query_results* results;
+  long count = -1;
+
+  query = bench_new_query(world, BENCH_COUNT_QUERY, base_uri, triples_source);
+  if(!query)
+    return -1;
+
+  results = rasqal_query_execute(query);
+  if(results) {
+    rasqal_literal* value;
+
+    value = rasqal_query_results_get_binding_value(results, 0);
+    if(value) {
+      int error = 0;
+
+      count = rasqal_literal_as_integer(value, &error);
+      if(error)
+        count = -1;
+    }
+    rasqal_free_query_results(results);
+  }
+
+  rasqal_free_query(query);
+
+  return count;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = rasqal_basename(argv[0]);
+  const char *data_file = NULL;
+  const char *output = NULL;
+  const char *only = NULL;
+  int iterations = BENCH_DEFAULT_ITERATIONS;
+  int warmup = BENCH_DEFAULT_WARMUP;
+  rasqal_world *world = NULL;
+  raptor_world *raptor_world_ptr;
+  raptor_uri *base_uri = NULL;
+  raptor_uri *data_uri = NULL;
+  unsigned char *uri_string;
+  raptor_sequence *data_graphs = NULL;
+  rasqal_data_graph *dg;
+  rasqal_triples_source *triples_source = NULL;
+  double* times = NULL;
+  double start;
+  double load_time;
+  long load_rss;
+  long triples;
+  FILE* fh = stdout;
+  int first = 1;
+  int failures = 0;
+  int q;
+  int i;
+
+  for(i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-n") && i + 1 < argc)
+      iterations = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-w") && i + 1 < argc)
+      warmup = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-o") && i + 1 < argc)
+      output = argv[++i];
+    else if(!strcmp(argv[i], "-q") && i + 1 < argc)
+      only = argv[++i];
+    else
+      break;
+  }
+  if(i == argc - 1)
+    data_file = argv[i];
+
+  if(!data_file || iterations < 1 || warmup < 0) {
+    fprintf(stderr, "USAGE: %s [-n ITERATIONS] [-w WARMUP] [-q QUERY] [-o FILE] DATA-FILE\n",
+            program);
+    fprintf(stderr, "Run the query mix over DATA-FILE made by rasqal_bench_gen and write timings as JSON\n");
+    fprintf(stderr, "Queries:");
+    for(q = 0; bench_queries[q].name; q++)
+      fprintf(stderr, " %s", bench_queries[q].name);
+    fputc('\n', stderr);
+    return 1;
+  }
+
+  world = rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return 1;
+  }
+  raptor_world_ptr = rasqal_world_get_raptor(world);
+
+  uri_string = raptor_uri_filename_to_uri_string("");
+  base_uri = raptor_new_uri(raptor_world_ptr, uri_string);
+  raptor_free_memory(uri_string);
+
+  uri_string = raptor_uri_filename_to_uri_string(data_file);
+  data_uri = raptor_new_uri(raptor_world_ptr, uri_string);
+  raptor_free_memory(uri_string);
+
+  times = RASQAL_CALLOC(double*, RASQAL_GOOD_CAST(size_t, iterations),
+                       sizeof(double));
+  data_graphs = raptor_new_sequence((raptor_data_free_handler)rasqal_free_data_graph,
+                                    NULL);
+  dg = rasqal_new_data_graph_from_uri(world, data_uri, NULL,
+                                      RASQAL_DATA_GRAPH_BACKGROUND,
+                                      NULL, NULL, NULL);
+  if(!base_uri || !data_uri || !times || !data_graphs || !dg ||
+     raptor_sequence_push(data_graphs, dg)) {
+    fprintf(stderr, "%s: failed to create data graph\n", program);
+    failures++;
+    goto tidy;
+  }
+
+  start = bench_get_time();
+  triples_source = rasqal_new_shared_triples_source(world, data_graphs);
+  load_time = bench_get_time() - start;
+  load_rss = bench_get_peak_rss();
+  if(!triples_source) {
+    fprintf(stderr, "%s: failed to load %s\n", program, data_file);
+    failures++;
+    goto tidy;
+  }
+
+  triples = bench_count_triples(world, base_uri, triples_source);
+
+  if(output) {
+    fh = fopen(output, "w");
+    if(!fh) {
+      fprintf(stderr, "%s: cannot write to %s\n", program, output);
+      failures++;
+      goto tidy;
+    }
+  }
+
+  fputs("{\n  \"rasqal_version\": ", fh);
+  bench_write_json_string(fh, rasqal_version_string);
+  fputs(",\n  \"data\": ", fh);
+  bench_write_json_string(fh, rasqal_basename(data_file));
+  fprintf(fh, ",\n  \"triples\": %ld,\n", triples);
+  fprintf(fh, "  \"iterations\": %d,\n", iterations);
+  fprintf(fh, "  \"load_ms\": %.3f,\n", load_time * 1000.0);
+  bench_write_peak_rss(fh, "load_peak_rss_kb", load_rss);
+  fputs(",\n  \"queries\": [", fh);
+
+  for(q = 0; bench_queries[q].name; q++) {
+    const bench_query* bq = &bench_queries[q];
+    rasqal_query* query;
+    size_t peak_memory = 0;
+    long rows = -1;
+    double total = 0.0;
+    int p;
+
+    if(only && strcmp(only, bq->name))
+      continue;
+
+    query = bench_new_query(world, bq->query, base_uri, triples_source);
+    if(!query) {
+      fprintf(stderr, "%s: query %s prepare FAILED\n", program, bq->name);
+      failures++;
+      continue;
+    }
+
+    for(i = 0; i < warmup + iterations; i++) {
+      size_t execution_peak = 0;
+      long count;
+
+      start = bench_get_time();
+      count = bench_execute(query, &execution_peak);
+      if(i >= warmup)
+        times[i - warmup] = bench_get_time() - start;
+
+      if(count < 0 || (rows >= 0 && count != rows)) {
+        fprintf(stderr, "%s: query %s execution %d returned %ld rows, expected %ld\n",
+                program, bq->name, i, count, rows);
+        failures++;
+        break;
+      }
+      rows = count;
+      if(execution_peak > peak_memory)
+        peak_memory = execution_peak;
+    }
+
+    rasqal_free_query(query);
+
+    if(i < warmup + iterations)
+      continue;
+
+    for(i = 0; i < iterations; i++)
+      total += times[i];
+    qsort(times, RASQAL_GOOD_CAST(size_t, iterations), sizeof(double),
+          bench_compare_doubles);
+
+    fputs(first ? "\n" : ",\n", fh);
+    first = 0;
+    fputs("    { \"name\": ", fh);
+    bench_write_json_string(fh, bq->name);
+    fprintf(fh, ", \"rows\": %ld, \"min_ms\": %.3f", rows, times[0] * 1000.0);
+    for(p = 0; p < BENCH_PERCENTILES_COUNT; p++)
+      fprintf(fh, ", \"p%d_ms\": %.3f", bench_percentiles[p],
+              bench_percentile(times, iterations, bench_percentiles[p]) * 1000.0);
+    fprintf(fh, ", \"max_ms\": %.3f, \"mean_ms\": %.3f, \"peak_row_bytes\": %lu }",
+            times[iterations - 1] * 1000.0, total * 1000.0 / iterations,
+            RASQAL_GOOD_CAST(unsigned long, peak_memory));
+  }
+
+  fputs("\n  ],\n", fh);
+  bench_write_peak_rss(fh, "peak_rss_kb", bench_get_peak_rss());
+  fputs("\n}\n", fh);
+
+  tidy:
+  if(fh && fh != stdout && fclose(fh)) {
+    fprintf(stderr, "%s: failed writing %s\n", program, output);
+    failures++;
+  }
+
+  if(triples_source)
+    rasqal_free_shared_triples_source(triples_source);
+  if(data_graphs)
+    raptor_free_sequence(data_graphs);
+  if(times)
+    RASQAL_FREE(double*, times);
+  if(data_uri)
+    raptor_free_uri(data_uri);
+  if(base_uri)
+    raptor_free_uri(base_uri);
+
+  rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif
@@ -0,0 +1,256 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_bench_gen.c - Rasqal benchmark data generator
+ *
+ * Copyright (C) 2026, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ * Writes an N-Triples graph shaped like the Berlin SPARQL Benchmark
+ * (BSBM) e-commerce data: products with types, features and numeric
+ * properties from producers, offers of them by vendors with prices
+ * and reviews of them by reviewers with ratings.  The scale is the
+ * number of products and every other count follows from it.
+ *
+ * The output only depends on the scale and seed so the same data is
+ * made on every platform; it uses its own random number generator
+ * rather than rand().
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+
+#define BSBM_VOCAB "http://www4.wiwiss.fu-berlin.de/bizer/bsbm/v01/vocabulary/"
+#define BSBM_INST "http://www4.wiwiss.fu-berlin.de/bizer/bsbm/v01/instances/"
+#define RDF_TYPE "http://www.w3.org/1999/02/22-rdf-syntax-ns#type"
+#define RDFS_LABEL "http://www.w3.org/2000/01/rdf-schema#label"
+#define DC_TITLE "http://purl.org/dc/elements/1.1/title"
+#define REV_REVIEWER "http://purl.org/stuff/rev#reviewer"
+#define XSD_INTEGER "http://www.w3.org/2001/XMLSchema#integer"
+#define XSD_DECIMAL "http://www.w3.org/2001/XMLSchema#decimal"
+
+/* fixed sizes of the classifications used by the queries */
+#define BENCH_PRODUCT_TYPES 20
+#define BENCH_PRODUCT_FEATURES 100
+#define BENCH_COUNTRIES 10
+
+#define BENCH_DEFAULT_SCALE 1000
+#define BENCH_DEFAULT_SEED 1
+
+
+/* 31-bit linear congruential generator giving the same sequence everywhere */
+static unsigned long bench_random_state;
+
+static unsigned long
+bench_random(unsigned long range)
+{
+  bench_random_state = (bench_random_state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+  /* the low bits of an LCG are the least random */
+  return (bench_random_state >> 8) % range;
+}
+
+
+static void
+bench_write_type(FILE* fh, const char* kind, long id, const char* type)
+{
+  fprintf(fh, "<" BSBM_INST "%s%ld> <" RDF_TYPE "> <" BSBM_VOCAB "%s> .\n",
+          kind, id, type);
+}
+
+
+static void
+bench_write_label(FILE* fh, const char* kind, long id, const char* predicate)
+{
+  fprintf(fh, "<" BSBM_INST "%s%ld> <%s> \"%s %ld\" .\n",
+          kind, id, predicate, kind, id);
+}
+
+
+static void
+bench_write_link(FILE* fh, const char* kind, long id, const char* predicate,
+                 const char* object_kind, long object_id)
+{
+  fprintf(fh, "<" BSBM_INST "%s%ld> <" BSBM_VOCAB "%s> <" BSBM_INST "%s%ld> .\n",
+          kind, id, predicate, object_kind, object_id);
+}
+
+
+static void
+bench_write_integer(FILE* fh, const char* kind, long id, const char* predicate,
+                    long value)
+{
+  fprintf(fh, "<" BSBM_INST "%s%ld> <" BSBM_VOCAB "%s> \"%ld\"^^<" XSD_INTEGER "> .\n",
+          kind, id, predicate, value);
+}
+
+
+static void
+bench_generate(FILE* fh, long scale)
+{
+  long producers = scale / 50 + 1;
+  long vendors = scale / 100 + 1;
+  long reviewers = scale / 20 + 1;
+  long offers = scale * 2;
+  long reviews = scale / 2;
+  long i;
+
+  for(i = 1; i <= BENCH_PRODUCT_TYPES; i++) {
+    bench_write_type(fh, "ProductType", i, "ProductType");
+    bench_write_label(fh, "ProductType", i, RDFS_LABEL);
+  }
+
+  for(i = 1; i <= BENCH_PRODUCT_FEATURES; i++) {
+    bench_write_type(fh, "ProductFeature", i, "ProductFeature");
+    bench_write_label(fh, "ProductFeature", i, RDFS_LABEL);
+  }
+
+  for(i = 1; i <= producers; i++) {
+    bench_write_type(fh, "Producer", i, "Producer");
+    bench_write_label(fh, "Producer", i, RDFS_LABEL);
+    bench_write_link(fh, "Producer", i, "country", "Country",
+                     RASQAL_GOOD_CAST(long, bench_random(BENCH_COUNTRIES)) + 1);
+  }
+
+  for(i = 1; i <= scale; i++) {
+    unsigned long features;
+    unsigned long j;
+
+    bench_write_type(fh, "Product", i, "Product");
+    bench_write_label(fh, "Product", i, RDFS_LABEL);
+    bench_write_link(fh, "Product", i, "productType", "ProductType",
+                     RASQAL_GOOD_CAST(long, bench_random(BENCH_PRODUCT_TYPES)) + 1);
+    bench_write_link(fh, "Product", i, "producer", "Producer",
+                     RASQAL_GOOD_CAST(long, bench_random(RASQAL_GOOD_CAST(unsigned long, producers))) + 1);
+
+    features = 3 + bench_random(5);
+    for(j = 0; j < features; j++)
+      bench_write_link(fh, "Product", i, "productFeature", "ProductFeature",
+                       RASQAL_GOOD_CAST(long, bench_random(BENCH_PRODUCT_FEATURES)) + 1);
+
+    bench_write_integer(fh, "Product", i, "productPropertyNumeric1",
+                        RASQAL_GOOD_CAST(long, bench_random(2000)) + 1);
+    bench_write_integer(fh, "Product", i, "productPropertyNumeric2",
+                        RASQAL_GOOD_CAST(long, bench_random(2000)) + 1);
+
+    /* an optional property for OPTIONAL to find missing */
+    if(bench_random(10) < 7)
+      fprintf(fh, "<" BSBM_INST "Product%ld> <" BSBM_VOCAB "productPropertyTextual1> \"text %lu\" .\n",
+              i, bench_random(100000));
+  }
+
+  for(i = 1; i <= vendors; i++) {
+    bench_write_type(fh, "Vendor", i, "Vendor");
+    bench_write_label(fh, "Vendor", i, RDFS_LABEL);
+    bench_write_link(fh, "Vendor", i, "country", "Country",
+                     RASQAL_GOOD_CAST(long, bench_random(BENCH_COUNTRIES)) + 1);
+  }
+
+  for(i = 1; i <= offers; i++) {
+    unsigned long cents = 500 + bench_random(999500);
+
+    bench_write_type(fh, "Offer", i, "Offer");
+    bench_write_link(fh, "Offer", i, "product", "Product",
+                     RASQAL_GOOD_CAST(long, bench_random(RASQAL_GOOD_CAST(unsigned long, scale))) + 1);
+    bench_write_link(fh, "Offer", i, "vendor", "Vendor",
+                     RASQAL_GOOD_CAST(long, bench_random(RASQAL_GOOD_CAST(unsigned long, vendors))) + 1);
+    fprintf(fh, "<" BSBM_INST "Offer%ld> <" BSBM_VOCAB "price> \"%lu.%02lu\"^^<" XSD_DECIMAL "> .\n",
+            i, cents / 100, cents % 100);
+    bench_write_integer(fh, "Offer", i, "deliveryDays",
+                        RASQAL_GOOD_CAST(long, bench_random(7)) + 1);
+  }
+
+  for(i = 1; i <= reviewers; i++) {
+    bench_write_type(fh, "Reviewer", i, "Reviewer");
+    bench_write_label(fh, "Reviewer", i, RDFS_LABEL);
+    bench_write_link(fh, "Reviewer", i, "country", "Country",
+                     RASQAL_GOOD_CAST(long, bench_random(BENCH_COUNTRIES)) + 1);
+  }
+
+  for(i = 1; i <= reviews; i++) {
+    bench_write_type(fh, "Review", i, "Review");
+    bench_write_label(fh, "Review", i, DC_TITLE);
+    bench_write_link(fh, "Review", i, "reviewFor", "Product",
+                     RASQAL_GOOD_CAST(long, bench_random(RASQAL_GOOD_CAST(unsigned long, scale))) + 1);
+    fprintf(fh, "<" BSBM_INST "Review%ld> <" REV_REVIEWER "> <" BSBM_INST "Reviewer%lu> .\n",
+            i, bench_random(RASQAL_GOOD_CAST(unsigned long, reviewers)) + 1);
+    if(bench_random(10) < 8)
+      bench_write_integer(fh, "Review", i, "rating1",
+                          RASQAL_GOOD_CAST(long, bench_random(10)) + 1);
+  }
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = rasqal_basename(argv[0]);
+  const char *output = NULL;
+  long scale = BENCH_DEFAULT_SCALE;
+  long seed = BENCH_DEFAULT_SEED;
+  FILE* fh = stdout;
+  int i;
+
+  for(i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-s") && i + 1 < argc)
+      scale = atol(argv[++i]);
+    else if(!strcmp(argv[i], "-r") && i + 1 < argc)
+      seed = atol(argv[++i]);
+    else if(!strcmp(argv[i], "-o") && i + 1 < argc)
+      output = argv[++i];
+    else
+      break;
+  }
+
+  if(i != argc || scale < 1) {
+    fprintf(stderr, "USAGE: %s [-s PRODUCTS] [-r SEED] [-o FILE]\n", program);
+    fprintf(stderr, "Write BSBM-shaped N-Triples for PRODUCTS products (default %d)\n",
+            BENCH_DEFAULT_SCALE);
+    return 1;
+  }
+
+  if(output) {
+    fh = fopen(output, "w");
+    if(!fh) {
+      fprintf(stderr, "%s: cannot write to %s\n", program, output);
+      return 1;
+    }
+  }
+
+  bench_random_state = RASQAL_GOOD_CAST(unsigned long, seed) & 0x7fffffffUL;
+  bench_generate(fh, scale);
+
+  if(output && fclose(fh)) {
+    fprintf(stderr, "%s: failed writing %s\n", program, output);
+    return 1;
+  }
+
+  return 0;
+}
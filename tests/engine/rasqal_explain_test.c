@@ -0,0 +1,329 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_explain_test.c - Rasqal RDF Query plan EXPLAIN and counters Tests
+ *
+ * Copyright (C) 2026, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#include <stdarg.h>
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+#ifdef RASQAL_QUERY_SPARQL
+#define QUERY_LANGUAGE "sparql"
+/* 26 triples match the pattern */
+#define QUERY_LIMIT "\
+SELECT $letter \
+FROM <%s> \
+WHERE { <http://example.org/> <http://example.org#pred> $letter } \
+LIMIT 5 \
+"
+/* 13 of the 26 letters are after m */
+#define QUERY_FILTER "\
+SELECT $letter \
+FROM <%s> \
+WHERE { <http://example.org/> <http://example.org#pred> $letter \
+        FILTER($letter > \"m\") } \
+"
+#else
+#define NO_QUERY_LANGUAGE
+#endif
+
+
+#ifdef NO_QUERY_LANGUAGE
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  fprintf(stderr, "%s: SPARQL query language not available, skipping test\n", program);
+  return(0);
+}
+#else
+
+#define PATTERN_ROWS_COUNT 26
+#define LIMIT_ROWS_COUNT 5
+#define FILTER_ROWS_COUNT 13
+
+
+/*
+ * Execute the query made from @query_format and @data_string and
+ * read all the results returning the results and setting *@count_p
+ */
+static rasqal_query_results*
+explain_test_execute(const char* program, rasqal_world* world,
+                     raptor_uri* base_uri, const char* query_format,
+                     const unsigned char* data_string,
+                     rasqal_query** query_p, int* count_p)
+{
+  rasqal_query *query;
+  rasqal_query_results *results;
+  unsigned char *query_string;
+  size_t qs_len;
+  int count = 0;
+
+  qs_len = strlen((const char*)data_string) + strlen(query_format);
+  query_string = RASQAL_MALLOC(unsigned char*, qs_len + 1);
+  if(!query_string)
+    return NULL;
+  IGNORE_FORMAT_NONLITERAL_START
+  snprintf((char*)query_string, qs_len, query_format, data_string);
+  IGNORE_FORMAT_NONLITERAL_END
+
+  query = rasqal_new_query(world, QUERY_LANGUAGE, NULL);
+  if(!query || rasqal_query_prepare(query, query_string, base_uri)) {
+    fprintf(stderr, "%s: query prepare '%s' FAILED\n", program, query_string);
+    RASQAL_FREE(char*, query_string);
+    if(query)
+      rasqal_free_query(query);
+    return NULL;
+  }
+  RASQAL_FREE(char*, query_string);
+
+  results = rasqal_query_execute(query);
+  if(!results) {
+    fprintf(stderr, "%s: query execution FAILED\n", program);
+    rasqal_free_query(query);
+    return NULL;
+  }
+
+  while(!rasqal_query_results_finished(results)) {
+    count++;
+    rasqal_query_results_next(results);
+  }
+
+  *query_p = query;
+  *count_p = count;
+  return results;
+}
+
+
+/*
+ * EXPLAIN of a BGP with a LIMIT: the triple pattern rowsource is
+ * estimated to return all the matches but returns only the rows read
+ */
+static int
+explain_test_limit(const char* program, rasqal_world* world,
+                   raptor_uri* base_uri, const unsigned char* data_string)
+{
+  rasqal_query *query = NULL;
+  rasqal_query_results *results;
+  raptor_iostream *iostr;
+  unsigned char *plan = NULL;
+  size_t plan_len;
+  const char *line;
+  char expected[64];
+  int failures = 0;
+  int count = 0;
+
+  results = explain_test_execute(program, world, base_uri, QUERY_LIMIT,
+                                 data_string, &query, &count);
+  if(!results)
+    return 1;
+
+  if(count != LIMIT_ROWS_COUNT) {
+    fprintf(stderr, "%s: LIMIT query returned %d results, expected %d\n",
+            program, count, LIMIT_ROWS_COUNT);
+    failures++;
+    goto tidy;
+  }
+
+  iostr = raptor_new_iostream_to_string(world->raptor_world_ptr,
+                                        (void**)&plan, &plan_len, NULL);
+  if(!iostr) {
+    failures++;
+    goto tidy;
+  }
+  if(rasqal_query_results_write_explain(iostr, results,
+                                        RASQAL_QUERY_EXPLAIN_FORMAT_TEXT)) {
+    fprintf(stderr, "%s: writing the query plan FAILED\n", program);
+    failures++;
+  }
+  raptor_free_iostream(iostr);
+  if(failures || !plan)
+    goto tidy;
+
+  /* the top of the plan returned the rows read */
+  snprintf(expected, sizeof(expected), " rows=%d ", LIMIT_ROWS_COUNT);
+  line = strchr((const char*)plan, '\n');
+  if(!line || !strstr((const char*)plan, expected) ||
+     strstr((const char*)plan, expected) > line) {
+    fprintf(stderr, "%s: query plan top does not have%s\n%s", program,
+            expected, plan);
+    failures++;
+  }
+
+  snprintf(expected, sizeof(expected), " estimated rows=%d rows=%d ",
+           PATTERN_ROWS_COUNT, LIMIT_ROWS_COUNT);
+  line = strstr((const char*)plan, "triple pattern ");
+  if(!line || !strstr(line, expected) ||
+     strstr(line, expected) > strchr(line, '\n')) {
+    fprintf(stderr, "%s: query plan triple pattern does not have%s\n%s",
+            program, expected, plan);
+    failures++;
+  }
+
+  tidy:
+  if(plan)
+    raptor_free_memory(plan);
+  rasqal_free_query_results(results);
+  rasqal_free_query(query);
+
+  return failures;
+}
+
+
+/*
+ * Operator counters of a filtered BGP: the triple pattern makes one
+ * match and steps it once per row, and the FILTER is evaluated once
+ * per triple pattern row by whichever operator applies it
+ */
+static int
+explain_test_counters(const char* program, rasqal_world* world,
+                      raptor_uri* base_uri, const unsigned char* data_string)
+{
+  rasqal_query *query = NULL;
+  rasqal_query_results *results;
+  rasqal_operator_counters counters;
+  long expressions = 0;
+  int pattern_seen = 0;
+  int failures = 0;
+  int count = 0;
+  int offset;
+  int rc;
+
+  results = explain_test_execute(program, world, base_uri, QUERY_FILTER,
+                                 data_string, &query, &count);
+  if(!results)
+    return 1;
+
+  if(count != FILTER_ROWS_COUNT) {
+    fprintf(stderr, "%s: FILTER query returned %d results, expected %d\n",
+            program, count, FILTER_ROWS_COUNT);
+    failures++;
+    goto tidy;
+  }
+
+  for(offset = 0;
+      !(rc = rasqal_query_results_get_operator_counters(results, offset,
+                                                        &counters));
+      offset++) {
+    if(!offset && (counters.depth || counters.rows_produced != FILTER_ROWS_COUNT)) {
+      fprintf(stderr,
+              "%s: top operator %s at depth %d returned %ld rows, expected %d\n",
+              program, counters.name, counters.depth, counters.rows_produced,
+              FILTER_ROWS_COUNT);
+      failures++;
+    }
+
+    if(!strcmp(counters.name, "triple pattern")) {
+      pattern_seen++;
+      if(counters.rows_produced != PATTERN_ROWS_COUNT ||
+         counters.rows_consumed || counters.resets ||
+         counters.triples_matches != 1 ||
+         counters.triples_next_matches != PATTERN_ROWS_COUNT) {
+        fprintf(stderr,
+                "%s: triple pattern returned %ld rows with %ld matches and %ld next matches, expected %d, 1 and %d\n",
+                program, counters.rows_produced, counters.triples_matches,
+                counters.triples_next_matches, PATTERN_ROWS_COUNT,
+                PATTERN_ROWS_COUNT);
+        failures++;
+      }
+    }
+
+    /* not profiled */
+    if(counters.wall_time > 0.0 || counters.bytes_allocated) {
+      fprintf(stderr, "%s: operator %s has profiled counters\n", program,
+              counters.name);
+      failures++;
+    }
+
+    expressions += counters.expression_evaluations;
+  }
+
+  if(rc < 0 || pattern_seen != 1) {
+    fprintf(stderr, "%s: getting operator counters FAILED\n", program);
+    failures++;
+  }
+
+  if(expressions != PATTERN_ROWS_COUNT) {
+    fprintf(stderr, "%s: operators evaluated %ld expressions, expected %d\n",
+            program, expressions, PATTERN_ROWS_COUNT);
+    failures++;
+  }
+
+  tidy:
+  rasqal_free_query_results(results);
+  rasqal_free_query(query);
+
+  return failures;
+}
+
+
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  raptor_uri *base_uri;
+  unsigned char *uri_string;
+  unsigned char *data_string;
+  int failures = 0;
+  rasqal_world *world;
+
+  if(argc != 2) {
+    fprintf(stderr, "USAGE: %s data-filename\n", program);
+    return(1);
+  }
+
+  world=rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  uri_string=raptor_uri_filename_to_uri_string("");
+  base_uri = raptor_new_uri(world->raptor_world_ptr, uri_string);
+  raptor_free_memory(uri_string);
+
+  data_string=raptor_uri_filename_to_uri_string(argv[1]);
+
+  failures += explain_test_limit(program, world, base_uri, data_string);
+  failures += explain_test_counters(program, world, base_uri, data_string);
+
+  raptor_free_memory(data_string);
+
+  raptor_free_uri(base_uri);
+
+  rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif
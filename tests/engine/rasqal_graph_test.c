@@ -50,7 +50,7 @@ static const char* graph_files[DATA_GRAPH_COUNT] = {
 };
 
 
-#define QUERY_VARIABLES_MAX_COUNT 3
+#define QUERY_VARIABLES_MAX_COUNT 5
 
 struct test
 {
@@ -66,11 +66,13 @@ struct test
   int graph_answers[QUERY_VARIABLES_MAX_COUNT];
   const char* value_var;
   const char* graph_var;
+  /* worker threads to evaluate the query with (0 for none) */
+  int parallelism;
 };
 
 
 
-#define QUERY_COUNT 2
+#define QUERY_COUNT 6
 
 
 static const struct test tests[QUERY_COUNT] = {
@@ -105,6 +107,78 @@ WHERE\
     /* graph_answers */ { 0, 1, 2 },
     /* value_var */ "value",
     /* graph_var */ "graph",
+  },
+  /* both triple patterns must match in the same graph */
+  { /* query_language */ "sparql",
+    /* query_string */ "\
+PREFIX : <http://example.org/>\
+SELECT ?graph ?value \
+WHERE\
+{\
+  GRAPH ?graph { ?var :a ?a . :x :b ?value } \
+}\
+",  
+    /* expected_count */  2,
+    /* data_graphs */ { 0, 1, 2 },
+    /* value_answers */ { "mercury", "orange" },
+    /* graph_answers */ { 0, 1 },
+    /* value_var */ "value",
+    /* graph_var */ "graph",
+  },
+  /* evaluated one named graph at a time */
+  { /* query_language */ "sparql",
+    /* query_string */ "\
+PREFIX : <http://example.org/>\
+SELECT ?graph ?value \
+WHERE\
+{\
+  GRAPH ?graph { ?var :a ?value FILTER(?value != \"apple\") } \
+}\
+",  
+    /* expected_count */  2,
+    /* data_graphs */ { 0, 1, 2 },
+    /* value_answers */ { "venus", "red" },
+    /* graph_answers */ { 0, 2 },
+    /* value_var */ "value",
+    /* graph_var */ "graph",
+  },
+  /* same with the named graphs evaluated in parallel, in graph order */
+  { /* query_language */ "sparql",
+    /* query_string */ "\
+PREFIX : <http://example.org/>\
+SELECT ?graph ?value \
+WHERE\
+{\
+  GRAPH ?graph { ?var :a ?value FILTER(?value != \"apple\") } \
+}\
+",  
+    /* expected_count */  2,
+    /* data_graphs */ { 0, 1, 2 },
+    /* value_answers */ { "venus", "red" },
+    /* graph_answers */ { 0, 2 },
+    /* value_var */ "value",
+    /* graph_var */ "graph",
+    /* parallelism */ 2,
+  },
+  /* UNION branches evaluated in parallel, in branch order */
+  { /* query_language */ "sparql",
+    /* query_string */ "\
+PREFIX : <http://example.org/>\
+SELECT ?graph ?value \
+WHERE\
+{\
+  { GRAPH ?graph { ?var :a ?value } } \
+  UNION \
+  { GRAPH ?graph { :x :b ?value } } \
+}\
+",  
+    /* expected_count */  5,
+    /* data_graphs */ { 0, 1, 2 },
+    /* value_answers */ { "venus", "apple", "red", "mercury", "orange" },
+    /* graph_answers */ { 0, 1, 2, 0, 1 },
+    /* value_var */ "value",
+    /* graph_var */ "graph",
+    /* parallelism */ 2,
   }
 };
 
@@ -123,9 +197,13 @@ main(int argc, char **argv) {
 }
 #else
 
-int
-main(int argc, char **argv) {
-  const char *program=rasqal_basename(argv[0]);
+/*
+ * Run the tests with @parallel set or not set in @world
+ */
+static int
+graph_test_run(const char* program, rasqal_world* world,
+               const char* data_dir, int parallel)
+{
   int failures=0;
   raptor_uri *base_uri;
   unsigned char *data_dir_string;
@@ -133,25 +211,13 @@ main(int argc, char **argv) {
   unsigned char *uri_string;
   int i;
   raptor_uri* graph_uris[DATA_GRAPH_COUNT];
-  rasqal_world *world;
-  
-  if(argc != 2) {
-    fprintf(stderr, "USAGE: %s <path to data directory>\n", program);
-    return(1);
-  }
 
-  world=rasqal_new_world();
-  if(!world || rasqal_world_open(world)) {
-    fprintf(stderr, "%s: rasqal_world init failed\n", program);
-    return(1);
-  }
-  
   uri_string=raptor_uri_filename_to_uri_string("");
   base_uri = raptor_new_uri(world->raptor_world_ptr, uri_string);
   raptor_free_memory(uri_string);
 
 
-  data_dir_string=raptor_uri_filename_to_uri_string(argv[1]);
+  data_dir_string=raptor_uri_filename_to_uri_string(data_dir);
   data_dir_uri = raptor_new_uri(world->raptor_world_ptr, data_dir_string);
 
   for(i=0; i < DATA_GRAPH_COUNT; i++)
@@ -173,6 +239,9 @@ main(int argc, char **argv) {
     int query_failed=0;
     int j;
 
+    if(!tests[i].parallelism != !parallel)
+      continue;
+
     query=rasqal_new_query(world, query_language_name, NULL);
     if(!query) {
       fprintf(stderr, "%s: creating query %d in language %s FAILED\n", 
@@ -189,6 +258,10 @@ main(int argc, char **argv) {
       goto tidy_query;
     }
 
+    if(tests[i].parallelism)
+      rasqal_query_set_feature(query, RASQAL_FEATURE_PARALLELISM,
+                               tests[i].parallelism);
+
     for(j=0; j < DATA_GRAPH_COUNT; j++) {
       int offset=tests[i].data_graphs[j];
       if(offset >= 0) {
@@ -293,8 +366,67 @@ main(int argc, char **argv) {
 
   raptor_free_uri(base_uri);
 
+  return failures;
+}
+
+
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  int failures=0;
+  raptor_world *raptor_world_ptr;
+  rasqal_world *world;
+  
+  if(argc != 2) {
+    fprintf(stderr, "USAGE: %s <path to data directory>\n", program);
+    return(1);
+  }
+
+  world=rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  failures += graph_test_run(program, world, argv[1], 0);
+
+  rasqal_free_world(world);
+
+
+  /* Worker threads evaluating named graphs make URIs so the parallel
+   * tests use a world of their own with URI interning turned off */
+  raptor_world_ptr = raptor_new_world();
+  if(!raptor_world_ptr ||
+     raptor_world_set_flag(raptor_world_ptr, RAPTOR_WORLD_FLAG_URI_INTERNING, 0) ||
+     raptor_world_open(raptor_world_ptr)) {
+    fprintf(stderr, "%s: raptor_world init failed\n", program);
+    return(1);
+  }
+
+  world=rasqal_new_world();
+  if(!world) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+  rasqal_world_set_raptor(world, raptor_world_ptr);
+  if(rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  /* worker pool shared by the tests that evaluate in parallel */
+  if(rasqal_world_set_feature(world, RASQAL_WORLD_FEATURE_WORKER_THREADS, 2) ||
+     rasqal_world_get_feature(world, RASQAL_WORLD_FEATURE_WORKER_THREADS) != 2) {
+    fprintf(stderr, "%s: setting world worker threads failed\n", program);
+    return(1);
+  }
+
+  failures += graph_test_run(program, world, argv[1], 1);
+
   rasqal_free_world(world);
 
+  raptor_free_world(raptor_world_ptr);
+
   return failures;
 }
 
@@ -0,0 +1,291 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_group_spill_test.c - Rasqal RDF Query GROUP BY spilling Tests
+ *
+ * Copyright (C) 2026, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#include <stdarg.h>
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+#ifdef RASQAL_QUERY_SPARQL
+#define QUERY_LANGUAGE "sparql"
+#define QUERY_FORMAT "\
+PREFIX : <http://example.org/> \
+SELECT ?key (SUM(?val) AS ?sum) (COUNT(?val) AS ?count) \
+FROM <%s> \
+WHERE { ?s :key ?key ; :val ?val } \
+GROUP BY ?key \
+"
+#else
+#define NO_QUERY_LANGUAGE
+#endif
+
+
+#ifdef NO_QUERY_LANGUAGE
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  fprintf(stderr, "%s: SPARQL query language not available, skipping test\n", program);
+  return(0);
+}
+#else
+
+/*
+ * group-keys.ttl has 3 rows for each of 48 keys with ?val 0 to 143.
+ * Key k is made from n = k / 6 as a URI, plain literal, @en literal,
+ * xsd:integer, @fr literal and blank node in turn, so rows k, k + 48
+ * and k + 96 make a group with a SUM of 3k + 144.
+ */
+#define GROUP_KEYS_GROUPS 48
+#define GROUP_KEYS_VARIANTS 6
+#define GROUP_KEYS_PER_GROUP 3
+
+/* the groups need several KB so a 1 KB limit makes them spill */
+#define GROUP_SPILL_LIMIT 1
+
+
+/*
+ * Run the GROUP BY query over @data_string with a GROUP BY memory
+ * budget of @spill_limit KB storing a copy of each group's key in
+ * @keys indexed by group.
+ */
+static int
+group_spill_test_run(const char* program, rasqal_world* world,
+                     raptor_uri* base_uri, const unsigned char* data_string,
+                     int spill_limit, rasqal_literal** keys)
+{
+  rasqal_query *query;
+  rasqal_query_results *results;
+  unsigned char *query_string;
+  size_t qs_len;
+  int failures = 0;
+  int count = 0;
+
+  qs_len = strlen((const char*)data_string) + strlen(QUERY_FORMAT);
+  query_string = RASQAL_MALLOC(unsigned char*, qs_len + 1);
+  if(!query_string)
+    return 1;
+  snprintf((char*)query_string, qs_len, QUERY_FORMAT, data_string);
+
+  query = rasqal_new_query(world, QUERY_LANGUAGE, NULL);
+  if(!query || rasqal_query_prepare(query, query_string, base_uri)) {
+    fprintf(stderr, "%s: query prepare '%s' FAILED\n", program, query_string);
+    RASQAL_FREE(char*, query_string);
+    if(query)
+      rasqal_free_query(query);
+    return 1;
+  }
+  RASQAL_FREE(char*, query_string);
+
+  rasqal_query_set_feature(query, RASQAL_FEATURE_GROUP_SPILL_LIMIT,
+                           spill_limit);
+
+  results = rasqal_query_execute(query);
+  if(!results) {
+    fprintf(stderr, "%s: query execution with spill limit %d FAILED\n",
+            program, spill_limit);
+    rasqal_free_query(query);
+    return 1;
+  }
+
+  while(!rasqal_query_results_finished(results)) {
+    rasqal_literal *key;
+    rasqal_literal *l;
+    int sum;
+    int group_count;
+    int k;
+    int error = 0;
+
+    count++;
+
+    key = rasqal_query_results_get_binding_value_by_name(results,
+            RASQAL_GOOD_CAST(const unsigned char*, "key"));
+    l = rasqal_query_results_get_binding_value_by_name(results,
+          RASQAL_GOOD_CAST(const unsigned char*, "sum"));
+    sum = l ? rasqal_literal_as_integer(l, &error) : -1;
+    l = rasqal_query_results_get_binding_value_by_name(results,
+          RASQAL_GOOD_CAST(const unsigned char*, "count"));
+    group_count = l ? rasqal_literal_as_integer(l, &error) : -1;
+
+    k = (sum - GROUP_KEYS_PER_GROUP * GROUP_KEYS_GROUPS) / GROUP_KEYS_PER_GROUP;
+    if(!key || error || group_count != GROUP_KEYS_PER_GROUP ||
+       k < 0 || k >= GROUP_KEYS_GROUPS ||
+       sum != GROUP_KEYS_PER_GROUP * (k + GROUP_KEYS_GROUPS) || keys[k]) {
+      fprintf(stderr,
+              "%s: spill limit %d result #%d has SUM %d and COUNT %d\n",
+              program, spill_limit, count, sum, group_count);
+      failures++;
+      break;
+    }
+
+    keys[k] = rasqal_new_literal_from_literal(key);
+
+    rasqal_query_results_next(results);
+  }
+
+  if(!failures && count != GROUP_KEYS_GROUPS) {
+    fprintf(stderr, "%s: spill limit %d returned %d groups, expected %d\n",
+            program, spill_limit, count, GROUP_KEYS_GROUPS);
+    failures++;
+  }
+
+  rasqal_free_query_results(results);
+  rasqal_free_query(query);
+
+  return failures;
+}
+
+
+/*
+ * Check the GROUP BY query returns the same groups when the groups
+ * spill to disk as when they are aggregated in memory.  Blank node
+ * labels are made per load of the data so only their kind is checked.
+ */
+static int
+group_spill_test(const char* program, rasqal_world* world,
+                 raptor_uri* base_uri, const unsigned char* data_string)
+{
+  rasqal_literal* memory_keys[GROUP_KEYS_GROUPS];
+  rasqal_literal* spill_keys[GROUP_KEYS_GROUPS];
+  int failures = 0;
+  int k;
+
+  memset(memory_keys, '\0', sizeof(memory_keys));
+  memset(spill_keys, '\0', sizeof(spill_keys));
+
+  failures += group_spill_test_run(program, world, base_uri, data_string,
+                                   0, memory_keys);
+  failures += group_spill_test_run(program, world, base_uri, data_string,
+                                   GROUP_SPILL_LIMIT, spill_keys);
+  if(failures)
+    goto tidy;
+
+  for(k = 0; k < GROUP_KEYS_GROUPS; k++) {
+    rasqal_literal* key = memory_keys[k];
+    rasqal_literal_type type = rasqal_literal_get_rdf_term_type(key);
+    int ok;
+
+    switch(k % GROUP_KEYS_VARIANTS) {
+      case 0:
+        ok = (type == RASQAL_LITERAL_URI);
+        break;
+      case 2:
+        ok = (key->language && !strcmp(key->language, "en"));
+        break;
+      case 3:
+        ok = (type == RASQAL_LITERAL_STRING && rasqal_literal_datatype(key) &&
+              raptor_uri_equals(rasqal_literal_datatype(key),
+                                rasqal_xsd_datatype_type_to_uri(world, RASQAL_LITERAL_INTEGER)));
+        break;
+      case 4:
+        ok = (key->language && !strcmp(key->language, "fr"));
+        break;
+      case 5:
+        ok = (type == RASQAL_LITERAL_BLANK);
+        break;
+      default:
+        ok = (type == RASQAL_LITERAL_STRING && !key->language &&
+              !key->datatype);
+        break;
+    }
+
+    if(ok) {
+      if(type == RASQAL_LITERAL_BLANK)
+        ok = (rasqal_literal_get_rdf_term_type(spill_keys[k]) == type);
+      else
+        ok = rasqal_literal_equals_flags(key, spill_keys[k],
+                                         RASQAL_COMPARE_RDF, NULL);
+    }
+
+    if(!ok) {
+      fprintf(stderr, "%s: group %d key ", program, k);
+      rasqal_literal_print(key, stderr);
+      fputs(" spilled as ", stderr);
+      rasqal_literal_print(spill_keys[k], stderr);
+      fputc('\n', stderr);
+      failures++;
+    }
+  }
+
+  tidy:
+  for(k = 0; k < GROUP_KEYS_GROUPS; k++) {
+    if(memory_keys[k])
+      rasqal_free_literal(memory_keys[k]);
+    if(spill_keys[k])
+      rasqal_free_literal(spill_keys[k]);
+  }
+
+  return failures;
+}
+
+
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  raptor_uri *base_uri;
+  unsigned char *uri_string;
+  unsigned char *data_string;
+  int failures = 0;
+  rasqal_world *world;
+
+  if(argc != 2) {
+    fprintf(stderr, "USAGE: %s data-filename\n", program);
+    return(1);
+  }
+
+  world=rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  uri_string=raptor_uri_filename_to_uri_string("");
+  base_uri = raptor_new_uri(world->raptor_world_ptr, uri_string);
+  raptor_free_memory(uri_string);
+
+  data_string=raptor_uri_filename_to_uri_string(argv[1]);
+
+  failures += group_spill_test(program, world, base_uri, data_string);
+
+  raptor_free_memory(data_string);
+
+  raptor_free_uri(base_uri);
+
+  rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif
@@ -60,6 +60,19 @@ SELECT $letter \
 } \
 "
 
+/* OFFSET rows are skipped through the projection and both branches */
+#define QUERY_UNION "\
+SELECT $letter \
+FROM <%s> \
+WHERE { \
+  { <http://example.org/> <http://example.org#pred> $letter \
+    FILTER($letter < \"n\") } \
+  UNION \
+  { <http://example.org/> <http://example.org#pred> $letter \
+    FILTER($letter >= \"n\") } \
+} \
+"
+
 #else
 #define NO_QUERY_LANGUAGE
 #endif
@@ -74,11 +87,12 @@ main(int argc, char **argv) {
 }
 #else
 
-#define NQUERIES 3
+#define NQUERIES 4
 static const char* limit_queries[NQUERIES]= { 
   QUERY_UNSORTED,
   QUERY_SORTED,
-  QUERY_SUBSELECT
+  QUERY_SUBSELECT,
+  QUERY_UNION
 };
 
 
@@ -95,18 +109,23 @@ static limit_test limit_offset_tests[]={
 /* limit offset count results */
   { NONE, NONE,   26, { "jcthzguxwpnefbioqadmrvykls",
                         "abcdefghijklmnopqrstuvwxyz",
-                        "abcdefghijklmnopqrstuvwxyz" } },
-  { 0,    NONE,    0, { "", "", "" } },
+                        "abcdefghijklmnopqrstuvwxyz",
+                        "jchgefbiadmkltzuxwpnoqrvys" } },
+  { 0,    NONE,    0, { "", "", "", "" } },
   { NONE,    0,   26, { "jcthzguxwpnefbioqadmrvykls",
                         "abcdefghijklmnopqrstuvwxyz",
-                        "abcdefghijklmnopqrstuvwxyz" } },
-  { 10,   NONE,   10, { "jcthzguxwp", "abcdefghij", "abcdefghij" } },
+                        "abcdefghijklmnopqrstuvwxyz",
+                        "jchgefbiadmkltzuxwpnoqrvys" } },
+  { 10,   NONE,   10, { "jcthzguxwp", "abcdefghij", "abcdefghij",
+                        "jchgefbiad" } },
   { NONE,    5,   21, { "guxwpnefbioqadmrvykls",
                         "fghijklmnopqrstuvwxyz",
-                        "fghijklmnopqrstuvwxyz" } },
-  { 10,      5,   10, { "guxwpnefbi", "fghijklmno", "fghijklmno" } },
-  { 5,      10,    5, { "nefbi", "klmno", "klmno" } },
-  { NONE, NONE, NONE, { NULL, NULL, NULL } }
+                        "fghijklmnopqrstuvwxyz",
+                        "fbiadmkltzuxwpnoqrvys" } },
+  { 10,      5,   10, { "guxwpnefbi", "fghijklmno", "fghijklmno",
+                        "fbiadmkltz" } },
+  { 5,      10,    5, { "nefbi", "klmno", "klmno", "mkltz" } },
+  { NONE, NONE, NONE, { NULL, NULL, NULL, NULL } }
 };
 
     
@@ -97,6 +97,9 @@ static char *program=NULL;
 #ifdef RASQAL_INTERNAL
 #define STORE_RESULTS_FLAG 0x100
 #endif
+#define EXPLAIN_FLAG 0x101
+#define EXPLAIN_ANALYZE_FLAG 0x102
+#define NO_URI_INTERNING_FLAG 0x103
 
 static struct option long_options[] =
 {
@@ -123,6 +126,9 @@ static struct option long_options[] =
 #ifdef STORE_RESULTS_FLAG
   {"store-results", 1, 0, STORE_RESULTS_FLAG},
 #endif
+  {"explain", 1, 0, EXPLAIN_FLAG},
+  {"explain-analyze", 1, 0, EXPLAIN_ANALYZE_FLAG},
+  {"no-uri-interning", 0, 0, NO_URI_INTERNING_FLAG},
   {NULL, 0, 0, 0}
 };
 #endif
@@ -134,6 +140,9 @@ static int warning_count = 0;
 static int warning_level = -1;
 static int ignore_errors = 0;
 
+/* raptor world made here rather than by rasqal or NULL */
+static raptor_world* roqet_raptor_world = NULL;
+
 static const char *title_string = "Rasqal RDF query utility ";
 
 #define MAX_QUERY_ERROR_REPORT_LEN 512
@@ -178,6 +187,18 @@ roqet_log_handler(void *data, raptor_log_message *message)
 
 }
 
+static void
+roqet_free_world(rasqal_world* world)
+{
+  rasqal_free_world(world);
+
+  if(roqet_raptor_world) {
+    raptor_free_world(roqet_raptor_world);
+    roqet_raptor_world = NULL;
+  }
+}
+
+
 #define SPACES_LENGTH 80
 static const char spaces[SPACES_LENGTH + 1] = "                                                                                ";
 
@@ -623,6 +644,51 @@ roqet_call_sparql_service(rasqal_world* world, raptor_uri* service_uri,
 
 
 
+/*
+ * Write the query plan of @results to @fh, first reading all of the
+ * results if @analyze is set so that the plan has the actual rows
+ */
+static int
+roqet_write_explain(rasqal_query_results* results,
+                    raptor_world* raptor_world_ptr, FILE* fh,
+                    rasqal_query_explain_format format, int analyze)
+{
+  raptor_iostream* iostr;
+  int rc;
+
+  if(analyze) {
+    if(rasqal_query_results_is_bindings(results)) {
+      while(!rasqal_query_results_finished(results)) {
+        if(rasqal_query_results_next(results))
+          break;
+      }
+    } else if(rasqal_query_results_is_graph(results)) {
+      while(rasqal_query_results_get_triple(results)) {
+        if(rasqal_query_results_next_triple(results))
+          break;
+      }
+    }
+
+    if(rasqal_query_results_get_error(results) != RASQAL_QUERY_RESULTS_ERROR_NONE) {
+      fprintf(stderr, "%s: Query execution failed\n", program);
+      return 1;
+    }
+  }
+
+  iostr = raptor_new_iostream_to_file_handle(raptor_world_ptr, fh);
+  if(!iostr)
+    return 1;
+
+  rc = rasqal_query_results_write_explain(iostr, results, format);
+  raptor_free_iostream(iostr);
+
+  if(rc)
+    fprintf(stderr, "%s: Query has no plan to explain\n", program);
+
+  return rc;
+}
+
+
 static rasqal_query*
 roqet_init_query(rasqal_world *world, 
                  const char* ql_name,
@@ -840,6 +906,11 @@ print_help(rasqal_world* world, raptor_world* raptor_world_ptr)
   puts(HELP_TEXT("s URI", "source URI  ", "Same as `-G URI'"));
   puts(HELP_TEXT("v", "version         ", "Print the Rasqal version"));
   puts(HELP_TEXT("W LEVEL", "warnings LEVEL", HELP_PAD "Set warning message LEVEL from 0: none to 100: all"));
+#ifdef EXPLAIN_FLAG
+  puts(HELP_TEXT_LONG("explain FORMAT  ", "Print the query plan in FORMAT text or json" HELP_PAD "instead of the results"));
+  puts(HELP_TEXT_LONG("explain-analyze FORMAT", HELP_PAD "Run the query and print the query plan in FORMAT" HELP_PAD "text or json with the rows and time of each part"));
+  puts(HELP_TEXT_LONG("no-uri-interning", "Turn off raptor URI interning so that the" HELP_PAD "parallelism and prefetch features are used"));
+#endif
 #ifdef STORE_RESULTS_FLAG
   puts("\nDEBUG options:");
   puts(HELP_TEXT_LONG("store-results BOOL", "Set store results yes/no BOOL"));
@@ -891,6 +962,9 @@ main(int argc, char *argv[])
 #ifdef RASQAL_INTERNAL
   int store_results = -1;
 #endif
+  /* 1: print the query plan, 2: and execute with profiling first */
+  int explain = 0;
+  rasqal_query_explain_format explain_format = RASQAL_QUERY_EXPLAIN_FORMAT_TEXT;
   char* data_graph_parser_name = NULL;
   raptor_iostream* iostr = NULL;
   const unsigned char* service_uri_string = 0;
@@ -907,6 +981,30 @@ main(int argc, char *argv[])
   argv[0] = program;
 
   world = rasqal_new_world();
+
+#ifdef NO_URI_INTERNING_FLAG
+  /* URI interning is set before the raptor world is opened so before
+   * the other options are read */
+  if(world) {
+    int i;
+
+    for(i = 1; i < argc && strcmp(argv[i], "--"); i++) {
+      if(!strcmp(argv[i], "--no-uri-interning")) {
+        roqet_raptor_world = raptor_new_world();
+        if(!roqet_raptor_world ||
+           raptor_world_set_flag(roqet_raptor_world,
+                                 RAPTOR_WORLD_FLAG_URI_INTERNING, 0) ||
+           raptor_world_open(roqet_raptor_world)) {
+          fprintf(stderr, "%s: raptor_world init failed\n", program);
+          return(1);
+        }
+        rasqal_world_set_raptor(world, roqet_raptor_world);
+        break;
+      }
+    }
+  }
+#endif
+
   if(!world || rasqal_world_open(world)) {
     fprintf(stderr, "%s: rasqal_world init failed\n", program);
     return(1);
@@ -1002,7 +1100,7 @@ main(int argc, char *argv[])
             }
             fputs("Features are set with `" HELP_ARG(f, feature) " FEATURE=VALUE or `-f FEATURE'\nand take a decimal integer VALUE except where noted, defaulting to 1 if omitted.\n", stderr);
 
-            rasqal_free_world(world);
+            roqet_free_world(world);
             exit(0);
           } else {
             unsigned int i;
@@ -1185,7 +1283,7 @@ main(int argc, char *argv[])
       case 'v':
         fputs(rasqal_version_string, stdout);
         fputc('\n', stdout);
-        rasqal_free_world(world);
+        roqet_free_world(world);
         exit(0);
 
 #ifdef STORE_RESULTS_FLAG
@@ -1195,6 +1293,30 @@ main(int argc, char *argv[])
         break;
 #endif
 
+#ifdef EXPLAIN_FLAG
+      case EXPLAIN_FLAG:
+      case EXPLAIN_ANALYZE_FLAG:
+        explain = (c == EXPLAIN_ANALYZE_FLAG) ? 2 : 1;
+        if(optarg && !strcmp(optarg, "text"))
+          explain_format = RASQAL_QUERY_EXPLAIN_FORMAT_TEXT;
+        else if(optarg && !strcmp(optarg, "json"))
+          explain_format = RASQAL_QUERY_EXPLAIN_FORMAT_JSON;
+        else {
+          fprintf(stderr,
+                  "%s: invalid argument `%s' for `--%s' - valid arguments are text or json\n",
+                  program, optarg,
+                  (c == EXPLAIN_ANALYZE_FLAG) ? "explain-analyze" : "explain");
+          usage = 1;
+        }
+        break;
+#endif
+
+#ifdef NO_URI_INTERNING_FLAG
+      case NO_URI_INTERNING_FLAG:
+        /* set before the raptor world was opened */
+        break;
+#endif
+
     }
     
   }
@@ -1229,14 +1351,14 @@ main(int argc, char *argv[])
     }
     fprintf(stderr, "Try `%s " HELP_ARG(h, help) "' for more information.\n",
                     program);
-    rasqal_free_world(world);
+    roqet_free_world(world);
 
     exit(1);
   }
 
   if(help) {
     print_help(world, raptor_world_ptr);
-    rasqal_free_world(world);
+    roqet_free_world(world);
 
     exit(0);
   }
@@ -1387,6 +1509,13 @@ main(int argc, char *argv[])
       if(output_format != QUERY_OUTPUT_NONE && !quiet)
         roqet_print_query(rq, raptor_world_ptr, output_format, base_uri);
       
+      /* LAQRS EXPLAIN SELECT ... */
+      if(!explain && rasqal_query_get_explain(rq))
+        explain = 1;
+
+      if(explain == 2)
+        rasqal_query_set_feature(rq, RASQAL_FEATURE_PROFILE, 1);
+      
       if(!dryrun)
         results = rasqal_query_execute(rq);
       break;
@@ -1447,7 +1576,10 @@ main(int argc, char *argv[])
     goto tidy_query;
   }
 
-  if(rasqal_query_results_is_bindings(results)) {
+  if(explain) {
+    rc = roqet_write_explain(results, raptor_world_ptr, stdout,
+                             explain_format, (explain == 2));
+  } else if(rasqal_query_results_is_bindings(results)) {
     if(result_format_name)
       rc = print_formatted_query_results(world, results,
                                          raptor_world_ptr, stdout,
@@ -1497,7 +1629,7 @@ main(int argc, char *argv[])
   if(service_uri)
     raptor_free_uri(service_uri);
 
-  rasqal_free_world(world);
+  roqet_free_world(world);
 
   if(error_count && !ignore_errors)
     return 1;